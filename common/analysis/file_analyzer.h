@@ -40,12 +40,14 @@
 #define VERIBLE_COMMON_ANALYSIS_FILE_ANALYZER_H_
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "common/lexer/lexer.h"
 #include "common/parser/parse.h"
+#include "common/strings/mem_block.h"
 #include "common/text/text_structure.h"
 #include "common/text/token_info.h"
 
@@ -77,6 +79,12 @@ class FileAnalyzer : public TextStructure {
   explicit FileAnalyzer(absl::string_view contents, absl::string_view filename)
       : TextStructure(contents), filename_(filename), rejected_tokens_() {}
 
+  // Takes shared ownership of 'contents' instead of copying them.
+  FileAnalyzer(std::shared_ptr<MemBlock> contents, absl::string_view filename)
+      : TextStructure(std::move(contents)),
+        filename_(filename),
+        rejected_tokens_() {}
+
   virtual ~FileAnalyzer() {}
 
   virtual absl::Status Tokenize() = 0;
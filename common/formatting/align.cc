@@ -15,14 +15,17 @@
 #include "common/formatting/align.h"
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <numeric>
+#include <thread>
 #include <vector>
 
 #include "absl/strings/str_join.h"
+#include "absl/types/span.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/token_partition_tree.h"
 #include "common/formatting/unwrapped_line.h"
@@ -130,8 +133,33 @@ struct AlignedColumnConfiguration {
   }
 };
 
-typedef std::vector<AlignmentCell> AlignmentRow;
-typedef std::vector<AlignmentRow> AlignmentMatrix;
+typedef absl::Span<AlignmentCell> AlignmentRow;
+typedef absl::Span<const AlignmentCell> ConstAlignmentRow;
+
+// Cells of all rows of an alignment group, stored contiguously in row-major
+// order.  Every row has one cell per column.
+class AlignmentMatrix {
+ public:
+  AlignmentMatrix() = default;
+  AlignmentMatrix(size_t num_rows, size_t num_columns)
+      : num_rows_(num_rows),
+        num_columns_(num_columns),
+        cells_(num_rows * num_columns) {}
+
+  size_t NumRows() const { return num_rows_; }
+
+  AlignmentRow Row(size_t i) {
+    return AlignmentRow(cells_.data() + i * num_columns_, num_columns_);
+  }
+  ConstAlignmentRow Row(size_t i) const {
+    return ConstAlignmentRow(cells_.data() + i * num_columns_, num_columns_);
+  }
+
+ private:
+  size_t num_rows_ = 0;
+  size_t num_columns_ = 0;
+  std::vector<AlignmentCell> cells_;
+};
 
 void ColumnSchemaScanner::ReserveNewColumn(
     const Symbol& symbol, const AlignmentColumnProperties& properties,
@@ -215,8 +243,8 @@ class ColumnSchemaAggregator {
   std::vector<SyntaxTreePath> column_positions_;
 };
 
-static SequenceStreamFormatter<AlignmentRow> MatrixRowFormatter(
-    const AlignmentRow& row) {
+static SequenceStreamFormatter<ConstAlignmentRow> MatrixRowFormatter(
+    const ConstAlignmentRow& row) {
   return SequenceFormatter(row, " | ", "< ", " >");
 }
 
@@ -232,7 +260,7 @@ struct AlignmentRowData {
 // Translate a sparse set of columns into a fully-populated matrix row.
 static void FillAlignmentRow(
     const AlignmentRowData& row_data,
-    const std::vector<SyntaxTreePath>& column_positions, AlignmentRow* row) {
+    const std::vector<SyntaxTreePath>& column_positions, AlignmentRow row) {
   VLOG(2) << __FUNCTION__;
   const auto& sparse_columns(row_data.sparse_columns);
   MutableFormatTokenRange partition_token_range(row_data.ftoken_range);
@@ -265,7 +293,7 @@ static void FillAlignmentRow(
     const MutableFormatTokenRange empty_filler(token_iter, token_iter);
     for (; last_column_index <= column_index; ++last_column_index) {
       VLOG(3) << "empty at column " << last_column_index;
-      (*row)[last_column_index].tokens = empty_filler;
+      row[last_column_index].tokens = empty_filler;
     }
     // At this point, the current cell has only seen its lower bound.
     // The upper bound will be set in a separate pass.
@@ -276,40 +304,39 @@ static void FillAlignmentRow(
   for (const int n = column_positions.size(); last_column_index < n;
        ++last_column_index) {
     VLOG(3) << "empty at column " << last_column_index;
-    (*row)[last_column_index].tokens = empty_filler;
+    row[last_column_index].tokens = empty_filler;
   }
 
   // In this pass, set the upper bounds of cells' token ranges.
   auto upper_bound = token_end;
-  for (auto& cell : verible::reversed_view(*row)) {
+  for (auto& cell : verible::reversed_view(row)) {
     cell.tokens.set_end(upper_bound);
     upper_bound = cell.tokens.begin();
   }
-  VLOG(2) << "end of " << __FUNCTION__ << ", row: " << MatrixRowFormatter(*row);
+  VLOG(2) << "end of " << __FUNCTION__ << ", row: " << MatrixRowFormatter(row);
 }
 
-struct MatrixCellSizeFormatter {
-  const AlignmentMatrix& matrix;
-};
-
-std::ostream& operator<<(std::ostream& stream,
-                         const MatrixCellSizeFormatter& p) {
-  const AlignmentMatrix& matrix = p.matrix;
-  for (const auto& row : matrix) {
-    stream << '['
-           << absl::StrJoin(row, ", ",
-                            [](std::string* out, const AlignmentCell& cell) {
-                              absl::StrAppend(out, cell.left_border_width, "+",
-                                              cell.compact_width);
-                            })
-           << ']' << std::endl;
-  }
-  return stream;
+static SequenceStreamFormatter<std::vector<std::string>> CellSizeFormatter(
+    const std::vector<std::string>& sizes) {
+  return SequenceFormatter(sizes, ", ", "[", "]");
 }
 
-static void ComputeCellWidths(AlignmentMatrix* matrix) {
-  VLOG(2) << __FUNCTION__;
-  for (auto& row : *matrix) {
+typedef std::vector<AlignedColumnConfiguration> AlignedFormattingColumnSchema;
+
+// Computes cell widths, column widths, and the widest unaligned row epilog
+// in a single pass over the rows of a matrix, as they are filled.
+class ColumnWidthAccumulator {
+ public:
+  explicit ColumnWidthAccumulator(
+      const std::vector<AlignmentColumnProperties>& column_properties)
+      : column_properties_(column_properties),
+        column_configs_(column_properties.size()) {}
+
+  // Computes the widths of the cells of 'row', and aggregates them into
+  // column widths.  'epilog_width' is the width of unaligned tokens that
+  // follow the row (e.g. trailing comments).
+  void AddRow(AlignmentRow row, int epilog_width, bool is_last_row) {
+    if (row.empty()) return;
     for (auto& cell : row) {
       cell.UpdateWidths();
     }
@@ -317,57 +344,62 @@ static void ComputeCellWidths(AlignmentMatrix* matrix) {
     // and thus should not factor into alignment calculation.
     // Note: this is different from how StateNode calculates column positions.
     row.front().left_border_width = 0;
-  }
-  VLOG(2) << "end of " << __FUNCTION__ << ", cell sizes:\n"
-          << MatrixCellSizeFormatter{*matrix};
-}
-
-typedef std::vector<AlignedColumnConfiguration> AlignedFormattingColumnSchema;
+    if (VLOG_IS_ON(2)) {
+      std::vector<std::string> sizes;
+      for (const auto& cell : row) {
+        sizes.push_back(absl::StrCat(cell.left_border_width, "+",
+                                     cell.compact_width));
+      }
+      VLOG(2) << "cell sizes: " << CellSizeFormatter(sizes);
+    }
 
-static AlignedFormattingColumnSchema ComputeColumnWidths(
-    const AlignmentMatrix& matrix,
-    const std::vector<AlignmentColumnProperties>& column_properties) {
-  VLOG(2) << __FUNCTION__;
-  AlignedFormattingColumnSchema column_configs(matrix.front().size());
-
-  // Check which cell before delimiter is the longest
-  // If this cell is in the last row, the sizes of column with delimiter
-  // must be set to 0
-  int longest_cell_before_delimiter = 0;
-  bool align_to_last_row = false;
-  for (const AlignmentRow& row : matrix) {
-    auto column_prop_iter = column_properties.begin();
-    for (const AlignmentCell& cell : row) {
-      const auto next_prop = std::next(column_prop_iter, 1);
-      if (next_prop != column_properties.end() &&
-          next_prop->contains_delimiter) {
-        if (longest_cell_before_delimiter < cell.TotalWidth()) {
-          longest_cell_before_delimiter = cell.TotalWidth();
-          if (&row == &matrix.back()) align_to_last_row = true;
+    // Check which cell before delimiter is the longest.
+    // If this cell is in the last row, the sizes of column with delimiter
+    // must be set to 0.
+    for (size_t i = 0; i + 1 < row.size(); ++i) {
+      if (column_properties_[i + 1].contains_delimiter) {
+        if (longest_cell_before_delimiter_ < row[i].TotalWidth()) {
+          longest_cell_before_delimiter_ = row[i].TotalWidth();
+          if (is_last_row) align_to_last_row_ = true;
         }
         break;
       }
-      ++column_prop_iter;
     }
-  }
 
-  for (const AlignmentRow& row : matrix) {
-    auto column_iter = column_configs.begin();
-    auto column_prop_iter = column_properties.begin();
+    auto column_iter = column_configs_.begin();
     for (const AlignmentCell& cell : row) {
-      if (column_prop_iter->contains_delimiter && align_to_last_row) {
-        column_iter->width = 0;
-        column_iter->left_border = 0;
-      } else {
-        column_iter->UpdateFromCell(cell);
-      }
+      column_iter->UpdateFromCell(cell);
       ++column_iter;
-      ++column_prop_iter;
     }
+    max_epilog_width_ = std::max(max_epilog_width_, epilog_width);
   }
-  VLOG(2) << "end of " << __FUNCTION__;
-  return column_configs;
-}
+
+  // Returns the aggregated column widths, after all rows have been added.
+  AlignedFormattingColumnSchema ColumnConfigs() const {
+    AlignedFormattingColumnSchema result(column_configs_);
+    if (align_to_last_row_) {
+      auto column_prop_iter = column_properties_.begin();
+      for (auto& column : result) {
+        if (column_prop_iter->contains_delimiter) {
+          column.width = 0;
+          column.left_border = 0;
+        }
+        ++column_prop_iter;
+      }
+    }
+    return result;
+  }
+
+  // Returns the widest unaligned tail among all (non-empty) rows.
+  int MaxEpilogWidth() const { return max_epilog_width_; }
+
+ private:
+  const std::vector<AlignmentColumnProperties>& column_properties_;
+  AlignedFormattingColumnSchema column_configs_;
+  int longest_cell_before_delimiter_ = 0;
+  bool align_to_last_row_ = false;
+  int max_epilog_width_ = 0;
+};
 
 // Saved spacing mutation so that it can be examined before applying.
 // There is one of these for every format token that immediately follows an
@@ -395,12 +427,12 @@ struct DeferredTokenAlignment {
 };
 
 // Align cells by adjusting pre-token spacing for a single row.
-static std::vector<DeferredTokenAlignment> ComputeAlignedRowSpacings(
+// Spacing changes are appended to 'align_actions'.
+static void ComputeAlignedRowSpacings(
     const AlignedFormattingColumnSchema& column_configs,
     const std::vector<AlignmentColumnProperties>& properties,
-    const AlignmentRow& row) {
+    ConstAlignmentRow row, std::vector<DeferredTokenAlignment>* align_actions) {
   VLOG(2) << __FUNCTION__;
-  std::vector<DeferredTokenAlignment> align_actions;
   int accrued_spaces = 0;
   auto column_iter = column_configs.begin();
   auto properties_iter = properties.begin();
@@ -428,7 +460,7 @@ static std::vector<DeferredTokenAlignment> ComputeAlignedRowSpacings(
         left_spacing = accrued_spaces + padding;
         accrued_spaces = 0;
       }
-      align_actions.emplace_back(&ftoken, left_spacing);
+      align_actions->emplace_back(&ftoken, left_spacing);
       VLOG(2) << "left_spacing = " << left_spacing;
     }
     VLOG(2) << "accrued_spaces = " << accrued_spaces;
@@ -436,7 +468,6 @@ static std::vector<DeferredTokenAlignment> ComputeAlignedRowSpacings(
     ++properties_iter;
   }
   VLOG(2) << "end of " << __FUNCTION__;
-  return align_actions;
 }
 
 // Given a const_iterator and the original mutable container, return
@@ -461,7 +492,7 @@ static MutableFormatTokenRange ConvertToMutableFormatTokenRange(
 }
 
 static FormatTokenRange EpilogRange(const TokenPartitionTree& partition,
-                                    const AlignmentRow& row) {
+                                    ConstAlignmentRow row) {
   // Identify the unaligned epilog tokens of this 'partition', i.e. those not
   // spanned by 'row'.
   auto partition_end = partition.Value().TokensRange().end();
@@ -471,7 +502,7 @@ static FormatTokenRange EpilogRange(const TokenPartitionTree& partition,
 
 // Mark format tokens as must-append to remove future decision-making.
 static void CommitAlignmentDecisionToRow(
-    TokenPartitionTree& partition, const AlignmentRow& row,
+    TokenPartitionTree& partition, ConstAlignmentRow row,
     MutableFormatTokenRange::iterator ftoken_base) {
   if (!row.empty()) {
     const auto ftoken_range = ConvertToMutableFormatTokenRange(
@@ -507,45 +538,23 @@ static MutableFormatTokenRange GetMutableFormatTokenRange(
       FormatTokenRange(range_begin, range_end), ftoken_base);
 }
 
-// This width calculation accounts for the unaligned tokens in the tail position
-// of each aligned row (e.g. unaligned trailing comments).
-static bool AlignedRowsFitUnderColumnLimit(
-    const std::vector<TokenPartitionIterator>& rows,
-    const AlignmentMatrix& matrix, int total_column_width, int column_limit) {
-  auto partition_iter = rows.begin();
-  for (const auto& row : matrix) {
-    if (!row.empty()) {
-      // Identify the unaligned epilog text on each partition.
-      const FormatTokenRange epilog_range(EpilogRange(**partition_iter, row));
-      const int aligned_partition_width =
-          total_column_width + EffectiveCellWidth(epilog_range);
-      if (aligned_partition_width > column_limit) {
-        VLOG(1) << "Total aligned partition width " << aligned_partition_width
-                << " exceeds limit " << column_limit
-                << ", so not aligning this group.";
-        return false;
-      }
-    }
-    ++partition_iter;
-  }
-  return true;
-}
-
 // Holds alignment calculations for an alignable group of token partitions.
 struct AlignablePartitionGroup::GroupAlignmentData {
   // Contains alignment calculations.
   AlignmentMatrix matrix;
 
+  // Spacing changes of all rows, in order.
   // If this is empty, don't do any alignment.
-  std::vector<std::vector<DeferredTokenAlignment>> align_actions_2D;
+  std::vector<DeferredTokenAlignment> align_actions;
+
+  // The user-elected or inferred policy.
+  AlignmentPolicy policy = AlignmentPolicy::kPreserve;
 
   int MaxAbsoluteAlignVsFlushLeftSpacingDifference() const {
     int result = std::numeric_limits<int>::min();
-    for (const auto& align_actions : align_actions_2D) {
-      for (const auto& action : align_actions) {
-        int abs_diff = std::abs(action.AlignVsFlushLeftSpacingDifference());
-        result = std::max(abs_diff, result);
-      }
+    for (const auto& action : align_actions) {
+      int abs_diff = std::abs(action.AlignVsFlushLeftSpacingDifference());
+      result = std::max(abs_diff, result);
     }
     return result;
   }
@@ -579,16 +588,16 @@ AlignablePartitionGroup::CalculateAlignmentSpacings(
     // Each row should correspond to an individual list element
     const UnwrappedLine& unwrapped_line = row->Value();
 
-    const AlignmentRowData row_data{
+    AlignmentRowData row_data{
         // Extract the range of format tokens whose spacings should be adjusted.
         GetMutableFormatTokenRange(unwrapped_line, ftoken_base),
         // Scan each token-range for cell boundaries based on syntax,
         // and establish partial ordering based on syntax tree paths.
         cell_scanner_gen(*row)};
 
-    alignment_row_data.emplace_back(row_data);
     // Aggregate union of all column keys (syntax tree paths).
     column_schema.Collect(row_data.sparse_columns);
+    alignment_row_data.push_back(std::move(row_data));
   }
 
   // Map SyntaxTreePaths to column indices.
@@ -598,29 +607,30 @@ AlignablePartitionGroup::CalculateAlignmentSpacings(
   const size_t num_columns = column_schema.NumUniqueColumns();
   VLOG(2) << "unique columns: " << num_columns;
 
+  // Extract other non-computed column properties.
+  const auto column_properties = column_schema.ColumnProperties();
+
   // Populate a matrix of cells, where cells span token ranges.
   // Null cells (due to optional constructs) are represented by empty ranges,
   // effectively width 0.
+  // Cell and column widths are computed in the same pass.
   VLOG(2) << "Filling dense matrix from sparse representation";
-  result.matrix.resize(rows.size());
-  {
-    auto row_data_iter = alignment_row_data.cbegin();
-    for (auto& row : result.matrix) {
-      row.resize(num_columns);
-      FillAlignmentRow(*row_data_iter, column_positions, &row);
-      ++row_data_iter;
-    }
+  result.matrix = AlignmentMatrix(rows.size(), num_columns);
+  ColumnWidthAccumulator column_widths(column_properties);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const AlignmentRow row(result.matrix.Row(i));
+    FillAlignmentRow(alignment_row_data[i], column_positions, row);
+    // The sparse columns are no longer needed.
+    alignment_row_data[i].sparse_columns = {};
+    column_widths.AddRow(
+        row,
+        row.empty() ? 0 : EffectiveCellWidth(EpilogRange(*rows[i], row)),
+        i + 1 == rows.size());
   }
 
-  // Compute compact sizes per cell.
-  ComputeCellWidths(&result.matrix);
-
-  // Extract other non-computed column properties.
-  const auto column_properties = column_schema.ColumnProperties();
-
-  // Compute max widths per column.
-  AlignedFormattingColumnSchema column_configs(
-      ComputeColumnWidths(result.matrix, column_properties));
+  // Max widths per column.
+  const AlignedFormattingColumnSchema column_configs(
+      column_widths.ColumnConfigs());
 
   {
     // Total width does not include initial left-indentation.
@@ -633,18 +643,23 @@ AlignablePartitionGroup::CalculateAlignmentSpacings(
         });
     VLOG(2) << "Total (aligned) column width = " << total_column_width;
     // if the aligned columns would exceed the column limit, then refuse to
-    // align for now.  However, this check alone does not include text that
-    // follows the last aligned column, like trailing comments and EOL comments.
+    // align for now.
     if (total_column_width > column_limit) {
       VLOG(1) << "Total aligned column width " << total_column_width
               << " exceeds limit " << column_limit
               << ", so not aligning this group.";
       return result;
     }
-    // Also check for length of unaligned trailing tokens.
-    if (!AlignedRowsFitUnderColumnLimit(rows, result.matrix, total_column_width,
-                                        column_limit))
+    // Also check for length of unaligned trailing tokens, like trailing
+    // comments and EOL comments.
+    const int aligned_partition_width =
+        total_column_width + column_widths.MaxEpilogWidth();
+    if (aligned_partition_width > column_limit) {
+      VLOG(1) << "Total aligned partition width " << aligned_partition_width
+              << " exceeds limit " << column_limit
+              << ", so not aligning this group.";
       return result;
+    }
   }
 
   // TODO(fangism): implement overflow mitigation fallback strategies.
@@ -652,12 +667,10 @@ AlignablePartitionGroup::CalculateAlignmentSpacings(
   // At this point, the proposed alignment/padding 'fits'.
 
   // Compute pre-token spacings of each row to align to the column configs.
-  // Store the mutation set in a 2D structure that reflects the original token
-  // partitions and alignment matrix representation.
-  result.align_actions_2D.reserve(result.matrix.size());
-  for (const auto& row : result.matrix) {
-    result.align_actions_2D.push_back(
-        ComputeAlignedRowSpacings(column_configs, column_properties, row));
+  // Store the mutation set in one flat array, in row order.
+  for (size_t i = 0; i < result.matrix.NumRows(); ++i) {
+    ComputeAlignedRowSpacings(column_configs, column_properties,
+                              result.matrix.Row(i), &result.align_actions);
   }
   return result;
 }
@@ -668,19 +681,14 @@ void AlignablePartitionGroup::ApplyAlignment(
     const GroupAlignmentData& align_data,
     MutableFormatTokenRange::iterator ftoken_base) const {
   // Apply spacing adjustments (mutates format tokens)
-  for (const auto& align_actions : align_data.align_actions_2D) {
-    for (const auto& action : align_actions) action.Apply();
-  }
+  for (const auto& action : align_data.align_actions) action.Apply();
 
   // Signal that these partitions spacing/wrapping decisions have already been
   // solved (append everything because they fit on one line).
-  {
-    auto partition_iter = alignable_rows_.begin();
-    for (auto& row : align_data.matrix) {
-      // Commits to appending all tokens in this row (mutates format tokens)
-      CommitAlignmentDecisionToRow(**partition_iter, row, ftoken_base);
-      ++partition_iter;
-    }
+  for (size_t i = 0; i < align_data.matrix.NumRows(); ++i) {
+    // Commits to appending all tokens in this row (mutates format tokens)
+    CommitAlignmentDecisionToRow(*alignable_rows_[i], align_data.matrix.Row(i),
+                                 ftoken_base);
   }
   VLOG(1) << "end of " << __FUNCTION__;
 }
@@ -795,10 +803,9 @@ AlignablePartitionGroup::GroupAlignmentData::InferUserIntendedAlignmentPolicy(
   return AlignmentPolicy::kPreserve;
 }
 
-void AlignablePartitionGroup::Align(
-    absl::string_view full_text, int column_limit,
-    std::vector<PreFormatToken>* ftokens) const {
-  const TokenPartitionRange partition_range(Range());
+AlignablePartitionGroup::GroupAlignmentData
+AlignablePartitionGroup::CalculateAlignment(
+    int column_limit, std::vector<PreFormatToken>* ftokens) const {
   // Compute dry-run of alignment spacings if it is needed.
   AlignmentPolicy policy = alignment_policy_;
   VLOG(2) << "AlignmentPolicy: " << policy;
@@ -816,14 +823,20 @@ void AlignablePartitionGroup::Align(
 
   // If enabled, try to decide automatically based on heurstics.
   if (policy == AlignmentPolicy::kInferUserIntent) {
-    policy = align_data.InferUserIntendedAlignmentPolicy(partition_range);
+    policy = align_data.InferUserIntendedAlignmentPolicy(Range());
     VLOG(2) << "AlignmentPolicy (automatic): " << policy;
   }
+  align_data.policy = policy;
+  return align_data;
+}
 
+void AlignablePartitionGroup::ApplyCalculatedAlignment(
+    const GroupAlignmentData& align_data, absl::string_view full_text,
+    std::vector<PreFormatToken>* ftokens) const {
   // Align or not, depending on user-elected or inferred policy.
-  switch (policy) {
+  switch (align_data.policy) {
     case AlignmentPolicy::kAlign: {
-      if (!align_data.align_actions_2D.empty()) {
+      if (!align_data.align_actions.empty()) {
         // This modifies format tokens' spacing values.
         ApplyAlignment(align_data, ftokens->begin());
       }
@@ -833,11 +846,101 @@ void AlignablePartitionGroup::Align(
       // This is already the default behavior elsewhere.  Nothing else to do.
       break;
     default:
-      IndentButPreserveOtherSpacing(partition_range, full_text, ftokens);
+      IndentButPreserveOtherSpacing(Range(), full_text, ftokens);
       break;
   }
 }
 
+void AlignablePartitionGroup::Align(
+    absl::string_view full_text, int column_limit,
+    std::vector<PreFormatToken>* ftokens) const {
+  ApplyCalculatedAlignment(CalculateAlignment(column_limit, ftokens),
+                           full_text, ftokens);
+}
+
+// Below this many rows in total, alignment groups are not worth the cost of
+// starting threads.
+static constexpr size_t kMinRowsForConcurrentAlignment = 1000;
+
+void AlignPartitionGroups(
+    const std::vector<AlignablePartitionGroup>& alignment_groups,
+    std::vector<PreFormatToken>* ftokens, absl::string_view full_text,
+    const ByteOffsetSet& disabled_byte_ranges, int column_limit) {
+  VLOG(1) << __FUNCTION__;
+  const size_t num_groups = alignment_groups.size();
+  // Within an aligned group, if the group is partially disabled
+  // due to incremental formatting, then leave the new lines
+  // unformatted rather than falling back to compact-left formatting.
+  // However, allow the first token to be correctly indented.
+  // TODO(fangism): instead of disabling the whole range, sub-partition
+  // it one more level, and operate on those ranges, essentially treating
+  // no-format ranges like alignment group boundaries.
+  // Requires IntervalSet::Intersect operation.
+  // TODO(b/159824483): attempt to detect and re-use pre-existing alignment
+  std::vector<bool> disabled(num_groups, true);
+  size_t total_rows = 0;
+  size_t enabled_groups = 0;
+  for (size_t i = 0; i < num_groups; ++i) {
+    const AlignablePartitionGroup& group(alignment_groups[i]);
+    if (group.IsEmpty()) continue;
+    disabled[i] = AnyPartitionSubRangeIsDisabled(group.Range(), full_text,
+                                                 disabled_byte_ranges);
+    if (!disabled[i]) {
+      total_rows += group.alignable_rows_.size();
+      ++enabled_groups;
+    }
+  }
+
+  const size_t num_threads = std::min<size_t>(
+      enabled_groups, std::max(1u, std::thread::hardware_concurrency()));
+  if (num_threads <= 1 || total_rows < kMinRowsForConcurrentAlignment) {
+    for (size_t i = 0; i < num_groups; ++i) {
+      if (alignment_groups[i].IsEmpty()) continue;
+      if (disabled[i]) {
+        IndentButPreserveOtherSpacing(alignment_groups[i].Range(), full_text,
+                                      ftokens);
+      } else {
+        // Calculate alignment and possibly apply it depending on alignment
+        // policy.
+        alignment_groups[i].Align(full_text, column_limit, ftokens);
+      }
+    }
+    return;
+  }
+
+  // Groups span disjoint ranges of tokens, and calculation only reads
+  // format tokens, so groups can be calculated concurrently.
+  // Modifications are applied afterwards, in order.
+  VLOG(1) << "aligning " << enabled_groups << " groups (" << total_rows
+          << " rows) with " << num_threads << " threads";
+  std::vector<AlignablePartitionGroup::GroupAlignmentData> align_data(
+      num_groups);
+  std::atomic<size_t> next_group(0);
+  const auto worker = [&]() {
+    for (size_t i = next_group++; i < num_groups; i = next_group++) {
+      if (disabled[i]) continue;
+      align_data[i] =
+          alignment_groups[i].CalculateAlignment(column_limit, ftokens);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t t = 1; t < num_threads; ++t) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+
+  for (size_t i = 0; i < num_groups; ++i) {
+    if (alignment_groups[i].IsEmpty()) continue;
+    if (disabled[i]) {
+      IndentButPreserveOtherSpacing(alignment_groups[i].Range(), full_text,
+                                    ftokens);
+    } else {
+      alignment_groups[i].ApplyCalculatedAlignment(align_data[i], full_text,
+                                                   ftokens);
+    }
+  }
+}
+
 void TabularAlignTokens(
     TokenPartitionTree* partition_ptr,
     const ExtractAlignmentGroupsFunction& extract_alignment_groups,
@@ -856,29 +959,8 @@ void TabularAlignTokens(
   VLOG(1) << "extracting alignment partition groups...";
   const std::vector<AlignablePartitionGroup> alignment_groups(
       extract_alignment_groups(subpartitions_range));
-  for (const auto& alignment_group : alignment_groups) {
-    const TokenPartitionRange partition_range(alignment_group.Range());
-    if (partition_range.empty()) continue;
-    if (AnyPartitionSubRangeIsDisabled(partition_range, full_text,
-                                       disabled_byte_ranges)) {
-      // Within an aligned group, if the group is partially disabled
-      // due to incremental formatting, then leave the new lines
-      // unformatted rather than falling back to compact-left formatting.
-      // However, allow the first token to be correctly indented.
-      IndentButPreserveOtherSpacing(partition_range, full_text, ftokens);
-      continue;
-
-      // TODO(fangism): instead of disabling the whole range, sub-partition
-      // it one more level, and operate on those ranges, essentially treating
-      // no-format ranges like alignment group boundaries.
-      // Requires IntervalSet::Intersect operation.
-
-      // TODO(b/159824483): attempt to detect and re-use pre-existing alignment
-    }
-
-    // Calculate alignment and possibly apply it depending on alignment policy.
-    alignment_group.Align(full_text, column_limit, ftokens);
-  }
+  AlignPartitionGroups(alignment_groups, ftokens, full_text,
+                       disabled_byte_ranges, column_limit);
   VLOG(1) << "end of " << __FUNCTION__;
 }
 
@@ -238,6 +238,22 @@ class AlignablePartitionGroup {
 
  private:
   struct GroupAlignmentData;
+
+  // First half of Align(): decides the policy and computes spacings, without
+  // modifying 'ftokens', so independent groups can do this concurrently.
+  GroupAlignmentData CalculateAlignment(
+      int column_limit, std::vector<PreFormatToken>* ftokens) const;
+
+  // Second half of Align(): applies the result of CalculateAlignment().
+  void ApplyCalculatedAlignment(const GroupAlignmentData& align_data,
+                                absl::string_view full_text,
+                                std::vector<PreFormatToken>* ftokens) const;
+
+  friend void AlignPartitionGroups(
+      const std::vector<AlignablePartitionGroup>& alignment_groups,
+      std::vector<PreFormatToken>* ftokens, absl::string_view full_text,
+      const ByteOffsetSet& disabled_byte_ranges, int column_limit);
+
   static GroupAlignmentData CalculateAlignmentSpacings(
       const std::vector<TokenPartitionIterator>& rows,
       const AlignmentCellScannerFunction& cell_scanner_gen,
@@ -258,6 +274,16 @@ class AlignablePartitionGroup {
   const AlignmentPolicy alignment_policy_;
 };
 
+// Aligns each of 'alignment_groups', which must span mutually disjoint
+// ranges of token partitions.  Groups that overlap 'disabled_byte_ranges' are
+// only indented, and otherwise keep their original spacing.
+// When there are many rows to align, independent groups are calculated
+// concurrently; 'ftokens' are only modified afterwards, in group order.
+void AlignPartitionGroups(
+    const std::vector<AlignablePartitionGroup>& alignment_groups,
+    std::vector<PreFormatToken>* ftokens, absl::string_view full_text,
+    const ByteOffsetSet& disabled_byte_ranges, int column_limit);
+
 // This is the interface used to sub-divide a range of token partitions into
 // a sequence of sub-ranges for the purposes of formatting aligned groups.
 using ExtractAlignmentGroupsFunction =
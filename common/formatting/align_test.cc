@@ -19,11 +19,13 @@
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/token_partition_tree.h"
 #include "common/formatting/unwrapped_line_test_utils.h"
 #include "common/text/tree_builder_test_util.h"
+#include "common/text/tree_utils.h"
 #include "common/util/range.h"
 #include "common/util/spacer.h"
 #include "gmock/gmock.h"
@@ -583,6 +585,12 @@ class MultiAlignmentGroupTest : public AlignmentTestFixture {
     };
   }
 
+  // For subclasses to initialize the syntax tree and partitions.
+  explicit MultiAlignmentGroupTest(absl::string_view text)
+      : AlignmentTestFixture(text),
+        syntax_tree_(nullptr),
+        partition_(/* temporary */ UnwrappedLine()) {}
+
   std::string Render() const {
     std::ostringstream stream;
     int position = 0;
@@ -628,6 +636,65 @@ TEST_F(MultiAlignmentGroupTest, BlankLineSeparatedGroups) {
             "     six   eight\n");
 }
 
+// Generates groups of two-token rows, separated by blank lines.
+// Within each group, first tokens have lengths 1 through 5.
+static std::string ManyGroupsText(int num_groups, int rows_per_group) {
+  std::string text;
+  for (int g = 0; g < num_groups; ++g) {
+    if (g > 0) text += "\n";
+    for (int r = 0; r < rows_per_group; ++r) {
+      absl::StrAppend(&text, std::string(1 + (r * 7 + g) % 5, 'a'), " b\n");
+    }
+  }
+  return text;
+}
+
+class ManyAlignmentGroupsTest : public MultiAlignmentGroupTest {
+ public:
+  static constexpr int kNumGroups = 4;
+  // Enough rows in total to calculate alignment groups concurrently.
+  static constexpr int kRowsPerGroup = 300;
+
+  ManyAlignmentGroupsTest()
+      : MultiAlignmentGroupTest(ManyGroupsText(kNumGroups, kRowsPerGroup)) {
+    syntax_tree_ = TNode(1);
+    auto& root = SymbolCastToNode(*syntax_tree_);
+    const auto begin = pre_format_tokens_.begin();
+    UnwrappedLine all(0, begin);
+    all.SpanUpToToken(pre_format_tokens_.end());
+    all.SetOrigin(&*syntax_tree_);
+    partition_ = TokenPartitionTree{all};
+    for (size_t i = 0; i < tokens_.size(); i += 2) {
+      root.AppendChild(TNode(2, Leaf(1, tokens_[i]), Leaf(1, tokens_[i + 1])));
+      UnwrappedLine row(0, begin + i);
+      row.SpanUpToToken(begin + i + 2);
+      row.SetOrigin(root.children().back().get());
+      partition_.NewChild(row);
+    }
+  }
+};
+
+TEST_F(ManyAlignmentGroupsTest, AlignsEveryGroup) {
+  // Require 1 space between tokens.
+  for (auto& ftoken : pre_format_tokens_) {
+    ftoken.before.spaces_required = 1;
+  }
+
+  TabularAlignTokens(&partition_, kDefaultAlignmentHandler, &pre_format_tokens_,
+                     sample_, ByteOffsetSet(), 40);
+
+  std::string expected;
+  for (int g = 0; g < kNumGroups; ++g) {
+    if (g > 0) expected += "\n";
+    for (int r = 0; r < kRowsPerGroup; ++r) {
+      const int length = 1 + (r * 7 + g) % 5;
+      absl::StrAppend(&expected, std::string(length, 'a'),
+                      std::string(5 - length + 1, ' '), "b\n");
+    }
+  }
+  EXPECT_EQ(Render(), expected);
+}
+
 // TODO(fangism): test case that demonstrates repeated constructs in a deeper
 // syntax tree.
 
@@ -24,7 +24,6 @@
 #include "common/strings/range.h"
 #include "common/text/token_info.h"
 #include "common/util/logging.h"
-#include "common/util/spacer.h"
 
 namespace verible {
 
@@ -152,28 +151,36 @@ absl::string_view FormattedToken::OriginalLeadingSpaces() const {
 }
 
 std::ostream& FormattedToken::FormattedText(std::ostream& stream) const {
+  std::string output;
+  AppendFormattedText(&output);
+  return stream << output;
+}
+
+void FormattedToken::AppendFormattedText(std::string* output) const {
   switch (before.action) {
     case SpacingDecision::Preserve: {
       if (before.preserved_space_start != nullptr) {
         // Calculate string_view range of pre-existing spaces, and print that.
-        stream << OriginalLeadingSpaces();
+        const absl::string_view spaces(OriginalLeadingSpaces());
+        output->append(spaces.data(), spaces.size());
       } else {
         // During testing, we are less interested in Preserve mode due to lack
         // of "original spacing", so fall-back to safe behavior.
-        stream << Spacer(before.spaces);
+        output->append(before.spaces, ' ');
       }
       break;
     }
     case SpacingDecision::Wrap:
       // Never print spaces before a newline.
-      stream << '\n';
+      output->push_back('\n');
       ABSL_FALLTHROUGH_INTENDED;
     case SpacingDecision::Align:
     case SpacingDecision::Append:
-      stream << Spacer(before.spaces);
+      output->append(before.spaces, ' ');
       break;
   }
-  return stream << token->text();
+  const absl::string_view text(token->text());
+  output->append(text.data(), text.size());
 }
 
 std::ostream& operator<<(std::ostream& stream, const FormattedToken& token) {
@@ -223,6 +223,9 @@ struct FormattedToken {
   // Print out formatted result after formatting decision optimization.
   std::ostream& FormattedText(std::ostream&) const;
 
+  // Same as FormattedText(), but appends to 'output'.
+  void AppendFormattedText(std::string* output) const;
+
   // The token this PreFormatToken holds. TokenInfo must outlive this object.
   const TokenInfo* token = nullptr;
 
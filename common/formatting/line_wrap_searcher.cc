@@ -14,11 +14,16 @@
 
 #include "common/formatting/line_wrap_searcher.h"
 
+#include <algorithm>
 #include <memory>
 #include <queue>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "common/formatting/basic_format_style.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/state_node.h"
@@ -42,15 +47,28 @@ struct SearchState {
   // Inverted to min-heap: *lowest* penalty has the highest search priority.
   bool operator<(const SearchState& r) const { return *r.state < *state; }
 };
+
+// Returns the decisions along the path that ends in 'state', in token order.
+std::vector<SpacingDecision> PathDecisions(const StateNode& state) {
+  std::vector<SpacingDecision> decisions;
+  for (const StateNode* iter = &state; iter != nullptr; iter = iter->next()) {
+    decisions.push_back(iter->spacing_choice);
+  }
+  std::reverse(decisions.begin(), decisions.end());
+  return decisions;
+}
 }  // namespace
 
 std::vector<FormattedExcerpt> SearchLineWraps(const UnwrappedLine& uwline,
                                               const BasicFormatStyle& style,
-                                              int max_search_states) {
+                                              int max_search_states,
+                                              int* explored_states,
+                                              absl::Time deadline) {
   // Dijkstra's algorithm for now: prioritize searching minimum penalty path
   // until destination is reached.
 
   VLOG(2) << "SearchLineWraps on: " << uwline;
+  if (explored_states != nullptr) *explored_states = 0;
   if (uwline.TokensRange().empty()) {
     std::vector<FormattedExcerpt> result(1);
     return result;
@@ -101,7 +119,11 @@ std::vector<FormattedExcerpt> SearchLineWraps(const UnwrappedLine& uwline,
       continue;
     }
 
-    if (state_count >= max_search_states) {
+    // Reading the clock is not free, so only do it periodically.
+    constexpr int kDeadlineCheckInterval = 256;
+    if (state_count >= max_search_states ||
+        ((state_count - 1) % kDeadlineCheckInterval == 0 &&
+         deadline != absl::InfiniteFuture() && absl::Now() >= deadline)) {
       // Search limit exceeded, abandon search.
       // Greedily finish formatting this partition, and return it.
       winning_paths.push_back(StateNode::QuickFinish(next.state, style));
@@ -148,6 +170,26 @@ std::vector<FormattedExcerpt> SearchLineWraps(const UnwrappedLine& uwline,
   }  // while (!worklist.empty())
 
   CHECK_GE(winning_paths.size(), 1);
+  if (explored_states != nullptr) *explored_states = state_count;
+
+  // The heap pops equally optimal paths in no particular order, so order them
+  // by their decisions, preferring to append at the first token where they
+  // differ.  This keeps the preferred (first) solution independent of the
+  // search strategy.
+  if (winning_paths.size() > 1) {
+    std::vector<std::pair<std::vector<SpacingDecision>,
+                          std::shared_ptr<const StateNode>>>
+        ordered_paths;
+    ordered_paths.reserve(winning_paths.size());
+    for (const auto& path : winning_paths) {
+      ordered_paths.emplace_back(PathDecisions(*path), path);
+    }
+    std::sort(ordered_paths.begin(), ordered_paths.end(),
+              [](const auto& l, const auto& r) { return l.first < r.first; });
+    for (size_t i = 0; i < ordered_paths.size(); ++i) {
+      winning_paths[i] = ordered_paths[i].second;
+    }
+  }
 
   // Reconstruct the unwrapped_line to reflect the decisions made to reach the
   // winning_paths.  Return a modified copy of the original UnwrappedLine.
@@ -165,6 +207,164 @@ std::vector<FormattedExcerpt> SearchLineWraps(const UnwrappedLine& uwline,
   return results;
 }
 
+bool IsFlatList(const UnwrappedLine& uwline) {
+  int depth = 0;
+  int max_depth = 0;
+  int outer_groups = 0;
+  int list_depth = -1;  // group depth of the separators, once one is seen
+  for (const auto& token : uwline.TokensRange()) {
+    switch (token.balancing) {
+      case GroupBalancing::Open:
+        if (++depth == 1) ++outer_groups;
+        max_depth = std::max(max_depth, depth);
+        break;
+      case GroupBalancing::Close:
+        // Partitions that start inside of a group are not lists.
+        if (--depth < 0) return false;
+        break;
+      default:
+        break;
+    }
+    if (token.token->text() == ",") {
+      if (list_depth < 0) list_depth = depth;
+      // Separators at different depths mean nested lists.
+      if (depth != list_depth) return false;
+    }
+  }
+  switch (list_depth) {
+    case 0:  // a bare list, like ".a(b), .c(d)"
+      return max_depth <= 1;
+    case 1:  // one enclosed list, like "f(a, b)", "{a, b}", "u(.a(b), .c(d))"
+      return outer_groups == 1 && max_depth <= 2;
+    default:
+      return false;
+  }
+}
+
+namespace {
+// A search state, and the position of its decision path in the order of
+// SearchLineWraps() results (lower is preferred among equally good paths).
+struct RankedState {
+  std::shared_ptr<const StateNode> state;
+  size_t rank;
+};
+
+// Returns the parts of a state that determine its future costs.
+auto FutureKey(const StateNode& s) {
+  return std::tie(s.wrap_column_positions, s.spacing_choice);
+}
+
+// Orders states by their future key, then by column, cost and rank.
+bool FutureKeyLess(const RankedState& l, const RankedState& r) {
+  return std::forward_as_tuple(FutureKey(*l.state), l.state->current_column,
+                               l.state->cumulative_cost, l.rank) <
+         std::forward_as_tuple(FutureKey(*r.state), r.state->current_column,
+                               r.state->cumulative_cost, r.rank);
+}
+}  // namespace
+
+std::vector<FormattedExcerpt> SearchFlatListLineWraps(
+    const UnwrappedLine& uwline, const BasicFormatStyle& style,
+    int max_search_states, int* explored_states, absl::Time deadline) {
+  VLOG(2) << "SearchFlatListLineWraps on: " << uwline;
+  if (explored_states != nullptr) *explored_states = 0;
+  if (uwline.TokensRange().empty()) {
+    std::vector<FormattedExcerpt> result(1);
+    return result;
+  }
+
+  // All states in a layer have decided the same number of tokens.  Layers are
+  // kept in rank order: since appending is explored before wrapping, the
+  // states of the next layer are then generated in rank order, too.
+  std::vector<RankedState> layer{{std::make_shared<StateNode>(uwline, style),
+                                  0}};
+  std::vector<RankedState> next_layer;
+  int state_count = 1;
+  bool aborted_search = false;
+  while (!layer.front().state->Done()) {
+    if (state_count >= max_search_states ||
+        (deadline != absl::InfiniteFuture() && absl::Now() >= deadline)) {
+      // Search limit exceeded, greedily finish the cheapest state.
+      const auto cheapest = std::min_element(
+          layer.begin(), layer.end(),
+          [](const RankedState& l, const RankedState& r) {
+            return *l.state < *r.state;
+          });
+      layer = {{StateNode::QuickFinish(cheapest->state, style), 0}};
+      aborted_search = true;
+      break;
+    }
+
+    // Explore the same decisions as SearchLineWraps().
+    next_layer.clear();
+    for (const auto& ranked : layer) {
+      const auto& state = ranked.state;
+      const auto& token = state->GetNextToken();
+      if (token.before.break_decision == SpacingOptions::Preserve) {
+        next_layer.push_back({std::make_shared<StateNode>(
+                                  state, style, SpacingDecision::Preserve),
+                              next_layer.size()});
+        continue;
+      }
+      if (token.before.break_decision != SpacingOptions::MustWrap) {
+        next_layer.push_back(
+            {std::make_shared<StateNode>(state, style, SpacingDecision::Append),
+             next_layer.size()});
+      }
+      if (token.before.break_decision != SpacingOptions::MustAppend) {
+        next_layer.push_back(
+            {std::make_shared<StateNode>(state, style, SpacingDecision::Wrap),
+             next_layer.size()});
+      }
+    }
+    state_count += next_layer.size();
+
+    // Future costs are non-decreasing with the current column, so a state can
+    // be dropped when another state with the same future key has no greater
+    // column and a lower cost: none of its completions can be optimal.  With
+    // equal cost, the other state must also have a lower rank, so that the
+    // preferred optimal path is never dropped.
+    std::sort(next_layer.begin(), next_layer.end(), FutureKeyLess);
+    layer.clear();
+    // Every kept state is better than those before it with the same key.
+    const RankedState* best_in_key = nullptr;
+    for (const auto& ranked : next_layer) {
+      if (best_in_key != nullptr &&
+          FutureKey(*best_in_key->state) == FutureKey(*ranked.state)) {
+        const int best_cost = best_in_key->state->cumulative_cost;
+        const int cost = ranked.state->cumulative_cost;
+        if (best_cost < cost ||
+            (best_cost == cost && best_in_key->rank < ranked.rank)) {
+          continue;
+        }
+      }
+      best_in_key = &ranked;
+      layer.push_back(ranked);
+    }
+    std::sort(layer.begin(), layer.end(),
+              [](const RankedState& l, const RankedState& r) {
+                return l.rank < r.rank;
+              });
+    VLOG(4) << "layer size: " << layer.size() << " of " << next_layer.size();
+  }
+  if (explored_states != nullptr) *explored_states = state_count;
+
+  // Same preference as SearchLineWraps(): lowest cost, then lowest column,
+  // then lowest rank (min_element returns the first of equal elements).
+  const auto& best = *std::min_element(
+      layer.begin(), layer.end(),
+      [](const RankedState& l, const RankedState& r) {
+        return *l.state < *r.state;
+      });
+  std::vector<FormattedExcerpt> results;
+  results.emplace_back(uwline);
+  auto& result = results.back();
+  CHECK_EQ(best.state->Depth(), result.Tokens().size());
+  best.state->ReconstructFormatDecisions(&result);
+  if (aborted_search) result.MarkIncomplete();
+  return results;
+}
+
 void DisplayEquallyOptimalWrappings(
     std::ostream& stream, const UnwrappedLine& uwline,
     const std::vector<FormattedExcerpt>& solutions) {
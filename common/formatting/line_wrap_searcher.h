@@ -18,6 +18,7 @@
 #include <iosfwd>
 #include <vector>
 
+#include "absl/time/time.h"
 #include "common/formatting/basic_format_style.h"
 #include "common/formatting/unwrapped_line.h"
 
@@ -27,15 +28,46 @@ namespace verible {
 // and a style structure, and returns equally-good FormattedExcerpts with
 // formatting decisions (wraps, spaces) committed.
 // This minimizes the numeric penalty during search to yield optimal results,
-// which can result in multiple optimal formattings.
+// which can result in multiple optimal formattings.  Those are ordered by
+// their decisions: at the first token where two of them differ, the one that
+// appends comes first.
 // max_search_states limits the size of the optimization search.
 // When the number of states evaluated exceeds this, this will abort by
 // returning a greedily formatted result (which can still be rendered)
 // that will be marked as !CompletedFormatting().
 // This is guaranteed to return at least one result.
-std::vector<FormattedExcerpt> SearchLineWraps(const UnwrappedLine& uwline,
-                                              const BasicFormatStyle& style,
-                                              int max_search_states);
+// If 'explored_states' is provided, it receives the number of search states
+// that were evaluated, which is useful for profiling.
+// Reaching the 'deadline' (wall time) aborts the search in the same manner
+// as exceeding max_search_states.
+std::vector<FormattedExcerpt> SearchLineWraps(
+    const UnwrappedLine& uwline, const BasicFormatStyle& style,
+    int max_search_states, int* explored_states = nullptr,
+    absl::Time deadline = absl::InfiniteFuture());
+
+// Returns true if 'uwline' is a flat list: its comma separators are either
+// all outside of groups (e.g. ".a(b), .c(d)"), or all directly inside of its
+// only outermost group (e.g. "f(a, b)", "{a, b}", "u(.a(b), .c(d))"), and list
+// elements contain at most one level of groups.  This covers port
+// connections, function arguments and concatenations.
+// SearchFlatListLineWraps() is efficient on such partitions.
+bool IsFlatList(const UnwrappedLine& uwline);
+
+// Same contract as SearchLineWraps(), but explores the decisions one token
+// at a time (dynamic programming) instead of best-first.  After each token,
+// states that can no longer lead to the preferred result are discarded:
+// among states with the same wrap column stack and last decision, a state is
+// dropped when another one has no greater column and lower cost (or equal
+// cost and a preferred decision path).
+// This yields the same first result as SearchLineWraps(), but runs in
+// roughly O(tokens * columns) states on flat lists, where the best-first
+// search can explore exponentially many.
+// Only that single result is returned, so use SearchLineWraps() to find all
+// equally optimal wrappings.
+std::vector<FormattedExcerpt> SearchFlatListLineWraps(
+    const UnwrappedLine& uwline, const BasicFormatStyle& style,
+    int max_search_states, int* explored_states = nullptr,
+    absl::Time deadline = absl::InfiniteFuture());
 
 // Diagnostic helper for displaying when multiple optimal wrappings are found
 // by SearchLineWraps.  This aids in development around wrap penalty tuning.
@@ -14,9 +14,12 @@
 
 #include "common/formatting/line_wrap_searcher.h"
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include "absl/strings/match.h"
+#include "absl/time/time.h"
 #include "common/formatting/basic_format_style.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/unwrapped_line.h"
@@ -417,13 +420,216 @@ TEST_F(SearchLineWrapsTestFixture, AbortedSearch) {
   ftokens_in[2].before.break_penalty = 1;
   ftokens_in[2].before.spaces_required = 1;
   // Intentionally limit search space to a small count to force early abort.
-  const auto formatted_lines = verible::SearchLineWraps(uwline_in, style_, 2);
+  int explored_states = -1;
+  const auto formatted_lines =
+      verible::SearchLineWraps(uwline_in, style_, 2, &explored_states);
   const FormattedExcerpt& formatted_line = formatted_lines.front();
   EXPECT_EQ(formatted_line.Tokens().size(), tokens.size());
   EXPECT_FALSE(formatted_line.CompletedFormatting());
+  EXPECT_EQ(explored_states, 2);
   // The resulting state is unpredictable, because the search terminated early.
   // So we don't check any other properties of the formatted_line.
 }
 
+// Test that a search past its deadline is aborted and marked as incomplete.
+TEST_F(SearchLineWrapsTestFixture, DeadlineExceeded) {
+  const std::vector<TokenInfo> tokens = {
+      {0, "zz"},
+      {0, "yyy"},
+      {0, "xxxx"},
+  };
+  CreateTokenInfos(tokens);
+  UnwrappedLine uwline_in(LevelsToSpaces(1), pre_format_tokens_.begin());
+  AddFormatTokens(&uwline_in);
+  auto& ftokens_in = pre_format_tokens_;
+  for (auto& ftoken : ftokens_in) {
+    ftoken.before.break_penalty = 1;
+    ftoken.before.spaces_required = 1;
+  }
+  int explored_states = -1;
+  const auto formatted_lines = verible::SearchLineWraps(
+      uwline_in, style_, 1000, &explored_states, absl::InfinitePast());
+  const FormattedExcerpt& formatted_line = formatted_lines.front();
+  EXPECT_EQ(formatted_line.Tokens().size(), tokens.size());
+  EXPECT_FALSE(formatted_line.CompletedFormatting());
+  EXPECT_EQ(explored_states, 1);
+}
+
+TEST_F(SearchLineWrapsTestFixture, IsFlatList) {
+  const std::vector<TokenInfo> tokens = {
+      {0, "f"}, {0, "("}, {0, "a"}, {0, ","}, {0, "b"}, {0, ")"},
+  };
+  CreateTokenInfos(tokens);
+  UnwrappedLine uwline(0, pre_format_tokens_.begin());
+  AddFormatTokens(&uwline);
+  auto& ftokens = pre_format_tokens_;
+  ftokens[1].balancing = GroupBalancing::Open;
+  ftokens[5].balancing = GroupBalancing::Close;
+  EXPECT_TRUE(IsFlatList(uwline));
+
+  // Without separators, this is not a list.
+  ftokens[3].token = ftokens[2].token;
+  EXPECT_FALSE(IsFlatList(uwline));
+}
+
+TEST_F(SearchLineWrapsTestFixture, IsFlatListTooDeep) {
+  const std::vector<TokenInfo> tokens = {
+      {0, "("}, {0, "("}, {0, "("}, {0, "a"}, {0, ","},
+      {0, "b"}, {0, ")"}, {0, ")"}, {0, ")"},
+  };
+  CreateTokenInfos(tokens);
+  UnwrappedLine uwline(0, pre_format_tokens_.begin());
+  AddFormatTokens(&uwline);
+  auto& ftokens = pre_format_tokens_;
+  for (int i = 0; i < 3; ++i) {
+    ftokens[i].balancing = GroupBalancing::Open;
+    ftokens[i + 6].balancing = GroupBalancing::Close;
+  }
+  EXPECT_FALSE(IsFlatList(uwline));
+}
+
+// Sets the group balancing of parentheses and braces.
+static void BalanceGroups(std::vector<PreFormatToken>* ftokens) {
+  for (auto& ftoken : *ftokens) {
+    const auto text = ftoken.token->text();
+    ftoken.balancing = (text == "(" || text == "{")   ? GroupBalancing::Open
+                       : (text == ")" || text == "}") ? GroupBalancing::Close
+                                                      : GroupBalancing::None;
+  }
+}
+
+TEST_F(SearchLineWrapsTestFixture, IsFlatListShapes) {
+  struct TestCase {
+    std::vector<absl::string_view> texts;
+    bool expected;
+  };
+  const TestCase kTestCases[] = {
+      {{".", "a", "(", "b", ")", ",", ".", "c", "(", "d", ")"}, true},
+      {{"u", "(", ".", "a", "(", "b", ")", ",", ".", "c", "(", "d", ")", ")",
+        ";"},
+       true},
+      {{"x", "=", "{", "a", ",", "b", "}", ";"}, true},
+      // Lists nested in list elements.
+      {{"f", "(", "a", ",", "g", "(", "b", ",", "c", ")", ")"}, false},
+      // Lists in more than one group.
+      {{"f", "(", "a", ",", "b", ")", "+", "g", "(", "c", ")"}, false},
+      // Starts inside of a group.
+      {{"a", ",", "b", ")", ";"}, false},
+  };
+  for (const auto& test : kTestCases) {
+    std::vector<TokenInfo> tokens;
+    for (const auto text : test.texts) tokens.push_back({0, text});
+    UnwrappedLineMemoryHandler handler;
+    handler.CreateTokenInfos(tokens);
+    UnwrappedLine uwline(0, handler.pre_format_tokens_.begin());
+    handler.AddFormatTokens(&uwline);
+    BalanceGroups(&handler.pre_format_tokens_);
+    EXPECT_EQ(IsFlatList(uwline), test.expected) << uwline;
+  }
+}
+
+// Test that equally optimal wrappings are ordered by their decisions.
+TEST_F(SearchLineWrapsTestFixture, EquallyOptimalOrder) {
+  const std::vector<TokenInfo> tokens = {
+      {0, "aa"}, {0, "bb"}, {0, "cc"}, {0, "dd"},
+  };
+  CreateTokenInfos(tokens);
+  UnwrappedLine uwline(0, pre_format_tokens_.begin());
+  AddFormatTokens(&uwline);
+  for (auto& ftoken : pre_format_tokens_) {
+    ftoken.before.break_penalty = 1;
+    ftoken.before.spaces_required = 1;
+  }
+  pre_format_tokens_[3].before.break_decision = SpacingOptions::MustWrap;
+  // Two tokens fit on a line, so "aa bb\ncc\ndd" and "aa\nbb cc\ndd" are
+  // equally good.
+  style_.column_limit = 5;
+  style_.wrap_spaces = 0;
+  const auto results = verible::SearchLineWraps(uwline, style_, 1000);
+  ASSERT_EQ(results.size(), 2) << results.front().Render();
+  EXPECT_EQ(results[0].Render(), "aa bb\ncc\ndd");
+  EXPECT_EQ(results[1].Render(), "aa\nbb cc\ndd");
+  // The flat-list solver finds the first one.
+  EXPECT_EQ(SearchFlatListLineWraps(uwline, style_, 1000).front().Render(),
+            results[0].Render());
+}
+
+// Test that the flat-list solver finds the same wrapping as the exhaustive
+// search, including which one of equally optimal wrappings.
+TEST_F(SearchLineWrapsTestFixture, FlatListSameAsSearch) {
+  const std::vector<std::vector<absl::string_view>> kLists = {
+      // Like: ".aa(bbbb), .c(dd), .eeeee(f), .g(hhhhhh)"
+      {".", "aa", "(", "bbbb", ")", ",", ".", "c",     "(", "dd",
+       ")", ",",  ".", "eeeee", "(", "f",  ")", ",", ".", "g",
+       "(", "hhhhhh", ")"},
+      // Like: "foo(a, bb, ccc, dddd, a, bb, ccc, dddd);"
+      {"foo", "(", "a", ",", "bb", ",", "ccc", ",", "dddd", ",", "a",
+       ",",   "bb", ",", "ccc", ",", "dddd", ")", ";"},
+      // Like: "x = {yy, zz, yy, zz, yy, zz, yy};"
+      {"x",  "=", "{",  "yy", ",", "zz", ",", "yy", ",", "zz", ",",
+       "yy", ",", "zz", ",",  "yy", "}",  ";"},
+  };
+  for (const auto& texts : kLists) {
+    std::vector<TokenInfo> tokens;
+    for (const auto text : texts) tokens.push_back({0, text});
+    UnwrappedLineMemoryHandler handler;
+    handler.CreateTokenInfos(tokens);
+    for (int column_limit : {8, 12, 16, 20, 30, 40}) {
+      for (int comma_penalty : {1, 3, 7, 10}) {
+        style_.column_limit = column_limit;
+        UnwrappedLine uwline(LevelsToSpaces(1),
+                             handler.pre_format_tokens_.begin());
+        handler.AddFormatTokens(&uwline);
+        BalanceGroups(&handler.pre_format_tokens_);
+        absl::string_view previous;
+        for (auto& ftoken : handler.pre_format_tokens_) {
+          const auto text = ftoken.token->text();
+          // Prefer breaking after commas, discourage breaking inside groups.
+          // Equal penalties result in many equally optimal wrappings.
+          ftoken.before.spaces_required =
+              (text == "." || previous == ",") ? 1 : 0;
+          ftoken.before.break_penalty =
+              (text == "." || previous == ",") ? comma_penalty : 7;
+          previous = text;
+        }
+        ASSERT_TRUE(IsFlatList(uwline)) << uwline;
+
+        const auto expected =
+            verible::SearchLineWraps(uwline, style_, 10000000);
+        ASSERT_TRUE(expected.front().CompletedFormatting());
+        int explored_states = 0;
+        const auto results = verible::SearchFlatListLineWraps(
+            uwline, style_, 10000000, &explored_states);
+        ASSERT_EQ(results.size(), 1);
+        EXPECT_TRUE(results.front().CompletedFormatting());
+        EXPECT_GT(explored_states, 0);
+        EXPECT_EQ(results.front().Render(), expected.front().Render())
+            << "column limit: " << column_limit
+            << ", comma penalty: " << comma_penalty << " (" << expected.size()
+            << " optimal wrappings)";
+      }
+    }
+  }
+}
+
+// Test that the flat-list solver honors the search state limit.
+TEST_F(SearchLineWrapsTestFixture, FlatListAbortedSearch) {
+  const std::vector<TokenInfo> tokens = {
+      {0, "zz"}, {0, ","}, {0, "yyy"}, {0, ","}, {0, "xxxx"},
+  };
+  CreateTokenInfos(tokens);
+  UnwrappedLine uwline_in(LevelsToSpaces(1), pre_format_tokens_.begin());
+  AddFormatTokens(&uwline_in);
+  for (auto& ftoken : pre_format_tokens_) {
+    ftoken.before.break_penalty = 1;
+    ftoken.before.spaces_required = 1;
+  }
+  const auto formatted_lines =
+      verible::SearchFlatListLineWraps(uwline_in, style_, 2);
+  const FormattedExcerpt& formatted_line = formatted_lines.front();
+  EXPECT_EQ(formatted_line.Tokens().size(), tokens.size());
+  EXPECT_FALSE(formatted_line.CompletedFormatting());
+}
+
 }  // namespace
 }  // namespace verible
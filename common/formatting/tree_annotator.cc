@@ -14,11 +14,15 @@
 
 #include "common/formatting/tree_annotator.h"
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
 #include "common/text/concrete_syntax_leaf.h"
+#include "common/text/concrete_syntax_tree.h"
 #include "common/text/token_stream_view.h"
 #include "common/text/tree_context_visitor.h"
+#include "common/text/tree_utils.h"
 
 namespace verible {
 
@@ -34,23 +38,46 @@ class TreeAnnotator : public TreeContextVisitor {
   TreeAnnotator(const Symbol* syntax_tree_root, const TokenInfo& eof_token,
                 std::vector<PreFormatToken>::iterator tokens_begin,
                 std::vector<PreFormatToken>::iterator tokens_end,
-                const ContextTokenAnnotatorFunction& annotator)
+                const ContextTokenAnnotatorFunction& annotator,
+                const char* skip_before = nullptr)
       : eof_token_(eof_token),
         syntax_tree_root_(syntax_tree_root),
         token_annotator_(annotator),
         next_filtered_token_(tokens_begin),
-        end_filtered_token_(tokens_end) {}
+        end_filtered_token_(tokens_end),
+        skip_before_(skip_before) {}
 
   void Annotate();
 
- private:                           // methods
-  using TreeContextVisitor::Visit;  // for SyntaxTreeNode
+ private:  // methods
+  void Visit(const SyntaxTreeNode& node) override;
+
   void Visit(const SyntaxTreeLeaf& leaf) override {
+    if (skip_before_ != nullptr && leaf.get().text().begin() < skip_before_) {
+      // Leaves before the first token of interest only provide context.
+      SaveLeftContext();
+      return;
+    }
     CatchUpToCurrentLeaf(leaf.get());
   }
 
+  // Saves the current context as the left context of the next token pairs.
+  void SaveLeftContext() {
+    saved_left_context_ = Context();
+    common_ancestors_ = Context().size();
+  }
+
   void CatchUpToCurrentLeaf(const TokenInfo& leaf_token);
 
+  // Returns true if there are no more tokens left to annotate.
+  bool Done() const {
+    return std::distance(next_filtered_token_, end_filtered_token_) <= 1;
+  }
+
+  // Saves the context of the rightmost leaf under 'symbol', as if the
+  // whole subtree had been visited.  Returns true if a leaf was found.
+  bool SaveContextOfRightmostLeaf(const Symbol& symbol);
+
   // TODO(fangism): This exists solely to facilitate CatchUpToCurrentLeaf().
   // Consider using position in text_buffer as a terminator, and eliminating
   // this.
@@ -78,8 +105,51 @@ class TreeAnnotator : public TreeContextVisitor {
   // Copy of current_context_ that is saved for use as a left-token's context
   // passed into the token_annotator_ function.
   SyntaxTreeContext saved_left_context_;
+
+  // Number of nodes that saved_left_context_ has in common with
+  // current_context_.  The context never shrinks below the lowest common
+  // ancestor of the left and the current leaf, but shrinks to it before
+  // growing towards the current leaf, so this is the smallest size of the
+  // context since saved_left_context_ was saved.
+  size_t common_ancestors_ = 0;
+
+  // When annotating only a sub-range of tokens, this points to the text of
+  // the first (left) token of interest.  Subtrees that end before this
+  // position are skipped.  nullptr means annotate the whole range.
+  const char* const skip_before_;
 };
 
+void TreeAnnotator::Visit(const SyntaxTreeNode& node) {
+  if (skip_before_ != nullptr) {
+    if (Done()) return;  // Nothing left to annotate, skip the rest.
+    const SyntaxTreeLeaf* last_leaf = GetRightmostLeaf(node);
+    if (last_leaf == nullptr) return;  // No tokens to annotate.
+    if (last_leaf->get().text().begin() < skip_before_) {
+      // Entire subtree precedes the range of interest.
+      SaveContextOfRightmostLeaf(node);
+      common_ancestors_ = std::min(common_ancestors_, Context().size());
+      return;
+    }
+  }
+  TreeContextVisitor::Visit(node);
+  // 'node' was popped.
+  common_ancestors_ = std::min(common_ancestors_, Context().size());
+}
+
+bool TreeAnnotator::SaveContextOfRightmostLeaf(const Symbol& symbol) {
+  if (symbol.Kind() == SymbolKind::kLeaf) {
+    SaveLeftContext();
+    return true;
+  }
+  const auto& node = SymbolCastToNode(symbol);
+  const SyntaxTreeContext::AutoPop p(&current_context_, &node);
+  const auto& children = node.children();
+  for (auto iter = children.rbegin(); iter != children.rend(); ++iter) {
+    if (*iter != nullptr && SaveContextOfRightmostLeaf(**iter)) return true;
+  }
+  return false;
+}
+
 void TreeAnnotator::Annotate() {
   if (next_filtered_token_ == end_filtered_token_) return;
 
@@ -103,9 +173,6 @@ void TreeAnnotator::CatchUpToCurrentLeaf(const TokenInfo& leaf_token) {
   // so we need to compare a unique property instead of address.
   // The very last token (before end_filtered_token) is an EOF token,
   // which doesn't need to be annotated.
-  // TODO(fangism): efficiently compute greatest-common-ancestor between
-  // left- and right- context.  Ideally this should be memo-ized as the
-  // traversal occurs, to avoid any unnecessary (linear) searches.
   while (std::distance(next_filtered_token_, end_filtered_token_) > 1 &&
          // compare const char* addresses:
          next_filtered_token_->token->text().begin() !=
@@ -113,12 +180,13 @@ void TreeAnnotator::CatchUpToCurrentLeaf(const TokenInfo& leaf_token) {
     const auto& left_token = *next_filtered_token_;
     ++next_filtered_token_;
     auto& right_token = *next_filtered_token_;
-    token_annotator_(left_token, &right_token, saved_left_context_, Context());
+    token_annotator_(left_token, &right_token, saved_left_context_, Context(),
+                     common_ancestors_);
   }
   // next_filtered_token_ now points to leaf_token, now caught up.
   // TODO(fangism): This costs an entire vector/stack-copy for every leaf token.
   // May need to choose a different structure for SyntaxTreeContext.
-  saved_left_context_ = Context();
+  SaveLeftContext();
 }
 
 }  // namespace
@@ -133,4 +201,20 @@ void AnnotateFormatTokensUsingSyntaxContext(
   t.Annotate();
 }
 
+void AnnotateFormatTokensUsingSyntaxContext(
+    const Symbol* syntax_tree_root, const TokenInfo& eof_token,
+    std::vector<PreFormatToken>::iterator tokens_begin,
+    std::vector<PreFormatToken>::iterator annotate_begin,
+    std::vector<PreFormatToken>::iterator annotate_end,
+    const ContextTokenAnnotatorFunction& annotator) {
+  if (annotate_begin >= annotate_end) return;
+  // Start from the left token of the first pair to annotate.
+  // The first token of the whole range never gets annotated.
+  const auto left_begin =
+      annotate_begin == tokens_begin ? tokens_begin : annotate_begin - 1;
+  TreeAnnotator t(syntax_tree_root, eof_token, left_begin, annotate_end,
+                  annotator, left_begin->token->text().begin());
+  t.Annotate();
+}
+
 }  // namespace verible
@@ -27,10 +27,13 @@ namespace verible {
 
 // Parameters: left token, right token (modified),
 // left token's syntax tree context,
-// right token's syntax tree context.
+// right token's syntax tree context,
+// number of syntax tree nodes that both contexts have in common (the depth of
+// their lowest common ancestor), which is tracked during the traversal.
 using ContextTokenAnnotatorFunction =
     std::function<void(const PreFormatToken&, PreFormatToken*,
-                       const SyntaxTreeContext&, const SyntaxTreeContext&)>;
+                       const SyntaxTreeContext&, const SyntaxTreeContext&,
+                       int)>;
 
 // Applies inter-token formatting annotations, using syntactic context
 // at every token.
@@ -40,6 +43,19 @@ void AnnotateFormatTokensUsingSyntaxContext(
     std::vector<PreFormatToken>::iterator tokens_end,
     const ContextTokenAnnotatorFunction& annotator);
 
+// Same as above, but only annotates the (right) tokens in the sub-range
+// [annotate_begin, annotate_end) of [tokens_begin, tokens_end).
+// Syntax subtrees that lie entirely outside of the sub-range are skipped,
+// while the contexts passed to the annotator remain identical to those of a
+// full-range annotation.  This is useful for incremental formatting, where
+// only a small portion of the token stream needs to be annotated.
+void AnnotateFormatTokensUsingSyntaxContext(
+    const Symbol* syntax_tree_root, const TokenInfo& eof_token,
+    std::vector<PreFormatToken>::iterator tokens_begin,
+    std::vector<PreFormatToken>::iterator annotate_begin,
+    std::vector<PreFormatToken>::iterator annotate_end,
+    const ContextTokenAnnotatorFunction& annotator);
+
 }  // namespace verible
 
 #endif  // VERIBLE_COMMON_FORMATTING_TREE_ANNOTATOR_H_
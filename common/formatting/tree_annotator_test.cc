@@ -36,8 +36,20 @@ std::vector<int> ExtractSyntaxTreeContextEnums(
   return result;
 }
 
+// Returns the number of leading nodes that 'left' and 'right' share.
+static int CommonAncestors(const SyntaxTreeContext& left,
+                           const SyntaxTreeContext& right) {
+  int common = 0;
+  for (auto l = left.begin(), r = right.begin();
+       l != left.end() && r != right.end() && *l == *r; ++l, ++r) {
+    ++common;
+  }
+  return common;
+}
+
 static void DoNothing(const PreFormatToken&, PreFormatToken*,
-                      const SyntaxTreeContext&, const SyntaxTreeContext&) {}
+                      const SyntaxTreeContext&, const SyntaxTreeContext&,
+                      int) {}
 
 TEST(AnnotateFormatTokensUsingSyntaxContextTest, EmptyFormatTokens) {
   std::vector<PreFormatToken> ftokens;
@@ -51,7 +63,8 @@ constexpr int kForcedSpaces = 5;
 
 void ForceSpaces(const PreFormatToken&, PreFormatToken* right,
                  const SyntaxTreeContext& /* left_context */,
-                 const SyntaxTreeContext& /* right_context */) {
+                 const SyntaxTreeContext& /* right_context */,
+                 int /* common_ancestors */) {
   right->before.spaces_required = kForcedSpaces;
 }
 
@@ -82,7 +95,8 @@ TEST(AnnotateFormatTokensUsingSyntaxContextTest, UnusedContext) {
 
 void LeftIsB(const PreFormatToken& left, PreFormatToken* right,
              const SyntaxTreeContext& /* left_context */,
-             const SyntaxTreeContext& /* right_context */) {
+             const SyntaxTreeContext& /* right_context */,
+             int /* common_ancestors */) {
   if (left.token->text() == "b") {
     right->before.spaces_required = kForcedSpaces;
   } else {
@@ -111,7 +125,8 @@ TEST(AnnotateFormatTokensUsingSyntaxContextTest, UnusedContextBasedOnLeft) {
 void RightContextDirectParentIsNine(const PreFormatToken&,
                                     PreFormatToken* right,
                                     const SyntaxTreeContext& left_context,
-                                    const SyntaxTreeContext& right_context) {
+                                    const SyntaxTreeContext& right_context,
+                                    int /* common_ancestors */) {
   if (right_context.DirectParentIs(9)) {
     right->before.spaces_required = kForcedSpaces;
   } else {
@@ -146,7 +161,8 @@ TEST(AnnotateFormatTokensUsingSyntaxContextTest, UsingRightContext) {
 void LeftContextDirectParentIsSeven(const PreFormatToken&,
                                     PreFormatToken* right,
                                     const SyntaxTreeContext& left_context,
-                                    const SyntaxTreeContext& right_context) {
+                                    const SyntaxTreeContext& right_context,
+                                    int /* common_ancestors */) {
   if (left_context.DirectParentIs(7)) {
     right->before.spaces_required = kForcedSpaces + 4;
   } else {
@@ -207,13 +223,17 @@ TEST(AnnotateFormatTokensUsingSyntaxContextTest, VerifySlidingContexts) {
   }
   std::vector<std::vector<int>> saved_contexts;
   saved_contexts.push_back({6, 7});  // first leaf's context
+  std::vector<int> common_ancestors;
   auto context_listener = [&](const PreFormatToken&, PreFormatToken*,
                               const SyntaxTreeContext& left_context,
-                              const SyntaxTreeContext& right_context) {
+                              const SyntaxTreeContext& right_context,
+                              int common) {
     // continuity and consistency check
     const auto left_enums = ExtractSyntaxTreeContextEnums(left_context);
     EXPECT_EQ(left_enums, saved_contexts.back());
     saved_contexts.push_back(ExtractSyntaxTreeContextEnums(right_context));
+    EXPECT_EQ(common, CommonAncestors(left_context, right_context));
+    common_ancestors.push_back(common);
   };
   AnnotateFormatTokensUsingSyntaxContext(&*tree, tokens[7], ftokens.begin(),
                                          ftokens.end(), context_listener);
@@ -222,6 +242,58 @@ TEST(AnnotateFormatTokensUsingSyntaxContextTest, VerifySlidingContexts) {
               ElementsAre(  //
                   V({6, 7}), V({6, 7, 10}), V({6, 7, 11}), V({6, 7, 11}),
                   V({6, 8}), V({6, 8}), V({6, 9}), V()));
+  EXPECT_THAT(common_ancestors, ElementsAre(2, 2, 3, 1, 2, 1, 0));
+}
+
+TEST(AnnotateFormatTokensUsingSyntaxContextTest, SubRangeSlidingContexts) {
+  const absl::string_view text("abcdefgh");
+  const TokenInfo tokens[] = {
+      {4, text.substr(0, 1)}, {5, text.substr(1, 1)},
+      {6, text.substr(2, 1)}, {4, text.substr(3, 1)},
+      {5, text.substr(4, 1)}, {6, text.substr(5, 1)},
+      {4, text.substr(6, 1)}, {verible::TK_EOF, text.substr(7, 0)},  // EOF
+  };
+  const auto tree = TNode(6,                      // synthesized syntax tree
+                          TNode(7,                //
+                                Leaf(tokens[0]),  //
+                                TNode(10,         //
+                                      Leaf(tokens[1]),  //
+                                      TNode(12)),       //
+                                TNode(11,               //
+                                      Leaf(tokens[2]),  //
+                                      Leaf(tokens[3]))  //
+                                ),                      //
+                          TNode(8,                      //
+                                Leaf(tokens[4]),        //
+                                Leaf(tokens[5])),       //
+                          TNode(9, Leaf(tokens[6]))     //
+  );
+  std::vector<PreFormatToken> ftokens;
+  for (const auto& t : tokens) {
+    ftokens.emplace_back(&t);
+  }
+  using V = std::vector<int>;
+  std::vector<std::pair<V, V>> contexts;
+  auto context_listener = [&](const PreFormatToken&, PreFormatToken* right,
+                              const SyntaxTreeContext& left_context,
+                              const SyntaxTreeContext& right_context,
+                              int common) {
+    contexts.emplace_back(ExtractSyntaxTreeContextEnums(left_context),
+                          ExtractSyntaxTreeContextEnums(right_context));
+    EXPECT_EQ(common, CommonAncestors(left_context, right_context));
+    right->before.spaces_required = kForcedSpaces;
+  };
+  // Annotate only tokens [4, 6).
+  AnnotateFormatTokensUsingSyntaxContext(&*tree, tokens[7], ftokens.begin(),
+                                         ftokens.begin() + 4,
+                                         ftokens.begin() + 6, context_listener);
+  EXPECT_THAT(contexts, ElementsAre(std::make_pair(V({6, 7, 11}), V({6, 8})),
+                                    std::make_pair(V({6, 8}), V({6, 8}))));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(ftokens[i].before.spaces_required,
+              (i >= 4 && i < 6) ? kForcedSpaces : 0)
+        << "token " << i;
+  }
 }
 
 }  // namespace
@@ -15,6 +15,7 @@
 #include "common/formatting/tree_unwrapper.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <functional>
 #include <iterator>
 #include <memory>
@@ -28,8 +29,8 @@
 #include "common/text/text_structure.h"
 #include "common/text/token_info.h"
 #include "common/text/token_stream_view.h"
+#include "common/text/tree_utils.h"
 #include "common/util/logging.h"
-#include "common/util/value_saver.h"
 #include "common/util/vector_tree.h"
 
 namespace verible {
@@ -66,7 +67,7 @@ const TokenPartitionTree* TreeUnwrapper::Unwrap() {
   CollectLeadingFilteredTokens();
 
   // Traverse the concrete syntax tree to build up token partitions.
-  ABSL_DIE_IF_NULL(text_structure_view_.SyntaxTree())->Accept(this);
+  TraverseTree(*ABSL_DIE_IF_NULL(text_structure_view_.SyntaxTree()));
 
   // After traversing the ConcreteSyntaxTree, collect possible tokens filtered
   // after the right-most leaf until the end-of-file.
@@ -275,66 +276,115 @@ void TreeUnwrapper::AdvanceNextUnfilteredToken() {
   }
 }
 
+void TreeUnwrapper::TraverseTree(const Symbol& root) {
+  StartVisit(root);
+  while (!traversal_stack_.empty()) {
+    TraversalFrame& frame = traversal_stack_.back();
+    const auto& children = frame.node.children();
+    if (frame.next_child == children.size()) {
+      FinishTraversalFrame();
+      continue;
+    }
+    const Symbol* child = children[frame.next_child++].get();
+    if (child == nullptr) continue;
+    if (StartVisit(*child)) {
+      InterChildNodeHook(traversal_stack_.back().node);
+    }
+    // Otherwise, the hook is called by FinishTraversalFrame() once the
+    // child's own children are done.
+  }
+}
+
+bool TreeUnwrapper::StartVisit(const Symbol& symbol) {
+  const size_t depth = traversal_stack_.size();
+  symbol.Accept(this);
+  if (traversal_stack_.size() != depth) {
+    CHECK_EQ(traversal_stack_.size(), depth + 1)
+        << "Visit() may schedule traversal of only one node's children.";
+    return false;
+  }
+  if (symbol.Kind() == SymbolKind::kNode) {
+    PostVisitNodeHook(SymbolCastToNode(symbol));
+  }
+  return true;
+}
+
+void TreeUnwrapper::FinishTraversalFrame() {
+  const TraversalFrame& frame = traversal_stack_.back();
+  const SyntaxTreeNode& node = frame.node;
+  const bool indented_section = frame.indented_section;
+  const int saved_indentation_spaces = frame.saved_indentation_spaces;
+  TokenPartitionTree* const saved_partition = frame.saved_partition;
+  traversal_stack_.pop_back();  // also pops 'node' from current_context_
+
+  if (indented_section) {
+    const auto last_ftoken_iter = CurrentFormatTokenIterator();
+    active_unwrapped_lines_ = saved_partition;
+    current_indentation_spaces_ = saved_indentation_spaces;
+
+    // TODO(fangism): do we ever need to remove trailing empty partitions here?
+
+    // Update parent's end() format token iterator to match that of
+    // its last child.  It can still be advanced later.
+    active_unwrapped_lines_->Value().SpanUpToToken(last_ftoken_iter);
+
+    // Start new empty UnwrappedLine at the previous indentation level.
+    StartNewUnwrappedLine(PartitionPolicyEnum::kUninitialized, nullptr);
+  }
+
+  PostVisitNodeHook(node);
+  if (!traversal_stack_.empty()) {
+    InterChildNodeHook(traversal_stack_.back().node);
+  }
+}
+
 void TreeUnwrapper::TraverseChildren(const verible::SyntaxTreeNode& node) {
   // Can't just use TreeContextVisitor::Visit(node) because we need to
   // call a visit hook between children.
-  const verible::SyntaxTreeContext::AutoPop p(&current_context_, &node);
+  // The children themselves are visited by TraverseTree().
+  traversal_stack_.emplace_back(&current_context_, node);
   InterChildNodeHook(node);
-  for (const auto& child : node.children()) {
-    if (child) {
-      child->Accept(this);
-      InterChildNodeHook(node);
-    }
-  }
 }
 
-TreeUnwrapper::preformatted_tokens_type::const_iterator
-TreeUnwrapper::VisitIndentedChildren(const SyntaxTreeNode& node,
-                                     int indentation_delta,
-                                     PartitionPolicyEnum partitioning) {
+void TreeUnwrapper::VisitIndentedSection(const SyntaxTreeNode& node,
+                                         int indentation_delta,
+                                         PartitionPolicyEnum partitioning) {
   // Visit subtree with increased indentation level.
-  const ValueSaver<int> depth_saver(
-      &current_indentation_spaces_,
-      current_indentation_spaces_ + indentation_delta);
+  const int saved_indentation_spaces = current_indentation_spaces_;
+  current_indentation_spaces_ += indentation_delta;
 
   // Mark a new sibling at the new indentation level, apply partition policy.
   StartNewUnwrappedLine(partitioning, &node);
 
+  // Most children start at most one sub-partition, so reserve for them up
+  // front, instead of reallocating (and relinking) sub-partitions as they
+  // are added.
+  TokenPartitionTree* const saved_partition = active_unwrapped_lines_;
+  saved_partition->Children().reserve(
+      std::count_if(node.children().begin(), node.children().end(),
+                    [](const SymbolPtr& child) { return child != nullptr; }));
+
   // Start first child right away.
-  const ValueSaver<TokenPartitionTree*> tree_saver(
-      &active_unwrapped_lines_,
-      active_unwrapped_lines_->NewChild(UnwrappedLine(
-          current_indentation_spaces_, CurrentFormatTokenIterator(),
-          PartitionPolicyEnum::kFitOnLineElseExpand /* default */)));
+  active_unwrapped_lines_ = saved_partition->NewChild(
+      UnwrappedLine(current_indentation_spaces_, CurrentFormatTokenIterator(),
+                    PartitionPolicyEnum::kFitOnLineElseExpand /* default */));
   VLOG(3) << __FUNCTION__ << ", new child node "
           << NodePath(*active_unwrapped_lines_) << ": "
           << CurrentUnwrappedLine();
   TraverseChildren(node);
 
-  return CurrentFormatTokenIterator();
-
+  // After the children are visited, FinishTraversalFrame() restores the
+  // indentation level and the active partition, and starts a new partition.
   // To maintain the invariant that a parent range's upper-bound is equal
   // to the upper-bound of its last child, we may have to add one more
   // child whose range spans up to the parent's upper-bound.
   // The right time to do this is when an UnwrappedLine is finalized,
   // which is the same time that a new UnwrappedLine is added.
   // See StartNewUnwrappedLine().
-}
-
-void TreeUnwrapper::VisitIndentedSection(const SyntaxTreeNode& node,
-                                         int indentation_delta,
-                                         PartitionPolicyEnum partitioning) {
-  const auto last_ftoken_iter =
-      VisitIndentedChildren(node, indentation_delta, partitioning);
-
-  // TODO(fangism): do we ever need to remove trailing empty partitions here?
-
-  // Update parent's end() format token iterator to match that of
-  // its last child.  It can still be advanced later.
-  active_unwrapped_lines_->Value().SpanUpToToken(last_ftoken_iter);
-
-  // Start new empty UnwrappedLine at the previous indentation level.
-  StartNewUnwrappedLine(PartitionPolicyEnum::kUninitialized, nullptr);
+  TraversalFrame& frame = traversal_stack_.back();
+  frame.indented_section = true;
+  frame.saved_indentation_spaces = saved_indentation_spaces;
+  frame.saved_partition = saved_partition;
 }
 
 std::ostream& operator<<(std::ostream& stream, const TreeUnwrapper& unwrapper) {
@@ -15,6 +15,7 @@
 #ifndef VERIBLE_COMMON_FORMATTING_TREE_UNWRAPPER_H_
 #define VERIBLE_COMMON_FORMATTING_TREE_UNWRAPPER_H_
 
+#include <deque>
 #include <functional>
 #include <iosfwd>
 #include <vector>
@@ -36,6 +37,9 @@ namespace verible {
 // token stream, while building the unwrapped lines.
 // For more information about the (unfiltered) TokenStreamView, see
 // design documentation.
+// The syntax tree is traversed using an explicit stack of pending nodes
+// (instead of recursion), so that deeply nested code, such as machine-generated
+// chains of begin/end blocks, does not exhaust the call stack.
 class TreeUnwrapper : public TreeContextVisitor {
  protected:
   typedef std::vector<verible::PreFormatToken> preformatted_tokens_type;
@@ -100,15 +104,23 @@ class TreeUnwrapper : public TreeContextVisitor {
   void StartNewUnwrappedLine(PartitionPolicyEnum partitioning,
                              const Symbol* origin);
 
-  // Traverses the children of a node in postorder, recursively accepting this
-  // visitor.
+  // Schedules traversal of the children of a node, accepting this visitor
+  // on each one.  The children are visited after the current Visit(node)
+  // returns, so this must be the last action of Visit(node), and may be
+  // called at most once per Visit().
   void TraverseChildren(const verible::SyntaxTreeNode& node);
 
   // Override-able hook for actions that should be taken while in the
   // context of traversing children.
   virtual void InterChildNodeHook(const verible::SyntaxTreeNode&) {}
 
+  // Override-able hook for actions that should be taken after a node and
+  // all of its children have been visited, i.e. on the return path of the
+  // traversal.
+  virtual void PostVisitNodeHook(const verible::SyntaxTreeNode&) {}
+
   // Visits a subtree with (possibly) additional indentation.
+  // Like TraverseChildren(), this must be the last action of Visit(node).
   // TODO(fangism): NOW: rename this to VisitSubPartition.
   void VisitIndentedSection(const verible::SyntaxTreeNode& node,
                             int indentation_delta, PartitionPolicyEnum);
@@ -171,11 +183,34 @@ class TreeUnwrapper : public TreeContextVisitor {
   // Finalizes an UnwrappedLine, prior to starting the next one.
   void FinishUnwrappedLine();
 
-  // Returns the last iterator position from visiting a set of children.
-  // This automatically restores active_unwrapped_lines_ on return.
-  preformatted_tokens_type::const_iterator VisitIndentedChildren(
-      const verible::SyntaxTreeNode& node, int indentation_delta,
-      PartitionPolicyEnum);
+  // Traverses the syntax tree rooted at 'root', using traversal_stack_.
+  void TraverseTree(const Symbol& root);
+
+  // Accepts this visitor on 'symbol'.  Returns true if the visit is complete,
+  // false if traversal of its children was scheduled.
+  bool StartVisit(const Symbol& symbol);
+
+  // Pops the top of traversal_stack_, after all of its children are visited.
+  void FinishTraversalFrame();
+
+  // A node whose children are being traversed.
+  struct TraversalFrame {
+    TraversalFrame(SyntaxTreeContext* context, const SyntaxTreeNode& node)
+        : node(node), context_pop(context, &node) {}
+
+    const SyntaxTreeNode& node;
+
+    // Index of the next child of 'node' to visit.
+    size_t next_child = 0;
+
+    // For VisitIndentedSection(): state to restore after visiting children.
+    bool indented_section = false;
+    int saved_indentation_spaces = 0;
+    TokenPartitionTree* saved_partition = nullptr;
+
+    // Keeps 'node' in the syntax tree context while its children are visited.
+    const SyntaxTreeContext::AutoPop context_pop;
+  };
 
   // Verifies parent-child token range equivalence in the entire tree of
   // unwrapped_lines_.
@@ -226,6 +261,10 @@ class TreeUnwrapper : public TreeContextVisitor {
   // No container is actually needed because popping the stack is a matter
   // of replacing this pointer with its Parent().
   TokenPartitionTree* active_unwrapped_lines_ = nullptr;
+
+  // Stack of nodes whose children are being traversed, innermost last.
+  // (std::deque does not require movable elements, nor move them.)
+  std::deque<TraversalFrame> traversal_stack_;
 };
 
 // Prints all of the unwrapped_lines_.  Used for diagnostics only.
@@ -17,18 +17,26 @@
 #include <algorithm>
 #include <iterator>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/unwrapped_line.h"
 #include "common/text/concrete_syntax_leaf.h"
 #include "common/text/concrete_syntax_tree.h"
+#include "common/text/symbol.h"
 #include "common/text/text_structure.h"
 #include "common/text/text_structure_test_utils.h"
 #include "common/text/token_info.h"
 #include "common/text/token_stream_view.h"
+#include "common/text/tree_builder_test_util.h"
+#include "common/util/casts.h"
 #include "common/util/container_iterator_range.h"
 #include "common/util/range.h"
 #include "gtest/gtest.h"
@@ -162,4 +170,90 @@ TEST(TreeUnwrapperTest, StreamPrinting) {
             "[world], policy: always-expand, (origin: \"world\")\n");
 }
 
+// Records the sequence of visitor actions, and the depth of the syntax tree
+// context at each one.
+class EventRecordingTreeUnwrapper : public FakeTreeUnwrapper {
+ public:
+  explicit EventRecordingTreeUnwrapper(const TextStructureView& view)
+      : FakeTreeUnwrapper(view) {}
+
+  void Visit(const verible::SyntaxTreeLeaf& leaf) override {
+    Record(absl::StrCat("leaf:", leaf.get().text()));
+    FakeTreeUnwrapper::Visit(leaf);
+  }
+
+  void Visit(const SyntaxTreeNode& node) override {
+    Record("node");
+    FakeTreeUnwrapper::Visit(node);
+  }
+
+  void InterChildNodeHook(const SyntaxTreeNode& node) override {
+    Record("between");
+  }
+
+  void PostVisitNodeHook(const SyntaxTreeNode& node) override {
+    Record("post");
+  }
+
+  std::vector<std::string> events;
+
+ private:
+  void Record(absl::string_view event) {
+    events.push_back(absl::StrCat(event, "@", Context().size()));
+  }
+};
+
+// Test that hooks are called in the same order as a recursive traversal would.
+TEST(TreeUnwrapperTest, VisitationOrder) {
+  std::unique_ptr<TextStructureView> view = MakeTextStructureViewHelloWorld();
+  EventRecordingTreeUnwrapper tree_unwrapper(*view);
+  tree_unwrapper.Unwrap();
+  EXPECT_EQ(tree_unwrapper.events,
+            std::vector<std::string>({
+                "node@0",         // root
+                "between@1",      //
+                "leaf:hello@1",   //
+                "between@1",      //
+                "leaf:,@1",       //
+                "between@1",      //
+                "node@1",         // Node(world)
+                "between@2",      //
+                "leaf:world@2",   //
+                "between@2",      //
+                "post@1",         // Node(world)
+                "between@1",      //
+                "post@0",         // root
+            }));
+}
+
+// Test that very deep syntax trees do not exhaust the call stack.
+TEST(TreeUnwrapperTest, DeeplyNestedTree) {
+  constexpr int kDepth = 200000;
+  auto view = absl::make_unique<TextStructureView>("x");
+  TokenSequence& tokens = view->MutableTokenStream();
+  tokens.push_back(TokenInfo(1, view->Contents()));
+  SymbolPtr tree = Leaf(tokens[0]);
+  for (int i = 0; i < kDepth; ++i) {
+    tree = MakeNode(std::move(tree));
+  }
+  view->MutableSyntaxTree() = std::move(tree);
+
+  {
+    FakeTreeUnwrapper tree_unwrapper(*view);
+    tree_unwrapper.Unwrap();
+    const auto unwrapped_lines =
+        tree_unwrapper.FullyPartitionedUnwrappedLines();
+    ASSERT_EQ(unwrapped_lines.size(), 1);
+    EXPECT_EQ(unwrapped_lines.front().Size(), 1);
+  }
+
+  // Dismantle the tree iteratively, because destruction is recursive.
+  tree = std::move(view->MutableSyntaxTree());
+  while (tree != nullptr && tree->Kind() == SymbolKind::kNode) {
+    SymbolPtr child =
+        std::move(down_cast<SyntaxTreeNode&>(*tree).mutable_children().front());
+    tree = std::move(child);
+  }
+}
+
 }  // namespace verible
@@ -97,30 +97,34 @@ FormattedExcerpt::FormattedExcerpt(const UnwrappedLine& uwline)
 
 std::ostream& FormattedExcerpt::FormattedText(std::ostream& stream,
                                               bool indent) const {
-  if (tokens_.empty()) return stream;
+  std::string output;
+  AppendFormattedText(&output, indent);
+  return stream << output;
+}
+
+void FormattedExcerpt::AppendFormattedText(std::string* output,
+                                           bool indent) const {
+  if (tokens_.empty()) return;
   // Let caller print the preceding/trailing newline.
   if (indent) {
     if (tokens_.front().before.action != SpacingDecision::Preserve) {
-      stream << Spacer(IndentationSpaces());
+      output->append(IndentationSpaces(), ' ');
     }
   }
   // We do not want the indentation before the first token, if it was
   // already handled separately.
   const auto& front = tokens_.front();
   VLOG(2) << "action: " << front.before.action;
-  switch (front.before.action) {
-    case SpacingDecision::Align:
-      // When aligning tokens, the first token might be further indented.
-      stream << Spacer(front.before.spaces) << front.token->text();
-      break;
-    default:
-      stream << front.token->text();
+  if (front.before.action == SpacingDecision::Align) {
+    // When aligning tokens, the first token might be further indented.
+    output->append(front.before.spaces, ' ');
   }
+  const absl::string_view front_text(front.token->text());
+  output->append(front_text.data(), front_text.size());
   for (const auto& ftoken :
        verible::make_range(tokens_.begin() + 1, tokens_.end())) {
-    stream << ftoken;
+    ftoken.AppendFormattedText(output);
   }
-  return stream;
 }
 
 std::ostream& operator<<(std::ostream& stream,
@@ -129,9 +133,9 @@ std::ostream& operator<<(std::ostream& stream,
 }
 
 std::string FormattedExcerpt::Render() const {
-  std::ostringstream stream;
-  FormattedText(stream, true);
-  return stream.str();
+  std::string output;
+  AppendFormattedText(&output, true);
+  return output;
 }
 
 }  // namespace verible
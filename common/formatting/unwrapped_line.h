@@ -177,6 +177,9 @@ class FormattedExcerpt {
   // that is to the left of the first token.
   std::ostream& FormattedText(std::ostream&, bool indent) const;
 
+  // Same as FormattedText(), but appends to 'output'.
+  void AppendFormattedText(std::string* output, bool indent) const;
+
   // Returns formatted code as a string.
   std::string Render() const;
 
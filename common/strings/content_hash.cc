@@ -0,0 +1,43 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/strings/content_hash.h"
+
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace verible {
+
+std::string ContentHash(absl::string_view text) {
+  // Two independent 64-bit hashes: FNV-1a, and a multiplicative hash with
+  // a final avalanche (from splitmix64).
+  uint64_t fnv = 0xcbf29ce484222325ULL;
+  uint64_t mix = 0x9e3779b97f4a7c15ULL ^ text.length();
+  for (const char c : text) {
+    const uint64_t byte = static_cast<unsigned char>(c);
+    fnv = (fnv ^ byte) * 0x100000001b3ULL;
+    mix = (mix + byte + 1) * 0xbf58476d1ce4e5b9ULL;
+    mix ^= mix >> 29;
+  }
+  mix ^= mix >> 30;
+  mix *= 0x94d049bb133111ebULL;
+  mix ^= mix >> 31;
+  return absl::StrCat(absl::Hex(fnv, absl::kZeroPad16),
+                      absl::Hex(mix, absl::kZeroPad16));
+}
+
+}  // namespace verible
@@ -0,0 +1,31 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_COMMON_STRINGS_CONTENT_HASH_H_
+#define VERIBLE_COMMON_STRINGS_CONTENT_HASH_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+namespace verible {
+
+// Returns a 128-bit hash of 'text' as 32 hex digits.  The result is stable
+// across processes and platforms, so it can be used to name files, or be
+// stored to detect later changes of the text.
+std::string ContentHash(absl::string_view text);
+
+}  // namespace verible
+
+#endif  // VERIBLE_COMMON_STRINGS_CONTENT_HASH_H_
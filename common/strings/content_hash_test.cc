@@ -0,0 +1,35 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/strings/content_hash.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace verible {
+namespace {
+
+TEST(ContentHashTest, Stable) {
+  EXPECT_EQ(ContentHash("").length(), 32);
+  EXPECT_EQ(ContentHash("module m; endmodule\n"),
+            ContentHash("module m; endmodule\n"));
+  EXPECT_NE(ContentHash("module m; endmodule\n"),
+            ContentHash("module m;  endmodule\n"));
+  EXPECT_NE(ContentHash("ab"), ContentHash("ba"));
+  EXPECT_NE(ContentHash(""), ContentHash(std::string(1, '\0')));
+}
+
+}  // namespace
+}  // namespace verible
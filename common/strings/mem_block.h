@@ -0,0 +1,54 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_COMMON_STRINGS_MEM_BLOCK_H_
+#define VERIBLE_COMMON_STRINGS_MEM_BLOCK_H_
+
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+
+namespace verible {
+
+// An immutable block of memory, such as the contents of a file, that
+// owns the bytes returned by AsStringView() for as long as it is alive.
+// Ownership of a MemBlock can be passed along (e.g. from a file reader
+// into a TextStructure) without copying the contents.
+class MemBlock {
+ public:
+  virtual ~MemBlock() = default;
+
+  // Returns a view of the whole block.
+  virtual absl::string_view AsStringView() const = 0;
+};
+
+// MemBlock backed by a std::string.
+class StringMemBlock final : public MemBlock {
+ public:
+  StringMemBlock() = default;
+  explicit StringMemBlock(std::string content) : content_(std::move(content)) {}
+
+  StringMemBlock(const StringMemBlock&) = delete;
+  StringMemBlock& operator=(const StringMemBlock&) = delete;
+
+  absl::string_view AsStringView() const final { return content_; }
+
+ private:
+  const std::string content_;
+};
+
+}  // namespace verible
+
+#endif  // VERIBLE_COMMON_STRINGS_MEM_BLOCK_H_
@@ -0,0 +1,39 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/strings/string_interner.h"
+
+#include "common/util/logging.h"
+
+namespace verible {
+
+StringInterner::id_type StringInterner::Intern(absl::string_view text) {
+  const auto found = ids_.find(text);
+  if (found != ids_.end()) return found->second;
+
+  const id_type id = strings_.size();
+  CHECK_EQ(size_t(id), strings_.size()) << "Too many distinct strings.";
+  strings_.emplace_back(text);
+  ids_.emplace(strings_.back(), id);
+  return id;
+}
+
+absl::optional<StringInterner::id_type> StringInterner::Find(
+    absl::string_view text) const {
+  const auto found = ids_.find(text);
+  if (found == ids_.end()) return absl::nullopt;
+  return found->second;
+}
+
+}  // namespace verible
@@ -0,0 +1,73 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_COMMON_STRINGS_STRING_INTERNER_H_
+#define VERIBLE_COMMON_STRINGS_STRING_INTERNER_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace verible {
+
+// StringInterner maps distinct strings to dense integer identifiers
+// (0, 1, 2, ...), in order of first appearance, and owns one copy of each
+// distinct string.  Comparing identifiers is cheaper than comparing strings,
+// and identifiers can index into flat arrays.
+//
+// Interning is not thread-safe, but concurrent lookups (without interning)
+// are.
+class StringInterner {
+ public:
+  typedef uint32_t id_type;
+
+  StringInterner() = default;
+
+  StringInterner(const StringInterner&) = delete;
+  StringInterner(StringInterner&&) = delete;
+  StringInterner& operator=(const StringInterner&) = delete;
+  StringInterner& operator=(StringInterner&&) = delete;
+
+  // Returns the identifier of 'text', adding it if it is new.
+  id_type Intern(absl::string_view text);
+
+  // Returns the identifier of 'text', if it was already interned.
+  absl::optional<id_type> Find(absl::string_view text) const;
+
+  // Returns the string of a previously returned identifier.
+  // The returned string_view remains valid for the lifetime of this object.
+  absl::string_view Text(id_type id) const { return strings_[id]; }
+
+  // Returns the number of distinct strings.
+  size_t size() const { return strings_.size(); }
+
+  bool empty() const { return strings_.empty(); }
+
+ private:
+  // Owned copies of strings, indexed by identifier.
+  // std::deque never relocates its elements, so string_views into them
+  // (including the keys of 'ids_') remain valid as more are added.
+  std::deque<std::string> strings_;
+
+  // Maps (owned) strings to their identifiers.
+  absl::flat_hash_map<absl::string_view, id_type> ids_;
+};
+
+}  // namespace verible
+
+#endif  // VERIBLE_COMMON_STRINGS_STRING_INTERNER_H_
@@ -0,0 +1,69 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/strings/string_interner.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace verible {
+namespace {
+
+TEST(StringInternerTest, Empty) {
+  const StringInterner interner;
+  EXPECT_TRUE(interner.empty());
+  EXPECT_EQ(interner.size(), 0);
+  EXPECT_FALSE(interner.Find("clk"));
+}
+
+TEST(StringInternerTest, DenseIdentifiers) {
+  StringInterner interner;
+  EXPECT_EQ(interner.Intern("clk"), 0);
+  EXPECT_EQ(interner.Intern("rst_n"), 1);
+  EXPECT_EQ(interner.Intern("clk"), 0);  // already interned
+  EXPECT_EQ(interner.Intern(""), 2);
+  EXPECT_EQ(interner.size(), 3);
+  EXPECT_EQ(interner.Text(0), "clk");
+  EXPECT_EQ(interner.Text(1), "rst_n");
+  EXPECT_EQ(interner.Text(2), "");
+  EXPECT_EQ(*interner.Find("rst_n"), 1);
+  EXPECT_FALSE(interner.Find("data"));
+}
+
+TEST(StringInternerTest, OwnsCopies) {
+  StringInterner interner;
+  absl::string_view text;
+  {
+    std::string temporary("data");
+    const auto id = interner.Intern(temporary);
+    text = interner.Text(id);
+    temporary = "modified";
+  }
+  EXPECT_EQ(text, "data");
+  EXPECT_EQ(*interner.Find("data"), 0);
+}
+
+TEST(StringInternerTest, StableText) {
+  StringInterner interner;
+  const absl::string_view first = interner.Text(interner.Intern("a"));
+  for (int i = 0; i < 1000; ++i) {
+    interner.Intern(std::to_string(i));  // short strings, no relocation
+  }
+  EXPECT_EQ(interner.Text(0).data(), first.data());
+  EXPECT_EQ(*interner.Find("999"), 1000);
+}
+
+}  // namespace
+}  // namespace verible
@@ -81,6 +81,18 @@ class StringViewSuperRangeMap {
     return string_map_.must_emplace(superstring.begin(), superstring.end());
   }
 
+  // Removes a superstring (range) that was previously inserted, e.g. before
+  // its memory is released.  Returns false if no such range was found.
+  bool erase(absl::string_view superstring) {
+    const const_iterator found(find(superstring));
+    if (found == string_map_.end() || found->first != superstring.begin() ||
+        found->second != superstring.end()) {
+      return false;
+    }
+    string_map_.erase(found);
+    return true;
+  }
+
  private:
   // Internal representation of string range map.
   impl_type string_map_;
@@ -105,6 +105,20 @@ TEST(StringViewSuperRangeMapTest, TwoStrings) {
   });
 }
 
+TEST(StringViewSuperRangeMapTest, Erase) {
+  StringViewSuperRangeMap svmap;
+  constexpr absl::string_view text1("hello"), text2("world");
+  svmap.must_emplace(text1);
+  svmap.must_emplace(text2);
+  EXPECT_FALSE(svmap.erase(text1.substr(1)));  // not a whole range
+  EXPECT_TRUE(svmap.erase(text1));
+  EXPECT_FALSE(svmap.erase(text1));  // already erased
+  EXPECT_EQ(svmap.find(text1), svmap.end());
+  EXPECT_TRUE(BoundsEqual(svmap.must_find(text2), text2));
+  svmap.must_emplace(text1);  // can be re-inserted
+  EXPECT_TRUE(BoundsEqual(svmap.must_find(text1), text1));
+}
+
 // Function to get the owned address range of the underlying string.
 static absl::string_view StringViewKey(
     const std::unique_ptr<const std::string>& owned) {
@@ -30,6 +30,7 @@
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "common/strings/line_column_map.h"
+#include "common/strings/mem_block.h"
 #include "common/text/concrete_syntax_leaf.h"
 #include "common/text/concrete_syntax_tree.h"
 #include "common/text/symbol.h"
@@ -458,7 +459,11 @@ void TextStructureView::ConsumeDeferredExpansion(
 }
 
 TextStructure::TextStructure(absl::string_view contents)
-    : owned_contents_(contents), data_(owned_contents_) {
+    : TextStructure(std::make_shared<StringMemBlock>(std::string(contents))) {}
+
+TextStructure::TextStructure(std::shared_ptr<MemBlock> contents)
+    : owned_contents_(std::move(contents)),
+      data_(ABSL_DIE_IF_NULL(owned_contents_)->AsStringView()) {
   // Internal string_view must point to memory owned by owned_contents_.
   const absl::Status status = InternalConsistencyCheck();
   CHECK(status.ok()) << status.message() << " (in ctor)";
@@ -507,7 +512,7 @@ void TextStructureView::ExpandSubtrees(NodeExpansionMap* expansions) {
 absl::Status TextStructure::StringViewConsistencyCheck() const {
   const absl::string_view contents = data_.Contents();
   if (!contents.empty() &&
-      !IsSubRange(contents, absl::string_view(owned_contents_))) {
+      !IsSubRange(contents, owned_contents_->AsStringView())) {
     return absl::InternalError(
         "string_view contents_ is not a substring of owned_contents_, "
         "contents_ might reference deallocated memory!");
@@ -35,6 +35,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "common/strings/line_column_map.h"
+#include "common/strings/mem_block.h"
 #include "common/text/concrete_syntax_tree.h"
 #include "common/text/symbol.h"
 #include "common/text/token_stream_view.h"
@@ -211,8 +212,12 @@ class TextStructureView {
 // the same owned memory can be used for multiple analysis views.
 class TextStructure {
  public:
+  // Copies 'contents' into memory owned by this object.
   explicit TextStructure(absl::string_view contents);
 
+  // Shares ownership of 'contents' (non-null), without copying them.
+  explicit TextStructure(std::shared_ptr<MemBlock> contents);
+
   TextStructure(const TextStructure&) = delete;
   TextStructure& operator=(const TextStructure&) = delete;
   TextStructure(TextStructure&&) = delete;
@@ -234,11 +239,9 @@ class TextStructure {
   absl::Status InternalConsistencyCheck() const;
 
  protected:
-  // This string owns the memory referenced by all substring string_views
+  // This block owns the memory referenced by all substring string_views
   // in this object.
-  // TODO(hzeller): avoid local copy and just require that the string-view
-  // we are called with outlives this object?
-  const std::string owned_contents_;
+  const std::shared_ptr<MemBlock> owned_contents_;
 
   // The data_ object's string_views are owned by owned_contents_.
   TextStructureView data_;
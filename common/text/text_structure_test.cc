@@ -26,6 +26,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "common/strings/line_column_map.h"
+#include "common/strings/mem_block.h"
 #include "common/text/concrete_syntax_tree.h"
 #include "common/text/symbol.h"
 #include "common/text/text_structure_test_utils.h"
@@ -63,6 +64,19 @@ TEST(TextStructureViewCtorTest, InitializeContents) {
   }
 }
 
+// Test that a TextStructure constructed from a MemBlock does not copy it.
+TEST(TextStructureCtorTest, SharesMemBlock) {
+  auto block = std::make_shared<StringMemBlock>("module foo;\nendmodule\n");
+  const absl::string_view text = block->AsStringView();
+  {
+    TextStructure structure(block);
+    EXPECT_EQ(structure.Data().Contents().data(), text.data());
+    EXPECT_EQ(structure.Data().Contents(), text);
+    EXPECT_EQ(block.use_count(), 2);
+  }
+  EXPECT_EQ(block.use_count(), 1);
+}
+
 // Test that filtering nothing works.
 TEST(FilterTokensTest, EmptyTokens) {
   TextStructureView test_view("blah");
@@ -17,14 +17,23 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <streambuf>
 #include <string>
 #include <system_error>
+#include <utility>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -32,6 +41,7 @@
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "common/strings/mem_block.h"
 #include "common/util/logging.h"
 
 namespace fs = std::filesystem;
@@ -147,13 +157,89 @@ absl::Status GetContents(absl::string_view filename, std::string *content) {
     stream = &fs;
   }
   if (!stream->good()) return CreateErrorStatusFromErrno("can't read");
-  content->assign((std::istreambuf_iterator<char>(*stream)),
-                  std::istreambuf_iterator<char>());
+  content->clear();
+  std::streambuf *const buffer = stream->rdbuf();
+  // Regular files know their size up front: read them into a buffer of that
+  // size in one go.  This is much faster for large files than going through
+  // std::istreambuf_iterator, which copies one character at a time.
+  const std::streamoff size =
+      use_stdin ? std::streamoff(-1)
+                : std::streamoff(
+                      buffer->pubseekoff(0, std::ios::end, std::ios::in));
+  if (size > 0 && buffer->pubseekpos(0, std::ios::in) == 0) {
+    content->resize(size);
+    content->resize(std::max<std::streamsize>(
+        buffer->sgetn(&(*content)[0], size), 0));
+  }
+  // Pipes and stdin (and files that grew while reading) are read in chunks.
+  char chunk[64 << 10];
+  for (std::streamsize n; (n = buffer->sgetn(chunk, sizeof(chunk))) > 0;) {
+    content->append(chunk, n);
+  }
   // Allow stdin to be reopened for more input.
   if (use_stdin && std::cin.eof()) std::cin.clear();
   return absl::OkStatus();
 }
 
+absl::StatusOr<std::unique_ptr<MemBlock>> GetContentAsMemBlock(
+    absl::string_view filename) {
+  std::string content;
+  const absl::Status status = GetContents(filename, &content);
+  if (!status.ok()) return status;
+  return std::make_unique<StringMemBlock>(std::move(content));
+}
+
+#ifndef _WIN32
+namespace {
+// Read-only memory mapping of a whole file.
+class MemoryMappedBlock final : public MemBlock {
+ public:
+  MemoryMappedBlock(const void *data, size_t size)
+      : data_(static_cast<const char *>(data)), size_(size) {}
+  ~MemoryMappedBlock() final { munmap(const_cast<char *>(data_), size_); }
+
+  MemoryMappedBlock(const MemoryMappedBlock &) = delete;
+  MemoryMappedBlock &operator=(const MemoryMappedBlock &) = delete;
+
+  absl::string_view AsStringView() const final {
+    return absl::string_view(data_, size_);
+  }
+
+ private:
+  const char *const data_;
+  const size_t size_;
+};
+}  // namespace
+#endif
+
+absl::StatusOr<std::unique_ptr<MemBlock>> MemoryMapFile(
+    absl::string_view filename) {
+#ifndef _WIN32
+  const std::string filename_str(filename);
+  const absl::Status usable_file = FileExists(filename_str);
+  if (!usable_file.ok()) return usable_file;
+  const int fd = open(filename_str.c_str(), O_RDONLY);
+  if (fd < 0) return CreateErrorStatusFromErrno("can't open");
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    const absl::Status status = CreateErrorStatusFromErrno("can't stat");
+    close(fd);
+    return status;
+  }
+  // Empty files can't be mapped, and pipes don't have a size.
+  if (S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+    const size_t size = file_stat.st_size;
+    void *const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the file.
+    close(fd);
+    if (data == MAP_FAILED) return CreateErrorStatusFromErrno("can't map");
+    return std::make_unique<MemoryMappedBlock>(data, size);
+  }
+  close(fd);
+#endif
+  return GetContentAsMemBlock(filename);
+}
+
 absl::Status SetContents(absl::string_view filename,
                          absl::string_view content) {
   VLOG(1) << __FUNCTION__ << ": Writing file: " << filename;
@@ -163,6 +249,68 @@ absl::Status SetContents(absl::string_view filename,
   return absl::OkStatus();
 }
 
+absl::Status SetContentsAtomically(absl::string_view filename,
+                                   absl::string_view content) {
+#ifdef _WIN32
+  // No exclusive-create/rename-over support to rely on; write in place.
+  return SetContents(filename, content);
+#else
+  std::string target(filename);
+  struct stat target_stat;
+  const bool target_exists = lstat(target.c_str(), &target_stat) == 0;
+  if (target_exists && S_ISLNK(target_stat.st_mode)) {
+    // Replace the file the link points to, not the link itself.
+    std::error_code err;
+    const fs::path resolved = fs::canonical(target, err);
+    if (err.value() != 0) return SetContents(filename, content);  // dangling
+    return SetContentsAtomically(resolved.string(), content);
+  }
+  // Renaming over anything but a plain file with a single link would replace
+  // a device/pipe or split off other hard links, so write those in place.
+  if (target_exists &&
+      (!S_ISREG(target_stat.st_mode) || target_stat.st_nlink > 1)) {
+    return SetContents(filename, content);
+  }
+
+  // The pid keeps names of concurrent writers in different processes apart,
+  // the counter those of threads in this process.  O_EXCL makes sure that
+  // we never share a file with a leftover of a crashed writer.
+  static std::atomic<int> temp_file_counter(0);
+  std::string temp_file;
+  int fd = -1;
+  for (int attempt = 0; fd < 0 && attempt < 100; ++attempt) {
+    temp_file =
+        absl::StrCat(target, ".tmp-", getpid(), "-", temp_file_counter++);
+    fd = open(temp_file.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0 && errno != EEXIST) break;
+  }
+  if (fd < 0) return CreateErrorStatusFromErrno("can't write.");
+
+  absl::Status status;
+  for (absl::string_view remaining = content; !remaining.empty();) {
+    const ssize_t written = write(fd, remaining.data(), remaining.size());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      status = CreateErrorStatusFromErrno("can't write.");
+      break;
+    }
+    remaining.remove_prefix(written);
+  }
+  if (status.ok() && target_exists &&
+      fchmod(fd, target_stat.st_mode & 07777) != 0) {
+    status = CreateErrorStatusFromErrno("can't set permissions.");
+  }
+  if (close(fd) != 0 && status.ok()) {
+    status = CreateErrorStatusFromErrno("can't write.");
+  }
+  if (status.ok() && rename(temp_file.c_str(), target.c_str()) != 0) {
+    status = CreateErrorStatusFromErrno("can't replace file.");
+  }
+  if (!status.ok()) unlink(temp_file.c_str());
+  return status;
+#endif
+}
+
 std::string JoinPath(absl::string_view base, absl::string_view name) {
   // Make sure the second element is not already absolute, otherwise
   // the fs::path() uses this as toplevel path. This is only an issue with
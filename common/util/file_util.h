@@ -17,12 +17,14 @@
 #ifndef VERIBLE_COMMON_UTIL_FILE_UTIL_H_
 #define VERIBLE_COMMON_UTIL_FILE_UTIL_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "common/strings/mem_block.h"
 
 namespace verible {
 namespace file {
@@ -65,9 +67,34 @@ absl::Status FileExists(const std::string& filename);
 // Read file "filename" and store its content in "content"
 absl::Status GetContents(absl::string_view filename, std::string* content);
 
+// Like GetContents(), but returns the content in a MemBlock whose ownership
+// can be handed to a consumer (e.g. an analyzer) without copying it again.
+absl::StatusOr<std::unique_ptr<MemBlock>> GetContentAsMemBlock(
+    absl::string_view filename);
+
+// Like GetContentAsMemBlock(), but maps the regular file "filename" into
+// memory read-only, instead of reading it, so that only the pages that are
+// accessed are ever loaded.
+// Only use this for files that are replaced atomically (as with
+// SetContentsAtomically()), never modified in place: accessing the mapping
+// of a file that was truncated in the meantime crashes.
+// Falls back to reading the file where mapping is not supported.
+absl::StatusOr<std::unique_ptr<MemBlock>> MemoryMapFile(
+    absl::string_view filename);
+
 // Create file "filename" and store given content in it.
 absl::Status SetContents(absl::string_view filename, absl::string_view content);
 
+// Like SetContents(), but writes "content" to a temporary file next to
+// "filename" first, and then renames it into place, so that readers never
+// observe a partially written file.  Permissions of an existing "filename"
+// are preserved, and a symbolic link is written through to its target.
+// Targets that are not plain files, or have more than one hard link, are
+// written in place like SetContents() does.  Safe to call concurrently, also
+// from different processes.
+absl::Status SetContentsAtomically(absl::string_view filename,
+                                   absl::string_view content);
+
 // Join directory + filename
 std::string JoinPath(absl::string_view base, absl::string_view name);
 
@@ -21,6 +21,7 @@
 
 #include "absl/status/status.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -112,6 +113,64 @@ TEST(FileUtil, CreateDir) {
   EXPECT_EQ(test_content, read_back_content);
 }
 
+TEST(FileUtil, SetContentsAtomically) {
+  const std::string test_file =
+      file::JoinPath(testing::TempDir(), "atomic-write");
+  unlink(test_file.c_str());  // Remove file if left from previous test.
+
+  // Creates a new file.
+  EXPECT_OK(file::SetContentsAtomically(test_file, "foo"));
+  std::string content;
+  EXPECT_OK(file::GetContents(test_file, &content));
+  EXPECT_EQ(content, "foo");
+
+  // Replaces an existing file, leaving no temporary files behind.
+  EXPECT_OK(file::SetContentsAtomically(test_file, "barbaz"));
+  EXPECT_OK(file::GetContents(test_file, &content));
+  EXPECT_EQ(content, "barbaz");
+  for (const auto& entry :
+       std::filesystem::directory_iterator(testing::TempDir())) {
+    EXPECT_FALSE(absl::StartsWith(entry.path().filename().string(),
+                                  "atomic-write.tmp-"))
+        << entry.path();
+  }
+
+  // Writing into a non-existent directory fails.
+  EXPECT_FALSE(file::SetContentsAtomically(
+                   file::JoinPath(test_file + "-nodir", "x"), "foo")
+                   .ok());
+}
+
+#ifndef _WIN32
+TEST(FileUtil, SetContentsAtomicallyKeepsLinks) {
+  const std::string target = file::JoinPath(testing::TempDir(), "atomic-dest");
+  const std::string symlink_file =
+      file::JoinPath(testing::TempDir(), "atomic-symlink");
+  const std::string hardlink_file =
+      file::JoinPath(testing::TempDir(), "atomic-hardlink");
+  for (const std::string &f : {target, symlink_file, hardlink_file}) {
+    unlink(f.c_str());  // Remove file if left from previous test.
+  }
+  EXPECT_OK(file::SetContents(target, "foo"));
+  std::filesystem::create_symlink(target, symlink_file);
+  std::filesystem::create_hard_link(target, hardlink_file);
+
+  // Writing through the symbolic link keeps the link and updates the target.
+  EXPECT_OK(file::SetContentsAtomically(symlink_file, "bar"));
+  EXPECT_TRUE(std::filesystem::is_symlink(symlink_file));
+  std::string content;
+  EXPECT_OK(file::GetContents(target, &content));
+  EXPECT_EQ(content, "bar");
+
+  // Writing a hard link is seen through all of its names.
+  EXPECT_OK(file::SetContentsAtomically(hardlink_file, "bazbaz"));
+  EXPECT_OK(file::GetContents(target, &content));
+  EXPECT_EQ(content, "bazbaz");
+  EXPECT_OK(file::GetContents(symlink_file, &content));
+  EXPECT_EQ(content, "bazbaz");
+}
+#endif
+
 TEST(FileUtil, StatusErrorReporting) {
   std::string content;
   absl::Status status = file::GetContents("does-not-exist", &content);
@@ -144,6 +203,52 @@ TEST(FileUtil, ScopedTestFile) {
   EXPECT_EQ(test_content, read_back_content);
 }
 
+TEST(FileUtil, GetContentsOfEmptyFile) {
+  ScopedTestFile test_file(testing::TempDir(), "");
+  std::string content = "not empty";
+  EXPECT_OK(file::GetContents(test_file.filename(), &content));
+  EXPECT_TRUE(content.empty());
+}
+
+TEST(FileUtil, GetContentsOfLargeFile) {
+  // Larger than any internal read buffer, and not a multiple of its size.
+  std::string test_content;
+  for (int i = 0; test_content.size() < (1 << 20); ++i) {
+    absl::StrAppend(&test_content, "line ", i, "\n");
+  }
+  ScopedTestFile test_file(testing::TempDir(), test_content);
+  std::string read_back_content = "previous content";
+  EXPECT_OK(file::GetContents(test_file.filename(), &read_back_content));
+  EXPECT_EQ(test_content, read_back_content);
+}
+
+TEST(FileUtil, GetContentAsMemBlock) {
+  const absl::string_view test_content = "Hello\nWorld!\n";
+  ScopedTestFile test_file(testing::TempDir(), test_content);
+  const auto block = file::GetContentAsMemBlock(test_file.filename());
+  ASSERT_OK(block.status());
+  EXPECT_EQ((*block)->AsStringView(), test_content);
+
+  const auto missing = file::GetContentAsMemBlock("does-not-exist");
+  EXPECT_EQ(missing.status().code(), absl::StatusCode::kNotFound);
+}
+
+TEST(FileUtil, MemoryMapFile) {
+  const absl::string_view test_content = "module m;\nendmodule\n";
+  ScopedTestFile test_file(testing::TempDir(), test_content);
+  const auto block = file::MemoryMapFile(test_file.filename());
+  ASSERT_OK(block.status());
+  EXPECT_EQ((*block)->AsStringView(), test_content);
+
+  ScopedTestFile empty_file(testing::TempDir(), "");
+  const auto empty_block = file::MemoryMapFile(empty_file.filename());
+  ASSERT_OK(empty_block.status());
+  EXPECT_TRUE((*empty_block)->AsStringView().empty());
+
+  const auto missing = file::MemoryMapFile("does-not-exist");
+  EXPECT_EQ(missing.status().code(), absl::StatusCode::kNotFound);
+}
+
 static ScopedTestFile TestFileGenerator(absl::string_view content) {
   return ScopedTestFile(testing::TempDir(), content);
 }
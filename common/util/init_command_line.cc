@@ -26,7 +26,7 @@
 
 namespace verible {
 
-static std::string GetBuildVersion() {
+std::string GetBuildVersion() {
   std::string result;
   // Build a version string with as much as possible info.
 #ifdef VERIBLE_GIT_DESCRIBE
@@ -15,12 +15,17 @@
 #ifndef VERIBLE_COMMON_UTIL_INIT_COMMAND_LINE_H_
 #define VERIBLE_COMMON_UTIL_INIT_COMMAND_LINE_H_
 
+#include <string>
 #include <vector>
 
 #include "absl/strings/string_view.h"
 
 namespace verible {
 
+// Returns the version information stamped into this build (git describe,
+// commit date, build time), or an empty string for unstamped builds.
+std::string GetBuildVersion();
+
 // Initializes command-line tool, including parsing flags.
 // Returns positional arguments, where element[0] is the program name.
 std::vector<char*> InitCommandLine(absl::string_view usage, int* argc,
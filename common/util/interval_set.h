@@ -629,6 +629,9 @@ class DisjointIntervalSet : private _IntervalSetImpl {
     return p.first;
   }
 
+  // Removes the interval at 'pos', which must be a valid iterator.
+  void erase(const_iterator pos) { intervals_.erase(pos); }
+
  private:
   impl_type intervals_;
 };
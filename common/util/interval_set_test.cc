@@ -1115,6 +1115,17 @@ TEST(DisjointIntervalSetTest, MustEmplaceOverlapsUpper) {
   EXPECT_DEATH(iset.must_emplace(45, 55), "Failed to emplace");
 }
 
+TEST(DisjointIntervalSetTest, EraseThenReEmplace) {
+  IntIntervalSet iset;
+  iset.must_emplace(30, 40);
+  iset.must_emplace(50, 60);
+  iset.erase(iset.find(35));
+  EXPECT_EQ(iset.find(35), iset.end());
+  EXPECT_NE(iset.find(55), iset.end());
+  iset.must_emplace(35, 45);  // no longer overlaps
+  EXPECT_NE(iset.find(44), iset.end());
+}
+
 TEST(DisjointIntervalMapTest, FindInterval) {
   IntIntervalSet iset;
   iset.must_emplace(20, 25);
@@ -200,8 +200,27 @@ class MapTree {
 
   // TODO(fangism): TryEmplaceHint(), like map::emplace_hint.
 
+  // Moves the child subtree at 'pos' (which must belong to 'other') to this
+  // node, under the same key, if this node does not already have that key.
+  // No nodes are copied or relocated, so pointers to moved nodes (and their
+  // values) remain valid.
+  // Returns (iterator, bool) like TryEmplace(), where false means that a
+  // subtree already existed at that key, and that 'other' was left unchanged.
+  std::pair<iterator, bool> TrySplice(this_type* other, iterator pos) {
+    const auto found = subtrees_.find(pos->first);
+    if (found != subtrees_.end()) return {found, false};
+    const auto inserted = subtrees_.insert(other->subtrees_.extract(pos));
+    // Link child to its new parent.
+    inserted.position->second.parent_ = this;
+    return {inserted.position, true};
+  }
+
   // Erasure
-  // TODO(fangism): void Erase(key);
+
+  // Removes the child subtree at 'pos', destroying all of its nodes.
+  // Iterators and pointers to other nodes remain valid.
+  // Returns the iterator following the removed subtree.
+  iterator Erase(iterator pos) { return subtrees_.erase(pos); }
 
   // Iteration/Navigation
 
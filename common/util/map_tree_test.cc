@@ -190,6 +190,62 @@ TEST(MapTreeTest, EmplaceSecondKey) {
   EXPECT_EQ(m.Find(9), first_iter);  // iterator stability on insert
 }
 
+TEST(MapTreeTest, SpliceSubtree) {
+  MapTreeTestType m("foo", KV{1, MapTreeTestType("bar")});
+  MapTreeTestType n("zoo",  //
+                    KV{2, MapTreeTestType("car",  //
+                                          KV{5, MapTreeTestType("dar")})});
+  const auto moved = n.Find(2);
+  const MapTreeTestType* moved_node = &moved->second;
+  const MapTreeTestType* grandchild = &moved->second.Find(5)->second;
+
+  const auto p = m.TrySplice(&n, moved);
+  EXPECT_TRUE(p.second);
+  EXPECT_TRUE(n.is_leaf());
+  EXPECT_EQ(m.Children().size(), 2);
+  EXPECT_EQ(p.first->first, 2);
+  // Nodes were not relocated.
+  EXPECT_EQ(&p.first->second, moved_node);
+  EXPECT_EQ(moved_node->Parent(), &m);
+  EXPECT_EQ(grandchild->Parent(), moved_node);
+  EXPECT_EQ(grandchild->Root(), &m);
+  EXPECT_EQ(*moved_node->Key(), 2);
+  EXPECT_TRUE(m.CheckIntegrity());
+  EXPECT_TRUE(n.CheckIntegrity());
+}
+
+TEST(MapTreeTest, SpliceSubtreeDuplicateKeyFails) {
+  MapTreeTestType m("foo", KV{2, MapTreeTestType("bar")});
+  MapTreeTestType n("zoo", KV{2, MapTreeTestType("car")});
+  const auto p = m.TrySplice(&n, n.begin());
+  EXPECT_FALSE(p.second);
+  EXPECT_EQ(p.first, m.begin());
+  EXPECT_EQ(p.first->second.Value(), "bar");  // first entry retained
+  // 'n' is unchanged.
+  ASSERT_EQ(n.Children().size(), 1);
+  EXPECT_EQ(n.begin()->second.Value(), "car");
+  EXPECT_EQ(n.begin()->second.Parent(), &n);
+}
+
+TEST(MapTreeTest, EraseSubtree) {
+  MapTreeTestType m("foo",  //
+                    KV{1, MapTreeTestType("bar",  //
+                                          KV{3, MapTreeTestType("baz")})},
+                    KV{2, MapTreeTestType("car")});
+  const MapTreeTestType* kept = &m.Find(2)->second;
+  const auto next = m.Erase(m.Find(1));
+  EXPECT_EQ(next, m.Find(2));
+  ASSERT_EQ(m.Children().size(), 1);
+  EXPECT_EQ(m.Find(1), m.end());
+  // Remaining nodes were not relocated.
+  EXPECT_EQ(&m.Find(2)->second, kept);
+  EXPECT_EQ(kept->Parent(), &m);
+  EXPECT_TRUE(m.CheckIntegrity());
+
+  EXPECT_EQ(m.Erase(m.begin()), m.end());
+  EXPECT_TRUE(m.is_leaf());
+}
+
 TEST(MapTreeTest, InitializeMultipleChildrenWithDuplicateKey) {
   const MapTreeTestType m("foo",  //
                           KV{4, MapTreeTestType("bbb")},
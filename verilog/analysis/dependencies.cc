@@ -14,8 +14,15 @@
 
 #include "verilog/analysis/dependencies.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "common/strings/compare.h"
 #include "common/strings/display_utils.h"
 #include "common/util/logging.h"
@@ -148,6 +155,147 @@ std::ostream& FileDependencies::PrintGraph(std::ostream& stream) const {
   return stream;
 }
 
+FileCompileOrder FileDependencies::CompileOrder(
+    absl::Span<const node_type> more_files) const {
+  VLOG(1) << __FUNCTION__;
+  // Number the files in name order, for deterministic results.
+  std::vector<node_type> files(more_files.begin(), more_files.end());
+  for (const auto& symbol : root_symbols_index) {
+    if (symbol.second.definer != nullptr) {
+      files.push_back(symbol.second.definer);
+    }
+    files.insert(files.end(), symbol.second.referencers.begin(),
+                 symbol.second.referencers.end());
+  }
+  std::sort(files.begin(), files.end(), FileCompare());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+  const uint32_t num_files = files.size();
+  absl::flat_hash_map<node_type, uint32_t> file_numbers;
+  file_numbers.reserve(num_files);
+  for (uint32_t i = 0; i < num_files; ++i) file_numbers[files[i]] = i;
+
+  // Compressed adjacency lists: the dependencies of file i are
+  // edge_targets[edge_offsets[i] .. edge_offsets[i + 1]).
+  std::vector<uint32_t> edge_offsets(num_files + 1, 0);
+  std::vector<uint32_t> edge_targets;
+  for (const auto& ref : file_deps) {
+    const uint32_t ref_number = file_numbers.at(ref.first);
+    for (const auto& def : ref.second) {
+      if (def.second.empty()) continue;
+      edge_targets.push_back(file_numbers.at(def.first));
+      ++edge_offsets[ref_number + 1];
+    }
+  }
+  // file_deps is ordered like 'files', so the edges already are in place.
+  for (uint32_t i = 0; i < num_files; ++i) {
+    edge_offsets[i + 1] += edge_offsets[i];
+  }
+
+  // Tarjan's strongly-connected components algorithm, without recursion.
+  // Components are completed only after all components that they depend on,
+  // which is exactly compile order.
+  constexpr uint32_t kUnvisited = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> visit_index(num_files, kUnvisited);
+  std::vector<uint32_t> low_link(num_files);
+  std::vector<uint32_t> component_of(num_files, kUnvisited);
+  std::vector<uint32_t> scc_stack;
+  // Each frame is a file and the position of its next unvisited edge.
+  std::vector<std::pair<uint32_t, uint32_t>> call_stack;
+  std::vector<std::vector<uint32_t>> components;
+  uint32_t next_visit_index = 0;
+  const auto visit = [&](uint32_t file) {
+    visit_index[file] = low_link[file] = next_visit_index++;
+    scc_stack.push_back(file);
+    call_stack.emplace_back(file, edge_offsets[file]);
+  };
+  for (uint32_t root = 0; root < num_files; ++root) {
+    if (visit_index[root] != kUnvisited) continue;
+    visit(root);
+    while (!call_stack.empty()) {
+      const uint32_t file = call_stack.back().first;
+      uint32_t& edge = call_stack.back().second;
+      if (edge < edge_offsets[file + 1]) {
+        const uint32_t target = edge_targets[edge++];
+        if (visit_index[target] == kUnvisited) {
+          visit(target);
+        } else if (component_of[target] == kUnvisited) {  // still on stack
+          low_link[file] = std::min(low_link[file], visit_index[target]);
+        }
+        continue;
+      }
+      call_stack.pop_back();
+      if (!call_stack.empty()) {
+        uint32_t& parent_link = low_link[call_stack.back().first];
+        parent_link = std::min(parent_link, low_link[file]);
+      }
+      if (low_link[file] != visit_index[file]) continue;
+      // 'file' is the root of a component.
+      std::vector<uint32_t> component;
+      uint32_t member;
+      do {
+        member = scc_stack.back();
+        scc_stack.pop_back();
+        component_of[member] = components.size();
+        component.push_back(member);
+      } while (member != file);
+      std::sort(component.begin(), component.end());
+      components.push_back(std::move(component));
+    }
+  }
+
+  // A component's level is one more than the highest level among the
+  // components that it depends on, all of which precede it.
+  FileCompileOrder order;
+  order.components.reserve(components.size());
+  std::vector<uint32_t> component_levels(components.size(), 0);
+  for (uint32_t c = 0; c < components.size(); ++c) {
+    std::vector<node_type>& component_files(order.components.emplace_back());
+    for (const uint32_t file : components[c]) {
+      component_files.push_back(files[file]);
+      for (uint32_t e = edge_offsets[file]; e < edge_offsets[file + 1]; ++e) {
+        const uint32_t dependency = component_of[edge_targets[e]];
+        if (dependency != c) {
+          component_levels[c] =
+              std::max(component_levels[c], component_levels[dependency] + 1);
+        }
+      }
+    }
+    const uint32_t level = component_levels[c];
+    if (level >= order.levels.size()) order.levels.resize(level + 1);
+    order.levels[level].push_back(c);
+  }
+  VLOG(1) << "end of " << __FUNCTION__;
+  return order;
+}
+
+bool FileCompileOrder::HasCycles() const {
+  return std::any_of(components.begin(), components.end(),
+                     [](const std::vector<node_type>& component) {
+                       return component.size() > 1;
+                     });
+}
+
+std::ostream& FileCompileOrder::PrintLevels(std::ostream& stream) const {
+  const auto print_file = [&stream](node_type file) {
+    stream << " \"" << file->ReferencedPath() << '"';
+  };
+  for (size_t level = 0; level < levels.size(); ++level) {
+    stream << "level " << level << ':';
+    for (const size_t c : levels[level]) {
+      const std::vector<node_type>& component(components[c]);
+      if (component.size() == 1) {
+        print_file(component.front());
+        continue;
+      }
+      stream << " {";
+      for (node_type file : component) print_file(file);
+      stream << " }";
+    }
+    stream << std::endl;
+  }
+  return stream;
+}
+
 std::ostream& operator<<(std::ostream& stream, const FileDependencies& deps) {
   return deps.PrintGraph(stream);
 }
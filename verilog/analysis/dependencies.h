@@ -19,13 +19,39 @@
 #include <iosfwd>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "common/strings/compare.h"
 #include "verilog/analysis/symbol_table.h"
 
 namespace verilog {
 
+// Order in which files can be compiled, such that every file comes after the
+// files that it depends on.  See FileDependencies::CompileOrder().
+struct FileCompileOrder {
+  using node_type = const VerilogSourceFile*;
+
+  // Strongly-connected components of the dependency graph, i.e. groups of
+  // files that (transitively) depend on each other, in compile order:
+  // each component only depends on preceding ones.
+  // Components with more than one file contain dependency cycles.
+  // Files within a component are sorted by name.
+  std::vector<std::vector<node_type>> components;
+
+  // Indices into 'components', grouped by dependency level: components of the
+  // same level do not depend on each other, and can be compiled concurrently
+  // once all lower levels are compiled.  Level 0 has no dependencies.
+  std::vector<std::vector<size_t>> levels;
+
+  // Returns true if any files depend on each other cyclically.
+  bool HasCycles() const;
+
+  // Prints one line of files per level, with cyclic components in braces.
+  std::ostream& PrintLevels(std::ostream&) const;
+};
+
 // Graph of inter-file dependencies based on what root-level symbols are defined
 // and referenced.
 // All data members are initialized only and const and publicly accessible.
@@ -98,6 +124,13 @@ struct FileDependencies {
 
   std::ostream& PrintGraph(std::ostream&) const;
 
+  // Computes a compile order of all files in the graph, plus 'more_files'
+  // (e.g. files without any root-level symbols), in O(files + edges).
+  // Dependency cycles are not an error: files in a cycle are grouped
+  // into one component.
+  FileCompileOrder CompileOrder(
+      absl::Span<const node_type> more_files = {}) const;
+
   // TODO: print unresolved references (no definition found)
 };
 
@@ -23,6 +23,7 @@ namespace verilog {
 namespace {
 
 using testing::ElementsAre;
+using testing::UnorderedElementsAre;
 using verible::file::Basename;
 using verible::file::CreateDir;
 using verible::file::JoinPath;
@@ -354,5 +355,122 @@ TEST(FileDependenciesTest, ModuleDiamondDependencies) {
   }
 }
 
+TEST(FileDependenciesTest, CompileOrderEmpty) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {/* no include paths */});
+  SymbolTable symbol_table(&project);
+
+  const FileDependencies file_deps(symbol_table);
+  const FileCompileOrder order(file_deps.CompileOrder());
+  EXPECT_TRUE(order.components.empty());
+  EXPECT_TRUE(order.levels.empty());
+  EXPECT_FALSE(order.HasCycles());
+}
+
+TEST(FileDependenciesTest, CompileOrderModuleDiamond) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+
+  VerilogProject project(sources_dir, {/* no include paths */});
+
+  // mmm depends on ppp and qqq, which both depend on rrr.
+  ScopedTestFile mmm(sources_dir,
+                     "module mmm;\n"
+                     "  ppp ppp_i();\n"
+                     "  qqq qqq_i();\n"
+                     "endmodule\n");
+  const VerilogSourceFile* mmm_file =
+      *project.OpenTranslationUnit(Basename(mmm.filename()));
+  ScopedTestFile ppp(sources_dir,
+                     "module ppp;\n"
+                     "  rrr rrr_i();\n"
+                     "endmodule\n");
+  const VerilogSourceFile* ppp_file =
+      *project.OpenTranslationUnit(Basename(ppp.filename()));
+  ScopedTestFile qqq(sources_dir,
+                     "module qqq;\n"
+                     "  rrr rrr_i();\n"
+                     "endmodule\n");
+  const VerilogSourceFile* qqq_file =
+      *project.OpenTranslationUnit(Basename(qqq.filename()));
+  ScopedTestFile rrr(sources_dir,
+                     "module rrr;\n"
+                     "endmodule\n");
+  const VerilogSourceFile* rrr_file =
+      *project.OpenTranslationUnit(Basename(rrr.filename()));
+
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> build_diagnostics;
+  symbol_table.Build(&build_diagnostics);
+  EXPECT_TRUE(build_diagnostics.empty());
+
+  const FileDependencies file_deps(symbol_table);
+  const FileCompileOrder order(file_deps.CompileOrder());
+  EXPECT_FALSE(order.HasCycles());
+  ASSERT_EQ(order.components.size(), 4);
+  EXPECT_THAT(order.components.front(), ElementsAre(rrr_file));
+  EXPECT_THAT(order.components.back(), ElementsAre(mmm_file));
+
+  ASSERT_EQ(order.levels.size(), 3);
+  std::vector<std::vector<const VerilogSourceFile*>> levels;
+  for (const auto& level : order.levels) {
+    auto& level_files(levels.emplace_back());
+    for (const size_t c : level) {
+      ASSERT_EQ(order.components[c].size(), 1);
+      level_files.push_back(order.components[c].front());
+    }
+  }
+  EXPECT_THAT(levels[0], ElementsAre(rrr_file));
+  EXPECT_THAT(levels[1], UnorderedElementsAre(ppp_file, qqq_file));
+  EXPECT_THAT(levels[2], ElementsAre(mmm_file));
+}
+
+TEST(FileDependenciesTest, CompileOrderWithCyclicDep) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+
+  VerilogProject project(sources_dir, {/* no include paths */});
+
+  ScopedTestFile tf1(sources_dir,
+                     "localparam int foo = 0;\n"
+                     "localparam int goo = bar;\n");
+  const VerilogSourceFile* file1 =
+      *project.OpenTranslationUnit(Basename(tf1.filename()));
+  ScopedTestFile tf2(sources_dir, "localparam int bar = foo - 2;\n");
+  const VerilogSourceFile* file2 =
+      *project.OpenTranslationUnit(Basename(tf2.filename()));
+  ScopedTestFile tf3(sources_dir, "localparam int baz = goo * 2;\n");
+  const VerilogSourceFile* file3 =
+      *project.OpenTranslationUnit(Basename(tf3.filename()));
+  // No symbols at all: only known through 'more_files'.
+  ScopedTestFile tf4(sources_dir, "");
+  const VerilogSourceFile* file4 =
+      *project.OpenTranslationUnit(Basename(tf4.filename()));
+
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> build_diagnostics;
+  symbol_table.Build(&build_diagnostics);
+  EXPECT_TRUE(build_diagnostics.empty());
+
+  const FileDependencies file_deps(symbol_table);
+  const FileCompileOrder order(file_deps.CompileOrder({file4}));
+  EXPECT_TRUE(order.HasCycles());
+  ASSERT_EQ(order.components.size(), 3);
+  ASSERT_EQ(order.levels.size(), 2);
+  ASSERT_EQ(order.levels[1].size(), 1);
+  EXPECT_THAT(order.components[order.levels[1].front()], ElementsAre(file3));
+  ASSERT_EQ(order.levels[0].size(), 2);
+  std::vector<std::vector<const VerilogSourceFile*>> level0;
+  for (const size_t c : order.levels[0]) {
+    level0.push_back(order.components[c]);
+  }
+  EXPECT_THAT(level0, UnorderedElementsAre(ElementsAre(file4),
+                                           UnorderedElementsAre(file1, file2)));
+}
+
 }  // namespace
 }  // namespace verilog
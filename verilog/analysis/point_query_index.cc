@@ -0,0 +1,139 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/analysis/point_query_index.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "common/text/text_structure.h"
+#include "common/text/tree_utils.h"
+
+namespace verilog {
+
+using verible::Symbol;
+using verible::SymbolKind;
+using verible::SymbolPtr;
+using verible::SyntaxTreeLeaf;
+using verible::SyntaxTreeNode;
+
+// Returns the range of memory addresses of 'text', as an interval key.
+static std::pair<const char*, const char*> TextRange(absl::string_view text) {
+  return {text.data(), text.data() + text.length()};
+}
+
+// Records the token ranges of the leaves under 'root' in 'leaves', and the
+// parents of all of its descendants in 'parents'.
+// This uses an explicit stack instead of recursion, so that deeply nested
+// syntax trees (e.g. of generated code) can not exhaust the call stack.
+static void IndexSyntaxTree(
+    const Symbol& root,
+    verible::DisjointIntervalMap<const char*, const SyntaxTreeLeaf*>* leaves,
+    absl::flat_hash_map<const Symbol*, const SyntaxTreeNode*>* parents) {
+  // Symbols to visit, with their parents (nullptr for the root).
+  std::vector<std::pair<const Symbol*, const SyntaxTreeNode*>> stack;
+  stack.emplace_back(&root, nullptr);
+  while (!stack.empty()) {
+    const Symbol& symbol = *stack.back().first;
+    const SyntaxTreeNode* const parent = stack.back().second;
+    stack.pop_back();
+    if (parent != nullptr) parents->emplace(&symbol, parent);
+    if (symbol.Kind() == SymbolKind::kLeaf) {
+      const SyntaxTreeLeaf& leaf = verible::SymbolCastToLeaf(symbol);
+      const absl::string_view text = leaf.get().text();
+      // Empty tokens can not be found.  Overlapping ranges (which should not
+      // occur in a file's own syntax tree) are skipped.
+      if (!text.empty()) leaves->emplace(TextRange(text), &leaf);
+      continue;
+    }
+    const SyntaxTreeNode& node = verible::SymbolCastToNode(symbol);
+    // Push in reverse, to visit children in order, like a recursive descent
+    // (the first of overlapping leaves is the one that is kept).
+    for (auto child = node.children().rbegin(); child != node.children().rend();
+         ++child) {
+      if (*child != nullptr) stack.emplace_back(child->get(), &node);
+    }
+  }
+}
+
+const PointQueryIndex::FileIndex& PointQueryIndex::IndexFile(
+    const VerilogSourceFile& file) {
+  std::unique_ptr<FileIndex>& index = files_[&file];
+  if (index != nullptr) return *index;
+  index = absl::make_unique<FileIndex>(file);
+  const verible::TextStructureView* text_structure = file.GetTextStructure();
+  if (text_structure != nullptr && text_structure->SyntaxTree() != nullptr) {
+    IndexSyntaxTree(*text_structure->SyntaxTree(), &index->leaves,
+                    &index->parents);
+  }
+  return *index;
+}
+
+void PointQueryIndex::IndexSymbols() {
+  if (symbols_indexed_) return;
+  symbols_indexed_ = true;
+  symbol_table_.Root().ApplyPreOrder([this](const SymbolTableNode& node) {
+    // The root has no name.  Generated names (of anonymous scopes) are not
+    // part of any file, so they will never be found.
+    if (node.Parent() != nullptr && !node.Key()->empty()) {
+      symbols_.emplace(TextRange(*node.Key()), &node);
+    }
+    for (const auto& reference : node.Value().local_references_to_bind) {
+      if (reference.Empty()) continue;
+      reference.components->ApplyPreOrder(
+          [this](const ReferenceComponentNode& component) {
+            const absl::string_view identifier = component.Value().identifier;
+            if (identifier.empty()) return;
+            references_.emplace(TextRange(identifier), &component);
+          });
+    }
+  });
+}
+
+PointQueryIndex::Result PointQueryIndex::Lookup(const VerilogSourceFile& file,
+                                                size_t offset) {
+  Result result;
+  const verible::TextStructureView* text_structure = file.GetTextStructure();
+  if (text_structure == nullptr) return result;
+  const absl::string_view contents = text_structure->Contents();
+  if (offset >= contents.length()) return result;
+  const char* const position = contents.data() + offset;
+
+  const FileIndex& file_index = IndexFile(file);
+  const auto found_leaf = file_index.leaves.find(position);
+  if (found_leaf != file_index.leaves.end()) {
+    result.leaf = found_leaf->second;
+    const Symbol* child = result.leaf;
+    for (auto parent = file_index.parents.find(child);
+         parent != file_index.parents.end();
+         parent = file_index.parents.find(child)) {
+      result.enclosing_nodes.push_back(parent->second);
+      child = parent->second;
+    }
+  }
+
+  IndexSymbols();
+  const auto found_symbol = symbols_.find(position);
+  if (found_symbol != symbols_.end()) result.symbol = found_symbol->second;
+  const auto found_reference = references_.find(position);
+  if (found_reference != references_.end()) {
+    result.reference = found_reference->second;
+  }
+  return result;
+}
+
+}  // namespace verilog
@@ -0,0 +1,131 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_VERILOG_ANALYSIS_POINT_QUERY_INDEX_H_
+#define VERIBLE_VERILOG_ANALYSIS_POINT_QUERY_INDEX_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "common/text/concrete_syntax_leaf.h"
+#include "common/text/concrete_syntax_tree.h"
+#include "common/text/symbol.h"
+#include "common/util/interval_map.h"
+#include "verilog/analysis/symbol_table.h"
+#include "verilog/analysis/verilog_project.h"
+
+namespace verilog {
+
+// PointQueryIndex answers "what is at this position of this file" queries,
+// such as those of hover and go-to-definition, in logarithmic time (plus the
+// depth of the syntax tree), instead of walking the syntax tree from its root
+// and searching the whole symbol table.
+//
+// Each file's syntax tree is indexed by the byte ranges of its tokens, on the
+// first query into that file.  Symbols and reference components are indexed
+// by the text ranges of their names (which are substrings of the files'
+// contents), on the first query overall.
+//
+// Files are pinned (see ParsedFilePin) from their first query on, so that
+// their syntax trees, and the leaves and nodes of results, stay valid for the
+// lifetime of this object, regardless of their project's memory budget.
+// Files whose syntax trees were evicted before their first query must be
+// Parse()d again to be found.
+//
+// The symbol table and its project must outlive this object, and must not
+// change while it is in use.
+//
+// Usage:
+//   PointQueryIndex index(symbol_table);
+//   const auto result = index.Lookup(*file, offset);
+//   if (result.reference != nullptr &&
+//       result.reference->Value().resolved_symbol != nullptr) {
+//     // go to definition of result.reference->Value().resolved_symbol
+//   }
+class PointQueryIndex {
+ public:
+  // What is found at a position.
+  struct Result {
+    // Innermost syntax tree leaf (token) that spans the position, or nullptr.
+    const verible::SyntaxTreeLeaf* leaf = nullptr;
+
+    // Syntax tree nodes that enclose 'leaf', innermost first, ending with the
+    // root of the syntax tree.
+    std::vector<const verible::SyntaxTreeNode*> enclosing_nodes;
+
+    // Symbol whose name (SymbolTableNode key) spans the position, or nullptr.
+    const SymbolTableNode* symbol = nullptr;
+
+    // Reference component whose identifier spans the position, or nullptr.
+    const ReferenceComponentNode* reference = nullptr;
+  };
+
+  explicit PointQueryIndex(const SymbolTable& symbol_table)
+      : symbol_table_(symbol_table) {}
+
+  PointQueryIndex(const PointQueryIndex&) = delete;
+  PointQueryIndex(PointQueryIndex&&) = delete;
+  PointQueryIndex& operator=(const PointQueryIndex&) = delete;
+  PointQueryIndex& operator=(PointQueryIndex&&) = delete;
+
+  // Returns what is found at byte 'offset' of 'file's contents.
+  // Returns an empty result for files that were not opened, and for offsets
+  // past their end.
+  Result Lookup(const VerilogSourceFile& file, size_t offset);
+
+ private:
+  // Index of one file's syntax tree.
+  struct FileIndex {
+    explicit FileIndex(const VerilogSourceFile& file) : pin(&file) {}
+
+    // Keeps the indexed syntax tree from being evicted.
+    const ParsedFilePin pin;
+
+    // Maps the text ranges of tokens to their leaves.
+    verible::DisjointIntervalMap<const char*, const verible::SyntaxTreeLeaf*>
+        leaves;
+
+    // Maps every syntax tree node and leaf to its parent node.
+    absl::flat_hash_map<const verible::Symbol*, const verible::SyntaxTreeNode*>
+        parents;
+  };
+
+  // Returns the index of 'file's syntax tree, building it if needed.
+  const FileIndex& IndexFile(const VerilogSourceFile& file);
+
+  // Indexes the names of all symbols and reference components, once.
+  void IndexSymbols();
+
+  const SymbolTable& symbol_table_;
+
+  // Syntax tree indices, by file.
+  std::map<const VerilogSourceFile*, std::unique_ptr<FileIndex>> files_;
+
+  // True once symbols_ and references_ were built.
+  bool symbols_indexed_ = false;
+
+  // Maps the text ranges of symbol names to their symbols.
+  verible::DisjointIntervalMap<const char*, const SymbolTableNode*> symbols_;
+
+  // Maps the text ranges of reference identifiers to their components.
+  verible::DisjointIntervalMap<const char*, const ReferenceComponentNode*>
+      references_;
+};
+
+}  // namespace verilog
+
+#endif  // VERIBLE_VERILOG_ANALYSIS_POINT_QUERY_INDEX_H_
@@ -0,0 +1,210 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/analysis/point_query_index.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "common/text/concrete_syntax_tree.h"
+#include "common/text/symbol.h"
+#include "common/text/text_structure.h"
+#include "common/text/token_info.h"
+#include "common/text/token_stream_view.h"
+#include "common/text/tree_builder_test_util.h"
+#include "common/text/tree_utils.h"
+#include "common/util/file_util.h"
+#include "gtest/gtest.h"
+#include "verilog/CST/verilog_nonterminals.h"
+#include "verilog/analysis/symbol_table.h"
+#include "verilog/analysis/verilog_project.h"
+#include "verilog/parser/verilog_token_enum.h"
+
+namespace verilog {
+namespace {
+
+using verible::file::CreateDir;
+using verible::file::JoinPath;
+using verible::file::testing::ScopedTestFile;
+
+constexpr absl::string_view kPackageText =
+    "package pp;\n"
+    "  localparam int ww = 8;\n"
+    "endpackage\n";
+
+constexpr absl::string_view kModuleText =
+    "module mm;\n"
+    "  logic [pp::ww-1:0] data;\n"
+    "  assign data = '0;\n"
+    "endmodule\n";
+
+class PointQueryIndexTest : public ::testing::Test {
+ protected:
+  PointQueryIndexTest()
+      : sources_dir_(JoinPath(::testing::TempDir(),
+                              ::testing::UnitTest::GetInstance()
+                                  ->current_test_info()
+                                  ->name())) {}
+
+  void SetUp() override {
+    ASSERT_TRUE(CreateDir(sources_dir_).ok());
+    package_file_ = absl::make_unique<ScopedTestFile>(sources_dir_,
+                                                      kPackageText, "pp.sv");
+    module_file_ = absl::make_unique<ScopedTestFile>(sources_dir_,
+                                                     kModuleText, "mm.sv");
+    project_ = absl::make_unique<VerilogProject>(sources_dir_,
+                                                 std::vector<std::string>{});
+    for (absl::string_view name : {"pp.sv", "mm.sv"}) {
+      ASSERT_TRUE(project_->OpenTranslationUnit(name).ok());
+    }
+    symbol_table_ = absl::make_unique<SymbolTable>(project_.get());
+    std::vector<absl::Status> diagnostics;
+    symbol_table_->Build(&diagnostics);
+    symbol_table_->Resolve(&diagnostics);
+    ASSERT_TRUE(diagnostics.empty());
+  }
+
+  const VerilogSourceFile& File(absl::string_view name) const {
+    return *project_->LookupRegisteredFile(name);
+  }
+
+  const std::string sources_dir_;
+  std::unique_ptr<ScopedTestFile> package_file_;
+  std::unique_ptr<ScopedTestFile> module_file_;
+  std::unique_ptr<VerilogProject> project_;
+  std::unique_ptr<SymbolTable> symbol_table_;
+};
+
+TEST_F(PointQueryIndexTest, SymbolDefinition) {
+  PointQueryIndex index(*symbol_table_);
+  // Anywhere in "ww" of its declaration.
+  for (size_t offset : {kPackageText.find("ww"), kPackageText.find("ww") + 1}) {
+    const auto result = index.Lookup(File("pp.sv"), offset);
+    ASSERT_NE(result.leaf, nullptr);
+    EXPECT_EQ(result.leaf->get().text(), "ww");
+    ASSERT_FALSE(result.enclosing_nodes.empty());
+    EXPECT_EQ(result.enclosing_nodes.back(),
+              File("pp.sv").GetTextStructure()->SyntaxTree().get());
+    ASSERT_NE(result.symbol, nullptr);
+    EXPECT_EQ(*result.symbol->Key(), "ww");
+    EXPECT_EQ(result.reference, nullptr);
+  }
+}
+
+TEST_F(PointQueryIndexTest, ResolvedReference) {
+  PointQueryIndex index(*symbol_table_);
+  const auto result = index.Lookup(File("mm.sv"), kModuleText.find("ww"));
+  ASSERT_NE(result.leaf, nullptr);
+  EXPECT_EQ(result.leaf->get().text(), "ww");
+  EXPECT_EQ(result.symbol, nullptr);
+  ASSERT_NE(result.reference, nullptr);
+  EXPECT_EQ(result.reference->Value().identifier, "ww");
+  const SymbolTableNode* resolved = result.reference->Value().resolved_symbol;
+  ASSERT_NE(resolved, nullptr);
+  // Go to definition.
+  const auto definition = index.Lookup(File("pp.sv"), kPackageText.find("ww"));
+  EXPECT_EQ(definition.symbol, resolved);
+}
+
+TEST_F(PointQueryIndexTest, EnclosingNodes) {
+  PointQueryIndex index(*symbol_table_);
+  const auto result = index.Lookup(File("mm.sv"), kModuleText.find("assign"));
+  ASSERT_NE(result.leaf, nullptr);
+  EXPECT_EQ(result.leaf->get().text(), "assign");
+  bool found_continuous_assign = false;
+  for (const auto* node : result.enclosing_nodes) {
+    if (NodeEnum(node->Tag().tag) == NodeEnum::kContinuousAssignmentStatement) {
+      found_continuous_assign = true;
+    }
+  }
+  EXPECT_TRUE(found_continuous_assign);
+  EXPECT_EQ(NodeEnum(result.enclosing_nodes.back()->Tag().tag),
+            NodeEnum::kDescriptionList);
+  EXPECT_EQ(result.symbol, nullptr);
+  EXPECT_EQ(result.reference, nullptr);
+}
+
+TEST_F(PointQueryIndexTest, NothingThere) {
+  PointQueryIndex index(*symbol_table_);
+  {  // whitespace
+    const auto result = index.Lookup(File("mm.sv"), kModuleText.find("  "));
+    EXPECT_EQ(result.leaf, nullptr);
+    EXPECT_TRUE(result.enclosing_nodes.empty());
+    EXPECT_EQ(result.symbol, nullptr);
+    EXPECT_EQ(result.reference, nullptr);
+  }
+  {  // past the end
+    const auto result = index.Lookup(File("mm.sv"), kModuleText.length());
+    EXPECT_EQ(result.leaf, nullptr);
+    EXPECT_EQ(result.symbol, nullptr);
+    EXPECT_EQ(result.reference, nullptr);
+  }
+}
+
+TEST_F(PointQueryIndexTest, QueriedFilesAreNotEvicted) {
+  PointQueryIndex index(*symbol_table_);
+  const size_t offset = kPackageText.find("ww");
+  const auto before = index.Lookup(File("pp.sv"), offset);
+  ASSERT_NE(before.leaf, nullptr);
+
+  // Any parsed file exceeds this budget, so every file but the most recently
+  // parsed one would be evicted, if it was not pinned.
+  project_->SetParsedMemoryBudget(1);
+  ASSERT_TRUE(project_->LookupRegisteredFile("mm.sv")->Parse().ok());
+  EXPECT_EQ(File("pp.sv").EvictionCount(), 0);
+
+  const auto after = index.Lookup(File("pp.sv"), offset);
+  EXPECT_EQ(after.leaf, before.leaf);
+  EXPECT_EQ(after.leaf->get().text(), "ww");
+  EXPECT_EQ(after.enclosing_nodes, before.enclosing_nodes);
+}
+
+// Test that very deep syntax trees do not exhaust the call stack.
+TEST(PointQueryIndexDeepTest, DeeplyNestedTree) {
+  constexpr int kDepth = 200000;
+  verible::TextStructureView view("x");
+  verible::TokenSequence& tokens = view.MutableTokenStream();
+  tokens.push_back(verible::TokenInfo(SymbolIdentifier, view.Contents()));
+  verible::SymbolPtr tree = verible::Leaf(tokens[0]);
+  for (int i = 0; i < kDepth; ++i) {
+    tree = verible::MakeNode(std::move(tree));
+  }
+  view.MutableSyntaxTree() = std::move(tree);
+  const ParsedVerilogSourceFile file("deep.sv", &view);
+  const SymbolTable symbol_table(nullptr);
+
+  {
+    PointQueryIndex index(symbol_table);
+    const auto result = index.Lookup(file, 0);
+    ASSERT_NE(result.leaf, nullptr);
+    EXPECT_EQ(result.leaf->get().text(), "x");
+    EXPECT_EQ(result.enclosing_nodes.size(), kDepth);
+  }
+
+  // Dismantle the tree iteratively, because destruction is recursive.
+  tree = std::move(view.MutableSyntaxTree());
+  while (tree != nullptr && tree->Kind() == verible::SymbolKind::kNode) {
+    verible::SymbolPtr child = std::move(
+        verible::SymbolCastToNode(*tree).mutable_children().front());
+    tree = std::move(child);
+  }
+}
+
+}  // namespace
+}  // namespace verilog
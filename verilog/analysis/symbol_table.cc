@@ -14,14 +14,27 @@
 
 #include "verilog/analysis/symbol_table.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <stack>
+#include <thread>
+#include <utility>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/types/optional.h"
 #include "common/strings/display_utils.h"
+#include "common/strings/string_interner.h"
 #include "common/text/concrete_syntax_leaf.h"
 #include "common/text/concrete_syntax_tree.h"
 #include "common/text/token_info.h"
@@ -30,6 +43,7 @@
 #include "common/text/visitors.h"
 #include "common/util/enum_flags.h"
 #include "common/util/logging.h"
+#include "common/util/range.h"
 #include "common/util/spacer.h"
 #include "common/util/value_saver.h"
 #include "verilog/CST/class.h"
@@ -161,19 +175,46 @@ static absl::Status DiagnoseMemberSymbolResolutionFailure(
                    context_name, "."));
 }
 
+// Runs 'worker' on up to 'jobs' threads, including the calling thread, and
+// waits for all of them to finish.  Non-positive 'jobs' means hardware
+// concurrency.  At most 'max_jobs' threads are used.
+static void RunWorkersConcurrently(int jobs, size_t max_jobs,
+                                   const std::function<void()>& worker) {
+  if (jobs <= 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+  jobs = std::min<size_t>(jobs, max_jobs);
+  std::vector<std::thread> workers;
+  if (jobs > 1) workers.reserve(jobs - 1);
+  for (int j = 1; j < jobs; ++j) workers.emplace_back(worker);
+  worker();  // This thread participates too.
+  for (auto& w : workers) w.join();
+}
+
 class SymbolTable::Builder : public TreeContextVisitor {
  public:
   Builder(const VerilogSourceFile& source, SymbolTable* symbol_table,
           VerilogProject* project)
       : source_(&source),
+        translation_unit_(&source),
         token_context_(MakeTokenContext()),
         symbol_table_(symbol_table),
-        current_scope_(&symbol_table_->MutableRoot()) {}
+        current_scope_(&symbol_table_->MutableRoot()) {
+    // Track this unit's included files, even if there are none.
+    symbol_table_->translation_unit_includes_[translation_unit_];
+  }
 
   std::vector<absl::Status> TakeDiagnostics() {
     return std::move(diagnostics_);
   }
 
+  // Returns true if any `include directive was ignored for lack of a project.
+  bool SkippedIncludes() const { return skipped_includes_; }
+
+  // Included 'files' will not be entered (but are still tracked as included),
+  // e.g. because their symbols are already in the symbol table.
+  void SkipIncludedFiles(const std::set<const VerilogSourceFile*>* files) {
+    skipped_include_files_ = files;
+  }
+
  private:  // methods
   void Visit(const SyntaxTreeNode& node) final {
     const auto tag = static_cast<NodeEnum>(node.Tag().tag);
@@ -305,8 +346,10 @@ class SymbolTable::Builder : public TreeContextVisitor {
       // Empty refs are non-actionable and must be excluded.
       DependentReferences& ref(Ref());
       if (!ref.Empty()) {
-        builder_->current_scope_->Value().local_references_to_bind.emplace_back(
-            std::move(ref));
+        auto& references =
+            builder_->current_scope_->Value().local_references_to_bind;
+        references.emplace_back(std::move(ref));
+        builder_->IndexNewReference(references.back());
       }
       builder_->reference_builders_.pop();
       builder_->reference_branch_point_ = saved_branch_point_;  // restore
@@ -351,7 +394,11 @@ class SymbolTable::Builder : public TreeContextVisitor {
     const ReferenceComponentNode* base_type_ref =
         recent_ref.LastTypeComponent();
     SymbolInfo& current_declared_class_info = current_scope_->Value();
+    // A class that is declared again (with diagnostics) takes the new base.
+    UnindexTypeUser(current_declared_class_info.parent_type.user_defined_type,
+                    current_scope_);
     current_declared_class_info.parent_type.user_defined_type = base_type_ref;
+    IndexTypeUser(base_type_ref, current_scope_);
   }
 
   // Traverse a subtree for a data type and collects type references
@@ -391,6 +438,8 @@ class SymbolTable::Builder : public TreeContextVisitor {
       // 'declaration_type_info_' holds the declared type we want to capture.
       if (verible::GetLeftmostLeaf(data_type_node) != nullptr) {
         declaration_type_info_->syntax_origin = &data_type_node;
+        declaration_type_info_->syntax_origin_text =
+            verible::StringSpanOfSymbol(data_type_node);
         // Otherwise, if the type subtree contains no leaves (e.g. implicit or
         // void), then do not assign a syntax origin.
       }
@@ -508,6 +557,8 @@ class SymbolTable::Builder : public TreeContextVisitor {
       const ValueSaver<DeclarationTypeInfo*> save_type(&declaration_type_info_,
                                                        &decl_type_info);
       declaration_type_info_->syntax_origin = &syntax_origin;
+      declaration_type_info_->syntax_origin_text =
+          verible::StringSpanOfSymbol(syntax_origin);
       declaration_type_info_->user_defined_type = cap.Ref().LastLeaf();
 
       // Constants should be visible in current scope so we create
@@ -804,6 +855,42 @@ class SymbolTable::Builder : public TreeContextVisitor {
     return SymbolMetaType::kUnspecified;
   }
 
+  // Records a symbol that was just created in the current file.
+  void IndexNewSymbol(SymbolTableNode* symbol) {
+    symbol_table_->symbols_by_file_[source_].push_back(symbol);
+    IndexTypeUser(symbol->Value().declared_type.user_defined_type, symbol);
+  }
+
+  // Records 'symbol' as one whose declared type or base class is 'type'.
+  void IndexTypeUser(const ReferenceComponentNode* type,
+                     SymbolTableNode* symbol) {
+    if (type == nullptr) return;
+    symbol_table_->type_users_[type].push_back(symbol);
+  }
+
+  void UnindexTypeUser(const ReferenceComponentNode* type,
+                       const SymbolTableNode* symbol) {
+    if (type == nullptr) return;
+    const auto found = symbol_table_->type_users_.find(type);
+    if (found == symbol_table_->type_users_.end()) return;
+    auto& users = found->second;
+    users.erase(std::remove(users.begin(), users.end(), symbol), users.end());
+    if (users.empty()) symbol_table_->type_users_.erase(found);
+  }
+
+  // Records a reference that was just added to the current scope, from the
+  // current file.
+  void IndexNewReference(DependentReferences& reference) {
+    SymbolTableNode* scope = current_scope_;
+    auto& scopes = symbol_table_->reference_scopes_by_file_[source_];
+    if (scopes.empty() || scopes.back() != scope) scopes.push_back(scope);
+    reference.components->ApplyPreOrder(
+        [this, scope](ReferenceComponentNode& component) {
+          symbol_table_->references_by_name_[component.Value().identifier]
+                                            [&component] = scope;
+        });
+  }
+
   // Creates a named element in the current scope.
   // Suitable for SystemVerilog language elements: functions, tasks, packages,
   // classes, modules, etc...
@@ -816,7 +903,9 @@ class SymbolTable::Builder : public TreeContextVisitor {
                                              .file_origin = source_,
                                              .syntax_origin = &element,
                                          });
-    if (!p.second) {
+    if (p.second) {
+      IndexNewSymbol(&p.first->second);
+    } else {
       DiagnoseSymbolAlreadyExists(name);
     }
     return p.first->second;  // scope of the new (or pre-existing symbol)
@@ -840,7 +929,9 @@ class SymbolTable::Builder : public TreeContextVisitor {
             // associate this instance with its declared type
             .declared_type = *ABSL_DIE_IF_NULL(declaration_type_info_),  // copy
         });
-    if (!p.second) {
+    if (p.second) {
+      IndexNewSymbol(&p.first->second);
+    } else {
       DiagnoseSymbolAlreadyExists(name);
     }
     VLOG(1) << "end of " << __FUNCTION__ << ": " << name;
@@ -1103,6 +1194,7 @@ class SymbolTable::Builder : public TreeContextVisitor {
                    });
     SymbolTableNode* inner_symbol = &p.first->second;
     if (p.second) {
+      IndexNewSymbol(inner_symbol);
       // If injection succeeded, then the outer_scope did not already contain a
       // forward declaration of the inner symbol to be defined.
       // Diagnose this non-fatally, but continue.
@@ -1187,7 +1279,10 @@ class SymbolTable::Builder : public TreeContextVisitor {
     // Opening included file requires a VerilogProject.
     // Open this file (could be first time, or previously opened).
     VerilogProject* project = symbol_table_->project_;
-    if (project == nullptr) return;  // Without project, ignore.
+    if (project == nullptr) {  // Without project, ignore.
+      skipped_includes_ = true;
+      return;
+    }
 
     const auto status_or_file = project->OpenIncludedFile(filename_unquoted);
     if (!status_or_file.ok()) {
@@ -1199,7 +1294,15 @@ class SymbolTable::Builder : public TreeContextVisitor {
     VerilogSourceFile* const included_file = *status_or_file;
     if (included_file == nullptr) return;
     VLOG(1) << "opened include file: " << included_file->ResolvedPath();
+    symbol_table_->translation_unit_includes_[translation_unit_].insert(
+        included_file);
+    if (skipped_include_files_ != nullptr &&
+        skipped_include_files_->find(included_file) !=
+            skipped_include_files_->end()) {
+      return;
+    }
 
+    const ParsedFilePin pin(included_file);
     const auto parse_status = included_file->Parse();
     if (!parse_status.ok()) {
       diagnostics_.push_back(parse_status);
@@ -1240,6 +1343,10 @@ class SymbolTable::Builder : public TreeContextVisitor {
   // TODO(fangism): maintain a vector/stack of these for richer diagnostics
   const VerilogSourceFile* source_;
 
+  // The translation unit being built, whose symbols may come from 'source_'
+  // and its included files.
+  const VerilogSourceFile* const translation_unit_;
+
   // For human-readable debugging.
   // This should be constructed using MakeTokenContext(), after setting
   // 'source_'.
@@ -1280,6 +1387,13 @@ class SymbolTable::Builder : public TreeContextVisitor {
   // Collection of findings that might be considered compiler/tool errors in a
   // real toolchain.  For example: attempt to redefine symbol.
   std::vector<absl::Status> diagnostics_;
+
+  // Set when an included file could not be entered because 'symbol_table_'
+  // has no project.
+  bool skipped_includes_ = false;
+
+  // Included files that are not to be entered, possibly nullptr.
+  const std::set<const VerilogSourceFile*>* skipped_include_files_ = nullptr;
 };
 
 void ReferenceComponent::VerifySymbolTableRoot(
@@ -1409,9 +1523,126 @@ std::ostream& operator<<(std::ostream& stream,
   return stream << *dep_refs.components;
 }
 
+// Hash index of every scope's members, keyed by (scope, interned name).
+// Looking up a name through a chain of scopes then hashes the name only once,
+// and compares integers, instead of strings, at every scope.
+// The index is a snapshot of the symbol table's structure: it is built at the
+// start of each resolution pass, and discarded at the end of it, so it holds
+// only the names that are currently in the table.
+class ScopeIndex {
+ public:
+  typedef verible::StringInterner::id_type id_type;
+
+  explicit ScopeIndex(const SymbolTableNode& root) {
+    root.ApplyPreOrder([this](const SymbolTableNode& scope) {
+      for (const auto& member : scope) {
+        const id_type id = identifiers_.Intern(member.first);
+        members_.emplace(std::make_pair(&scope, id), &member.second);
+      }
+    });
+  }
+
+  // Returns the identifier of 'name', if there can be any symbol by that name.
+  absl::optional<id_type> FindIdentifier(absl::string_view name) const {
+    return identifiers_.Find(name);
+  }
+
+  // Returns the member of 'scope' with the identifier 'id', or nullptr.
+  const SymbolTableNode* FindMember(const SymbolTableNode& scope,
+                                    id_type id) const {
+    const auto found = members_.find(std::make_pair(&scope, id));
+    return found == members_.end() ? nullptr : found->second;
+  }
+
+ private:
+  // Distinct names of all members of all scopes.
+  verible::StringInterner identifiers_;
+
+  absl::flat_hash_map<std::pair<const SymbolTableNode*, id_type>,
+                      const SymbolTableNode*>
+      members_;
+};
+
+// Provides access to the symbols that reference components are bound to,
+// during symbol resolution.
+class ReferenceBindings {
+ public:
+  virtual ~ReferenceBindings() = default;
+
+  // If set, 'index' is used to find scopes' members.
+  void SetScopeIndex(const ScopeIndex* index) { scope_index_ = index; }
+  const ScopeIndex* GetScopeIndex() const { return scope_index_; }
+
+  // Returns the symbol that 'node' is bound to, or nullptr if it is unbound.
+  virtual const SymbolTableNode* ResolvedSymbol(
+      const ReferenceComponentNode& node) = 0;
+
+  // Binds 'node' to 'symbol'.
+  virtual void Bind(ReferenceComponentNode* node,
+                    const SymbolTableNode& symbol) = 0;
+
+ private:
+  const ScopeIndex* scope_index_ = nullptr;
+};
+
+// A name to look up among the members of (possibly many) scopes.
+class MemberName {
+ public:
+  MemberName(absl::string_view name, const ScopeIndex* index)
+      : name_(name), index_(index) {
+    if (index_ != nullptr) id_ = index_->FindIdentifier(name_);
+  }
+
+  absl::string_view Text() const { return name_; }
+
+  // Returns the member of 'scope' with this name, or nullptr.
+  const SymbolTableNode* FindIn(const SymbolTableNode& scope) const {
+    if (index_ == nullptr) {
+      const auto found = scope.Find(name_);
+      return found == scope.end() ? nullptr : &found->second;
+    }
+    if (!id_.has_value()) return nullptr;  // no symbol has this name
+    return index_->FindMember(scope, *id_);
+  }
+
+ private:
+  const absl::string_view name_;
+  const ScopeIndex* const index_;
+  absl::optional<ScopeIndex::id_type> id_;
+};
+
+// Reads and writes ReferenceComponent::resolved_symbol directly.
+class DirectReferenceBindings final : public ReferenceBindings {
+ public:
+  const SymbolTableNode* ResolvedSymbol(
+      const ReferenceComponentNode& node) final {
+    return node.Value().resolved_symbol;
+  }
+
+  void Bind(ReferenceComponentNode* node, const SymbolTableNode& symbol) final {
+    node->Value().resolved_symbol = &symbol;
+  }
+};
+
+// Same as ReferenceComponent::ResolveSymbol(), but binds through 'bindings'.
+static absl::Status BindResolvedSymbol(ReferenceComponentNode* node,
+                                       const SymbolTableNode& resolved,
+                                       ReferenceBindings* bindings) {
+  // Verify metatype match.
+  const auto metatype_match_status =
+      node->Value().MatchesMetatype(resolved.Value().metatype);
+  if (!metatype_match_status.ok()) {
+    VLOG(2) << metatype_match_status.message();
+    return metatype_match_status;
+  }
+  VLOG(2) << "  resolved: " << ContextFullPath(resolved);
+  bindings->Bind(node, resolved);
+  return absl::OkStatus();
+}
+
 // Follow type aliases through canonical type.
 static const SymbolTableNode* CanonicalizeTypeForMemberLookup(
-    const SymbolTableNode& context) {
+    const SymbolTableNode& context, ReferenceBindings* bindings) {
   VLOG(2) << __FUNCTION__;
   const SymbolTableNode* current_context = &context;
   do {
@@ -1423,7 +1654,7 @@ static const SymbolTableNode* CanonicalizeTypeForMemberLookup(
       // Could be a primitive type.
       return nullptr;
     }
-    current_context = ref_type->Value().resolved_symbol;
+    current_context = bindings->ResolvedSymbol(*ref_type);
     // TODO: We haven't guaranteed that typedefs have been resolved in order,
     // so these will need to be resolved on-demand in the future.
   } while (current_context != nullptr);
@@ -1435,14 +1666,13 @@ static const SymbolTableNode* CanonicalizeTypeForMemberLookup(
 
 // Search through base class's scopes for a symbol.
 static const SymbolTableNode* LookupSymbolThroughInheritedScopes(
-    const SymbolTableNode& context, absl::string_view symbol) {
+    const SymbolTableNode& context, const MemberName& symbol,
+    ReferenceBindings* bindings) {
   const SymbolTableNode* current_context = &context;
   do {
     // Look directly in current scope.
-    const auto found = current_context->Find(symbol);
-    if (found != current_context->end()) {
-      return &found->second;
-    }
+    const SymbolTableNode* found = symbol.FindIn(*current_context);
+    if (found != nullptr) return found;
     // TODO: lookup imported namespaces and symbols
 
     // Point to next inherited scope.
@@ -1450,24 +1680,25 @@ static const SymbolTableNode* LookupSymbolThroughInheritedScopes(
         current_context->Value().parent_type.user_defined_type;
     if (base_type == nullptr) break;
 
-    const SymbolTableNode* resolved_base = base_type->Value().resolved_symbol;
+    const SymbolTableNode* resolved_base = bindings->ResolvedSymbol(*base_type);
     // TODO: attempt to resolve on-demand because resolve ordering is not
     // guaranteed.
     if (resolved_base == nullptr) return nullptr;
 
     // base type could be a typedef, so canonicalize
-    current_context = CanonicalizeTypeForMemberLookup(*resolved_base);
+    current_context = CanonicalizeTypeForMemberLookup(*resolved_base, bindings);
   } while (current_context != nullptr);
   return nullptr;  // resolution failed
 }
 
 // Search up-scope, stopping at the first symbol found in the nearest scope.
 static const SymbolTableNode* LookupSymbolUpwards(
-    const SymbolTableNode& context, absl::string_view symbol) {
+    const SymbolTableNode& context, const MemberName& symbol,
+    ReferenceBindings* bindings) {
   const SymbolTableNode* current_context = &context;
   do {
     const SymbolTableNode* found =
-        LookupSymbolThroughInheritedScopes(*current_context, symbol);
+        LookupSymbolThroughInheritedScopes(*current_context, symbol, bindings);
     if (found != nullptr) return found;
 
     // Point to next enclosing scope.
@@ -1502,20 +1733,23 @@ static void ResolveReferenceComponentNodeLocal(ReferenceComponentNode& node,
   }
 }
 
-static void ResolveUnqualifiedName(ReferenceComponent& component,
+static void ResolveUnqualifiedName(ReferenceComponentNode* node,
                                    const SymbolTableNode& context,
+                                   ReferenceBindings* bindings,
                                    std::vector<absl::Status>* diagnostics) {
+  const ReferenceComponent& component(node->Value());
   VLOG(2) << __FUNCTION__ << ": " << component;
   const absl::string_view key(component.identifier);
   // Find the first symbol whose name matches, without regard to its metatype.
-  const SymbolTableNode* resolved = LookupSymbolUpwards(context, key);
+  const SymbolTableNode* resolved = LookupSymbolUpwards(
+      context, MemberName(key, bindings->GetScopeIndex()), bindings);
   if (resolved == nullptr) {
     diagnostics->emplace_back(
         DiagnoseUnqualifiedSymbolResolutionFailure(key, context));
     return;
   }
 
-  const auto resolve_status = component.ResolveSymbol(*resolved);
+  const auto resolve_status = BindResolvedSymbol(node, *resolved, bindings);
   if (!resolve_status.ok()) {
     diagnostics->push_back(resolve_status);
   }
@@ -1524,34 +1758,39 @@ static void ResolveUnqualifiedName(ReferenceComponent& component,
 
 // Search this scope directly for a symbol, without any upward/inheritance
 // lookups.
-static void ResolveImmediateMember(ReferenceComponent& component,
+static void ResolveImmediateMember(ReferenceComponentNode* node,
                                    const SymbolTableNode& context,
+                                   ReferenceBindings* bindings,
                                    std::vector<absl::Status>* diagnostics) {
+  const ReferenceComponent& component(node->Value());
   VLOG(2) << __FUNCTION__ << ": " << component;
   const absl::string_view key(component.identifier);
-  const auto found = context.Find(key);
-  if (found == context.end()) {
+  const SymbolTableNode* found =
+      MemberName(key, bindings->GetScopeIndex()).FindIn(context);
+  if (found == nullptr) {
     diagnostics->emplace_back(
         DiagnoseMemberSymbolResolutionFailure(key, context));
     return;
   }
 
-  const SymbolTableNode& found_symbol = found->second;
-  const auto resolve_status = component.ResolveSymbol(found_symbol);
+  const SymbolTableNode& found_symbol = *found;
+  const auto resolve_status = BindResolvedSymbol(node, found_symbol, bindings);
   if (!resolve_status.ok()) {
     diagnostics->push_back(resolve_status);
   }
   VLOG(2) << "end of " << __FUNCTION__;
 }
 
-static void ResolveDirectMember(ReferenceComponent& component,
+static void ResolveDirectMember(ReferenceComponentNode* node,
                                 const SymbolTableNode& context,
+                                ReferenceBindings* bindings,
                                 std::vector<absl::Status>* diagnostics) {
+  const ReferenceComponent& component(node->Value());
   VLOG(2) << __FUNCTION__ << ": " << component;
 
   // Canonicalize context if it an alias.
   const SymbolTableNode* canonical_context =
-      CanonicalizeTypeForMemberLookup(context);
+      CanonicalizeTypeForMemberLookup(context, bindings);
   if (canonical_context == nullptr) {
     // TODO: diagnostic could be improved by following each typedef indirection.
     diagnostics->push_back(absl::InvalidArgumentError(
@@ -1561,8 +1800,8 @@ static void ResolveDirectMember(ReferenceComponent& component,
   }
 
   const absl::string_view key(component.identifier);
-  const auto* found =
-      LookupSymbolThroughInheritedScopes(*canonical_context, key);
+  const auto* found = LookupSymbolThroughInheritedScopes(
+      *canonical_context, MemberName(key, bindings->GetScopeIndex()), bindings);
   if (found == nullptr) {
     diagnostics->emplace_back(
         DiagnoseMemberSymbolResolutionFailure(key, *canonical_context));
@@ -1570,7 +1809,7 @@ static void ResolveDirectMember(ReferenceComponent& component,
   }
 
   const SymbolTableNode& found_symbol = *found;
-  const auto resolve_status = component.ResolveSymbol(found_symbol);
+  const auto resolve_status = BindResolvedSymbol(node, found_symbol, bindings);
   if (!resolve_status.ok()) {
     diagnostics->push_back(resolve_status);
   }
@@ -1583,37 +1822,36 @@ static void ResolveDirectMember(ReferenceComponent& component,
 // traversal).
 static void ResolveReferenceComponentNode(
     ReferenceComponentNode& node, const SymbolTableNode& context,
-    std::vector<absl::Status>* diagnostics) {
-  ReferenceComponent& component(node.Value());
+    ReferenceBindings* bindings, std::vector<absl::Status>* diagnostics) {
+  const ReferenceComponent& component(node.Value());
   VLOG(2) << __FUNCTION__ << ": " << component;
-  if (component.resolved_symbol != nullptr) return;  // already bound
+  if (bindings->ResolvedSymbol(node) != nullptr) return;  // already bound
 
   switch (component.ref_type) {
     case ReferenceType::kUnqualified: {
       // root node: lookup this symbol from its context upward
       CHECK(node.Parent() == nullptr);
-      ResolveUnqualifiedName(component, context, diagnostics);
+      ResolveUnqualifiedName(&node, context, bindings, diagnostics);
       break;
     }
     case ReferenceType::kImmediate: {
-      ResolveImmediateMember(component, context, diagnostics);
+      ResolveImmediateMember(&node, context, bindings, diagnostics);
       break;
     }
     case ReferenceType::kDirectMember: {
       // Use parent's scope (if resolved successfully) to resolve this node.
-      const ReferenceComponent& parent_component(node.Parent()->Value());
-
-      const SymbolTableNode* parent_scope = parent_component.resolved_symbol;
+      const SymbolTableNode* parent_scope =
+          bindings->ResolvedSymbol(*node.Parent());
       if (parent_scope == nullptr) return;  // leave this subtree unresolved
 
-      ResolveDirectMember(component, *parent_scope, diagnostics);
+      ResolveDirectMember(&node, *parent_scope, bindings, diagnostics);
       break;
     }
     case ReferenceType::kMemberOfTypeOfParent: {
       // Use parent's type's scope (if resolved successfully) to resolve this
       // node. Get the type of the object from the parent component.
-      const ReferenceComponent& parent_component(node.Parent()->Value());
-      const SymbolTableNode* parent_scope = parent_component.resolved_symbol;
+      const SymbolTableNode* parent_scope =
+          bindings->ResolvedSymbol(*node.Parent());
       if (parent_scope == nullptr) return;  // leave this subtree unresolved
 
       const DeclarationTypeInfo& type_info =
@@ -1623,7 +1861,7 @@ static void ResolveReferenceComponentNode(
         diagnostics->push_back(absl::InvalidArgumentError(
             absl::StrCat("Type of parent reference ",
                          ReferenceNodeFullPathString(*node.Parent()), " (",
-                         verible::StringSpanOfSymbol(*type_info.syntax_origin),
+                         type_info.syntax_origin_text,
                          ") does not have any members.")));
         return;
       }
@@ -1632,10 +1870,10 @@ static void ResolveReferenceComponentNode(
       // thus, not guaranteed to have been resolved first.
       // TODO(fangism): resolve on-demand
       const SymbolTableNode* type_scope =
-          type_info.user_defined_type->Value().resolved_symbol;
+          bindings->ResolvedSymbol(*type_info.user_defined_type);
       if (type_scope == nullptr) return;
 
-      ResolveDirectMember(component, *type_scope, diagnostics);
+      ResolveDirectMember(&node, *type_scope, bindings, diagnostics);
       break;
     }
   }
@@ -1651,22 +1889,163 @@ ReferenceComponentMap ReferenceComponentNodeMapView(
   return map_view;
 }
 
-void DependentReferences::Resolve(const SymbolTableNode& context,
-                                  std::vector<absl::Status>* diagnostics) {
+static void ResolveDependentReferences(DependentReferences* references,
+                                       const SymbolTableNode& context,
+                                       ReferenceBindings* bindings,
+                                       std::vector<absl::Status>* diagnostics) {
   VLOG(1) << __FUNCTION__;
-  if (components == nullptr) return;
+  if (references->components == nullptr) return;
   // References are arranged in dependency trees.
   // Parent node references must be resolved before children nodes,
   // hence a pre-order traversal.
-  components->ApplyPreOrder(
-      [&context, diagnostics](ReferenceComponentNode& node) {
-        ResolveReferenceComponentNode(node, context, diagnostics);
+  references->components->ApplyPreOrder(
+      [&context, bindings, diagnostics](ReferenceComponentNode& node) {
+        ResolveReferenceComponentNode(node, context, bindings, diagnostics);
         // TODO: minor optimization, when resolution for a node fails,
         // skip checking that node's subtree; early terminate.
       });
   VLOG(1) << "end of " << __FUNCTION__;
 }
 
+void DependentReferences::Resolve(const SymbolTableNode& context,
+                                  std::vector<absl::Status>* diagnostics) {
+  DirectReferenceBindings bindings;
+  ResolveDependentReferences(this, context, &bindings, diagnostics);
+}
+
+// Resolves all references of a symbol table concurrently, with the same
+// results as resolving them serially in pre-order, like SymbolTable::Resolve().
+//
+// Resolving one chain of references may read the bindings of other chains
+// (declared types, base classes, typedefs).  Chains are numbered in serial
+// resolution order, and each one is resolved into its own result slot.
+// Reading a chain that comes earlier first resolves that chain (on-demand),
+// while reading a chain that comes later sees its bindings from before
+// resolution, just like the serial order would.  Slots are committed to the
+// symbol table only after all chains are resolved.
+class ConcurrentReferenceResolver {
+ public:
+  ConcurrentReferenceResolver(SymbolTableNode* root,
+                              const ScopeIndex* scope_index)
+      : scope_index_(scope_index) {
+    root->ApplyPreOrder([this](SymbolTableNode& scope) {
+      auto& references = scope.Value().local_references_to_bind;
+      if (references.empty()) return;
+      scope_begins_.push_back(slots_.size());
+      for (auto& reference : references) {
+        const size_t index = slots_.size();
+        slots_.emplace_back();
+        slots_.back().references = &reference;
+        slots_.back().context = &scope;
+        if (reference.components != nullptr) {
+          slot_of_chain_.emplace(reference.components.get(), index);
+        }
+      }
+    });
+  }
+
+  // Resolves the references of every scope, using up to 'jobs' threads.
+  void Resolve(int jobs, std::vector<absl::Status>* diagnostics) {
+    // Workers pull the next scope from a shared index.
+    std::atomic<size_t> next_scope(0);
+    RunWorkersConcurrently(jobs, scope_begins_.size(), [&]() {
+      for (size_t i = next_scope++; i < scope_begins_.size();
+           i = next_scope++) {
+        const size_t end = i + 1 < scope_begins_.size() ? scope_begins_[i + 1]
+                                                        : slots_.size();
+        for (size_t index = scope_begins_[i]; index < end; ++index) {
+          ResolveSlot(index);
+        }
+      }
+    });
+
+    // Commit bindings, and report diagnostics in serial order.
+    for (auto& slot : slots_) {
+      for (const auto& binding : slot.bindings) {
+        binding.first->Value().resolved_symbol = binding.second;
+      }
+      diagnostics->insert(diagnostics->end(), slot.diagnostics.begin(),
+                          slot.diagnostics.end());
+    }
+  }
+
+ private:
+  static constexpr size_t kNoSlot = std::numeric_limits<size_t>::max();
+
+  struct Slot {
+    DependentReferences* references = nullptr;
+    const SymbolTableNode* context = nullptr;
+    std::once_flag resolved;
+    // Symbols bound to this chain's components.
+    std::vector<std::pair<ReferenceComponentNode*, const SymbolTableNode*>>
+        bindings;
+    std::vector<absl::Status> diagnostics;
+  };
+
+  // Bindings as seen by one slot at its turn in serial resolution order.
+  class SlotBindings final : public ReferenceBindings {
+   public:
+    SlotBindings(ConcurrentReferenceResolver* resolver, size_t index)
+        : resolver_(resolver), index_(index) {}
+
+    const SymbolTableNode* ResolvedSymbol(
+        const ReferenceComponentNode& node) final {
+      const size_t owner = resolver_->SlotOf(node);
+      if (owner <= index_) {
+        if (owner < index_) resolver_->ResolveSlot(owner);
+        for (const auto& binding : resolver_->slots_[owner].bindings) {
+          if (binding.first == &node) return binding.second;
+        }
+      }
+      // Otherwise, the binding that existed before resolution.
+      // Components are not modified until all slots are resolved.
+      return node.Value().resolved_symbol;
+    }
+
+    void Bind(ReferenceComponentNode* node,
+              const SymbolTableNode& symbol) final {
+      resolver_->slots_[index_].bindings.emplace_back(node, &symbol);
+    }
+
+   private:
+    ConcurrentReferenceResolver* const resolver_;
+    const size_t index_;
+  };
+
+  // Returns the index of the slot whose chain contains 'node'.
+  size_t SlotOf(const ReferenceComponentNode& node) const {
+    const ReferenceComponentNode* chain = &node;
+    while (chain->Parent() != nullptr) chain = chain->Parent();
+    const auto found = slot_of_chain_.find(chain);
+    return found == slot_of_chain_.end() ? kNoSlot : found->second;
+  }
+
+  // Resolves the chain at 'index', once.
+  // This only ever waits for chains that come earlier in serial order,
+  // so there can be no deadlock.
+  void ResolveSlot(size_t index) {
+    Slot& slot(slots_[index]);
+    std::call_once(slot.resolved, [this, index, &slot]() {
+      SlotBindings bindings(this, index);
+      bindings.SetScopeIndex(scope_index_);
+      ResolveDependentReferences(slot.references, *slot.context, &bindings,
+                                 &slot.diagnostics);
+    });
+  }
+
+  // Shared by all slots, read-only.
+  const ScopeIndex* const scope_index_;
+
+  // In serial resolution order.  (std::once_flag is not movable.)
+  std::deque<Slot> slots_;
+
+  // Index of the first slot of each scope that has references.
+  std::vector<size_t> scope_begins_;
+
+  // Maps each chain's root component to its slot index.
+  absl::flat_hash_map<const ReferenceComponentNode*, size_t> slot_of_chain_;
+};
+
 void DependentReferences::ResolveLocally(const SymbolTableNode& context) {
   if (components == nullptr) return;
   // Only attempt to resolve the reference root, and none of its subtrees.
@@ -1753,10 +2132,10 @@ std::ostream& operator<<(std::ostream& stream,
   stream << "type-info { ";
 
   stream << "source: ";
-  if (decl_type_info.syntax_origin != nullptr) {
+  // The text outlives the syntax origin, so this does not depend on evictions.
+  if (!decl_type_info.syntax_origin_text.empty()) {
     stream << "\""
-           << AutoTruncate{.text = StringSpanOfSymbol(
-                               *decl_type_info.syntax_origin),
+           << AutoTruncate{.text = decl_type_info.syntax_origin_text,
                            .max_chars = 25}
            << "\"";
   } else {
@@ -1837,6 +2216,34 @@ SymbolInfo::LocalReferencesMapViewForTesting() const {
   return map_view;
 }
 
+SymbolTable::SymbolTable(VerilogProject* project)
+    : project_(project),
+      symbol_table_root_(SymbolInfo{.metatype = SymbolMetaType::kRoot}) {
+  if (project_ != nullptr) {
+    project_->AddEvictionObserver(&syntax_origin_invalidator_);
+  }
+}
+
+SymbolTable::~SymbolTable() {
+  if (project_ != nullptr) {
+    project_->RemoveEvictionObserver(&syntax_origin_invalidator_);
+  }
+  CheckIntegrity();
+}
+
+void SymbolTable::SyntaxOriginInvalidator::OnParsedStructuresEvicted(
+    const VerilogSourceFile& file) {
+  const auto found = symbol_table_->symbols_by_file_.find(&file);
+  if (found == symbol_table_->symbols_by_file_.end()) return;
+  // A symbol's declared type is captured from the same declaration, so its
+  // syntax origin is in the same file.
+  for (SymbolTableNode* symbol : found->second) {
+    SymbolInfo& info(symbol->Value());
+    info.syntax_origin = nullptr;
+    info.declared_type.syntax_origin = nullptr;
+  }
+}
+
 void SymbolTable::CheckIntegrity() const {
   const SymbolTableNode* root = &symbol_table_root_;
   symbol_table_root_.ApplyPreOrder(
@@ -1844,13 +2251,81 @@ void SymbolTable::CheckIntegrity() const {
 }
 
 void SymbolTable::Resolve(std::vector<absl::Status>* diagnostics) {
-  symbol_table_root_.ApplyPreOrder(
-      [=](SymbolTableNode& node) { node.Value().Resolve(node, diagnostics); });
+  const ScopeIndex scope_index(symbol_table_root_);
+  DirectReferenceBindings bindings;
+  bindings.SetScopeIndex(&scope_index);
+  symbol_table_root_.ApplyPreOrder([&](SymbolTableNode& node) {
+    for (auto& reference : node.Value().local_references_to_bind) {
+      ResolveDependentReferences(&reference, node, &bindings, diagnostics);
+    }
+  });
+  IndexReverseReferences();
+}
+
+void SymbolTable::ResolveConcurrently(std::vector<absl::Status>* diagnostics,
+                                      int jobs) {
+  if (jobs == 1) {
+    Resolve(diagnostics);
+    return;
+  }
+  const ScopeIndex scope_index(symbol_table_root_);
+  ConcurrentReferenceResolver resolver(&symbol_table_root_, &scope_index);
+  resolver.Resolve(jobs, diagnostics);
+  IndexReverseReferences();
 }
 
 void SymbolTable::ResolveLocallyOnly() {
   symbol_table_root_.ApplyPreOrder(
       [=](SymbolTableNode& node) { node.Value().ResolveLocally(node); });
+  IndexReverseReferences();
+}
+
+void SymbolTable::EnableReverseReferenceIndex(bool enable) {
+  index_reverse_references_ = enable;
+  reverse_references_.clear();
+  IndexReverseReferences();
+}
+
+void SymbolTable::IndexReverseReferences() {
+  if (!index_reverse_references_) return;
+  reverse_references_.clear();
+  symbol_table_root_.ApplyPreOrder([this](const SymbolInfo& symbol) {
+    for (const auto& reference : symbol.local_references_to_bind) {
+      IndexReverseReferences(reference);
+    }
+  });
+}
+
+void SymbolTable::IndexReverseReferences(const DependentReferences& reference) {
+  if (reference.Empty()) return;
+  reference.components->ApplyPreOrder(
+      [this](const ReferenceComponentNode& component) {
+        const SymbolTableNode* resolved = component.Value().resolved_symbol;
+        if (resolved == nullptr) return;
+        reverse_references_[resolved].push_back(&component);
+      });
+}
+
+void SymbolTable::UnindexReverseReferences(
+    const absl::flat_hash_set<const SymbolTableNode*>& bound_symbols,
+    const std::function<bool(const ReferenceComponentNode*)>& unindexed) {
+  for (const SymbolTableNode* symbol : bound_symbols) {
+    const auto found = reverse_references_.find(symbol);
+    if (found == reverse_references_.end()) continue;
+    auto& references = found->second;
+    references.erase(
+        std::remove_if(references.begin(), references.end(), unindexed),
+        references.end());
+    if (references.empty()) reverse_references_.erase(found);
+  }
+}
+
+const std::vector<const ReferenceComponentNode*>&
+SymbolTable::FindReferencesTo(const SymbolTableNode& symbol) const {
+  static const std::vector<const ReferenceComponentNode*> kNoReferences;
+  const auto found = reverse_references_.find(&symbol);
+  if (found == reverse_references_.end()) return kNoReferences;
+  return found->second;
 }
 
 std::ostream& SymbolTable::PrintSymbolDefinitions(std::ostream& stream) const {
@@ -1875,6 +2350,7 @@ std::ostream& SymbolTable::PrintSymbolReferences(std::ostream& stream) const {
 static void ParseFileAndBuildSymbolTable(
     VerilogSourceFile* source, SymbolTable* symbol_table,
     VerilogProject* project, std::vector<absl::Status>* diagnostics) {
+  const ParsedFilePin pin(source);
   const auto parse_status = source->Parse();
   if (!parse_status.ok()) diagnostics->push_back(parse_status);
   // Continue, in case syntax-error recovery left a partial syntax tree.
@@ -1907,6 +2383,739 @@ void SymbolTable::BuildSingleTranslationUnit(
   ParseFileAndBuildSymbolTable(translation_unit, this, project_, diagnostics);
 }
 
+// Symbols of a single translation unit, built in isolation from all other
+// translation units, and without entering any included files.
+// Such builds are independent, and can be done concurrently.
+struct SymbolTable::IsolatedBuild {
+  // Project-less symbol table with only this unit's symbols.
+  SymbolTable symbol_table{nullptr};
+
+  std::vector<absl::Status> diagnostics;
+
+  bool skipped_includes = false;
+
+  // The source's EvictionCount() while it was built.  The table is project-
+  // less, so its syntax origins are not reset by evictions.
+  size_t eviction_count = 0;
+};
+
+static std::unique_ptr<SymbolTable::IsolatedBuild> BuildIsolatedTranslationUnit(
+    VerilogSourceFile* source) {
+  auto result = absl::make_unique<SymbolTable::IsolatedBuild>();
+  // Parse status is cached, and reported when merging.
+  const ParsedFilePin pin(source);
+  source->Parse().IgnoreError();
+  result->eviction_count = source->EvictionCount();
+
+  const auto* text_structure = source->GetTextStructure();
+  if (text_structure == nullptr) return result;
+  const auto& syntax_tree = text_structure->SyntaxTree();
+  if (syntax_tree == nullptr) return result;
+
+  SymbolTable::Builder builder(*source, &result->symbol_table, nullptr);
+  syntax_tree->Accept(&builder);
+  result->diagnostics = builder.TakeDiagnostics();
+  result->skipped_includes = builder.SkippedIncludes();
+  return result;
+}
+
+// Builds every non-null element of 'sources' in isolation, using up to 'jobs'
+// threads.  Elements of the returned vector correspond to those of 'sources'.
+static std::vector<std::unique_ptr<SymbolTable::IsolatedBuild>>
+BuildIsolatedTranslationUnits(const std::vector<VerilogSourceFile*>& sources,
+                              int jobs) {
+  std::vector<std::unique_ptr<SymbolTable::IsolatedBuild>> results(
+      sources.size());
+  // Workers pull the next file from a shared index.
+  std::atomic<size_t> next_source(0);
+  RunWorkersConcurrently(jobs, sources.size(), [&]() {
+    for (size_t i = next_source++; i < sources.size(); i = next_source++) {
+      if (sources[i] == nullptr) continue;
+      results[i] = BuildIsolatedTranslationUnit(sources[i]);
+    }
+  });
+  return results;
+}
+
+bool SymbolTable::TryMergeIsolatedTable(SymbolTable* isolated) {
+  SymbolTableNode& isolated_root(isolated->MutableRoot());
+  SymbolInfo& isolated_info(isolated_root.Value());
+  // Anonymous scopes are numbered per enclosing scope, so the root's would be
+  // named differently when built directly into this table.
+  if (!isolated_info.anonymous_scope_names.empty()) return false;
+  // A pre-existing symbol would have been re-entered (with diagnostics),
+  // when built directly into this table.
+  for (const auto& child : isolated_root) {
+    if (symbol_table_root_.Find(child.first) != symbol_table_root_.end()) {
+      return false;
+    }
+  }
+
+  // Nodes are moved without relocation, so that pointers into them (e.g.
+  // already resolved self-references) remain valid.
+  while (!isolated_root.is_leaf()) {
+    symbol_table_root_.TrySplice(&isolated_root, isolated_root.begin());
+  }
+  auto& references = symbol_table_root_.Value().local_references_to_bind;
+  references.reserve(references.size() +
+                     isolated_info.local_references_to_bind.size());
+  for (auto& reference : isolated_info.local_references_to_bind) {
+    references.emplace_back(std::move(reference));
+  }
+  isolated_info.local_references_to_bind.clear();
+  for (auto& file_symbols : isolated->symbols_by_file_) {
+    auto& symbols = symbols_by_file_[file_symbols.first];
+    symbols.insert(symbols.end(), file_symbols.second.begin(),
+                   file_symbols.second.end());
+  }
+  isolated->symbols_by_file_.clear();
+  // The references of the isolated root now belong to this root.
+  const auto moved_scope = [this, &isolated_root](SymbolTableNode* scope) {
+    return scope == &isolated_root ? &symbol_table_root_ : scope;
+  };
+  for (auto& file_scopes : isolated->reference_scopes_by_file_) {
+    auto& scopes = reference_scopes_by_file_[file_scopes.first];
+    for (SymbolTableNode* scope : file_scopes.second) {
+      scopes.push_back(moved_scope(scope));
+    }
+  }
+  isolated->reference_scopes_by_file_.clear();
+  for (auto& name_references : isolated->references_by_name_) {
+    auto& references = references_by_name_[name_references.first];
+    for (const auto& reference : name_references.second) {
+      references[reference.first] = moved_scope(reference.second);
+    }
+  }
+  isolated->references_by_name_.clear();
+  for (auto& type_users : isolated->type_users_) {
+    auto& users = type_users_[type_users.first];
+    users.insert(users.end(), type_users.second.begin(),
+                 type_users.second.end());
+  }
+  isolated->type_users_.clear();
+  translation_unit_includes_.insert(
+      isolated->translation_unit_includes_.begin(),
+      isolated->translation_unit_includes_.end());
+  return true;
+}
+
+void SymbolTable::MergeOrBuildTranslationUnit(
+    VerilogSourceFile* source, IsolatedBuild* isolated,
+    std::vector<absl::Status>* diagnostics) {
+  const ParsedFilePin pin(source);
+  const auto parse_status = source->Parse();  // cached
+  if (!parse_status.ok()) diagnostics->push_back(parse_status);
+
+  // Isolated builds with diagnostics or included files may depend on other
+  // translation units (e.g. out-of-line definitions of classes defined
+  // elsewhere), so those units are re-built directly into this table,
+  // exactly as Build() would.  So are those whose syntax tree was evicted
+  // since, because their syntax origins are no longer valid.
+  if (isolated != nullptr && isolated->diagnostics.empty() &&
+      !isolated->skipped_includes &&
+      isolated->eviction_count == source->EvictionCount() &&
+      TryMergeIsolatedTable(&isolated->symbol_table)) {
+    return;
+  }
+  const std::vector<absl::Status> statuses =
+      BuildSymbolTable(*source, this, project_);
+  diagnostics->insert(diagnostics->end(), statuses.begin(), statuses.end());
+}
+
+void SymbolTable::BuildConcurrently(std::vector<absl::Status>* diagnostics,
+                                    int jobs) {
+  if (jobs == 1) {
+    Build(diagnostics);
+    return;
+  }
+
+  std::vector<VerilogSourceFile*> sources;
+  for (auto& translation_unit : *project_) {
+    sources.push_back(translation_unit.second.get());
+  }
+  auto isolated_builds = BuildIsolatedTranslationUnits(sources, jobs);
+
+  // Merge in the same order as Build().  Files that are opened while merging
+  // (by `include) are also visited in order, like Build() does.
+  size_t next_source = 0;
+  for (auto& translation_unit : *project_) {
+    VerilogSourceFile* source = translation_unit.second.get();
+    std::unique_ptr<IsolatedBuild> isolated;
+    if (next_source < sources.size() && sources[next_source] == source) {
+      isolated = std::move(isolated_builds[next_source++]);
+    }
+    MergeOrBuildTranslationUnit(source, isolated.get(), diagnostics);
+  }
+}
+
+void SymbolTable::BuildTranslationUnitsConcurrently(
+    const std::vector<std::string>& referenced_file_names,
+    std::vector<absl::Status>* diagnostics, int jobs) {
+  if (jobs == 1) {
+    for (const auto& file_name : referenced_file_names) {
+      BuildSingleTranslationUnit(file_name, diagnostics);
+    }
+    return;
+  }
+
+  // Only the first occurrence of each successfully opened file is built in
+  // isolation.
+  std::vector<VerilogSourceFile*> sources;
+  std::set<const VerilogSourceFile*> seen_sources;
+  for (const auto& file_name : referenced_file_names) {
+    VerilogSourceFile* source = project_->LookupRegisteredFile(file_name);
+    if (source != nullptr &&
+        (!source->Status().ok() || !seen_sources.insert(source).second)) {
+      source = nullptr;
+    }
+    sources.push_back(source);
+  }
+  auto isolated_builds = BuildIsolatedTranslationUnits(sources, jobs);
+
+  for (size_t i = 0; i < referenced_file_names.size(); ++i) {
+    if (sources[i] == nullptr) {
+      BuildSingleTranslationUnit(referenced_file_names[i], diagnostics);
+      continue;
+    }
+    const std::unique_ptr<IsolatedBuild> isolated =
+        std::move(isolated_builds[i]);
+    MergeOrBuildTranslationUnit(sources[i], isolated.get(), diagnostics);
+  }
+}
+
+// Nodes of a symbol table, keyed by file.
+using NodesByFile = absl::flat_hash_map<const VerilogSourceFile*,
+                                        std::vector<SymbolTableNode*>>;
+
+// Symbols and references that originate from a set of files, e.g. a
+// translation unit and the files that only it includes.
+class FileSetOrigin {
+ public:
+  // The files' symbols and reference scopes are taken from a symbol table's
+  // 'symbols_by_file' and 'reference_scopes_by_file', as of construction.
+  // 'visits' counts the symbols and references that are checked against
+  // these files, as a measure of work.
+  FileSetOrigin(std::set<const VerilogSourceFile*> files,
+                const NodesByFile& symbols_by_file,
+                const NodesByFile& reference_scopes_by_file, size_t* visits)
+      : files_(std::move(files)), visits_(visits) {
+    absl::flat_hash_set<const SymbolTableNode*> seen_scopes;
+    for (const VerilogSourceFile* file : files_) {
+      const auto* text_structure = file->GetTextStructure();
+      if (text_structure != nullptr) {
+        contents_.push_back(text_structure->Contents());
+      }
+      const auto symbols = symbols_by_file.find(file);
+      if (symbols != symbols_by_file.end()) {
+        symbols_.insert(symbols_.end(), symbols->second.begin(),
+                        symbols->second.end());
+      }
+      const auto scopes = reference_scopes_by_file.find(file);
+      if (scopes == reference_scopes_by_file.end()) continue;
+      for (SymbolTableNode* scope : scopes->second) {
+        if (seen_scopes.insert(scope).second) {
+          reference_scopes_.push_back(scope);
+        }
+      }
+    }
+  }
+
+  const std::set<const VerilogSourceFile*>& Files() const { return files_; }
+
+  // Symbols defined in any of the files.
+  const std::vector<SymbolTableNode*>& Symbols() const { return symbols_; }
+
+  // Scopes that hold references from any of the files (among others).
+  const std::vector<SymbolTableNode*>& ReferenceScopes() const {
+    return reference_scopes_;
+  }
+
+  // Returns true if 'text' belongs to any of the files' contents.
+  bool ContainsText(absl::string_view text) const {
+    ++*visits_;
+    return std::any_of(contents_.begin(), contents_.end(),
+                       [text](absl::string_view contents) {
+                         return verible::IsSubRange(text, contents);
+                       });
+  }
+
+  // Returns true if the symbol at 'node' is defined in any of the files.
+  bool Defines(const SymbolTableNode& node) const {
+    ++*visits_;
+    return files_.find(node.Value().file_origin) != files_.end();
+  }
+
+  // Returns true if 'reference' appears in any of the files.
+  bool Contains(const DependentReferences& reference) const {
+    return reference.components != nullptr &&
+           ContainsText(reference.components->Value().identifier);
+  }
+
+ private:
+  const std::set<const VerilogSourceFile*> files_;
+
+  std::vector<absl::string_view> contents_;
+
+  std::vector<SymbolTableNode*> symbols_;
+
+  std::vector<SymbolTableNode*> reference_scopes_;
+
+  size_t* const visits_;
+};
+
+// Returns an error if the symbols and references of 'origin' are entangled
+// with those of other files, such that they cannot be removed without
+// leaving dangling pointers, e.g. definitions of other files in scopes of
+// 'origin', or types of other files' symbols that are referenced in 'origin'.
+// 'type_users' maps reference components to the symbols that they declare
+// the types of.
+static absl::Status CheckSeparableOrigin(
+    const FileSetOrigin& origin,
+    const absl::flat_hash_map<const ReferenceComponentNode*,
+                              std::vector<SymbolTableNode*>>& type_users) {
+  for (const SymbolTableNode* symbol : origin.Symbols()) {
+    for (const auto& reference : symbol->Value().local_references_to_bind) {
+      if (reference.components == nullptr || origin.Contains(reference)) {
+        continue;
+      }
+      return absl::FailedPreconditionError(
+          absl::StrCat("Scope ", ContextFullPath(*symbol),
+                       " contains references from other files: ",
+                       ReferenceNodeFullPathString(*reference.components)));
+    }
+    for (const auto& child : *symbol) {
+      if (origin.Defines(child.second)) continue;
+      return absl::FailedPreconditionError(absl::StrCat(
+          "Symbol ", ContextFullPath(child.second),
+          " is defined in another file than its parent scope."));
+    }
+  }
+  absl::Status status;
+  for (const SymbolTableNode* scope : origin.ReferenceScopes()) {
+    for (const auto& reference : scope->Value().local_references_to_bind) {
+      if (!origin.Contains(reference)) continue;
+      reference.components->ApplyPreOrder(
+          [&](const ReferenceComponentNode& component) {
+            if (!status.ok()) return;
+            const auto found = type_users.find(&component);
+            if (found == type_users.end()) return;
+            for (const SymbolTableNode* user : found->second) {
+              if (origin.Defines(*user)) continue;
+              const SymbolInfo& info(user->Value());
+              if (info.declared_type.user_defined_type != &component &&
+                  info.parent_type.user_defined_type != &component) {
+                continue;
+              }
+              status = absl::FailedPreconditionError(absl::StrCat(
+                  "Type of symbol ", ContextFullPath(*user),
+                  " is referenced from another file: ",
+                  component.Value().identifier));
+              return;
+            }
+          });
+      if (!status.ok()) return status;
+    }
+  }
+  return status;
+}
+
+// Collects the 'symbols' defined by 'origin', and the 'names' of those that
+// can be seen from scopes of other files (not nested in other such symbols).
+static void CollectSymbolsOfOrigin(
+    const FileSetOrigin& origin, absl::flat_hash_set<SymbolTableNode*>* symbols,
+    absl::flat_hash_set<std::string>* names) {
+  for (SymbolTableNode* symbol : origin.Symbols()) {
+    symbols->insert(symbol);
+    if (!origin.Defines(*symbol->Parent())) names->emplace(*symbol->Key());
+  }
+}
+
+// Collects the reference 'components' of 'origin', and the symbols that they
+// are bound to.
+static void CollectReferencesOfOrigin(
+    const FileSetOrigin& origin,
+    absl::flat_hash_set<const ReferenceComponentNode*>* components,
+    absl::flat_hash_set<const SymbolTableNode*>* bound_symbols) {
+  for (const SymbolTableNode* scope : origin.ReferenceScopes()) {
+    for (const auto& reference : scope->Value().local_references_to_bind) {
+      if (!origin.Contains(reference)) continue;
+      reference.components->ApplyPreOrder(
+          [&](const ReferenceComponentNode& component) {
+            components->insert(&component);
+            const SymbolTableNode* resolved = component.Value().resolved_symbol;
+            if (resolved != nullptr) bound_symbols->insert(resolved);
+          });
+    }
+  }
+}
+
+// Removes all symbols and references of 'origin', which must have passed
+// CheckSeparableOrigin().
+static void RemoveSymbolsOfOrigin(const FileSetOrigin& origin) {
+  // References in scopes of other files are removed first, while those scopes
+  // can still be told apart from the ones that are destroyed below.
+  for (SymbolTableNode* scope : origin.ReferenceScopes()) {
+    if (origin.Defines(*scope)) continue;
+    auto& references = scope->Value().local_references_to_bind;
+    if (std::none_of(references.begin(), references.end(),
+                     [&origin](const DependentReferences& reference) {
+                       return origin.Contains(reference);
+                     })) {
+      continue;
+    }
+    // DependentReferences are move-constructible, but not move-assignable.
+    std::vector<DependentReferences> kept_references;
+    kept_references.reserve(references.size());
+    for (auto& reference : references) {
+      if (!origin.Contains(reference)) {
+        kept_references.emplace_back(std::move(reference));
+      }
+    }
+    references = std::move(kept_references);
+  }
+
+  // Scopes of other files never nest inside those of 'origin', so erasing
+  // the outermost symbols of 'origin' removes all of them.
+  std::vector<std::pair<SymbolTableNode*, absl::string_view>> outermost;
+  for (SymbolTableNode* symbol : origin.Symbols()) {
+    SymbolTableNode* scope = symbol->Parent();
+    if (!origin.Defines(*scope)) outermost.emplace_back(scope, *symbol->Key());
+  }
+  for (const auto& symbol : outermost) {
+    symbol.first->Erase(symbol.first->Find(symbol.second));
+  }
+}
+
+// Set of references whose bindings could change when a translation unit is
+// updated.  Entire reference trees are tracked, but only their components'
+// addresses are stored, so that no references can dangle when the symbols
+// that they are bound to are removed.
+// Candidate references are found through the indexes of the symbol table,
+// so that the work is proportional to the number of affected references and
+// symbols, rather than the size of the table.
+class SymbolTable::AffectedReferences {
+ public:
+  explicit AffectedReferences(SymbolTable* symbol_table)
+      : symbol_table_(symbol_table) {}
+
+  bool Contains(const DependentReferences& reference) const {
+    return components_.contains(reference.components.get());
+  }
+
+  bool ContainsComponent(const ReferenceComponentNode* component) const {
+    return components_.contains(component);
+  }
+
+  const absl::flat_hash_set<const SymbolTableNode*>& PreviousBindings() const {
+    return previous_bindings_;
+  }
+
+  // Scopes that hold any of the affected references.
+  const absl::flat_hash_set<SymbolTableNode*>& Scopes() const {
+    return scopes_;
+  }
+
+  // Adds every reference of 'origin' (e.g. all new references).
+  void AddReferencesOf(const FileSetOrigin& origin) {
+    for (SymbolTableNode* scope : origin.ReferenceScopes()) {
+      for (auto& reference : scope->Value().local_references_to_bind) {
+        if (origin.Contains(reference)) Add(scope, reference.components.get());
+      }
+    }
+  }
+
+  // Adds every reference outside of 'origin' that could bind differently
+  // when 'symbols' change, or when symbols named 'names' are added or removed:
+  //   * references bound to any of 'symbols'
+  //   * unqualified references by any of 'names'
+  //   * unqualified references from any scope within 'symbols'
+  // These rules are applied until no more references are added, with
+  // 'symbols' growing to include symbols whose declared type or base class is
+  // an affected reference.
+  // Bindings of added references are cleared, for re-resolution.
+  void AddDependentReferences(
+      const FileSetOrigin& origin,
+      const absl::flat_hash_set<std::string>& names,
+      const absl::flat_hash_set<SymbolTableNode*>& symbols) {
+    const auto& references_by_name(symbol_table_->references_by_name_);
+    for (const auto& name : names) {
+      const auto found = references_by_name.find(name);
+      if (found == references_by_name.end()) continue;
+      for (const auto& entry : found->second) {
+        ++symbol_table_->update_visits_;
+        if (entry.first->Parent() == nullptr &&
+            IsUnqualified(entry.first->Value())) {
+          AddUnlessOf(origin, entry.second, entry.first);
+        }
+      }
+    }
+
+    pending_symbols_.insert(pending_symbols_.end(), symbols.begin(),
+                            symbols.end());
+    absl::flat_hash_set<const SymbolTableNode*> affected_symbols;
+    while (!pending_symbols_.empty()) {
+      SymbolTableNode* symbol = pending_symbols_.back();
+      pending_symbols_.pop_back();
+      if (!affected_symbols.insert(symbol).second) continue;
+
+      // References can only be bound to symbols of the same name.
+      const auto found = references_by_name.find(*symbol->Key());
+      if (found != references_by_name.end()) {
+        for (const auto& entry : found->second) {
+          ++symbol_table_->update_visits_;
+          if (entry.first->Value().resolved_symbol != symbol) continue;
+          ReferenceComponentNode* base = entry.first;
+          while (base->Parent() != nullptr) base = base->Parent();
+          AddUnlessOf(origin, entry.second, base);
+        }
+      }
+
+      symbol->ApplyPreOrder([&](SymbolTableNode& scope) {
+        ++symbol_table_->update_visits_;
+        for (auto& reference : scope.Value().local_references_to_bind) {
+          if (reference.components != nullptr &&
+              IsUnqualified(reference.components->Value())) {
+            AddUnlessOf(origin, &scope, reference.components.get());
+          }
+        }
+      });
+    }
+  }
+
+ private:
+  // Only unqualified (base) references are looked up by name from their
+  // scope.
+  static bool IsUnqualified(const ReferenceComponent& base) {
+    return base.ref_type != ReferenceType::kDirectMember &&
+           base.ref_type != ReferenceType::kMemberOfTypeOfParent;
+  }
+
+  // Adds the reference whose base component is 'base', in 'scope', unless it
+  // was already added or it belongs to 'origin'.
+  void AddUnlessOf(const FileSetOrigin& origin, SymbolTableNode* scope,
+                   ReferenceComponentNode* base) {
+    if (components_.contains(base) ||
+        origin.ContainsText(base->Value().identifier)) {
+      return;
+    }
+    Add(scope, base);
+  }
+
+  void Add(SymbolTableNode* scope, ReferenceComponentNode* base) {
+    if (base == nullptr) return;
+    scopes_.insert(scope);
+    const auto& type_users(symbol_table_->type_users_);
+    base->ApplyPreOrder([&](ReferenceComponentNode& node) {
+      components_.insert(&node);
+      const SymbolTableNode*& resolved = node.Value().resolved_symbol;
+      if (resolved != nullptr) previous_bindings_.insert(resolved);
+      resolved = nullptr;
+      // Symbols whose type this is are affected too.
+      const auto found = type_users.find(&node);
+      if (found == type_users.end()) return;
+      for (SymbolTableNode* user : found->second) {
+        const SymbolInfo& info(user->Value());
+        if (info.declared_type.user_defined_type == &node ||
+            info.parent_type.user_defined_type == &node) {
+          pending_symbols_.push_back(user);
+        }
+      }
+    });
+  }
+
+  SymbolTable* const symbol_table_;
+
+  absl::flat_hash_set<const ReferenceComponentNode*> components_;
+
+  absl::flat_hash_set<SymbolTableNode*> scopes_;
+
+  // Symbols that any of components_ were bound to before they were added.
+  // Some of these may have been removed since, so they must not be
+  // dereferenced.
+  absl::flat_hash_set<const SymbolTableNode*> previous_bindings_;
+
+  // Symbols whose types became affected, yet to be handled by
+  // AddDependentReferences().
+  std::vector<SymbolTableNode*> pending_symbols_;
+};
+
+// Returns the keys on the path from the root to 'node'.  Sorting nodes by
+// these orders them like a pre-order traversal.
+static std::vector<absl::string_view> KeyPath(const SymbolTableNode& node) {
+  std::vector<absl::string_view> path;
+  for (const SymbolTableNode* iter = &node; iter->Parent() != nullptr;
+       iter = iter->Parent()) {
+    path.push_back(*iter->Key());
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+void SymbolTable::UnindexSymbolsAndReferences(
+    const absl::flat_hash_set<SymbolTableNode*>& symbols,
+    const absl::flat_hash_set<const ReferenceComponentNode*>& components) {
+  for (const SymbolTableNode* symbol : symbols) {
+    const SymbolInfo& info(symbol->Value());
+    for (const DeclarationTypeInfo* type_info :
+         {&info.declared_type, &info.parent_type}) {
+      const auto found = type_users_.find(type_info->user_defined_type);
+      if (found == type_users_.end()) continue;
+      auto& users = found->second;
+      users.erase(std::remove(users.begin(), users.end(), symbol),
+                  users.end());
+      if (users.empty()) type_users_.erase(found);
+    }
+  }
+  for (const ReferenceComponentNode* component : components) {
+    type_users_.erase(component);
+    const auto found = references_by_name_.find(component->Value().identifier);
+    if (found == references_by_name_.end()) continue;
+    found->second.erase(component);
+    if (found->second.empty()) references_by_name_.erase(found);
+  }
+}
+
+absl::Status SymbolTable::UpdateTranslationUnit(
+    absl::string_view referenced_file_name,
+    std::vector<absl::Status>* diagnostics) {
+  update_visits_ = 0;
+  VerilogSourceFile* translation_unit =
+      project_->LookupRegisteredFile(referenced_file_name);
+  const auto found_unit = translation_unit_includes_.find(translation_unit);
+  if (found_unit == translation_unit_includes_.end()) {
+    return absl::NotFoundError(absl::StrCat("Translation unit '",
+                                            referenced_file_name,
+                                            "' was never built."));
+  }
+  if (translation_unit->IsPinned()) {
+    // Reopening would fail after the old symbols were already removed.
+    return absl::FailedPreconditionError(
+        absl::StrCat("Translation unit '", referenced_file_name,
+                     "' is pinned, and cannot be re-read."));
+  }
+
+  // Files that are included by other units (or built as units themselves)
+  // keep their symbols, and are not entered again.
+  const auto included_elsewhere = [this, translation_unit](
+                                      const VerilogSourceFile* file) {
+    for (const auto& unit : translation_unit_includes_) {
+      if (unit.first == translation_unit) continue;
+      if (unit.first == file || unit.second.find(file) != unit.second.end()) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::set<const VerilogSourceFile*> shared_includes;
+  std::set<const VerilogSourceFile*> old_files{translation_unit};
+  for (const VerilogSourceFile* included : found_unit->second) {
+    if (included_elsewhere(included)) {
+      shared_includes.insert(included);
+    } else {
+      old_files.insert(included);
+    }
+  }
+  const FileSetOrigin old_origin(std::move(old_files), symbols_by_file_,
+                                 reference_scopes_by_file_, &update_visits_);
+  {
+    const absl::Status status = CheckSeparableOrigin(old_origin, type_users_);
+    if (!status.ok()) return status;
+  }
+
+  AffectedReferences affected(this);
+  {
+    absl::flat_hash_set<SymbolTableNode*> old_symbols;
+    absl::flat_hash_set<std::string> old_names;
+    CollectSymbolsOfOrigin(old_origin, &old_symbols, &old_names);
+    absl::flat_hash_set<const ReferenceComponentNode*> old_components;
+    absl::flat_hash_set<const SymbolTableNode*> bound_symbols;
+    CollectReferencesOfOrigin(old_origin, &old_components, &bound_symbols);
+    if (index_reverse_references_) {
+      // Drop the index entries of everything that is about to be destroyed,
+      // while their addresses cannot be reused.
+      for (const SymbolTableNode* symbol : old_symbols) {
+        reverse_references_.erase(symbol);
+      }
+      UnindexReverseReferences(
+          bound_symbols, [&old_components](const ReferenceComponentNode* c) {
+            return old_components.contains(c);
+          });
+    }
+    affected.AddDependentReferences(old_origin, old_names, old_symbols);
+    UnindexSymbolsAndReferences(old_symbols, old_components);
+  }
+  RemoveSymbolsOfOrigin(old_origin);
+  for (const VerilogSourceFile* file : old_origin.Files()) {
+    symbols_by_file_.erase(file);
+    reference_scopes_by_file_.erase(file);
+  }
+  found_unit->second.clear();
+
+  // Re-read and re-build this unit, now that nothing refers to its old text.
+  const auto reopened = project_->ReopenFile(referenced_file_name);
+  if (!reopened.ok()) {
+    diagnostics->push_back(reopened.status());
+  } else {
+    const ParsedFilePin pin(translation_unit);
+    const auto parse_status = translation_unit->Parse();
+    if (!parse_status.ok()) diagnostics->push_back(parse_status);
+    const auto* text_structure = translation_unit->GetTextStructure();
+    if (text_structure != nullptr && text_structure->SyntaxTree() != nullptr) {
+      Builder builder(*translation_unit, this, project_);
+      builder.SkipIncludedFiles(&shared_includes);
+      text_structure->SyntaxTree()->Accept(&builder);
+      const std::vector<absl::Status> statuses = builder.TakeDiagnostics();
+      diagnostics->insert(diagnostics->end(), statuses.begin(),
+                          statuses.end());
+    }
+  }
+
+  std::set<const VerilogSourceFile*> new_files{translation_unit};
+  for (const VerilogSourceFile* included : found_unit->second) {
+    if (!included_elsewhere(included)) new_files.insert(included);
+  }
+  const FileSetOrigin new_origin(std::move(new_files), symbols_by_file_,
+                                 reference_scopes_by_file_, &update_visits_);
+  affected.AddReferencesOf(new_origin);
+  {
+    absl::flat_hash_set<SymbolTableNode*> new_symbols;
+    absl::flat_hash_set<std::string> new_names;
+    CollectSymbolsOfOrigin(new_origin, &new_symbols, &new_names);
+    affected.AddDependentReferences(new_origin, new_names, new_symbols);
+  }
+
+  // Only the affected references were unbound, so only their index entries
+  // change.  (New references have none yet.)
+  if (index_reverse_references_) {
+    UnindexReverseReferences(
+        affected.PreviousBindings(),
+        [&affected](const ReferenceComponentNode* component) {
+          return affected.ContainsComponent(component);
+        });
+  }
+
+  // Resolve in the same order as Resolve(), in only the scopes that hold
+  // affected references.
+  std::vector<std::pair<std::vector<absl::string_view>, SymbolTableNode*>>
+      scopes;
+  scopes.reserve(affected.Scopes().size());
+  for (SymbolTableNode* scope : affected.Scopes()) {
+    scopes.emplace_back(KeyPath(*scope), scope);
+  }
+  std::sort(scopes.begin(), scopes.end());
+  DirectReferenceBindings bindings;
+  for (const auto& scope : scopes) {
+    SymbolTableNode& node(*scope.second);
+    for (auto& reference : node.Value().local_references_to_bind) {
+      ++update_visits_;
+      if (!affected.Contains(reference)) continue;
+      ResolveDependentReferences(&reference, node, &bindings, diagnostics);
+      if (index_reverse_references_) IndexReverseReferences(reference);
+    }
+  }
+  return absl::OkStatus();
+}
+
 std::vector<absl::Status> BuildSymbolTable(const VerilogSourceFile& source,
                                            SymbolTable* symbol_table,
                                            VerilogProject* project) {
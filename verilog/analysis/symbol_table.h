@@ -18,7 +18,12 @@
 #include <functional>
 #include <iosfwd>
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "common/strings/compare.h"
@@ -30,6 +35,7 @@
 namespace verilog {
 
 struct SymbolInfo;  // forward declaration, defined below
+class SymbolTableSnapshot;
 
 // SymbolTableNode represents a named element in the syntax.
 // When it represents a scope, it may have named subtrees.
@@ -229,10 +235,14 @@ std::ostream& operator<<(std::ostream&, const DependentReferences&);
 // Contains information about a type used to declare data/instances/variables.
 struct DeclarationTypeInfo {
   // Pointer to the syntax tree origin, e.g. a NodeEnum::kDataType node.
-  // This is useful for diagnostic that detail the relevant text,
-  // which can be recovered by StringSpanOfSymbol(const verible::Symbol&).
+  // This is reset to nullptr when the file's syntax tree is evicted (see
+  // VerilogProject::SetParsedMemoryBudget()), like SymbolInfo::syntax_origin.
   const verible::Symbol* syntax_origin = nullptr;
 
+  // Text spanned by syntax_origin, for diagnostics that detail the relevant
+  // text.  This points into file contents, which are never evicted.
+  absl::string_view syntax_origin_text;
+
   // Pointer to the reference node that represents a user-defined type, if
   // applicable.
   // For built-in and primitive types, this is left as nullptr.
@@ -283,6 +293,10 @@ struct SymbolInfo {
   // Pointer to the syntax tree origin.
   // An easy way to view this text is StringSpanOfSymbol(*syntax_origin).
   // Reminder: Parts of the syntax tree may originate from included files.
+  // This is reset to nullptr when the syntax tree of file_origin is evicted
+  // (see VerilogProject::SetParsedMemoryBudget()), and is not restored when
+  // the file is parsed again.  Hold a ParsedFilePin of file_origin from
+  // before building the symbol table to keep this valid.
   const verible::Symbol* syntax_origin = nullptr;
 
   // What is the type associated with this symbol?
@@ -389,8 +403,8 @@ struct SymbolInfo {
 // definitions.
 // The string_view key should be a substring of text whose memory is owned by
 // any VerilogSourceFile that defines the macro.
-// TODO(fangism): This should come from a preprocessor and possibly maintained
-// per translation-unit in multi-file compilation mode.
+// TODO(fangism): Populate this from the per-translation-unit definitions of
+// VerilogProject::MacroDefinitions() in multi-file compilation mode.
 using MacroSymbolMap =
     std::map<absl::string_view, SymbolInfo, verible::StringViewCompare>;
 
@@ -414,15 +428,17 @@ using MacroSymbolMap =
 //
 class SymbolTable {
  public:
-  class Builder;  // implementation detail
-  class Tester;   // test-only
+  class Builder;             // implementation detail
+  struct IsolatedBuild;      // implementation detail
+  class AffectedReferences;  // implementation detail
+  class Tester;              // test-only
+
+  friend class SymbolTableSnapshot;  // restores tables from snapshots
 
  public:
   // If 'project' is nullptr, caller assumes responsibility for managing files
   // and string memory, otherwise string memory is owned by 'project'.
-  explicit SymbolTable(VerilogProject* project)
-      : project_(project),
-        symbol_table_root_(SymbolInfo{.metatype = SymbolMetaType::kRoot}) {}
+  explicit SymbolTable(VerilogProject* project);
 
   // can become move-able when needed
   SymbolTable(const SymbolTable&) = delete;
@@ -430,7 +446,7 @@ class SymbolTable {
   SymbolTable& operator=(const SymbolTable&) = delete;
   SymbolTable& operator=(SymbolTable&&) = delete;
 
-  ~SymbolTable() { CheckIntegrity(); }
+  ~SymbolTable();
 
   const SymbolTableNode& Root() const { return symbol_table_root_; }
 
@@ -454,10 +470,49 @@ class SymbolTable {
   // duplicate definitions among translation units.
   void Build(std::vector<absl::Status>* diagnostics);
 
+  // Same as Build(), but translation units are parsed and their symbols are
+  // collected concurrently, using up to 'jobs' threads (non-positive means
+  // hardware concurrency).  Per-unit results are merged in the same order that
+  // Build() processes units, so that the resulting symbol table and
+  // diagnostics are the same as those of Build().
+  void BuildConcurrently(std::vector<absl::Status>* diagnostics, int jobs = 0);
+
+  // Same as calling BuildSingleTranslationUnit() on each of
+  // 'referenced_file_names' in order, but concurrently, like
+  // BuildConcurrently().  Only files that were already opened in the project
+  // are processed concurrently, the rest are opened and built serially.
+  void BuildTranslationUnitsConcurrently(
+      const std::vector<std::string>& referenced_file_names,
+      std::vector<absl::Status>* diagnostics, int jobs = 0);
+
   // Lookup all symbol references, and bind references where successful.
   // Only attempt to resolve after merging symbol tables.
   void Resolve(std::vector<absl::Status>* diagnostics);
 
+  // Same as Resolve(), but references are resolved concurrently, using up to
+  // 'jobs' threads (non-positive means hardware concurrency).  The resulting
+  // bindings and diagnostics are the same as those of Resolve().
+  void ResolveConcurrently(std::vector<absl::Status>* diagnostics,
+                           int jobs = 0);
+
+  // Replaces the symbols and references that originate from the previously
+  // built translation unit 'referenced_file_name' (and the files that only it
+  // includes) with those of its current contents, which are re-read from the
+  // project and re-parsed.  Only references that could be affected by the
+  // change are re-resolved: those of the updated unit, those that could bind
+  // to any symbol that it defines (before or after the update), and those
+  // that depend on such symbols through declared types and base classes.
+  // These are found through indexes kept by Build(), so the work done is
+  // proportional to the size of the unit and of its dependents, rather than
+  // to that of the whole table.
+  // This is intended for use after Build() and Resolve().
+  // Returns an error, leaving the symbol table unchanged, if this unit's
+  // symbols cannot be separated from those of other units (e.g. when other
+  // files add members to its scopes), in which case the whole table should be
+  // rebuilt, or if the unit's file is pinned (see ParsedFilePin).
+  absl::Status UpdateTranslationUnit(absl::string_view referenced_file_name,
+                                     std::vector<absl::Status>* diagnostics);
+
   // A "weaker" version of Resolve() that only attempts to resolve symbol
   // references to definitions belonging to the same scope as the reference
   // (without upward search).
@@ -467,6 +522,23 @@ class SymbolTable {
   // is intended.
   void ResolveLocallyOnly();
 
+  // Enables (or disables) the index from symbols to the references that
+  // resolved to them.  When enabled, the index is built right away, and
+  // rebuilt at the end of every Resolve(), ResolveConcurrently() and
+  // ResolveLocallyOnly().  Successful calls to UpdateTranslationUnit() only
+  // update the entries of the references that they re-resolve.
+  // This is disabled by default, because its memory usage is proportional to
+  // the number of resolved references.
+  void EnableReverseReferenceIndex(bool enable = true);
+
+  // Returns all reference components that resolved to 'symbol', in the order
+  // in which PrintSymbolReferences() shows them, as of the last resolution.
+  // References re-resolved by UpdateTranslationUnit() are moved to the end.
+  // This takes time proportional to the size of the result, but requires
+  // EnableReverseReferenceIndex(), and returns an empty list otherwise.
+  const std::vector<const ReferenceComponentNode*>& FindReferencesTo(
+      const SymbolTableNode& symbol) const;
+
   // Print only the information about symbols defined (no references).
   // This will print the results of Build().
   std::ostream& PrintSymbolDefinitions(std::ostream&) const;
@@ -483,6 +555,54 @@ class SymbolTable {
   // Verify internal structural and pointer consistency.
   void CheckIntegrity() const;
 
+  // Returns the number of symbols and references that the last call to
+  // UpdateTranslationUnit() visited, as a measure of its work.
+  size_t LastUpdateVisits() const { return update_visits_; }
+
+ private:  // methods
+  // Amends this symbol table with the translation unit 'source', taking its
+  // symbols from 'isolated' (built in isolation, possibly nullptr) where that
+  // gives the same result as building 'source' directly into this table.
+  void MergeOrBuildTranslationUnit(VerilogSourceFile* source,
+                                   IsolatedBuild* isolated,
+                                   std::vector<absl::Status>* diagnostics);
+
+  // Moves all symbols out of 'isolated' (the table of a single translation
+  // unit) into this table, if none of them depends on this table's existing
+  // contents.  Returns false, leaving both tables unchanged, otherwise.
+  bool TryMergeIsolatedTable(SymbolTable* isolated);
+
+  // Rebuilds reverse_references_ if enabled.
+  void IndexReverseReferences();
+
+  // Adds the resolved components of 'reference' to reverse_references_.
+  void IndexReverseReferences(const DependentReferences& reference);
+
+  // Removes from reverse_references_ the components for which 'unindexed' is
+  // true, among those that were resolved to any of 'bound_symbols'.
+  void UnindexReverseReferences(
+      const absl::flat_hash_set<const SymbolTableNode*>& bound_symbols,
+      const std::function<bool(const ReferenceComponentNode*)>& unindexed);
+
+  // Removes the entries of 'symbols' and 'components' from
+  // references_by_name_ and type_users_, before they are destroyed.
+  void UnindexSymbolsAndReferences(
+      const absl::flat_hash_set<SymbolTableNode*>& symbols,
+      const absl::flat_hash_set<const ReferenceComponentNode*>& components);
+
+  // Resets the syntax tree pointers (syntax_origin) that point into files
+  // whose parsed structures are evicted by the project.
+  class SyntaxOriginInvalidator final : public ParsedFileEvictionObserver {
+   public:
+    explicit SyntaxOriginInvalidator(SymbolTable* symbol_table)
+        : symbol_table_(symbol_table) {}
+
+    void OnParsedStructuresEvicted(const VerilogSourceFile& file) final;
+
+   private:
+    SymbolTable* const symbol_table_;
+  };
+
  private:  // data
   // This owns all files used to construct the symbol table and therefore,
   // owns all string_views inside the symbol table and outlives objects of
@@ -502,6 +622,51 @@ class SymbolTable {
 
   // All macro definitions/references interact through this global namespace.
   MacroSymbolMap macro_symbols_;
+
+  // Files that were (transitively) `included by each translation unit that
+  // was built into this table, keyed by translation unit.
+  std::map<const VerilogSourceFile*, std::set<const VerilogSourceFile*>>
+      translation_unit_includes_;
+
+  // If true, reverse_references_ is maintained.
+  bool index_reverse_references_ = false;
+
+  // Reference components that resolved to each symbol, keyed by symbol.
+  absl::flat_hash_map<const SymbolTableNode*,
+                      std::vector<const ReferenceComponentNode*>>
+      reverse_references_;
+
+  // Symbols keyed by their file_origin, so that the symbols of a single file
+  // can be visited without traversing the whole table.
+  absl::flat_hash_map<const VerilogSourceFile*, std::vector<SymbolTableNode*>>
+      symbols_by_file_;
+
+  // Scopes that hold the references of each file (the one that was being
+  // built when they were added), keyed by file.  A scope is listed once for
+  // each run of consecutive references that were added to it.
+  absl::flat_hash_map<const VerilogSourceFile*, std::vector<SymbolTableNode*>>
+      reference_scopes_by_file_;
+
+  // Every reference component, keyed by identifier, with the scope that its
+  // reference belongs to.  This finds the references that could bind
+  // differently when symbols of some name are added or removed (including
+  // those that did not resolve), without traversing the whole table.
+  absl::flat_hash_map<
+      std::string,
+      absl::flat_hash_map<ReferenceComponentNode*, SymbolTableNode*>>
+      references_by_name_;
+
+  // Symbols whose declared type or base class is a reference component,
+  // keyed by component.
+  absl::flat_hash_map<const ReferenceComponentNode*,
+                      std::vector<SymbolTableNode*>>
+      type_users_;
+
+  // See LastUpdateVisits().
+  size_t update_visits_ = 0;
+
+  // Registered with project_, if there is one.
+  SyntaxOriginInvalidator syntax_origin_invalidator_{this};
 };
 
 // Construct a partial symbol table and bindings locations from a single source
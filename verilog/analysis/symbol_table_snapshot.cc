@@ -0,0 +1,693 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/analysis/symbol_table_snapshot.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "common/strings/content_hash.h"
+#include "common/strings/mem_block.h"
+#include "common/text/text_structure.h"
+#include "common/util/file_util.h"
+#include "common/util/status_macros.h"
+#include "verilog/analysis/symbol_table.h"
+#include "verilog/analysis/verilog_project.h"
+
+namespace verilog {
+
+namespace {
+
+// Snapshot file layout, in this order:
+//   Header
+//   FileRecord[num_files]
+//   StringRef[num_include_paths]
+//   IncludeLookupRecord[num_include_lookups]
+//   SymbolRecord[num_symbols]
+//   ReferenceRecord[num_references]
+//   DiagnosticRecord[num_diagnostics]
+//   string pool (string_pool_size bytes)
+// All records consist of 32-bit integers (in native byte order), so that
+// every array is suitably aligned in a memory-mapped file.
+
+// Identifies snapshot files, and changes with the byte order.
+constexpr uint32_t kMagic = 0x56534e50;  // "VSNP"
+
+// Increment this on every change of the layout.
+constexpr uint32_t kVersion = 2;
+
+// Index value for "none".
+constexpr int32_t kNone = -1;
+
+// Reference trees are only as deep as chains of hierarchical references (like
+// a.b.c) are long, so deeper trees come from malformed images, and would be
+// too deep to destroy (recursively).
+constexpr size_t kMaxReferenceDepth = 1000;
+
+// A string in the string pool.
+struct StringRef {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_files;
+  uint32_t num_include_paths;
+  uint32_t num_include_lookups;
+  uint32_t num_symbols;
+  uint32_t num_references;
+  uint32_t num_diagnostics;
+  uint32_t string_pool_size;
+  StringRef fingerprint;
+};
+
+struct FileRecord {
+  StringRef path;          // VerilogSourceFile::ResolvedPath()
+  StringRef content_hash;  // verible::ContentHash() of the contents
+};
+
+// See VerilogProject::IncludeLookups().
+struct IncludeLookupRecord {
+  StringRef referenced;  // name in the `include directive
+  StringRef resolved;    // empty if not found
+};
+
+// Where a name was found in the source files.
+struct AnchorRecord {
+  int32_t file;     // index of FileRecord, or kNone
+  uint32_t offset;  // byte offset into the file's contents
+};
+
+// One SymbolTableNode.  Symbols are stored in pre-order, starting with the
+// root, so parents precede their children.
+struct SymbolRecord {
+  StringRef name;  // empty for the root
+  AnchorRecord anchor;
+  int32_t parent;           // index of SymbolRecord, kNone for the root
+  uint32_t metatype;        // SymbolMetaType
+  int32_t declared_type;    // index of ReferenceRecord, or kNone
+  int32_t parent_type;      // index of ReferenceRecord, or kNone
+  uint32_t num_references;  // size of local_references_to_bind
+};
+
+// One ReferenceComponentNode.  The trees of local_references_to_bind are
+// stored in pre-order, grouped by symbol, in the order of the symbols.
+struct ReferenceRecord {
+  StringRef identifier;
+  AnchorRecord anchor;
+  uint32_t ref_type;           // ReferenceType
+  uint32_t required_metatype;  // SymbolMetaType
+  int32_t resolved_symbol;     // index of SymbolRecord, or kNone
+  uint32_t num_children;
+};
+
+struct DiagnosticRecord {
+  uint32_t code;  // absl::StatusCode
+  StringRef message;
+};
+
+template <typename T>
+void AppendRecords(const std::vector<T>& records, std::string* image) {
+  static_assert(std::is_trivially_copyable<T>::value, "T must be POD");
+  static_assert(sizeof(T) % sizeof(uint32_t) == 0, "alignment");
+  image->append(reinterpret_cast<const char*>(records.data()),
+                records.size() * sizeof(T));
+}
+
+// Flattens a SymbolTable into snapshot records.
+class ImageWriter {
+ public:
+  explicit ImageWriter(const SymbolTable& table) : table_(table) {}
+
+  std::string Serialize(const std::vector<absl::Status>& diagnostics,
+                        absl::string_view fingerprint) {
+    header_.magic = kMagic;
+    header_.version = kVersion;
+    header_.fingerprint = AddString(fingerprint);
+    AddFiles();
+    AddIncludeLookups();
+    NumberNodes();
+    AddSymbolsAndReferences();
+    for (const auto& diagnostic : diagnostics) {
+      if (diagnostic.ok()) continue;
+      diagnostics_.push_back(
+          DiagnosticRecord{.code = static_cast<uint32_t>(diagnostic.code()),
+                           .message = AddString(diagnostic.message())});
+    }
+    header_.num_files = files_.size();
+    header_.num_include_paths = include_paths_.size();
+    header_.num_include_lookups = include_lookups_.size();
+    header_.num_symbols = symbols_.size();
+    header_.num_references = references_.size();
+    header_.num_diagnostics = diagnostics_.size();
+    header_.string_pool_size = string_pool_.size();
+
+    std::string image(reinterpret_cast<const char*>(&header_),
+                      sizeof(header_));
+    AppendRecords(files_, &image);
+    AppendRecords(include_paths_, &image);
+    AppendRecords(include_lookups_, &image);
+    AppendRecords(symbols_, &image);
+    AppendRecords(references_, &image);
+    AppendRecords(diagnostics_, &image);
+    image.append(string_pool_);
+    return image;
+  }
+
+ private:
+  StringRef AddString(absl::string_view text) {
+    const StringRef ref{.offset = static_cast<uint32_t>(string_pool_.size()),
+                        .length = static_cast<uint32_t>(text.length())};
+    string_pool_.append(text.begin(), text.end());
+    return ref;
+  }
+
+  // Records the content hashes of all of the project's files.
+  void AddFiles() {
+    const VerilogProject* project = table_.Project();
+    if (project == nullptr) return;
+    for (const auto& file : *project) {
+      const verible::TextStructureView* text_structure =
+          file.second->GetTextStructure();
+      if (text_structure == nullptr) continue;  // not opened
+      file_indices_[file.second.get()] = files_.size();
+      files_.push_back(FileRecord{
+          .path = AddString(file.second->ResolvedPath()),
+          .content_hash =
+              AddString(verible::ContentHash(text_structure->Contents()))});
+    }
+  }
+
+  // Records where `included files were searched, and what was found, so that
+  // files that would be found differently now can be detected.
+  void AddIncludeLookups() {
+    const VerilogProject* project = table_.Project();
+    if (project == nullptr) return;
+    for (const auto& include_path : project->IncludePaths()) {
+      include_paths_.push_back(AddString(include_path));
+    }
+    for (const auto& lookup : project->IncludeLookups()) {
+      include_lookups_.push_back(
+          IncludeLookupRecord{.referenced = AddString(lookup.first),
+                              .resolved = AddString(lookup.second)});
+    }
+  }
+
+  AnchorRecord Anchor(absl::string_view name) const {
+    const VerilogProject* project = table_.Project();
+    if (project == nullptr) return AnchorRecord{.file = kNone, .offset = 0};
+    const VerilogSourceFile* file = project->LookupFileOrigin(name);
+    const auto found = file_indices_.find(file);
+    if (found == file_indices_.end()) {
+      // e.g. generated names
+      return AnchorRecord{.file = kNone, .offset = 0};
+    }
+    const absl::string_view contents =
+        file->GetTextStructure()->Contents();
+    return AnchorRecord{
+        .file = found->second,
+        .offset = static_cast<uint32_t>(
+            std::distance(contents.begin(), name.begin()))};
+  }
+
+  // Assigns record indices to all symbols and reference nodes, in the order
+  // in which they are stored.
+  void NumberNodes() {
+    table_.Root().ApplyPreOrder([this](const SymbolTableNode& node) {
+      symbol_indices_.emplace(&node, symbol_indices_.size());
+    });
+    table_.Root().ApplyPreOrder([this](const SymbolTableNode& node) {
+      for (const auto& ref : node.Value().local_references_to_bind) {
+        if (ref.Empty()) continue;
+        ref.components->ApplyPreOrder(
+            [this](const ReferenceComponentNode& component) {
+              reference_indices_.emplace(&component,
+                                         reference_indices_.size());
+            });
+      }
+    });
+  }
+
+  int32_t SymbolIndex(const SymbolTableNode* node) const {
+    if (node == nullptr) return kNone;
+    const auto found = symbol_indices_.find(node);
+    return found == symbol_indices_.end() ? kNone : found->second;
+  }
+
+  int32_t ReferenceIndex(const ReferenceComponentNode* node) const {
+    if (node == nullptr) return kNone;
+    const auto found = reference_indices_.find(node);
+    return found == reference_indices_.end() ? kNone : found->second;
+  }
+
+  void AddSymbolsAndReferences() {
+    // Names are added to the string pool in the order of their records, which
+    // keeps the name offsets of each kind of record sorted for LocateName().
+    table_.Root().ApplyPreOrder([this](const SymbolTableNode& node) {
+      const SymbolInfo& info = node.Value();
+      const absl::string_view name =
+          node.Key() == nullptr ? absl::string_view() : *node.Key();
+      uint32_t num_references = 0;
+      for (const auto& ref : info.local_references_to_bind) {
+        if (!ref.Empty()) ++num_references;
+      }
+      symbols_.push_back(SymbolRecord{
+          .name = AddString(name),
+          .anchor = Anchor(name),
+          .parent = SymbolIndex(node.Parent()),
+          .metatype = static_cast<uint32_t>(info.metatype),
+          .declared_type =
+              ReferenceIndex(info.declared_type.user_defined_type),
+          .parent_type = ReferenceIndex(info.parent_type.user_defined_type),
+          .num_references = num_references});
+    });
+    table_.Root().ApplyPreOrder([this](const SymbolTableNode& node) {
+      for (const auto& ref : node.Value().local_references_to_bind) {
+        if (ref.Empty()) continue;
+        ref.components->ApplyPreOrder(
+            [this](const ReferenceComponentNode& component) {
+              const ReferenceComponent& value = component.Value();
+              references_.push_back(ReferenceRecord{
+                  .identifier = AddString(value.identifier),
+                  .anchor = Anchor(value.identifier),
+                  .ref_type = static_cast<uint32_t>(value.ref_type),
+                  .required_metatype =
+                      static_cast<uint32_t>(value.required_metatype),
+                  .resolved_symbol = SymbolIndex(value.resolved_symbol),
+                  .num_children =
+                      static_cast<uint32_t>(component.Children().size())});
+            });
+      }
+    });
+  }
+
+  const SymbolTable& table_;
+
+  Header header_ = {};
+  std::vector<FileRecord> files_;
+  std::vector<StringRef> include_paths_;
+  std::vector<IncludeLookupRecord> include_lookups_;
+  std::vector<SymbolRecord> symbols_;
+  std::vector<ReferenceRecord> references_;
+  std::vector<DiagnosticRecord> diagnostics_;
+  std::string string_pool_;
+
+  absl::flat_hash_map<const VerilogSourceFile*, int32_t> file_indices_;
+  absl::flat_hash_map<const SymbolTableNode*, int32_t> symbol_indices_;
+  absl::flat_hash_map<const ReferenceComponentNode*, int32_t>
+      reference_indices_;
+};
+
+absl::Status MalformedError(absl::string_view what) {
+  return absl::DataLossError(
+      absl::StrCat("Malformed symbol table snapshot: ", what));
+}
+
+// Returns the path of 'referenced' under the first of 'include_paths' that
+// contains it, or "" if none does, like VerilogProject::OpenIncludedFile().
+std::string SearchIncludePaths(
+    const std::vector<absl::string_view>& include_paths,
+    absl::string_view referenced) {
+  for (const absl::string_view include_path : include_paths) {
+    std::string resolved = verible::file::JoinPath(include_path, referenced);
+    if (verible::file::FileExists(resolved).ok()) return resolved;
+  }
+  return "";
+}
+
+// Returns true if 'index' is kNone or a valid index below 'size'.
+bool ValidIndex(int32_t index, uint32_t size) {
+  return index == kNone || (index >= 0 && static_cast<uint32_t>(index) < size);
+}
+
+}  // namespace
+
+struct SymbolTableSnapshot::Image {
+  const Header* header = nullptr;
+  const FileRecord* files = nullptr;
+  const StringRef* include_paths = nullptr;
+  const IncludeLookupRecord* include_lookups = nullptr;
+  const SymbolRecord* symbols = nullptr;
+  const ReferenceRecord* references = nullptr;
+  const DiagnosticRecord* diagnostics = nullptr;
+  absl::string_view string_pool;
+
+  absl::string_view String(StringRef ref) const {
+    return string_pool.substr(ref.offset, ref.length);
+  }
+
+  bool ValidString(StringRef ref) const {
+    return uint64_t{ref.offset} + ref.length <= string_pool.length();
+  }
+
+  bool ValidAnchor(const AnchorRecord& anchor) const {
+    return ValidIndex(anchor.file, header->num_files);
+  }
+};
+
+std::string SymbolTableSnapshot::Serialize(
+    const SymbolTable& table, const std::vector<absl::Status>& diagnostics,
+    absl::string_view fingerprint) {
+  return ImageWriter(table).Serialize(diagnostics, fingerprint);
+}
+
+absl::Status SymbolTableSnapshot::Write(
+    const SymbolTable& table, const std::vector<absl::Status>& diagnostics,
+    absl::string_view fingerprint, absl::string_view path) {
+  // Writing atomically also guarantees that a mapped snapshot never changes.
+  return verible::file::SetContentsAtomically(
+      path, Serialize(table, diagnostics, fingerprint));
+}
+
+absl::StatusOr<std::unique_ptr<SymbolTableSnapshot>> SymbolTableSnapshot::Open(
+    absl::string_view path) {
+  auto image = verible::file::MemoryMapFile(path);
+  if (!image.ok()) return image.status();
+  return Load(std::move(*image));
+}
+
+absl::StatusOr<std::unique_ptr<SymbolTableSnapshot>> SymbolTableSnapshot::Load(
+    std::unique_ptr<verible::MemBlock> image) {
+  std::unique_ptr<SymbolTableSnapshot> snapshot(
+      new SymbolTableSnapshot(std::move(image)));
+  RETURN_IF_ERROR(snapshot->Restore());
+  return snapshot;
+}
+
+SymbolTableSnapshot::SymbolTableSnapshot(
+    std::unique_ptr<verible::MemBlock> image)
+    : image_(std::move(image)), view_(absl::make_unique<Image>()) {}
+
+SymbolTableSnapshot::~SymbolTableSnapshot() = default;
+
+absl::Status SymbolTableSnapshot::Restore() {
+  // Locate the arrays.
+  const absl::string_view data = image_->AsStringView();
+  if (data.length() < sizeof(Header)) return MalformedError("truncated");
+  if (reinterpret_cast<uintptr_t>(data.data()) % alignof(Header) != 0) {
+    return absl::InvalidArgumentError("Misaligned symbol table snapshot.");
+  }
+  Image& view(*view_);
+  view.header = reinterpret_cast<const Header*>(data.data());
+  const Header& header(*view.header);
+  if (header.magic != kMagic) {
+    return absl::InvalidArgumentError("Not a symbol table snapshot.");
+  }
+  if (header.version != kVersion) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("Symbol table snapshot has version ", header.version,
+                     ", expected ", kVersion, "."));
+  }
+  const uint64_t size =
+      sizeof(Header) + uint64_t{header.num_files} * sizeof(FileRecord) +
+      uint64_t{header.num_include_paths} * sizeof(StringRef) +
+      uint64_t{header.num_include_lookups} * sizeof(IncludeLookupRecord) +
+      uint64_t{header.num_symbols} * sizeof(SymbolRecord) +
+      uint64_t{header.num_references} * sizeof(ReferenceRecord) +
+      uint64_t{header.num_diagnostics} * sizeof(DiagnosticRecord) +
+      header.string_pool_size;
+  if (size != data.length()) return MalformedError("size mismatch");
+  const char* next = data.data() + sizeof(Header);
+  const auto take = [&next](size_t n, size_t record_size) {
+    const char* const array = next;
+    next += n * record_size;
+    return array;
+  };
+  view.files = reinterpret_cast<const FileRecord*>(
+      take(header.num_files, sizeof(FileRecord)));
+  view.include_paths = reinterpret_cast<const StringRef*>(
+      take(header.num_include_paths, sizeof(StringRef)));
+  view.include_lookups = reinterpret_cast<const IncludeLookupRecord*>(
+      take(header.num_include_lookups, sizeof(IncludeLookupRecord)));
+  view.symbols = reinterpret_cast<const SymbolRecord*>(
+      take(header.num_symbols, sizeof(SymbolRecord)));
+  view.references = reinterpret_cast<const ReferenceRecord*>(
+      take(header.num_references, sizeof(ReferenceRecord)));
+  view.diagnostics = reinterpret_cast<const DiagnosticRecord*>(
+      take(header.num_diagnostics, sizeof(DiagnosticRecord)));
+  view.string_pool = absl::string_view(next, header.string_pool_size);
+
+  if (!view.ValidString(header.fingerprint)) {
+    return MalformedError("fingerprint");
+  }
+  for (uint32_t i = 0; i < header.num_files; ++i) {
+    if (!view.ValidString(view.files[i].path) ||
+        !view.ValidString(view.files[i].content_hash)) {
+      return MalformedError("file");
+    }
+  }
+  for (uint32_t i = 0; i < header.num_include_paths; ++i) {
+    if (!view.ValidString(view.include_paths[i])) {
+      return MalformedError("include path");
+    }
+  }
+  for (uint32_t i = 0; i < header.num_include_lookups; ++i) {
+    if (!view.ValidString(view.include_lookups[i].referenced) ||
+        !view.ValidString(view.include_lookups[i].resolved)) {
+      return MalformedError("include lookup");
+    }
+  }
+
+  // Recreate the symbol tree.
+  if (header.num_symbols == 0 || view.symbols[0].parent != kNone) {
+    return MalformedError("missing root symbol");
+  }
+  table_ = absl::make_unique<SymbolTable>(nullptr);
+  std::vector<SymbolTableNode*> symbols;
+  symbols.reserve(header.num_symbols);
+  symbols.push_back(&table_->MutableRoot());
+  for (uint32_t i = 1; i < header.num_symbols; ++i) {
+    const SymbolRecord& record = view.symbols[i];
+    // Parents precede their children.
+    if (record.parent < 0 || static_cast<uint32_t>(record.parent) >= i ||
+        !view.ValidString(record.name) || !view.ValidAnchor(record.anchor) ||
+        record.metatype > static_cast<uint32_t>(SymbolMetaType::kCallable)) {
+      return MalformedError(absl::StrCat("symbol ", i));
+    }
+    SymbolInfo info{};
+    info.metatype = static_cast<SymbolMetaType>(record.metatype);
+    const auto inserted = symbols[record.parent]->TryEmplace(
+        view.String(record.name), std::move(info));
+    if (!inserted.second) {
+      return MalformedError(absl::StrCat("duplicate symbol ", i));
+    }
+    symbols.push_back(&inserted.first->second);
+  }
+
+  // Recreate the reference trees.  Nodes are created with exactly the
+  // capacity for their children, so that their addresses remain stable.
+  std::vector<const ReferenceComponentNode*> references(
+      header.num_references, nullptr);
+  uint32_t next_reference = 0;
+  const auto make_component =
+      [&](uint32_t index) -> absl::StatusOr<ReferenceComponent> {
+    if (index >= header.num_references) return MalformedError("references");
+    const ReferenceRecord& record = view.references[index];
+    if (!view.ValidString(record.identifier) ||
+        !view.ValidAnchor(record.anchor) ||
+        record.ref_type >
+            static_cast<uint32_t>(ReferenceType::kMemberOfTypeOfParent) ||
+        record.required_metatype >
+            static_cast<uint32_t>(SymbolMetaType::kCallable) ||
+        !ValidIndex(record.resolved_symbol, header.num_symbols) ||
+        record.num_children > header.num_references) {
+      return MalformedError(absl::StrCat("reference ", index));
+    }
+    return ReferenceComponent{
+        .identifier = view.String(record.identifier),
+        .ref_type = static_cast<ReferenceType>(record.ref_type),
+        .required_metatype =
+            static_cast<SymbolMetaType>(record.required_metatype),
+        .resolved_symbol = record.resolved_symbol == kNone
+                               ? nullptr
+                               : symbols[record.resolved_symbol]};
+  };
+  // Restores the descendants of 'root', whose record is the next one.  This
+  // does not recurse, so that malformed images can't overflow the stack.
+  // Holds the nodes along the path from the root, with their numbers of
+  // children yet to be restored.
+  std::vector<std::pair<ReferenceComponentNode*, uint32_t>> pending_children;
+  const auto restore_tree = [&](ReferenceComponentNode* root) -> absl::Status {
+    const auto enter = [&](ReferenceComponentNode* node) {
+      references[next_reference] = node;
+      const uint32_t num_children =
+          view.references[next_reference].num_children;
+      ++next_reference;
+      node->Children().reserve(num_children);
+      pending_children.emplace_back(node, num_children);
+    };
+    pending_children.clear();
+    enter(root);
+    while (!pending_children.empty()) {
+      ReferenceComponentNode* const parent = pending_children.back().first;
+      if (pending_children.back().second-- == 0) {
+        pending_children.pop_back();
+        continue;
+      }
+      if (pending_children.size() >= kMaxReferenceDepth) {
+        return MalformedError("reference tree too deep");
+      }
+      auto component = make_component(next_reference);
+      if (!component.ok()) return component.status();
+      enter(parent->NewChild(std::move(*component)));
+    }
+    return absl::OkStatus();
+  };
+  for (uint32_t i = 0; i < header.num_symbols; ++i) {
+    const uint32_t num_references = view.symbols[i].num_references;
+    if (num_references > header.num_references) {
+      return MalformedError(absl::StrCat("symbol ", i));
+    }
+    auto& local_references = symbols[i]->Value().local_references_to_bind;
+    local_references.reserve(num_references);
+    for (uint32_t k = 0; k < num_references; ++k) {
+      auto component = make_component(next_reference);
+      if (!component.ok()) return component.status();
+      local_references.emplace_back();
+      local_references.back().components =
+          absl::make_unique<ReferenceComponentNode>(std::move(*component));
+      RETURN_IF_ERROR(restore_tree(local_references.back().components.get()));
+    }
+  }
+  if (next_reference != header.num_references) {
+    return MalformedError("unreferenced references");
+  }
+
+  // Link declared and parent types.
+  for (uint32_t i = 0; i < header.num_symbols; ++i) {
+    const SymbolRecord& record = view.symbols[i];
+    if (!ValidIndex(record.declared_type, header.num_references) ||
+        !ValidIndex(record.parent_type, header.num_references)) {
+      return MalformedError(absl::StrCat("symbol ", i));
+    }
+    SymbolInfo& info = symbols[i]->Value();
+    if (record.declared_type != kNone) {
+      info.declared_type.user_defined_type = references[record.declared_type];
+    }
+    if (record.parent_type != kNone) {
+      info.parent_type.user_defined_type = references[record.parent_type];
+    }
+  }
+
+  for (uint32_t i = 0; i < header.num_diagnostics; ++i) {
+    const DiagnosticRecord& record = view.diagnostics[i];
+    constexpr auto kLastCode = absl::StatusCode::kUnauthenticated;
+    if (!view.ValidString(record.message) || record.code == 0 ||
+        record.code > static_cast<uint32_t>(kLastCode)) {
+      return MalformedError(absl::StrCat("diagnostic ", i));
+    }
+    diagnostics_.emplace_back(static_cast<absl::StatusCode>(record.code),
+                              view.String(record.message));
+  }
+  return absl::OkStatus();
+}
+
+absl::string_view SymbolTableSnapshot::Fingerprint() const {
+  return view_->String(view_->header->fingerprint);
+}
+
+std::vector<absl::string_view> SymbolTableSnapshot::Files() const {
+  std::vector<absl::string_view> files;
+  files.reserve(view_->header->num_files);
+  for (uint32_t i = 0; i < view_->header->num_files; ++i) {
+    files.push_back(view_->String(view_->files[i].path));
+  }
+  return files;
+}
+
+std::vector<std::string> SymbolTableSnapshot::StaleFiles() const {
+  std::vector<std::string> stale_files;
+  std::string contents;
+  for (uint32_t i = 0; i < view_->header->num_files; ++i) {
+    const FileRecord& record = view_->files[i];
+    const absl::string_view path = view_->String(record.path);
+    if (!verible::file::GetContents(path, &contents).ok() ||
+        verible::ContentHash(contents) !=
+            view_->String(record.content_hash)) {
+      stale_files.emplace_back(path);
+    }
+  }
+
+  // `included files that would be found elsewhere now, e.g. a new file that
+  // shadows the one found before, or one that was previously missing.
+  std::vector<absl::string_view> include_paths;
+  include_paths.reserve(view_->header->num_include_paths);
+  for (uint32_t i = 0; i < view_->header->num_include_paths; ++i) {
+    include_paths.push_back(view_->String(view_->include_paths[i]));
+  }
+  for (uint32_t i = 0; i < view_->header->num_include_lookups; ++i) {
+    const IncludeLookupRecord& record = view_->include_lookups[i];
+    const absl::string_view resolved = view_->String(record.resolved);
+    std::string found =
+        SearchIncludePaths(include_paths, view_->String(record.referenced));
+    if (found != resolved) {
+      stale_files.push_back(found.empty() ? std::string(resolved)
+                                          : std::move(found));
+    }
+  }
+  return stale_files;
+}
+
+absl::optional<SymbolTableSnapshot::Location> SymbolTableSnapshot::LocateName(
+    absl::string_view name) const {
+  const absl::string_view pool = view_->string_pool;
+  static constexpr std::less<const char*> less;
+  if (less(name.data(), pool.data()) ||
+      less(pool.data() + pool.length(), name.data() + name.length())) {
+    return absl::nullopt;
+  }
+  const uint32_t offset = std::distance(pool.data(), name.data());
+  // Names are stored in the string pool in the same order as their records.
+  const auto locate = [&](const auto* begin, const auto* end,
+                          auto get_name) -> absl::optional<Location> {
+    auto found = std::lower_bound(
+        begin, end, offset, [&](const auto& record, uint32_t value) {
+          return get_name(record).offset < value;
+        });
+    for (; found != end && get_name(*found).offset == offset; ++found) {
+      if (get_name(*found).length != name.length()) continue;
+      if (found->anchor.file == kNone) return absl::nullopt;
+      return Location{
+          .file = view_->String(view_->files[found->anchor.file].path),
+          .offset = found->anchor.offset};
+    }
+    return absl::nullopt;
+  };
+  const Header& header(*view_->header);
+  const auto symbol =
+      locate(view_->symbols, view_->symbols + header.num_symbols,
+             [](const SymbolRecord& record) { return record.name; });
+  if (symbol.has_value()) return symbol;
+  return locate(
+      view_->references, view_->references + header.num_references,
+      [](const ReferenceRecord& record) { return record.identifier; });
+}
+
+}  // namespace verilog
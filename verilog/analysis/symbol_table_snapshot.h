@@ -0,0 +1,147 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_VERILOG_ANALYSIS_SYMBOL_TABLE_SNAPSHOT_H_
+#define VERIBLE_VERILOG_ANALYSIS_SYMBOL_TABLE_SNAPSHOT_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "common/strings/mem_block.h"
+#include "verilog/analysis/symbol_table.h"
+
+namespace verilog {
+
+// SymbolTableSnapshot is a compact, read-only on-disk image of a built (and
+// usually resolved) SymbolTable, so that tools can skip parsing, building and
+// resolving when none of the project's files changed.
+//
+// A snapshot records the symbol tree, all reference trees, the links from
+// references to the symbols they resolved to, declared and parent types, and
+// for every name, the file and byte offset it originates from.  It also
+// records the content hash of every file of the project, and where each
+// `included file was searched for and found (or not), which tells which
+// files changed since (see StaleFiles()), and the diagnostics of building
+// the table.
+//
+// The snapshot file consists of flat arrays of fixed-size records followed
+// by a pool of strings, so opening it only memory-maps the file and validates
+// it before recreating the SymbolTable, whose names then point into the
+// mapped string pool.  Syntax tree pointers (SymbolInfo::syntax_origin) and
+// files (SymbolInfo::file_origin) can not be restored, and are nullptr.
+//
+// Usage:
+//   // after symbol_table.Build() and .Resolve()
+//   SymbolTableSnapshot::Write(symbol_table, diagnostics, fingerprint, path);
+//   ...
+//   auto snapshot = SymbolTableSnapshot::Open(path);
+//   if (snapshot.ok() && (*snapshot)->Fingerprint() == fingerprint &&
+//       (*snapshot)->StaleFiles().empty()) {
+//     (*snapshot)->Table().PrintSymbolReferences(stream);
+//   }
+class SymbolTableSnapshot {
+ public:
+  // Location of a name in the original source files.
+  struct Location {
+    // Resolved path of the file.
+    absl::string_view file;
+    // Byte offset of the name in the file's contents.
+    size_t offset;
+  };
+
+  // Returns the snapshot image of 'table' and 'diagnostics' (from building
+  // and resolving 'table').  'fingerprint' is recorded as is, and should
+  // identify everything besides file contents that went into 'table', such as
+  // the list of files and include paths.
+  static std::string Serialize(const SymbolTable& table,
+                               const std::vector<absl::Status>& diagnostics,
+                               absl::string_view fingerprint);
+
+  // Same as Serialize(), but (atomically) writes the image to file 'path'.
+  static absl::Status Write(const SymbolTable& table,
+                            const std::vector<absl::Status>& diagnostics,
+                            absl::string_view fingerprint,
+                            absl::string_view path);
+
+  // Memory-maps the snapshot file 'path' that was created by Write().
+  static absl::StatusOr<std::unique_ptr<SymbolTableSnapshot>> Open(
+      absl::string_view path);
+
+  // Loads a snapshot image (from Serialize()) from 'image', which is kept
+  // alive by the returned object.  Returns an error if the image is
+  // malformed, or was created by an incompatible version.
+  static absl::StatusOr<std::unique_ptr<SymbolTableSnapshot>> Load(
+      std::unique_ptr<verible::MemBlock> image);
+
+  SymbolTableSnapshot(const SymbolTableSnapshot&) = delete;
+  SymbolTableSnapshot(SymbolTableSnapshot&&) = delete;
+  SymbolTableSnapshot& operator=(const SymbolTableSnapshot&) = delete;
+  SymbolTableSnapshot& operator=(SymbolTableSnapshot&&) = delete;
+
+  ~SymbolTableSnapshot();
+
+  // The 'fingerprint' that was passed to Serialize().
+  absl::string_view Fingerprint() const;
+
+  // Resolved paths of all files that the snapshot was made from.
+  std::vector<absl::string_view> Files() const;
+
+  // Returns the resolved paths of the files whose current contents differ
+  // from those that the snapshot was made from (including files that can no
+  // longer be read), and of `included files that would now be found in a
+  // different include path (or that were not found before, or are not found
+  // now).  Empty means that the snapshot is up-to-date.
+  std::vector<std::string> StaleFiles() const;
+
+  // The recreated symbol table.
+  const SymbolTable& Table() const { return *table_; }
+
+  // The diagnostics that were passed to Serialize().
+  const std::vector<absl::Status>& Diagnostics() const { return diagnostics_; }
+
+  // Returns the source location of 'name', which must be a symbol name
+  // (SymbolTableNode key) or reference identifier of Table().  Returns
+  // nullopt for any other string, and for generated names (like those of
+  // anonymous scopes).
+  absl::optional<Location> LocateName(absl::string_view name) const;
+
+ private:
+  struct Image;  // views of the snapshot's arrays, defined in the .cc file
+
+  explicit SymbolTableSnapshot(std::unique_ptr<verible::MemBlock> image);
+
+  // Validates image_, and recreates table_ and diagnostics_ from it.
+  absl::Status Restore();
+
+  // Owns the memory of all strings in this object.
+  const std::unique_ptr<verible::MemBlock> image_;
+
+  // Views of the arrays in image_.
+  std::unique_ptr<Image> view_;
+
+  // Must be destroyed before image_.
+  std::unique_ptr<SymbolTable> table_;
+
+  std::vector<absl::Status> diagnostics_;
+};
+
+}  // namespace verilog
+
+#endif  // VERIBLE_VERILOG_ANALYSIS_SYMBOL_TABLE_SNAPSHOT_H_
@@ -0,0 +1,323 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/analysis/symbol_table_snapshot.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "common/strings/mem_block.h"
+#include "common/util/file_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "verilog/analysis/symbol_table.h"
+#include "verilog/analysis/verilog_project.h"
+
+namespace verilog {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using verible::StringMemBlock;
+using verible::file::CreateDir;
+using verible::file::JoinPath;
+using verible::file::SetContents;
+using verible::file::testing::ScopedTestFile;
+
+constexpr absl::string_view kFingerprint("test-fingerprint");
+
+std::string PrintReferences(const SymbolTable& symbol_table) {
+  std::ostringstream stream;
+  symbol_table.PrintSymbolReferences(stream);
+  return stream.str();
+}
+
+std::string PrintDefinitions(const SymbolTable& symbol_table) {
+  std::ostringstream stream;
+  symbol_table.PrintSymbolDefinitions(stream);
+  return stream.str();
+}
+
+// Returns 'definitions' (as printed by PrintDefinitions()) the way they print
+// once restored from a snapshot, which keeps neither files nor syntax origins.
+std::string WithoutOrigins(absl::string_view definitions) {
+  std::vector<std::string> lines;
+  for (absl::string_view line : absl::StrSplit(definitions, '\n')) {
+    if (absl::StartsWith(absl::StripLeadingAsciiWhitespace(line), "file: ")) {
+      continue;
+    }
+    const size_t source = line.find("source: \"");
+    const size_t source_end = line.find("\", type ref: ");
+    if (source != absl::string_view::npos &&
+        source_end != absl::string_view::npos) {
+      lines.push_back(absl::StrCat(line.substr(0, source), "source: (unknown)",
+                                   line.substr(source_end + 1)));
+    } else {
+      lines.emplace_back(line);
+    }
+  }
+  return absl::StrJoin(lines, "\n");
+}
+
+// Builds and resolves a symbol table of the files in 'sources_dir'.
+class SnapshotTestProject {
+ public:
+  SnapshotTestProject(absl::string_view sources_dir,
+                      const std::vector<absl::string_view>& file_names)
+      : project_(sources_dir, {/* no include path */}),
+        symbol_table_(&project_) {
+    for (const auto& file_name : file_names) {
+      const auto status_or_file = project_.OpenTranslationUnit(file_name);
+      EXPECT_TRUE(status_or_file.ok()) << status_or_file.status();
+    }
+    symbol_table_.Build(&diagnostics_);
+    symbol_table_.Resolve(&diagnostics_);
+  }
+
+  const SymbolTable& Table() const { return symbol_table_; }
+  const std::vector<absl::Status>& Diagnostics() const { return diagnostics_; }
+
+ private:
+  VerilogProject project_;
+  SymbolTable symbol_table_;
+  std::vector<absl::Status> diagnostics_;
+};
+
+std::unique_ptr<SymbolTableSnapshot> LoadOrDie(absl::string_view image) {
+  auto status_or_snapshot = SymbolTableSnapshot::Load(
+      absl::make_unique<StringMemBlock>(std::string(image)));
+  EXPECT_TRUE(status_or_snapshot.ok()) << status_or_snapshot.status();
+  return std::move(*status_or_snapshot);
+}
+
+TEST(SymbolTableSnapshotTest, EmptyTable) {
+  SymbolTable symbol_table(nullptr);
+  const std::string image =
+      SymbolTableSnapshot::Serialize(symbol_table, {}, kFingerprint);
+  const auto snapshot = LoadOrDie(image);
+  ASSERT_NE(snapshot, nullptr);
+  EXPECT_EQ(snapshot->Fingerprint(), kFingerprint);
+  EXPECT_THAT(snapshot->Files(), IsEmpty());
+  EXPECT_THAT(snapshot->StaleFiles(), IsEmpty());
+  EXPECT_THAT(snapshot->Diagnostics(), IsEmpty());
+  EXPECT_EQ(PrintDefinitions(snapshot->Table()),
+            PrintDefinitions(symbol_table));
+  EXPECT_EQ(snapshot->Table().Project(), nullptr);
+}
+
+TEST(SymbolTableSnapshotTest, RoundTrip) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg(sources_dir,
+                           "package pp;\n"
+                           "  localparam int ww = 8;\n"
+                           "  class base;\n"
+                           "    int mm;\n"
+                           "  endclass\n"
+                           "endpackage\n",
+                           "pp.sv");
+  const ScopedTestFile mod(sources_dir,
+                           "module qq;\n"
+                           "  logic [pp::ww-1:0] data;\n"
+                           "  class derived extends pp::base;\n"
+                           "  endclass\n"
+                           "  derived obj;\n"
+                           "  assign data = obj.mm + zz;\n"  // zz: unresolved
+                           "endmodule\n",
+                           "qq.sv");
+  const SnapshotTestProject project(sources_dir, {"pp.sv", "qq.sv"});
+  ASSERT_FALSE(project.Diagnostics().empty());  // for zz
+
+  const std::string image = SymbolTableSnapshot::Serialize(
+      project.Table(), project.Diagnostics(), kFingerprint);
+  const auto snapshot = LoadOrDie(image);
+  ASSERT_NE(snapshot, nullptr);
+  EXPECT_EQ(snapshot->Fingerprint(), kFingerprint);
+  EXPECT_THAT(snapshot->Files(),
+              ElementsAre(JoinPath(sources_dir, "pp.sv"),
+                          JoinPath(sources_dir, "qq.sv")));
+  EXPECT_THAT(snapshot->StaleFiles(), IsEmpty());
+  EXPECT_EQ(snapshot->Diagnostics(), project.Diagnostics());
+  EXPECT_EQ(PrintDefinitions(snapshot->Table()),
+            WithoutOrigins(PrintDefinitions(project.Table())));
+  EXPECT_EQ(PrintReferences(snapshot->Table()),
+            PrintReferences(project.Table()));
+
+  // Names point into the snapshot, and know where they came from.
+  const SymbolTableNode& root(snapshot->Table().Root());
+  const auto found = root.Find("qq");
+  ASSERT_NE(found, root.end());
+  const auto location = snapshot->LocateName(found->first);
+  ASSERT_TRUE(location.has_value());
+  EXPECT_EQ(location->file, JoinPath(sources_dir, "qq.sv"));
+  EXPECT_EQ(location->offset, 7);  // "module qq"
+  EXPECT_FALSE(snapshot->LocateName("qq").has_value());  // not in snapshot
+
+  // Modifying a file makes it stale.
+  ASSERT_TRUE(
+      SetContents(JoinPath(sources_dir, "pp.sv"), "package pp;\nendpackage\n")
+          .ok());
+  EXPECT_THAT(snapshot->StaleFiles(),
+              ElementsAre(JoinPath(sources_dir, "pp.sv")));
+}
+
+TEST(SymbolTableSnapshotTest, WriteAndOpen) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile mod(sources_dir,
+                           "module mm;\n"
+                           "  wire ww;\n"
+                           "  assign ww = 1'b0;\n"
+                           "endmodule\n",
+                           "mm.sv");
+  const SnapshotTestProject project(sources_dir, {"mm.sv"});
+  EXPECT_THAT(project.Diagnostics(), IsEmpty());
+
+  const std::string path = JoinPath(sources_dir, "symbols.snapshot");
+  ASSERT_TRUE(SymbolTableSnapshot::Write(project.Table(),
+                                         project.Diagnostics(), kFingerprint,
+                                         path)
+                  .ok());
+  const auto status_or_snapshot = SymbolTableSnapshot::Open(path);
+  ASSERT_TRUE(status_or_snapshot.ok()) << status_or_snapshot.status();
+  const SymbolTableSnapshot& snapshot(**status_or_snapshot);
+  EXPECT_EQ(PrintReferences(snapshot.Table()),
+            PrintReferences(project.Table()));
+}
+
+TEST(SymbolTableSnapshotTest, OpenMissingFile) {
+  const auto status_or_snapshot = SymbolTableSnapshot::Open(
+      JoinPath(::testing::TempDir(), "no-such-snapshot"));
+  EXPECT_FALSE(status_or_snapshot.ok());
+}
+
+TEST(SymbolTableSnapshotTest, RejectsMalformedImages) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile mod(sources_dir,
+                           "module mm;\n"
+                           "  wire ww;\n"
+                           "endmodule\n",
+                           "mm.sv");
+  const SnapshotTestProject project(sources_dir, {"mm.sv"});
+  const std::string image = SymbolTableSnapshot::Serialize(
+      project.Table(), project.Diagnostics(), kFingerprint);
+
+  const auto load = [](absl::string_view bytes) {
+    return SymbolTableSnapshot::Load(
+        absl::make_unique<StringMemBlock>(std::string(bytes)));
+  };
+  EXPECT_FALSE(load("").ok());
+  EXPECT_FALSE(load("not a snapshot, but long enough to hold a header").ok());
+  // Every truncation is detected.
+  for (size_t length = 0; length < image.length(); ++length) {
+    EXPECT_FALSE(load(image.substr(0, length)).ok()) << length;
+  }
+  // Wrong version.
+  std::string other_version(image);
+  ++other_version[4];
+  const auto status_or_snapshot = load(other_version);
+  ASSERT_FALSE(status_or_snapshot.ok());
+  EXPECT_EQ(status_or_snapshot.status().code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(SymbolTableSnapshotTest, StaleIncludeLookups) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  const std::string first_dir = JoinPath(sources_dir, "first");
+  const std::string second_dir = JoinPath(sources_dir, "second");
+  for (const auto& dir : {sources_dir, first_dir, second_dir}) {
+    ASSERT_TRUE(CreateDir(dir).ok());
+  }
+  const ScopedTestFile defs(second_dir, "`define DD 1\n", "defs.svh");
+  VerilogProject project(sources_dir, {first_dir, second_dir});
+  EXPECT_TRUE(project.OpenIncludedFile("defs.svh").ok());
+  EXPECT_FALSE(project.OpenIncludedFile("missing.svh").ok());
+  SymbolTable symbol_table(&project);
+  const auto snapshot = LoadOrDie(
+      SymbolTableSnapshot::Serialize(symbol_table, {}, kFingerprint));
+  ASSERT_NE(snapshot, nullptr);
+  EXPECT_THAT(snapshot->StaleFiles(), IsEmpty());
+
+  {  // A file in an earlier include path shadows the one found before.
+    const ScopedTestFile shadow(first_dir, "`define DD 2\n", "defs.svh");
+    EXPECT_THAT(snapshot->StaleFiles(),
+                ElementsAre(JoinPath(first_dir, "defs.svh")));
+  }
+  {  // A previously missing file is found now.
+    const ScopedTestFile found(second_dir, "", "missing.svh");
+    EXPECT_THAT(snapshot->StaleFiles(),
+                ElementsAre(JoinPath(second_dir, "missing.svh")));
+  }
+  EXPECT_THAT(snapshot->StaleFiles(), IsEmpty());
+}
+
+// A table whose root has a reference chain of 'depth' components.
+class ReferenceChainTable : public SymbolTable {
+ public:
+  explicit ReferenceChainTable(int depth);
+};
+
+ReferenceChainTable::ReferenceChainTable(int depth) : SymbolTable(nullptr) {
+  auto& references = MutableRoot().Value().local_references_to_bind;
+  const auto component = [](ReferenceType ref_type) {
+    return ReferenceComponent{.identifier = "xx",
+                              .ref_type = ref_type,
+                              .required_metatype = SymbolMetaType::kUnspecified,
+                              .resolved_symbol = nullptr};
+  };
+  references.emplace_back();
+  references.back().components = absl::make_unique<ReferenceComponentNode>(
+      component(ReferenceType::kUnqualified));
+  ReferenceComponentNode* node = references.back().components.get();
+  for (int i = 1; i < depth; ++i) {
+    node = node->NewChild(component(ReferenceType::kMemberOfTypeOfParent));
+  }
+}
+
+TEST(SymbolTableSnapshotTest, ReferenceTreeDepth) {
+  {
+    const ReferenceChainTable symbol_table(100);
+    const auto snapshot = LoadOrDie(
+        SymbolTableSnapshot::Serialize(symbol_table, {}, kFingerprint));
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(PrintReferences(snapshot->Table()),
+              PrintReferences(symbol_table));
+  }
+  {  // Only malformed images have such deep trees.
+    const ReferenceChainTable symbol_table(2000);
+    const auto status_or_snapshot =
+        SymbolTableSnapshot::Load(absl::make_unique<StringMemBlock>(
+            SymbolTableSnapshot::Serialize(symbol_table, {}, kFingerprint)));
+    ASSERT_FALSE(status_or_snapshot.ok());
+    EXPECT_EQ(status_or_snapshot.status().code(), absl::StatusCode::kDataLoss);
+  }
+}
+
+}  // namespace
+}  // namespace verilog
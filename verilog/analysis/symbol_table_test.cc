@@ -17,12 +17,18 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "common/text/symbol.h"
 #include "common/text/tree_utils.h"
@@ -40,6 +46,7 @@ class SymbolTable::Tester : public SymbolTable {
  public:
   explicit Tester(VerilogProject* project) : SymbolTable(project) {}
 
+  using SymbolTable::LastUpdateVisits;
   using SymbolTable::MutableRoot;
 };
 
@@ -50,6 +57,7 @@ using testing::HasSubstr;
 using verible::file::Basename;
 using verible::file::CreateDir;
 using verible::file::JoinPath;
+using verible::file::SetContents;
 using verible::file::testing::ScopedTestFile;
 
 // An in-memory source file that doesn't require file-system access,
@@ -8357,6 +8365,778 @@ TEST(BuildSymbolTableTest, IncludedTwiceFromDifferentFiles) {
   EXPECT_EMPTY_STATUSES(resolve_diagnostics);
 }
 
+// Mix of self-contained translation units and ones that depend on others.
+static const std::vector<std::pair<absl::string_view, absl::string_view>>
+    kConcurrentBuildTestFiles = {
+        {"a.sv",
+         "module a;\n"
+         "  b b_inst();\n"
+         "endmodule\n"},
+        {"b.sv",
+         "module b;\n"
+         "endmodule\n"},
+        {"c.sv",
+         "class c;\n"
+         "  extern function void f();\n"
+         "endclass\n"},
+        {"c_f.sv",  // out-of-line definition of a class from another file
+         "function void c::f();\n"
+         "endfunction\n"},
+        {"dup.sv",  // duplicate definition
+         "module b;\n"
+         "  wire w;\n"
+         "endmodule\n"},
+        {"err.sv", "module 333;\n"},  // syntax error
+        {"inc.sv", "`include \"inc.svh\"\n"},
+        {"inc.svh",
+         "module i;\n"
+         "  a a_inst();\n"
+         "endmodule\n"},
+        {"s.sv",  // anonymous scope in $root
+         "typedef struct {\n"
+         "  int x;\n"
+         "} s_t;\n"},
+        {"t.sv",  // references that depend on other references' bindings
+         "class base;\n"
+         "  int m;\n"
+         "endclass\n"
+         "class derived extends base;\n"
+         "endclass\n"
+         "typedef derived alias_t;\n"
+         "module t;\n"
+         "  alias_t obj;\n"
+         "  s_t s;\n"
+         "  initial begin\n"
+         "    obj.m = s.x;\n"
+         "  end\n"
+         "endmodule\n"},
+};
+
+// Result of building a project from kConcurrentBuildTestFiles, in printed form.
+struct ConcurrentBuildTestResult {
+  std::vector<std::string> diagnostics;
+  std::string definitions;
+  std::string references;
+};
+
+using SymbolTableFunction =
+    std::function<void(SymbolTable*, std::vector<absl::Status>*)>;
+
+static void SerialResolve(SymbolTable* symbol_table,
+                          std::vector<absl::Status>* diagnostics) {
+  symbol_table->Resolve(diagnostics);
+}
+
+static ConcurrentBuildTestResult BuildProjectForTesting(
+    absl::string_view sources_dir, const SymbolTableFunction& build,
+    const SymbolTableFunction& resolve = SerialResolve,
+    size_t parsed_memory_budget = 0) {
+  VerilogProject project(sources_dir, {std::string(sources_dir)});
+  project.SetParsedMemoryBudget(parsed_memory_budget);
+  for (const auto& file : kConcurrentBuildTestFiles) {
+    if (absl::EndsWith(file.first, ".svh")) continue;  // only included
+    EXPECT_TRUE(project.OpenTranslationUnit(file.first).ok());
+  }
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  build(&symbol_table, &diagnostics);
+  resolve(&symbol_table, &diagnostics);
+
+  ConcurrentBuildTestResult result;
+  for (const auto& status : diagnostics) {
+    result.diagnostics.push_back(status.ToString());
+  }
+  std::ostringstream definitions, references;
+  symbol_table.PrintSymbolDefinitions(definitions);
+  symbol_table.PrintSymbolReferences(references);
+  result.definitions = definitions.str();
+  result.references = references.str();
+  return result;
+}
+
+TEST(BuildSymbolTableTest, BuildConcurrentlySameAsBuild) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  std::vector<ScopedTestFile> files;
+  for (const auto& file : kConcurrentBuildTestFiles) {
+    files.emplace_back(sources_dir, file.second, file.first);
+  }
+
+  const auto expected = BuildProjectForTesting(
+      sources_dir,
+      [](SymbolTable* symbol_table, std::vector<absl::Status>* diagnostics) {
+        symbol_table->Build(diagnostics);
+      });
+  EXPECT_FALSE(expected.diagnostics.empty());
+  for (int jobs : {0, 1, 2, 4}) {
+    const auto result = BuildProjectForTesting(
+        sources_dir, [=](SymbolTable* symbol_table,
+                         std::vector<absl::Status>* diagnostics) {
+          symbol_table->BuildConcurrently(diagnostics, jobs);
+        });
+    EXPECT_EQ(result.diagnostics, expected.diagnostics) << "jobs: " << jobs;
+    EXPECT_EQ(result.definitions, expected.definitions) << "jobs: " << jobs;
+    EXPECT_EQ(result.references, expected.references) << "jobs: " << jobs;
+  }
+}
+
+TEST(BuildSymbolTableTest, BuildWithParsedMemoryBudgetSameAsBuild) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  std::vector<ScopedTestFile> files;
+  for (const auto& file : kConcurrentBuildTestFiles) {
+    files.emplace_back(sources_dir, file.second, file.first);
+  }
+
+  const auto expected = BuildProjectForTesting(
+      sources_dir,
+      [](SymbolTable* symbol_table, std::vector<absl::Status>* diagnostics) {
+        symbol_table->Build(diagnostics);
+      });
+  // Any parsed file exceeds this budget, so files are evicted as soon as
+  // they are unpinned, also between isolated builds and merging them.
+  for (int jobs : {1, 2, 4}) {
+    const auto result = BuildProjectForTesting(
+        sources_dir,
+        [=](SymbolTable* symbol_table, std::vector<absl::Status>* diagnostics) {
+          symbol_table->BuildConcurrently(diagnostics, jobs);
+        },
+        SerialResolve, 1);
+    EXPECT_EQ(result.diagnostics, expected.diagnostics) << "jobs: " << jobs;
+    EXPECT_EQ(result.definitions, expected.definitions) << "jobs: " << jobs;
+    EXPECT_EQ(result.references, expected.references) << "jobs: " << jobs;
+  }
+}
+
+TEST(BuildSymbolTableTest, EvictionResetsSyntaxOrigins) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package pp;\n"
+                                "  typedef int tt;\n"
+                                "  tt vv;\n"
+                                "endpackage\n",
+                                "pp.sv");
+  const ScopedTestFile module_file(sources_dir, "module mm;\nendmodule\n",
+                                   "mm.sv");
+  VerilogProject project(sources_dir, {});
+  for (absl::string_view name : {"pp.sv", "mm.sv"}) {
+    ASSERT_TRUE(project.OpenTranslationUnit(name).ok());
+  }
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.Build(&diagnostics);
+  EXPECT_TRUE(diagnostics.empty());
+
+  const SymbolTableNode& root(symbol_table.Root());
+  MUST_ASSIGN_LOOKUP_SYMBOL(pp, root, "pp");
+  MUST_ASSIGN_LOOKUP_SYMBOL(vv, pp, "vv");
+  MUST_ASSIGN_LOOKUP_SYMBOL(mm, root, "mm");
+  ASSERT_NE(pp_info.syntax_origin, nullptr);
+  ASSERT_NE(vv_info.declared_type.syntax_origin, nullptr);
+  ASSERT_NE(mm_info.syntax_origin, nullptr);
+  std::ostringstream before;
+  symbol_table.PrintSymbolDefinitions(before);
+
+  // Evicts all but the most recently parsed file.
+  ASSERT_TRUE(project.LookupRegisteredFile("mm.sv")->Parse().ok());
+  project.SetParsedMemoryBudget(1);
+  EXPECT_EQ(project.LookupRegisteredFile("pp.sv")->EvictionCount(), 1);
+  EXPECT_EQ(project.LookupRegisteredFile("mm.sv")->EvictionCount(), 0);
+  EXPECT_EQ(pp_info.syntax_origin, nullptr);
+  EXPECT_EQ(vv_info.declared_type.syntax_origin, nullptr);
+  EXPECT_EQ(vv_info.declared_type.syntax_origin_text, "tt");
+  EXPECT_NE(mm_info.syntax_origin, nullptr);
+
+  // Printing does not depend on syntax trees.
+  std::ostringstream after;
+  symbol_table.PrintSymbolDefinitions(after);
+  EXPECT_EQ(after.str(), before.str());
+
+  // Parsing again does not restore the syntax origins.
+  ASSERT_TRUE(project.LookupRegisteredFile("pp.sv")->Parse().ok());
+  EXPECT_EQ(pp_info.syntax_origin, nullptr);
+  EXPECT_EQ(vv_info.declared_type.syntax_origin, nullptr);
+}
+
+TEST(BuildSymbolTableTest, PinnedFilesKeepSyntaxOrigins) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package pp;\n"
+                                "  typedef int tt;\n"
+                                "  tt vv;\n"
+                                "endpackage\n",
+                                "pp.sv");
+  const ScopedTestFile module_file(sources_dir, "module mm;\nendmodule\n",
+                                   "mm.sv");
+  VerilogProject project(sources_dir, {});
+  for (absl::string_view name : {"pp.sv", "mm.sv"}) {
+    ASSERT_TRUE(project.OpenTranslationUnit(name).ok());
+  }
+  const ParsedFilePin pin(project.LookupRegisteredFile("pp.sv"));
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.Build(&diagnostics);
+  EXPECT_TRUE(diagnostics.empty());
+
+  const SymbolTableNode& root(symbol_table.Root());
+  MUST_ASSIGN_LOOKUP_SYMBOL(pp, root, "pp");
+  MUST_ASSIGN_LOOKUP_SYMBOL(vv, pp, "vv");
+  ASSERT_NE(pp_info.syntax_origin, nullptr);
+  ASSERT_NE(vv_info.declared_type.syntax_origin, nullptr);
+
+  ASSERT_TRUE(project.LookupRegisteredFile("mm.sv")->Parse().ok());
+  project.SetParsedMemoryBudget(1);
+  EXPECT_EQ(project.LookupRegisteredFile("pp.sv")->EvictionCount(), 0);
+  EXPECT_NE(pp_info.syntax_origin, nullptr);
+  EXPECT_NE(vv_info.declared_type.syntax_origin, nullptr);
+
+  // Pinned files can be neither reopened nor updated.
+  std::ostringstream before;
+  symbol_table.PrintSymbolDefinitions(before);
+  EXPECT_EQ(project.ReopenFile("pp.sv").status().code(),
+            absl::StatusCode::kFailedPrecondition);
+  EXPECT_EQ(symbol_table.UpdateTranslationUnit("pp.sv", &diagnostics).code(),
+            absl::StatusCode::kFailedPrecondition);
+  EXPECT_TRUE(diagnostics.empty());
+  std::ostringstream after;
+  symbol_table.PrintSymbolDefinitions(after);
+  EXPECT_EQ(after.str(), before.str());
+  EXPECT_NE(pp_info.syntax_origin, nullptr);
+}
+
+TEST(BuildSymbolTableTest, ReopenFileResetsSyntaxOrigins) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package pp;\n"
+                                "  typedef int tt;\n"
+                                "  tt vv;\n"
+                                "endpackage\n",
+                                "pp.sv");
+  const ScopedTestFile module_file(sources_dir, "module mm;\nendmodule\n",
+                                   "mm.sv");
+  VerilogProject project(sources_dir, {});
+  for (absl::string_view name : {"pp.sv", "mm.sv"}) {
+    ASSERT_TRUE(project.OpenTranslationUnit(name).ok());
+  }
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.Build(&diagnostics);
+  symbol_table.Resolve(&diagnostics);
+  EXPECT_TRUE(diagnostics.empty());
+
+  const SymbolTableNode& root(symbol_table.Root());
+  MUST_ASSIGN_LOOKUP_SYMBOL(pp, root, "pp");
+  MUST_ASSIGN_LOOKUP_SYMBOL(vv, pp, "vv");
+  MUST_ASSIGN_LOOKUP_SYMBOL(mm, root, "mm");
+  ASSERT_NE(pp_info.syntax_origin, nullptr);
+  ASSERT_NE(vv_info.declared_type.syntax_origin, nullptr);
+
+  // The symbol table is notified before the old syntax trees are released.
+  ASSERT_TRUE(project.ReopenFile("pp.sv").ok());
+  EXPECT_EQ(project.LookupRegisteredFile("pp.sv")->EvictionCount(), 1);
+  EXPECT_EQ(pp_info.syntax_origin, nullptr);
+  EXPECT_EQ(vv_info.declared_type.syntax_origin, nullptr);
+  EXPECT_NE(mm_info.syntax_origin, nullptr);
+}
+
+TEST(BuildSymbolTableTest, BuildTranslationUnitsConcurrentlySameAsSerial) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  std::vector<ScopedTestFile> files;
+  for (const auto& file : kConcurrentBuildTestFiles) {
+    files.emplace_back(sources_dir, file.second, file.first);
+  }
+  // Reverse order, with a duplicate entry and a file that is not found.
+  const std::vector<std::string> file_names{
+      "s.sv",  "inc.sv", "err.sv", "dup.sv",      "c_f.sv",
+      "c.sv",  "b.sv",   "a.sv",   "missing.sv", "b.sv",
+  };
+
+  const auto expected = BuildProjectForTesting(
+      sources_dir, [&](SymbolTable* symbol_table,
+                       std::vector<absl::Status>* diagnostics) {
+        for (const auto& file_name : file_names) {
+          symbol_table->BuildSingleTranslationUnit(file_name, diagnostics);
+        }
+      });
+  EXPECT_FALSE(expected.diagnostics.empty());
+  for (int jobs : {0, 1, 2, 4}) {
+    const auto result = BuildProjectForTesting(
+        sources_dir, [&](SymbolTable* symbol_table,
+                         std::vector<absl::Status>* diagnostics) {
+          symbol_table->BuildTranslationUnitsConcurrently(file_names,
+                                                          diagnostics, jobs);
+        });
+    EXPECT_EQ(result.diagnostics, expected.diagnostics) << "jobs: " << jobs;
+    EXPECT_EQ(result.definitions, expected.definitions) << "jobs: " << jobs;
+    EXPECT_EQ(result.references, expected.references) << "jobs: " << jobs;
+  }
+}
+
+TEST(ResolveSymbolTableTest, ResolveConcurrentlySameAsResolve) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  std::vector<ScopedTestFile> files;
+  for (const auto& file : kConcurrentBuildTestFiles) {
+    files.emplace_back(sources_dir, file.second, file.first);
+  }
+  const auto build = [](SymbolTable* symbol_table,
+                        std::vector<absl::Status>* diagnostics) {
+    symbol_table->Build(diagnostics);
+  };
+
+  const auto expected = BuildProjectForTesting(sources_dir, build);
+  // Member of an object whose type is an alias of a derived class.
+  EXPECT_THAT(expected.references, HasSubstr("m -> $root::base::m"));
+  for (int jobs : {0, 1, 2, 4}) {
+    const auto result = BuildProjectForTesting(
+        sources_dir, build,
+        [=](SymbolTable* symbol_table, std::vector<absl::Status>* diagnostics) {
+          symbol_table->ResolveConcurrently(diagnostics, jobs);
+        });
+    EXPECT_EQ(result.diagnostics, expected.diagnostics) << "jobs: " << jobs;
+    EXPECT_EQ(result.definitions, expected.definitions) << "jobs: " << jobs;
+    EXPECT_EQ(result.references, expected.references) << "jobs: " << jobs;
+  }
+}
+
+TEST(UpdateSymbolTableTest, UpdateTranslationUnit) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package p;\n"
+                                "  parameter int A = 1;\n"
+                                "endpackage\n"
+                                "class base;\n"
+                                "  int m;\n"
+                                "endclass\n",
+                                "pkg.sv");
+  const ScopedTestFile user_file(sources_dir,
+                                 "module u;\n"
+                                 "  base obj;\n"
+                                 "  int x = p::A;\n"
+                                 "  int y = p::B;\n"
+                                 "  initial begin\n"
+                                 "    obj.m = 1;\n"
+                                 "  end\n"
+                                 "endmodule\n",
+                                 "user.sv");
+  VerilogProject project(sources_dir, {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.BuildSingleTranslationUnit("pkg.sv", &diagnostics);
+  symbol_table.BuildSingleTranslationUnit("user.sv", &diagnostics);
+  EXPECT_EMPTY_STATUSES(diagnostics);
+  symbol_table.Resolve(&diagnostics);
+  ASSERT_EQ(diagnostics.size(), 1);  // p::B
+  {
+    std::ostringstream references;
+    symbol_table.PrintSymbolReferences(references);
+    EXPECT_THAT(references.str(), HasSubstr("A -> $root::p::A"));
+    EXPECT_THAT(references.str(), HasSubstr("m -> $root::base::m"));
+  }
+
+  // Rename both members.
+  ASSERT_TRUE(SetContents(pkg_file.filename(),
+                          "package p;\n"
+                          "  parameter int B = 1;\n"
+                          "endpackage\n"
+                          "class base;\n"
+                          "  int n;\n"
+                          "endclass\n")
+                  .ok());
+  diagnostics.clear();
+  const auto status =
+      symbol_table.UpdateTranslationUnit("pkg.sv", &diagnostics);
+  ASSERT_TRUE(status.ok()) << status;
+  // Only the affected references were re-resolved: p::A and obj.m.
+  EXPECT_EQ(diagnostics.size(), 2);
+  std::ostringstream references;
+  symbol_table.PrintSymbolReferences(references);
+  EXPECT_THAT(references.str(), HasSubstr("A -> <unresolved>"));
+  EXPECT_THAT(references.str(), HasSubstr("B -> $root::p::B"));
+  EXPECT_THAT(references.str(), HasSubstr("m -> <unresolved>"));
+  EXPECT_THAT(references.str(), HasSubstr("obj -> $root::u::obj"));
+
+  // Same result as building the modified project from scratch.
+  VerilogProject fresh_project(sources_dir, {});
+  SymbolTable fresh_symbol_table(&fresh_project);
+  std::vector<absl::Status> fresh_diagnostics;
+  fresh_symbol_table.BuildSingleTranslationUnit("pkg.sv", &fresh_diagnostics);
+  fresh_symbol_table.BuildSingleTranslationUnit("user.sv", &fresh_diagnostics);
+  fresh_symbol_table.Resolve(&fresh_diagnostics);
+  std::ostringstream definitions, fresh_definitions, fresh_references;
+  symbol_table.PrintSymbolDefinitions(definitions);
+  fresh_symbol_table.PrintSymbolDefinitions(fresh_definitions);
+  fresh_symbol_table.PrintSymbolReferences(fresh_references);
+  EXPECT_EQ(definitions.str(), fresh_definitions.str());
+  EXPECT_EQ(references.str(), fresh_references.str());
+}
+
+TEST(UpdateSymbolTableTest, UpdateUnknownTranslationUnit) {
+  VerilogProject project(".", {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  const auto status =
+      symbol_table.UpdateTranslationUnit("never-built.sv", &diagnostics);
+  EXPECT_EQ(status.code(), absl::StatusCode::kNotFound);
+}
+
+TEST(UpdateSymbolTableTest, UpdateEntangledTranslationUnitFails) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile class_file(sources_dir,
+                                  "class c;\n"
+                                  "  extern function void f();\n"
+                                  "endclass\n",
+                                  "c.sv");
+  // Defines symbols inside the scope of a class from another file.
+  const ScopedTestFile function_file(sources_dir,
+                                     "function void c::f();\n"
+                                     "  int local_var;\n"
+                                     "endfunction\n",
+                                     "c_f.sv");
+  VerilogProject project(sources_dir, {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.BuildSingleTranslationUnit("c.sv", &diagnostics);
+  symbol_table.BuildSingleTranslationUnit("c_f.sv", &diagnostics);
+  symbol_table.Resolve(&diagnostics);
+  std::ostringstream before;
+  symbol_table.PrintSymbolDefinitions(before);
+  symbol_table.PrintSymbolReferences(before);
+
+  const auto status = symbol_table.UpdateTranslationUnit("c.sv", &diagnostics);
+  EXPECT_EQ(status.code(), absl::StatusCode::kFailedPrecondition) << status;
+  // Unchanged.
+  std::ostringstream after;
+  symbol_table.PrintSymbolDefinitions(after);
+  symbol_table.PrintSymbolReferences(after);
+  EXPECT_EQ(after.str(), before.str());
+}
+
+TEST(UpdateSymbolTableTest, UpdateWithForeignTypeUserFails) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile class_file(sources_dir, "class c;\nendclass\n", "c.sv");
+  // Declares the class again, giving it a base class from this file.
+  const ScopedTestFile base_file(sources_dir,
+                                 "class b;\n"
+                                 "endclass\n"
+                                 "class c extends b;\n"
+                                 "endclass\n",
+                                 "b.sv");
+  VerilogProject project(sources_dir, {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.BuildSingleTranslationUnit("c.sv", &diagnostics);
+  symbol_table.BuildSingleTranslationUnit("b.sv", &diagnostics);
+  symbol_table.Resolve(&diagnostics);
+  std::ostringstream before;
+  symbol_table.PrintSymbolDefinitions(before);
+  symbol_table.PrintSymbolReferences(before);
+
+  const auto status = symbol_table.UpdateTranslationUnit("b.sv", &diagnostics);
+  EXPECT_EQ(status.code(), absl::StatusCode::kFailedPrecondition) << status;
+  EXPECT_THAT(status.message(), HasSubstr("Type of symbol $root::c"));
+  // Unchanged.
+  std::ostringstream after;
+  symbol_table.PrintSymbolDefinitions(after);
+  symbol_table.PrintSymbolReferences(after);
+  EXPECT_EQ(after.str(), before.str());
+}
+
+TEST(UpdateSymbolTableTest, UpdateDependentTypesSameAsRebuild) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package p;\n"
+                                "  class base;\n"
+                                "    int m;\n"
+                                "  endclass\n"
+                                "  typedef base alias_t;\n"
+                                "endpackage\n",
+                                "pkg.sv");
+  // Depends on pkg.sv through a typedef, a base class, and declared types.
+  const ScopedTestFile user_file(sources_dir,
+                                 "package q;\n"
+                                 "  typedef p::alias_t other_t;\n"
+                                 "  class derived extends p::base;\n"
+                                 "    function int get();\n"
+                                 "      return m;\n"
+                                 "    endfunction\n"
+                                 "  endclass\n"
+                                 "endpackage\n"
+                                 "module u;\n"
+                                 "  q::other_t obj;\n"
+                                 "  q::derived d;\n"
+                                 "  initial begin\n"
+                                 "    obj.m = 1;\n"
+                                 "    d.m = 2;\n"
+                                 "  end\n"
+                                 "endmodule\n",
+                                 "user.sv");
+  const ScopedTestFile unrelated_file(sources_dir,
+                                      "module v;\n"
+                                      "  int m;\n"
+                                      "  initial m = 1;\n"
+                                      "endmodule\n",
+                                      "unrelated.sv");
+  const std::vector<absl::string_view> unit_names{"pkg.sv", "user.sv",
+                                                  "unrelated.sv"};
+  VerilogProject project(sources_dir, {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  for (absl::string_view name : unit_names) {
+    symbol_table.BuildSingleTranslationUnit(name, &diagnostics);
+  }
+  symbol_table.Resolve(&diagnostics);
+  EXPECT_EMPTY_STATUSES(diagnostics);
+
+  // Rename the member, and then restore it.
+  for (absl::string_view member : {"n", "m"}) {
+    ASSERT_TRUE(SetContents(pkg_file.filename(),
+                            absl::StrCat("package p;\n"
+                                         "  class base;\n"
+                                         "    int ",
+                                         member,
+                                         ";\n"
+                                         "  endclass\n"
+                                         "  typedef base alias_t;\n"
+                                         "endpackage\n"))
+                    .ok());
+    diagnostics.clear();
+    const auto status =
+        symbol_table.UpdateTranslationUnit("pkg.sv", &diagnostics);
+    ASSERT_TRUE(status.ok()) << status;
+
+    VerilogProject fresh_project(sources_dir, {});
+    SymbolTable fresh_symbol_table(&fresh_project);
+    std::vector<absl::Status> fresh_diagnostics;
+    for (absl::string_view name : unit_names) {
+      fresh_symbol_table.BuildSingleTranslationUnit(name, &fresh_diagnostics);
+    }
+    fresh_symbol_table.Resolve(&fresh_diagnostics);
+    // Every failed reference depends on the update.
+    EXPECT_EQ(diagnostics.size(), fresh_diagnostics.size()) << member;
+    std::ostringstream definitions, references, fresh_definitions,
+        fresh_references;
+    symbol_table.PrintSymbolDefinitions(definitions);
+    symbol_table.PrintSymbolReferences(references);
+    fresh_symbol_table.PrintSymbolDefinitions(fresh_definitions);
+    fresh_symbol_table.PrintSymbolReferences(fresh_references);
+    EXPECT_EQ(definitions.str(), fresh_definitions.str()) << member;
+    EXPECT_EQ(references.str(), fresh_references.str()) << member;
+  }
+}
+
+// Returns the number of symbols and references that updating a package
+// visits, in a project with 'num_unrelated' other modules.
+static size_t UpdateVisitsWithUnrelatedFiles(absl::string_view test_name,
+                                             int num_unrelated) {
+  const std::string sources_dir = JoinPath(
+      ::testing::TempDir(), absl::StrCat(test_name, "_", num_unrelated));
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  std::vector<ScopedTestFile> files;
+  files.emplace_back(sources_dir,
+                     "package p;\n"
+                     "  parameter int A = 1;\n"
+                     "endpackage\n",
+                     "pkg.sv");
+  files.emplace_back(sources_dir,
+                     "module u;\n"
+                     "  int x = p::A;\n"
+                     "endmodule\n",
+                     "user.sv");
+  std::vector<std::string> unit_names{"pkg.sv", "user.sv"};
+  for (int i = 0; i < num_unrelated; ++i) {
+    const std::string name = absl::StrCat("m", i);
+    files.emplace_back(sources_dir,
+                       absl::StrCat("module ", name, ";\n", "  int v_", name,
+                                    ";\n", "  initial v_", name, " = 1;\n",
+                                    "endmodule\n"),
+                       absl::StrCat(name, ".sv"));
+    unit_names.push_back(absl::StrCat(name, ".sv"));
+  }
+  VerilogProject project(sources_dir, {});
+  SymbolTable::Tester symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  for (const auto& name : unit_names) {
+    symbol_table.BuildSingleTranslationUnit(name, &diagnostics);
+  }
+  symbol_table.Resolve(&diagnostics);
+  EXPECT_EMPTY_STATUSES(diagnostics);
+
+  EXPECT_TRUE(SetContents(files.front().filename(),
+                          "package p;\n"
+                          "  parameter int B = 1;\n"
+                          "endpackage\n")
+                  .ok());
+  const auto status =
+      symbol_table.UpdateTranslationUnit("pkg.sv", &diagnostics);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(diagnostics.size(), 1);  // p::A
+  return symbol_table.LastUpdateVisits();
+}
+
+TEST(UpdateSymbolTableTest, UpdateWorkDoesNotGrowWithUnrelatedFiles) {
+  const size_t small_project_visits =
+      UpdateVisitsWithUnrelatedFiles(__FUNCTION__, 4);
+  const size_t large_project_visits =
+      UpdateVisitsWithUnrelatedFiles(__FUNCTION__, 200);
+  EXPECT_GT(small_project_visits, 0);
+  EXPECT_EQ(large_project_visits, small_project_visits);
+}
+
+TEST(ReverseReferenceIndexTest, FindReferencesTo) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package p;\n"
+                                "  parameter int A = 1;\n"
+                                "endpackage\n",
+                                "pkg.sv");
+  const ScopedTestFile user_file(sources_dir,
+                                 "module u;\n"
+                                 "  int x = p::A;\n"
+                                 "  int y = x + p::A;\n"
+                                 "endmodule\n",
+                                 "user.sv");
+  VerilogProject project(sources_dir, {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.BuildSingleTranslationUnit("pkg.sv", &diagnostics);
+  symbol_table.BuildSingleTranslationUnit("user.sv", &diagnostics);
+  symbol_table.Resolve(&diagnostics);
+  EXPECT_EMPTY_STATUSES(diagnostics);
+
+  const SymbolTableNode& root_symbol(symbol_table.Root());
+  MUST_ASSIGN_LOOKUP_SYMBOL(p, root_symbol, "p");
+  MUST_ASSIGN_LOOKUP_SYMBOL(p_A, p, "A");
+  MUST_ASSIGN_LOOKUP_SYMBOL(u, root_symbol, "u");
+  MUST_ASSIGN_LOOKUP_SYMBOL(u_x, u, "x");
+
+  // Disabled by default.
+  EXPECT_TRUE(symbol_table.FindReferencesTo(p_A).empty());
+
+  // Enabling indexes the existing bindings.
+  symbol_table.EnableReverseReferenceIndex();
+  {
+    const auto& references = symbol_table.FindReferencesTo(p_A);
+    ASSERT_EQ(references.size(), 2);
+    for (const ReferenceComponentNode* reference : references) {
+      EXPECT_EQ(reference->Value().identifier, "A");
+      EXPECT_EQ(reference->Value().resolved_symbol, &p_A);
+      // Qualified by "p".
+      ASSERT_NE(reference->Parent(), nullptr);
+      EXPECT_EQ(reference->Parent()->Value().resolved_symbol, &p);
+    }
+    // In textual order.
+    EXPECT_LT(references[0]->Value().identifier.begin(),
+              references[1]->Value().identifier.begin());
+  }
+  EXPECT_EQ(symbol_table.FindReferencesTo(p).size(), 2);
+  EXPECT_EQ(symbol_table.FindReferencesTo(u_x).size(), 1);
+  EXPECT_TRUE(symbol_table.FindReferencesTo(u).empty());
+
+  // Updates are reflected in the index.
+  ASSERT_TRUE(SetContents(pkg_file.filename(),
+                          "package p;\n"
+                          "  parameter int B = 1;\n"
+                          "endpackage\n")
+                  .ok());
+  diagnostics.clear();
+  const auto status =
+      symbol_table.UpdateTranslationUnit("pkg.sv", &diagnostics);
+  ASSERT_TRUE(status.ok()) << status;
+  MUST_ASSIGN_LOOKUP_SYMBOL(new_p, root_symbol, "p");
+  EXPECT_EQ(symbol_table.FindReferencesTo(new_p).size(), 2);
+  EXPECT_EQ(symbol_table.FindReferencesTo(u_x).size(), 1);
+
+  // Disabling discards the index.
+  symbol_table.EnableReverseReferenceIndex(false);
+  EXPECT_TRUE(symbol_table.FindReferencesTo(new_p).empty());
+}
+
+// Returns the reverse reference index of every symbol, ignoring order.
+static std::map<const SymbolTableNode*, std::set<const ReferenceComponentNode*>>
+ReverseReferenceSets(const SymbolTable& symbol_table) {
+  std::map<const SymbolTableNode*, std::set<const ReferenceComponentNode*>>
+      result;
+  symbol_table.Root().ApplyPreOrder([&](const SymbolTableNode& node) {
+    const auto& references = symbol_table.FindReferencesTo(node);
+    if (references.empty()) return;
+    result[&node].insert(references.begin(), references.end());
+  });
+  return result;
+}
+
+TEST(ReverseReferenceIndexTest, UpdateSameAsRebuild) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  ASSERT_TRUE(CreateDir(sources_dir).ok());
+  const ScopedTestFile pkg_file(sources_dir,
+                                "package p;\n"
+                                "  parameter int A = 1;\n"
+                                "  parameter int B = A;\n"
+                                "endpackage\n",
+                                "pkg.sv");
+  const ScopedTestFile user_file(sources_dir,
+                                 "module u;\n"
+                                 "  int x = p::A;\n"
+                                 "  int y = x + p::B;\n"
+                                 "endmodule\n",
+                                 "user.sv");
+  const ScopedTestFile other_file(sources_dir,
+                                  "module v;\n"
+                                  "  u u_inst();\n"
+                                  "  int z = p::A;\n"
+                                  "endmodule\n",
+                                  "other.sv");
+  VerilogProject project(sources_dir, {});
+  SymbolTable symbol_table(&project);
+  std::vector<absl::Status> diagnostics;
+  symbol_table.BuildSingleTranslationUnit("pkg.sv", &diagnostics);
+  symbol_table.BuildSingleTranslationUnit("user.sv", &diagnostics);
+  symbol_table.BuildSingleTranslationUnit("other.sv", &diagnostics);
+  symbol_table.Resolve(&diagnostics);
+  EXPECT_EMPTY_STATUSES(diagnostics);
+  symbol_table.EnableReverseReferenceIndex();
+
+  // Replaces symbols that other files refer to, and their references.
+  ASSERT_TRUE(SetContents(user_file.filename(),
+                          "module u;\n"
+                          "  int w = p::B;\n"
+                          "  int x = w + p::A;\n"
+                          "endmodule\n")
+                  .ok());
+  diagnostics.clear();
+  const auto status =
+      symbol_table.UpdateTranslationUnit("user.sv", &diagnostics);
+  ASSERT_TRUE(status.ok()) << status;
+  const auto updated = ReverseReferenceSets(symbol_table);
+  EXPECT_FALSE(updated.empty());
+
+  symbol_table.EnableReverseReferenceIndex(false);
+  symbol_table.EnableReverseReferenceIndex();
+  EXPECT_EQ(updated, ReverseReferenceSets(symbol_table));
+}
+
 struct FileListTestCase {
   absl::string_view contents;
   std::vector<absl::string_view> expected_files;
@@ -32,6 +32,7 @@
 #include "common/analysis/file_analyzer.h"
 #include "common/lexer/token_stream_adapter.h"
 #include "common/strings/comment_utils.h"
+#include "common/strings/mem_block.h"
 #include "common/text/concrete_syntax_leaf.h"
 #include "common/text/concrete_syntax_tree.h"
 #include "common/text/symbol.h"
@@ -133,8 +134,14 @@ static const absl::string_view FailingTokenKeywordToParsingMode(
 
 std::unique_ptr<VerilogAnalyzer> VerilogAnalyzer::AnalyzeAutomaticMode(
     absl::string_view text, absl::string_view name) {
+  return AnalyzeAutomaticMode(
+      std::make_shared<verible::StringMemBlock>(std::string(text)), name);
+}
+
+std::unique_ptr<VerilogAnalyzer> VerilogAnalyzer::AnalyzeAutomaticMode(
+    std::shared_ptr<verible::MemBlock> content, absl::string_view name) {
   VLOG(2) << __FUNCTION__;
-  auto analyzer = absl::make_unique<VerilogAnalyzer>(text, name);
+  auto analyzer = absl::make_unique<VerilogAnalyzer>(std::move(content), name);
   if (analyzer == nullptr) return analyzer;
   const absl::string_view text_base = analyzer->Data().Contents();
   // If there is any lexical error, stop right away.
@@ -147,7 +154,7 @@ std::unique_ptr<VerilogAnalyzer> VerilogAnalyzer::AnalyzeAutomaticMode(
     // Slightly inefficient to lex text all over again, but this is
     // acceptable for an exceptional code path.
     VLOG(1) << "Analyzing using parse mode directive: " << parse_mode;
-    auto mode_analyzer = AnalyzeVerilogWithMode(text, name, parse_mode);
+    auto mode_analyzer = AnalyzeVerilogWithMode(text_base, name, parse_mode);
     if (mode_analyzer != nullptr) return mode_analyzer;
     // Silently ignore any unknown parsing modes.
   }
@@ -169,7 +176,7 @@ std::unique_ptr<VerilogAnalyzer> VerilogAnalyzer::AnalyzeAutomaticMode(
       VLOG(1) << "Retrying parsing in mode: \"" << retry_parse_mode << "\".";
       if (!retry_parse_mode.empty()) {
         auto retry_analyzer =
-            AnalyzeVerilogWithMode(text, name, retry_parse_mode);
+            AnalyzeVerilogWithMode(text_base, name, retry_parse_mode);
         const absl::string_view retry_text_base =
             retry_analyzer->Data().Contents();
         VLOG(1) << "Retrying to parse:\n" << retry_text_base;
@@ -226,10 +233,9 @@ absl::Status VerilogAnalyzer::Analyze() {
   ContextualizeTokens();
 
   // pseudo-preprocess token stream.
-  // TODO(fangism): preprocessor_.Configure();
-  //   Not all analyses will want to preprocess.
+  // Not all analyses will want to preprocess.
   {
-    VerilogPreprocess preprocessor;
+    VerilogPreprocess preprocessor(preprocess_config_);
     preprocessor_data_ = preprocessor.ScanStream(Data().GetTokenStreamView());
     if (!preprocessor_data_.errors.empty()) {
       for (const auto& error : preprocessor_data_.errors) {
@@ -23,6 +23,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "common/analysis/file_analyzer.h"
+#include "common/strings/mem_block.h"
 #include "common/text/token_stream_view.h"
 #include "verilog/preprocessor/verilog_preprocess.h"
 
@@ -34,6 +35,12 @@ class VerilogAnalyzer : public verible::FileAnalyzer {
   VerilogAnalyzer(absl::string_view text, absl::string_view name)
       : verible::FileAnalyzer(text, name), max_used_stack_size_(0) {}
 
+  // Takes shared ownership of 'text' instead of copying it.
+  VerilogAnalyzer(std::shared_ptr<verible::MemBlock> text,
+                  absl::string_view name)
+      : verible::FileAnalyzer(std::move(text), name),
+        max_used_stack_size_(0) {}
+
   // Lex-es the input text into tokens.
   absl::Status Tokenize() override;
 
@@ -57,6 +64,21 @@ class VerilogAnalyzer : public verible::FileAnalyzer {
   static std::unique_ptr<VerilogAnalyzer> AnalyzeAutomaticMode(
       absl::string_view text, absl::string_view name);
 
+  // Same as above, but the analyzer shares ownership of 'text', which is
+  // not copied.
+  static std::unique_ptr<VerilogAnalyzer> AnalyzeAutomaticMode(
+      std::shared_ptr<verible::MemBlock> text, absl::string_view name);
+
+  // Configures the preprocessing done by Analyze().  By default, all
+  // conditional branches are kept.
+  void SetPreprocessConfig(const VerilogPreprocess::Config& config) {
+    preprocess_config_ = config;
+  }
+
+  const VerilogPreprocess::Config& PreprocessConfig() const {
+    return preprocess_config_;
+  }
+
   const VerilogPreprocessData& PreprocessorData() const {
     return preprocessor_data_;
   }
@@ -93,7 +115,8 @@ class VerilogAnalyzer : public verible::FileAnalyzer {
   // Maximum symbol stack depth.
   size_t max_used_stack_size_;
 
-  // Preprocessor.
+  // Preprocessor configuration and results.
+  VerilogPreprocess::Config preprocess_config_;
   VerilogPreprocessData preprocessor_data_;
 
   // Status of lexing.
@@ -21,8 +21,11 @@
 #include <cstddef>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "common/lexer/token_stream_adapter.h"
 #include "common/text/token_info.h"
@@ -246,6 +249,175 @@ DiffStatus FormatEquivalent(absl::string_view left, absl::string_view right,
       errstream);
 }
 
+namespace {
+// Lexes text on demand, yielding only non-whitespace tokens.
+class NonWhitespaceTokenStream {
+ public:
+  explicit NonWhitespaceTokenStream(absl::string_view text) : lexer_(text) {}
+
+  // Lexes up to the next non-whitespace token, which is EOF at the end of text.
+  // Returns false on lexical error, in which case 'token' is the error token.
+  bool Next(TokenInfo* token) {
+    do {
+      *token = lexer_.DoNextToken();
+      if (lexer_.TokenIsError(*token)) return false;
+    } while (IsWhitespace(verilog_tokentype(token->token_enum())));
+    return true;
+  }
+
+ private:
+  VerilogLexer lexer_;
+};
+}  // namespace
+
+DiffStatus StreamingFormatEquivalent(absl::string_view left,
+                                     absl::string_view right,
+                                     std::ostream* errstream) {
+  VLOG(2) << __FUNCTION__;
+  NonWhitespaceTokenStream left_stream(left);
+  NonWhitespaceTokenStream right_stream(right);
+  TokenInfo left_token = TokenInfo::EOFToken();
+  TokenInfo right_token = TokenInfo::EOFToken();
+  for (size_t index = 0;; ++index) {
+    if (!left_stream.Next(&left_token)) {
+      if (errstream != nullptr) {
+        *errstream << "Lexical error from left input text: " << left_token
+                   << std::endl;
+      }
+      return DiffStatus::kLeftError;
+    }
+    if (!right_stream.Next(&right_token)) {
+      if (errstream != nullptr) {
+        *errstream << "Lexical error from right input text: " << right_token
+                   << std::endl;
+      }
+      return DiffStatus::kRightError;
+    }
+    if (left_token.token_enum() == right_token.token_enum() &&
+        IsUnlexed(verilog_tokentype(left_token.token_enum()))) {
+      // Recursively lex and compare, e.g. macro definition bodies.
+      const DiffStatus status = StreamingFormatEquivalent(
+          left_token.text(), right_token.text(), errstream);
+      if (status != DiffStatus::kEquivalent) return status;
+    } else if (!left_token.EquivalentWithoutLocation(right_token)) {
+      if (errstream != nullptr) {
+        *errstream << "First mismatched token [" << index << "]: ";
+        VerilogTokenPrinter(left_token, *errstream);
+        *errstream << " vs. ";
+        VerilogTokenPrinter(right_token, *errstream);
+        *errstream << std::endl;
+      }
+      return DiffStatus::kDifferent;
+    }
+    if (left_token.isEOF()) return DiffStatus::kEquivalent;
+  }
+}
+
+namespace {
+// Yields the non-whitespace tokens of a token sequence, or of lexed text, in
+// which unlexed tokens can be expanded into their own lexed tokens.
+class ExpandableTokenStream {
+ public:
+  explicit ExpandableTokenStream(const TokenSequence& tokens)
+      : next_token_(tokens.begin()), end_token_(tokens.end()) {}
+
+  explicit ExpandableTokenStream(absl::string_view text) : base_lexers_(1) {
+    lexers_.push_back(absl::make_unique<VerilogLexer>(text));
+  }
+
+  // Yields the next non-whitespace token, which is EOF at the end of input.
+  // Returns false on lexical error, in which case 'token' is the error token.
+  bool Next(TokenInfo* token) {
+    for (;;) {
+      if (lexers_.empty()) {
+        *token = next_token_ == end_token_ ? TokenInfo::EOFToken()
+                                           : *next_token_++;
+      } else {
+        VerilogLexer& lexer(*lexers_.back());
+        *token = lexer.DoNextToken();
+        if (lexer.TokenIsError(*token)) return false;
+        if (token->isEOF() && lexers_.size() > base_lexers_) {
+          // Resume after the expanded token.
+          lexers_.pop_back();
+          continue;
+        }
+      }
+      if (!IsWhitespace(verilog_tokentype(token->token_enum()))) return true;
+    }
+  }
+
+  // Continues with the tokens lexed from 'token's text, before the rest.
+  void Expand(const TokenInfo& token) {
+    lexers_.push_back(absl::make_unique<VerilogLexer>(token.text()));
+  }
+
+ private:
+  TokenSequence::const_iterator next_token_;
+  TokenSequence::const_iterator end_token_;
+
+  // Stack of lexers of expanded tokens, innermost last, preceded by the
+  // lexer of the whole text, if there is one.
+  std::vector<std::unique_ptr<VerilogLexer>> lexers_;
+  size_t base_lexers_ = 0;
+};
+}  // namespace
+
+DiffStatus FormatEquivalentToTokens(const TokenSequence& left_tokens,
+                                    absl::string_view right,
+                                    std::ostream* errstream) {
+  VLOG(2) << __FUNCTION__;
+  ExpandableTokenStream left_stream(left_tokens);
+  ExpandableTokenStream right_stream(right);
+  TokenInfo left_token = TokenInfo::EOFToken();
+  TokenInfo right_token = TokenInfo::EOFToken();
+  const auto next_left = [&]() {
+    if (left_stream.Next(&left_token)) return true;
+    if (errstream != nullptr) {
+      *errstream << "Lexical error from left input text: " << left_token
+                 << std::endl;
+    }
+    return false;
+  };
+  const auto next_right = [&]() {
+    if (right_stream.Next(&right_token)) return true;
+    if (errstream != nullptr) {
+      *errstream << "Lexical error from right input text: " << right_token
+                 << std::endl;
+    }
+    return false;
+  };
+  for (size_t index = 0;; ++index) {
+    if (!next_left()) return DiffStatus::kLeftError;
+    if (!next_right()) return DiffStatus::kRightError;
+    while (left_token.text() != right_token.text() ||
+           left_token.isEOF() != right_token.isEOF()) {
+      const bool left_unlexed =
+          IsUnlexed(verilog_tokentype(left_token.token_enum()));
+      const bool right_unlexed =
+          IsUnlexed(verilog_tokentype(right_token.token_enum()));
+      if (!left_unlexed && !right_unlexed) {
+        if (errstream != nullptr) {
+          *errstream << "First mismatched token [" << index << "]: ";
+          VerilogTokenPrinter(left_token, *errstream);
+          *errstream << " vs. ";
+          VerilogTokenPrinter(right_token, *errstream);
+          *errstream << std::endl;
+        }
+        return DiffStatus::kDifferent;
+      }
+      if (left_unlexed) {
+        left_stream.Expand(left_token);
+        if (!next_left()) return DiffStatus::kLeftError;
+      }
+      if (right_unlexed) {
+        right_stream.Expand(right_token);
+        if (!next_right()) return DiffStatus::kRightError;
+      }
+    }
+    if (left_token.isEOF()) return DiffStatus::kEquivalent;
+  }
+}
+
 static bool ObfuscationEquivalentTokens(const TokenInfo& l,
                                         const TokenInfo& r) {
   const auto l_vtoken_enum = verilog_tokentype(l.token_enum());
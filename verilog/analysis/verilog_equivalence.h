@@ -69,6 +69,23 @@ DiffStatus VerilogLexicallyEquivalent(
 DiffStatus FormatEquivalent(absl::string_view left, absl::string_view right,
                             std::ostream* errstream = nullptr);
 
+// Same as FormatEquivalent, but compares tokens as they are lexed, in a single
+// pass over both texts, without storing the token sequences.  Stops at the
+// first difference or lexical error, whichever comes first.
+DiffStatus StreamingFormatEquivalent(absl::string_view left,
+                                     absl::string_view right,
+                                     std::ostream* errstream = nullptr);
+
+// Same as StreamingFormatEquivalent, but 'left_tokens' were already lexed
+// from the left text (e.g. TextStructureView::TokenStream()), so only 'right'
+// is lexed.  Because analysis may re-classify tokens by lexical context, and
+// expand macro call arguments in place, tokens are compared by text, and
+// unlexed tokens (macro arguments and definition bodies) are lexed only where
+// their texts differ.
+DiffStatus FormatEquivalentToTokens(const verible::TokenSequence& left_tokens,
+                                    absl::string_view right,
+                                    std::ostream* errstream = nullptr);
+
 // Similar to FormatEquivalent except that:
 //   1) whitespaces must match
 //   2) identifiers only need to match in length and not string content to be
@@ -16,6 +16,7 @@
 
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 #include "absl/status/status.h"
@@ -23,9 +24,12 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "common/text/token_info.h"
+#include "common/text/token_stream_view.h"
 #include "common/util/logging.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "verilog/parser/verilog_lexer.h"
+#include "verilog/parser/verilog_token_enum.h"
 
 #undef EXPECT_OK
 #define EXPECT_OK(value) EXPECT_TRUE((value).ok())
@@ -340,6 +344,126 @@ TEST(FormatEquivalentTest, LexErrorOnRightInMacroDefinitionBody) {
                                                            << errs.str();
 }
 
+struct StreamingTestCase {
+  absl::string_view left;
+  absl::string_view right;
+  DiffStatus expect;
+};
+
+TEST(StreamingFormatEquivalentTest, Various) {
+  const StreamingTestCase kTestCases[] = {
+      {"", "", DiffStatus::kEquivalent},
+      {"", " \n\t", DiffStatus::kEquivalent},
+      {"1;", "1 ;\n", DiffStatus::kEquivalent},
+      {"1;", "1", DiffStatus::kDifferent},
+      {"1;", "1;;", DiffStatus::kDifferent},
+      {"1;", "2;", DiffStatus::kDifferent},
+      {"a b", "ab", DiffStatus::kDifferent},
+      {"module m;endmodule", "module m;\nendmodule\n",
+       DiffStatus::kEquivalent},
+      {"// comment\nx", "// comment\n  x", DiffStatus::kEquivalent},
+      {"// comment\nx", "//  comment\nx", DiffStatus::kDifferent},
+      {"`define FOO  a+b\n", "`define FOO a + b\n", DiffStatus::kEquivalent},
+      {"`define FOO a+b\n", "`define FOO a-b\n", DiffStatus::kDifferent},
+      {"`foo(a,b)\n", "`foo(a, b)\n", DiffStatus::kEquivalent},
+      {"hello 123badid\n", "hello good_id", DiffStatus::kLeftError},
+      {"`hello(234badid)\n", "`hello(good_id)", DiffStatus::kLeftError},
+      {"`define hello 345badid\n", "`define hello good_id\n",
+       DiffStatus::kLeftError},
+  };
+  for (const auto& test : kTestCases) {
+    ExpectCompareWithErrstream(StreamingFormatEquivalent, test.expect,
+                               test.left, test.right);
+    // Must agree with the non-streaming implementation.
+    EXPECT_EQ(StreamingFormatEquivalent(test.left, test.right),
+              FormatEquivalent(test.left, test.right, &std::cout))
+        << "left:\n"
+        << test.left << "\nright:\n"
+        << test.right;
+  }
+}
+
+TEST(StreamingFormatEquivalentTest, LexErrorMessage) {
+  std::ostringstream errs;
+  ExpectCompareWithErrstream(StreamingFormatEquivalent, DiffStatus::kRightError,
+                             "`define hello good_id\n",
+                             "`define hello 654_bad_id\n", &errs);
+  EXPECT_TRUE(absl::StrContains(errs.str(), "error from right input"))
+      << "full message:\n"
+      << errs.str();
+  EXPECT_TRUE(absl::StrContains(errs.str(), "654_bad_id")) << "full message:\n"
+                                                           << errs.str();
+}
+
+// Lexes 'text' into the token sequence of a TextStructureView.
+static verible::TokenSequence LexTokens(absl::string_view text) {
+  verible::TokenSequence tokens;
+  VerilogLexer lexer(text);
+  for (;;) {
+    const verible::TokenInfo token(lexer.DoNextToken());
+    if (token.isEOF()) break;
+    tokens.push_back(token);
+  }
+  tokens.push_back(verible::TokenInfo::EOFToken(text));
+  return tokens;
+}
+
+TEST(StreamingFormatEquivalentTest, LexedLeftSameAsText) {
+  const StreamingTestCase kTestCases[] = {
+      {"", "", DiffStatus::kEquivalent},
+      {"", " \n\t", DiffStatus::kEquivalent},
+      {"1;", "1 ;\n", DiffStatus::kEquivalent},
+      {"1;", "1", DiffStatus::kDifferent},
+      {"1;", "1;;", DiffStatus::kDifferent},
+      {"1;", "2;", DiffStatus::kDifferent},
+      {"a b", "ab", DiffStatus::kDifferent},
+      {"module m;endmodule", "module m;\nendmodule\n",
+       DiffStatus::kEquivalent},
+      {"// comment\nx", "// comment\n  x", DiffStatus::kEquivalent},
+      {"// comment\nx", "//  comment\nx", DiffStatus::kDifferent},
+      {"`define FOO  a+b\n", "`define FOO a + b\n", DiffStatus::kEquivalent},
+      {"`define FOO a+b\n", "`define FOO a-b\n", DiffStatus::kDifferent},
+      {"`foo(a,b)\n", "`foo(a, b)\n", DiffStatus::kEquivalent},
+      {"`foo(a,b)\n", "`foo(a, c)\n", DiffStatus::kDifferent},
+      {"`define hello good_id\n", "`define hello 345badid\n",
+       DiffStatus::kRightError},
+  };
+  for (const auto& test : kTestCases) {
+    const verible::TokenSequence left_tokens(LexTokens(test.left));
+    std::ostringstream errs;
+    EXPECT_EQ(FormatEquivalentToTokens(left_tokens, test.right, &errs),
+              test.expect)
+        << "left:\n"
+        << test.left << "\nright:\n"
+        << test.right << "\nerrors:\n"
+        << errs.str();
+  }
+}
+
+TEST(StreamingFormatEquivalentTest, LexedLeftAfterAnalysis) {
+  constexpr absl::string_view kText("`foo(a+b);\n");
+  // Analysis may re-classify tokens by context, and expand macro arguments
+  // into their own tokens.
+  verible::TokenSequence left_tokens;
+  for (const auto& token : LexTokens(kText)) {
+    if (verilog_tokentype(token.token_enum()) == verilog_tokentype::MacroArg) {
+      for (const auto& sub_token : LexTokens(token.text())) {
+        if (!sub_token.isEOF()) left_tokens.push_back(sub_token);
+      }
+    } else {
+      left_tokens.push_back(token);
+    }
+    if (token.text() == ";") {
+      left_tokens.back().set_token_enum(
+          verilog_tokentype::SemicolonEndOfAssertionVariableDeclarations);
+    }
+  }
+  EXPECT_EQ(FormatEquivalentToTokens(left_tokens, "`foo(a + b) ;\n"),
+            DiffStatus::kEquivalent);
+  EXPECT_EQ(FormatEquivalentToTokens(left_tokens, "`foo(a - b);\n"),
+            DiffStatus::kDifferent);
+}
+
 struct ObfuscationTestCase {
   absl::string_view before;
   absl::string_view after;
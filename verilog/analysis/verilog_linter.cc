@@ -280,18 +280,16 @@ int LintOneFile(std::ostream* stream, absl::string_view filename,
                 const LinterConfiguration& config,
                 ViolationHandler* violation_handler, bool check_syntax,
                 bool parse_fatal, bool lint_fatal, bool show_context) {
-  std::string content;
-  const absl::Status content_status =
-      verible::file::GetContents(filename, &content);
-  if (!content_status.ok()) {
+  auto content = verible::file::GetContentAsMemBlock(filename);
+  if (!content.ok()) {
     LOG(ERROR) << "Can't read '" << filename
-               << "': " << content_status.message();
+               << "': " << content.status().message();
     return 2;
   }
 
   // Lex and parse the contents of the file.
   const auto analyzer =
-      VerilogAnalyzer::AnalyzeAutomaticMode(content, filename);
+      VerilogAnalyzer::AnalyzeAutomaticMode(std::move(*content), filename);
   if (check_syntax) {
     const auto lex_status = ABSL_DIE_IF_NULL(analyzer)->LexStatus();
     const auto parse_status = analyzer->ParseStatus();
@@ -14,19 +14,32 @@
 
 #include "verilog/analysis/verilog_project.h"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/strip.h"
+#include "common/text/concrete_syntax_leaf.h"
+#include "common/text/concrete_syntax_tree.h"
 #include "common/text/text_structure.h"
+#include "common/text/token_info.h"
+#include "common/text/token_stream_view.h"
 #include "common/util/file_util.h"
 #include "common/util/logging.h"
 #include "verilog/analysis/verilog_analyzer.h"
+#include "verilog/parser/verilog_token_enum.h"
+#include "verilog/preprocessor/verilog_macro_registry.h"
+#include "verilog/preprocessor/verilog_preprocess.h"
 
 namespace verilog {
 
@@ -38,14 +51,14 @@ absl::Status VerilogSourceFile::Open() {
   // Don't re-open.  analyzed_structure_ should be set/written once only.
   if (state_ != State::kInitialized) return status_;
 
-  // Load file contents.
-  std::string content;
-  status_ = verible::file::GetContents(ResolvedPath(), &content);
+  // Load file contents, and hand them to the analyzer without copying.
+  auto content = verible::file::GetContentAsMemBlock(ResolvedPath());
+  status_ = content.status();
   if (!status_.ok()) return status_;
 
-  // TODO(fangism): std::move or memory-map to avoid a short-term copy.
+  contents_ = std::move(*content);
   analyzed_structure_ =
-      absl::make_unique<VerilogAnalyzer>(content, ResolvedPath());
+      absl::make_unique<VerilogAnalyzer>(contents_, ResolvedPath());
   state_ = State::kOpened;
   // status_ is Ok here.
   return status_;
@@ -53,18 +66,58 @@ absl::Status VerilogSourceFile::Open() {
 
 absl::Status VerilogSourceFile::Parse() {
   // Parsed state is cached.
-  if (state_ == State::kParsed) return status_;
+  if (state_ == State::kParsed) {
+    if (project_ != nullptr) project_->TouchParsedFile(this);
+    return status_;
+  }
 
   // Open file and load contents if not already done.
-  status_ = Open();
-  if (!status_.ok()) return status_;
+  if (state_ == State::kInitialized) {
+    status_ = Open();
+    if (!status_.ok()) return status_;
+  }
 
   // Lex, parse, populate underlying TextStructureView.
   status_ = analyzed_structure_->Analyze();
   state_ = State::kParsed;
+  if (project_ != nullptr) project_->TouchParsedFile(this);
   return status_;
 }
 
+void VerilogSourceFile::EvictParsedStructures() {
+  if (state_ != State::kParsed || contents_ == nullptr) return;
+  // A fresh analyzer over the same contents, with the same configuration.
+  auto analyzer = absl::make_unique<VerilogAnalyzer>(contents_, ResolvedPath());
+  analyzer->SetPreprocessConfig(analyzed_structure_->PreprocessConfig());
+  analyzed_structure_ = std::move(analyzer);
+  state_ = State::kOpened;  // status_ of parsing is kept
+  ++eviction_count_;
+}
+
+size_t VerilogSourceFile::EvictionCount() const {
+  if (project_ == nullptr) return eviction_count_;  // never evicted
+  const std::lock_guard<std::mutex> lock(project_->parsed_files_mutex_);
+  return eviction_count_;
+}
+
+bool VerilogSourceFile::IsPinned() const {
+  if (project_ == nullptr) return false;  // pins have no effect
+  const std::lock_guard<std::mutex> lock(project_->parsed_files_mutex_);
+  return pin_count_ > 0;
+}
+
+// Returns a rough estimate of the memory used by the tokens and syntax tree
+// of 'text_structure', excluding its contents.
+static size_t EstimateParsedBytes(const verible::TextStructureView& text) {
+  // Syntax tree tokens are referenced by the token stream view, and are
+  // leaves of the syntax tree, with about one inner node per leaf.
+  return text.TokenStream().size() * sizeof(verible::TokenInfo) +
+         text.GetTokenStreamView().size() *
+             (sizeof(verible::TokenSequence::const_iterator) +
+              sizeof(verible::SyntaxTreeLeaf) +
+              sizeof(verible::SyntaxTreeNode));
+}
+
 const verible::TextStructureView* VerilogSourceFile::GetTextStructure() const {
   if (analyzed_structure_ == nullptr) return nullptr;
   return &analyzed_structure_->Data();
@@ -84,8 +137,10 @@ std::ostream& operator<<(std::ostream& stream,
 }
 
 absl::Status InMemoryVerilogSourceFile::Open() {
+  contents_ = std::make_shared<verible::StringMemBlock>(
+      std::string(contents_for_open_));
   analyzed_structure_ = ABSL_DIE_IF_NULL(
-      absl::make_unique<VerilogAnalyzer>(contents_for_open_, ResolvedPath()));
+      absl::make_unique<VerilogAnalyzer>(contents_, ResolvedPath()));
   state_ = State::kOpened;
   status_ = absl::OkStatus();
   return status_;
@@ -117,13 +172,18 @@ absl::StatusOr<VerilogSourceFile*> VerilogProject::OpenFile(
   CHECK(inserted.second);  // otherwise, would have already returned above
   const auto file_iter = inserted.first;
   VerilogSourceFile& file(*file_iter->second);
+  file.project_ = this;
 
   // Read the file's contents.
   const absl::Status status = file.Open();
   if (!status.ok()) return status;
 
-  const absl::string_view contents(file.GetTextStructure()->Contents());
+  RegisterFileContents(file.GetTextStructure()->Contents(), file_iter);
+  return &file;
+}
 
+void VerilogProject::RegisterFileContents(
+    absl::string_view contents, file_set_type::const_iterator file_iter) {
   // Register the file's contents range in string_view_map_.
   string_view_map_.must_emplace(contents);
 
@@ -132,8 +192,6 @@ absl::StatusOr<VerilogSourceFile*> VerilogProject::OpenFile(
   const auto map_inserted =
       buffer_to_analyzer_map_.emplace(contents.begin(), file_iter);
   CHECK(map_inserted.second);
-
-  return &file;
 }
 
 absl::StatusOr<VerilogSourceFile*> VerilogProject::OpenTranslationUnit(
@@ -174,19 +232,41 @@ absl::StatusOr<VerilogSourceFile*> VerilogProject::OpenIncludedFile(
       return found->second.get();
     }
   }
+  {
+    const auto found = include_aliases_.find(referenced_filename);
+    if (found != include_aliases_.end()) {
+      const auto status = found->second->Status();
+      if (!status.ok()) return status;
+      return found->second;
+    }
+  }
 
   // Locate the file among the base paths.
   for (const auto& include_path : include_paths_) {
     const std::string resolved_filename =
         verible::file::JoinPath(include_path, referenced_filename);
-    if (verible::file::FileExists(resolved_filename).ok()) {
+    if (IncludeDirectoryContains(resolved_filename)) {
       VLOG(2) << "File'" << resolved_filename << "' exists.";
-      return OpenFile(referenced_filename, resolved_filename, Corpus());
+      include_lookups_.emplace(referenced_filename, resolved_filename);
+      // Share a file that was included under a different name.
+      const auto opened = included_files_.find(resolved_filename);
+      if (opened != included_files_.end()) {
+        include_aliases_.emplace(referenced_filename, opened->second);
+        const auto status = opened->second->Status();
+        if (!status.ok()) return status;
+        return opened->second;
+      }
+      const auto status_or_file =
+          OpenFile(referenced_filename, resolved_filename, Corpus());
+      included_files_.emplace(resolved_filename,
+                              LookupRegisteredFile(referenced_filename));
+      return status_or_file;
     }
     VLOG(2) << "Checked for file'" << resolved_filename << "', but not found.";
   }
 
   // Not found in any path.  Cache this status.
+  include_lookups_.emplace(referenced_filename, "");
   const auto inserted = files_.emplace(
       referenced_filename,
       absl::make_unique<VerilogSourceFile>(
@@ -195,22 +275,258 @@ absl::StatusOr<VerilogSourceFile*> VerilogProject::OpenIncludedFile(
   return inserted.first->second->Status();
 }
 
+bool VerilogProject::IncludeDirectoryContains(
+    absl::string_view resolved_filename) {
+  const size_t last_slash = resolved_filename.find_last_of("/\\");
+  const absl::string_view directory =
+      last_slash == absl::string_view::npos
+          ? "."
+          : resolved_filename.substr(0, std::max<size_t>(last_slash, 1));
+  const absl::string_view basename =
+      verible::file::Basename(resolved_filename);
+
+  // List each directory only once.
+  const auto inserted = include_dir_listings_.emplace(
+      std::string(directory), absl::flat_hash_set<std::string>());
+  absl::flat_hash_set<std::string>& listing(inserted.first->second);
+  if (inserted.second) {
+    const auto status_or_dir = verible::file::ListDir(directory);
+    if (status_or_dir.ok()) {
+      for (const std::string& file : status_or_dir->files) {
+        listing.emplace(verible::file::Basename(file));
+      }
+    } else {
+      VLOG(2) << "Cannot list directory '" << directory
+              << "': " << status_or_dir.status();
+    }
+  }
+  return listing.find(basename) != listing.end();
+}
+
 void VerilogProject::AddVirtualFile(absl::string_view referenced_filename,
                                     absl::string_view content) {
   const auto inserted = files_.emplace(
       referenced_filename, absl::make_unique<InMemoryVerilogSourceFile>(
                                referenced_filename, content));
   CHECK(inserted.second);
-  const auto file_iter = inserted.first;
+  inserted.first->second->project_ = this;
+  RegisterFileContents(content, inserted.first);
+}
 
-  // Register the file's contents range in string_view_map_.
-  string_view_map_.must_emplace(content);
+absl::StatusOr<VerilogSourceFile*> VerilogProject::ReopenFile(
+    absl::string_view referenced_filename) {
+  const auto file_iter = files_.find(referenced_filename);
+  if (file_iter == files_.end()) {
+    return absl::NotFoundError(absl::StrCat("File '", referenced_filename,
+                                            "' was never opened."));
+  }
+  VerilogSourceFile& file(*file_iter->second);
+  {
+    const absl::Status status = ReleaseParsedFile(&file);
+    if (!status.ok()) return status;
+  }
 
-  // Map the start of the file's contents to its corresponding owner
-  // VerilogSourceFile.
-  const auto map_inserted =
-      buffer_to_analyzer_map_.emplace(content.begin(), file_iter);
-  CHECK(map_inserted.second);
+  // Forget the previous contents before releasing their memory.
+  const auto* old_text_structure = file.GetTextStructure();
+  if (old_text_structure != nullptr) {
+    const absl::string_view old_contents(old_text_structure->Contents());
+    if (string_view_map_.erase(old_contents)) {
+      buffer_to_analyzer_map_.erase(old_contents.begin());
+    }
+  }
+  // Macro registries of this file, and of the files that include it, share
+  // its definitions.
+  macro_registries_.clear();
+  macro_layers_.clear();
+  macro_cycle_files_.clear();
+  file.analyzed_structure_.reset();
+  file.contents_.reset();
+  file.state_ = VerilogSourceFile::State::kInitialized;
+  file.status_ = absl::OkStatus();
+
+  const absl::Status status = file.Open();
+  if (!status.ok()) return status;
+
+  const auto* text_structure = file.GetTextStructure();
+  if (text_structure != nullptr &&
+      string_view_map_.find(text_structure->Contents()) ==
+          string_view_map_.end()) {
+    RegisterFileContents(text_structure->Contents(), file_iter);
+  }
+  return &file;
+}
+
+// Returns the names of the files that are `included in 'tokens'.
+static std::vector<absl::string_view> IncludedFileNames(
+    const verible::TokenStreamView& tokens) {
+  std::vector<absl::string_view> names;
+  for (auto iter = tokens.begin(); iter != tokens.end(); ++iter) {
+    if ((*iter)->token_enum() != PP_include) continue;
+    const auto next = std::next(iter);
+    if (next == tokens.end() || (*next)->token_enum() != TK_StringLiteral) {
+      continue;  // e.g. `include `MACRO
+    }
+    absl::string_view name = (*next)->text();
+    absl::ConsumePrefix(&name, "\"");
+    absl::ConsumeSuffix(&name, "\"");
+    names.push_back(name);
+  }
+  return names;
+}
+
+absl::StatusOr<LayeredMacroRegistry> VerilogProject::MacroDefinitions(
+    absl::string_view referenced_filename) {
+  VerilogSourceFile* file = LookupRegisteredFile(referenced_filename);
+  if (file == nullptr) {
+    return absl::NotFoundError(absl::StrCat("File '", referenced_filename,
+                                            "' was never opened."));
+  }
+  return CollectMacroDefinitions(file);
+}
+
+LayeredMacroRegistry VerilogProject::CollectMacroDefinitions(
+    VerilogSourceFile* file) {
+  const auto found = macro_registries_.find(file);
+  if (found != macro_registries_.end()) return found->second;
+
+  LayeredMacroRegistry registry;
+  const auto on_stack =
+      std::find(collecting_macros_.begin(), collecting_macros_.end(), file);
+  if (on_stack != collecting_macros_.end()) {
+    // All files from 'file' up to the top of the stack are in a cycle.
+    macro_cycle_files_.insert(on_stack, collecting_macros_.end());
+    return registry;
+  }
+  collecting_macros_.push_back(file);
+
+  // Preprocessing results are available even if parsing fails.
+  const ParsedFilePin pin(file);
+  file->Parse().IgnoreError();
+  const VerilogAnalyzer* analyzer = file->analyzed_structure_.get();
+  if (analyzer != nullptr) {
+    const VerilogPreprocessData& preprocessed(analyzer->PreprocessorData());
+    for (const absl::string_view included_filename :
+         IncludedFileNames(preprocessed.preprocessed_token_stream)) {
+      const auto included_file = OpenIncludedFile(included_filename);
+      // Files that are not found are reported by GetErrorStatuses().
+      if (!included_file.ok() || *included_file == nullptr) continue;
+      registry.AddLayers(CollectMacroDefinitions(*included_file));
+    }
+    // A file's own layer is shared, even when its registry is not cached.
+    auto& layer = macro_layers_[file];
+    if (layer == nullptr) {
+      layer = std::make_shared<const LayeredMacroRegistry::Layer>(
+          preprocessed.macro_definitions);
+    }
+    registry.AddLayer(layer);
+  }
+
+  collecting_macros_.pop_back();
+  // The registry of a file in an `include cycle depends on which file of the
+  // cycle was entered first, so it is collected anew every time.
+  if (macro_cycle_files_.find(file) == macro_cycle_files_.end()) {
+    macro_registries_.emplace(file, registry);
+  }
+  return registry;
+}
+
+ParsedFilePin::ParsedFilePin(const VerilogSourceFile* file) : file_(file) {
+  VerilogProject* project = file_->project_;
+  if (project == nullptr) return;
+  const std::lock_guard<std::mutex> lock(project->parsed_files_mutex_);
+  ++file_->pin_count_;
+}
+
+ParsedFilePin::~ParsedFilePin() {
+  VerilogProject* project = file_->project_;
+  if (project == nullptr) return;
+  const std::lock_guard<std::mutex> lock(project->parsed_files_mutex_);
+  --file_->pin_count_;
+  // Evictions may have been deferred by this pin.
+  project->EvictParsedFilesLocked();
+}
+
+void VerilogProject::SetParsedMemoryBudget(size_t max_bytes) {
+  const std::lock_guard<std::mutex> lock(parsed_files_mutex_);
+  parsed_memory_budget_ = max_bytes;
+  EvictParsedFilesLocked();
+}
+
+size_t VerilogProject::ParsedMemoryUsage() const {
+  const std::lock_guard<std::mutex> lock(parsed_files_mutex_);
+  return parsed_memory_usage_;
+}
+
+void VerilogProject::AddEvictionObserver(
+    ParsedFileEvictionObserver* observer) {
+  const std::lock_guard<std::mutex> lock(parsed_files_mutex_);
+  eviction_observers_.push_back(observer);
+}
+
+void VerilogProject::RemoveEvictionObserver(
+    ParsedFileEvictionObserver* observer) {
+  const std::lock_guard<std::mutex> lock(parsed_files_mutex_);
+  eviction_observers_.erase(std::remove(eviction_observers_.begin(),
+                                        eviction_observers_.end(), observer),
+                            eviction_observers_.end());
+}
+
+void VerilogProject::TouchParsedFile(VerilogSourceFile* file) {
+  const std::lock_guard<std::mutex> lock(parsed_files_mutex_);
+  if (file->parse_tracked_) {
+    // Move to the most recently used end.
+    parsed_files_.splice(parsed_files_.end(), parsed_files_,
+                         file->parsed_position_);
+  } else {
+    file->parsed_bytes_ = EstimateParsedBytes(*file->GetTextStructure());
+    file->parsed_position_ = parsed_files_.insert(parsed_files_.end(), file);
+    file->parse_tracked_ = true;
+    parsed_memory_usage_ += file->parsed_bytes_;
+  }
+  EvictParsedFilesLocked();
+}
+
+absl::Status VerilogProject::ReleaseParsedFile(VerilogSourceFile* file) {
+  const std::lock_guard<std::mutex> lock(parsed_files_mutex_);
+  if (file->pin_count_ > 0) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("File '", file->ReferencedPath(),
+                     "' is pinned, and cannot be reopened."));
+  }
+  if (file->state_ == VerilogSourceFile::State::kParsed) {
+    for (ParsedFileEvictionObserver* observer : eviction_observers_) {
+      observer->OnParsedStructuresEvicted(*file);
+    }
+    ++file->eviction_count_;
+  }
+  if (!file->parse_tracked_) return absl::OkStatus();
+  parsed_files_.erase(file->parsed_position_);
+  parsed_memory_usage_ -= file->parsed_bytes_;
+  file->parse_tracked_ = false;
+  return absl::OkStatus();
+}
+
+void VerilogProject::EvictParsedFilesLocked() {
+  if (parsed_memory_budget_ == 0) return;  // unlimited
+  if (parsed_files_.empty()) return;
+  // The most recently parsed file is kept.
+  const auto last = std::prev(parsed_files_.end());
+  auto iter = parsed_files_.begin();
+  while (parsed_memory_usage_ > parsed_memory_budget_ && iter != last) {
+    VerilogSourceFile* file = *iter;
+    if (file->pin_count_ > 0) {
+      ++iter;
+      continue;
+    }
+    VLOG(2) << "Evicting parsed structures of " << file->ReferencedPath();
+    iter = parsed_files_.erase(iter);
+    parsed_memory_usage_ -= file->parsed_bytes_;
+    file->parse_tracked_ = false;
+    for (ParsedFileEvictionObserver* observer : eviction_observers_) {
+      observer->OnParsedStructuresEvicted(*file);
+    }
+    file->EvictParsedStructures();
+  }
 }
 
 std::vector<absl::Status> VerilogProject::GetErrorStatuses() const {
@@ -15,17 +15,23 @@
 #ifndef VERIBLE_VERILOG_ANALYSIS_VERILOG_PROJECT_H_
 #define VERIBLE_VERILOG_ANALYSIS_VERILOG_PROJECT_H_
 
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "common/strings/mem_block.h"
 #include "common/strings/string_memory_map.h"
 #include "common/text/text_structure.h"
 #include "verilog/analysis/verilog_analyzer.h"
+#include "verilog/preprocessor/verilog_macro_registry.h"
 
 namespace verilog {
 
@@ -60,13 +66,26 @@ class VerilogSourceFile {
   // Attempts to lex and parse the file (without preprocessing).
   // Will Open() if the file is not already opened.
   // Depending on context, not all files are suitable for standalone parsing.
+  // Files whose parsed structures were evicted by their project's memory
+  // budget are parsed again.
   virtual absl::Status Parse();
 
   // After Open(), the underlying text structure contains at least the file's
-  // contents.  After Parse(), it may contain other analyzed structural forms.
+  // contents.  After Parse(), it may contain other analyzed structural forms,
+  // until they are evicted (see VerilogProject::SetParsedMemoryBudget()).
+  // Eviction invalidates the returned pointer, and any pointers into the
+  // token streams and syntax tree.  Hold a ParsedFilePin to prevent it, or
+  // compare EvictionCount() to detect it.
   // Before Open(), this returns nullptr.
   virtual const verible::TextStructureView* GetTextStructure() const;
 
+  // Returns the number of times that this file's parsed structures were
+  // evicted, or discarded by VerilogProject::ReopenFile().
+  size_t EvictionCount() const;
+
+  // Returns true while any ParsedFilePin of this file is alive.
+  bool IsPinned() const;
+
   // Returns the first non-Ok status if there is one, else OkStatus().
   absl::Status Status() const { return status_; }
 
@@ -104,6 +123,7 @@ class VerilogSourceFile {
 
  private:
   friend class VerilogProject;
+  friend class ParsedFilePin;
 
  protected:
   // Tracking state for linear progression of analysis, which allows
@@ -113,6 +133,8 @@ class VerilogSourceFile {
     kInitialized,
 
     // Files have been opened and contents loaded.
+    // Files whose parsed structures were evicted return to this state, but
+    // keep the status of parsing.
     kOpened,
 
     // Parse() as at least attempted.
@@ -140,14 +162,77 @@ class VerilogSourceFile {
   // Holds any diagostics for problems encountered finding/reading this file.
   absl::Status status_;
 
+  // The file's contents, shared with analyzed_structure_, so that they outlive
+  // (and keep their address across) evictions of the parsed structures.
+  std::shared_ptr<verible::MemBlock> contents_;
+
   // Holds the file's string contents in owned memory, along with other forms
   // like token streams and syntax tree.
   std::unique_ptr<VerilogAnalyzer> analyzed_structure_;
+
+ private:
+  // Discards the token streams and syntax tree, but keeps the contents.
+  void EvictParsedStructures();
+
+  // The project that owns this file, or nullptr.
+  VerilogProject* project_ = nullptr;
+
+  // The following members are guarded by project_->parsed_files_mutex_.
+
+  // Estimated memory used by the parsed structures, while they are tracked.
+  size_t parsed_bytes_ = 0;
+
+  // Whether this file is in project_->parsed_files_, at parsed_position_.
+  bool parse_tracked_ = false;
+  std::list<VerilogSourceFile*>::iterator parsed_position_;
+
+  // Number of live ParsedFilePins of this file.  Pinning does not change
+  // the file, so this can be modified through const files.
+  mutable int pin_count_ = 0;
+
+  // See EvictionCount().
+  size_t eviction_count_ = 0;
 };
 
 // Printable representation for debugging.
 std::ostream& operator<<(std::ostream&, const VerilogSourceFile&);
 
+// Keeps the parsed structures (token streams and syntax tree) of a file from
+// being evicted by its project's memory budget, for the lifetime of this
+// object.  Hold one while reading a file's parsed structures when other files
+// may be parsed in the meantime, e.g. while following `includes, or when
+// parsing concurrently, or for as long as pointers into them are kept.
+// Usage:
+//   const ParsedFilePin pin(file);
+//   file->Parse();
+//   ... file->GetTextStructure()->SyntaxTree() ...
+class ParsedFilePin {
+ public:
+  explicit ParsedFilePin(const VerilogSourceFile* file);
+  ~ParsedFilePin();
+
+  ParsedFilePin(const ParsedFilePin&) = delete;
+  ParsedFilePin& operator=(const ParsedFilePin&) = delete;
+
+ private:
+  const VerilogSourceFile* const file_;
+};
+
+// Interface for structures that keep pointers into the parsed structures of
+// files, and need to drop them when those are evicted (see
+// VerilogProject::SetParsedMemoryBudget()).
+class ParsedFileEvictionObserver {
+ public:
+  virtual ~ParsedFileEvictionObserver() = default;
+
+  // Called right before the token streams and syntax tree of 'file' are
+  // destroyed.  This is called on the thread that caused the eviction (by
+  // parsing, unpinning, or lowering the budget), while the project's
+  // bookkeeping of parsed files is locked, so implementations must not parse
+  // or pin files.
+  virtual void OnParsedStructuresEvicted(const VerilogSourceFile& file) = 0;
+};
+
 // An in-memory source file that doesn't require file-system access,
 // nor create temporary files.
 class InMemoryVerilogSourceFile final : public VerilogSourceFile {
@@ -235,6 +320,19 @@ class VerilogProject {
   // Returns the corpus to which this project belongs to.
   absl::string_view Corpus() const { return corpus_; }
 
+  // Returns the directories that are searched for `included files, in order.
+  const std::vector<std::string>& IncludePaths() const {
+    return include_paths_;
+  }
+
+  // Returns the outcomes of searching the include paths for `included files:
+  // the resolved path for each referenced name, or "" if none of the include
+  // paths contained it.  Names that were previously opened directly (e.g. as
+  // translation units) are not searched, and thus not listed.
+  const std::map<std::string, std::string>& IncludeLookups() const {
+    return include_lookups_;
+  }
+
   // Opens a single top-level file, known as a "translation unit".
   // This uses translation_unit_root_ directory to calculate the file's path.
   // If the file was previously opened, that data is returned.
@@ -242,7 +340,12 @@ class VerilogProject {
       absl::string_view referenced_filename);
 
   // Opens a file that was `included.
-  // If the file was previously opened, that data is returned.
+  // If the file was previously opened, that data is returned.  This is also
+  // the case when it was previously opened under a different name that
+  // resolves to the same path, so that every included file is read and parsed
+  // only once, no matter which translation units (or tools) include it.
+  // The include paths are listed once (on first use), and are assumed not to
+  // change while the project is in use.
   absl::StatusOr<VerilogSourceFile*> OpenIncludedFile(
       absl::string_view referenced_filename);
 
@@ -250,6 +353,49 @@ class VerilogProject {
   void AddVirtualFile(absl::string_view referenced_filename,
                       absl::string_view content);
 
+  // Discards the contents and analysis results of a previously registered
+  // file, and opens it again, e.g. after it was modified.
+  // All string_views into the file's previous contents (including those held
+  // by other structures, like SymbolTable) become invalid.
+  // Eviction observers are notified before the parsed structures are
+  // discarded, as if they were evicted.  Pinned files (see ParsedFilePin)
+  // cannot be reopened, and are left unchanged with an error.
+  absl::StatusOr<VerilogSourceFile*> ReopenFile(
+      absl::string_view referenced_filename);
+
+  // Returns the macro definitions that are visible at the end of the
+  // previously opened file 'referenced_filename': those of the files that it
+  // `includes (recursively, in order), overlaid by its own.
+  // Included files are opened and parsed as needed.  The definitions of each
+  // file are collected only once, and are shared (not copied) among all
+  // registries that contain them.
+  // Known limitations: the position of `includes relative to the file's own
+  // `defines is not taken into account, and neither is `undef.
+  absl::StatusOr<LayeredMacroRegistry> MacroDefinitions(
+      absl::string_view referenced_filename);
+
+  // Limits the estimated memory used by the token streams and syntax trees of
+  // parsed files to 'max_bytes' (0 means unlimited, which is the default).
+  // When exceeded, the parsed structures of the least recently parsed files
+  // are evicted, except for pinned ones (see ParsedFilePin) and the most
+  // recently parsed one, and re-parsed when Parse() is called again.
+  // File contents are never evicted, so string_views into them (e.g. symbol
+  // names) remain valid, but pointers into evicted tokens or syntax trees do
+  // not.  Structures that keep such pointers either pin files (e.g.
+  // PointQueryIndex), or reset the pointers when notified of evictions (e.g.
+  // SymbolInfo::syntax_origin, see AddEvictionObserver()).
+  void SetParsedMemoryBudget(size_t max_bytes);
+
+  // Returns the estimated memory used by the parsed structures of all files.
+  size_t ParsedMemoryUsage() const;
+
+  // Registers 'observer' to be notified of every eviction, until it is
+  // removed.  'observer' is not owned.
+  void AddEvictionObserver(ParsedFileEvictionObserver* observer);
+
+  // Stops notifying 'observer'.
+  void RemoveEvictionObserver(ParsedFileEvictionObserver* observer);
+
   // Returns a collection of non-ok diagnostics for the entire project.
   std::vector<absl::Status> GetErrorStatuses() const;
 
@@ -279,6 +425,31 @@ class VerilogProject {
       absl::string_view referenced_filename,
       absl::string_view resolved_filename, absl::string_view corpus);
 
+  // Makes 'contents' (owned by the file at 'file_iter') searchable by
+  // LookupFileOrigin().
+  void RegisterFileContents(absl::string_view contents,
+                            file_set_type::const_iterator file_iter);
+
+  // Returns true if 'resolved_filename' (a path under an include path) is an
+  // existing file, according to the cached listing of its directory.
+  bool IncludeDirectoryContains(absl::string_view resolved_filename);
+
+  // Returns the macro definitions of 'file' (see MacroDefinitions()).
+  LayeredMacroRegistry CollectMacroDefinitions(VerilogSourceFile* file);
+
+  // Records that 'file' was (just) parsed, and evicts other files' parsed
+  // structures as needed to stay within the memory budget.
+  void TouchParsedFile(VerilogSourceFile* file);
+
+  // Stops tracking the parsed structures of 'file', and notifies the eviction
+  // observers before they are discarded.  Returns an error, without changing
+  // anything, if 'file' is pinned.
+  absl::Status ReleaseParsedFile(VerilogSourceFile* file);
+
+  // Evicts least recently parsed files, except the most recent and pinned
+  // ones, while over the memory budget.  Requires parsed_files_mutex_.
+  void EvictParsedFilesLocked();
+
   // Error status factory, when include file is not found.
   absl::Status IncludeFileNotFoundError(
       absl::string_view referenced_filename) const;
@@ -309,6 +480,57 @@ class VerilogProject {
   //   This can come from the .begin() of any entry in string_view_map_.
   std::map<absl::string_view::const_iterator, file_set_type::const_iterator>
       buffer_to_analyzer_map_;
+
+  // Names of the files (not directories) in each directory that was searched
+  // for included files, keyed by directory path.  Directories that could not
+  // be listed are empty.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>
+      include_dir_listings_;
+
+  // Included files, keyed by resolved path.
+  absl::flat_hash_map<std::string, VerilogSourceFile*> included_files_;
+
+  // See IncludeLookups().
+  std::map<std::string, std::string> include_lookups_;
+
+  // Included files that were referenced under other names than the ones they
+  // were opened with, keyed by those other names.
+  absl::flat_hash_map<std::string, VerilogSourceFile*> include_aliases_;
+
+  // Macro definitions of files, including those of the files they `include.
+  absl::flat_hash_map<const VerilogSourceFile*, LayeredMacroRegistry>
+      macro_registries_;
+
+  // Macro definitions of files, excluding those of the files they `include.
+  absl::flat_hash_map<const VerilogSourceFile*,
+                      std::shared_ptr<const LayeredMacroRegistry::Layer>>
+      macro_layers_;
+
+  // Files whose macro definitions are being collected (innermost last), to
+  // stop at `include cycles.
+  std::vector<const VerilogSourceFile*> collecting_macros_;
+
+  // Files that are part of an `include cycle, whose registries are not cached.
+  absl::flat_hash_set<const VerilogSourceFile*> macro_cycle_files_;
+
+  // Guards the parsed files' bookkeeping, because files may be parsed (and
+  // pinned) concurrently.
+  mutable std::mutex parsed_files_mutex_;
+
+  // See SetParsedMemoryBudget().
+  size_t parsed_memory_budget_ = 0;
+
+  // Files with parsed structures, least recently parsed first.
+  std::list<VerilogSourceFile*> parsed_files_;
+
+  // Sum of the parsed_files_' estimated memory.
+  size_t parsed_memory_usage_ = 0;
+
+  // See AddEvictionObserver().
+  std::vector<ParsedFileEvictionObserver*> eviction_observers_;
+
+  friend class ParsedFilePin;
+  friend class VerilogSourceFile;
 };
 
 // Reads in a list of files line-by-line from 'file_list_file'.
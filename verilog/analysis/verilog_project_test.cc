@@ -31,6 +31,7 @@ using verible::TextStructureView;
 using verible::file::Basename;
 using verible::file::CreateDir;
 using verible::file::JoinPath;
+using verible::file::SetContents;
 using verible::file::testing::ScopedTestFile;
 
 class TempDirFile : public ScopedTestFile {
@@ -311,6 +312,36 @@ TEST(VerilogProjectTest, LookupFileOriginTest) {
             verilog_source_file2);
 }
 
+TEST(VerilogProjectTest, ReopenModifiedFile) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, "reopen");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {});
+  EXPECT_FALSE(project.ReopenFile("never-opened.sv").ok());
+
+  const ScopedTestFile tf(sources_dir, "module m;\nendmodule\n");
+  const std::string file_name(Basename(tf.filename()));
+  const auto status_or_file = project.OpenTranslationUnit(file_name);
+  ASSERT_TRUE(status_or_file.ok());
+  VerilogSourceFile* verilog_source_file = *status_or_file;
+  ASSERT_TRUE(verilog_source_file->Parse().ok());
+
+  constexpr absl::string_view new_text("class c;\nendclass\n");
+  ASSERT_TRUE(SetContents(tf.filename(), new_text).ok());
+  const auto status_or_reopened = project.ReopenFile(file_name);
+  ASSERT_TRUE(status_or_reopened.ok());
+  EXPECT_EQ(*status_or_reopened, verilog_source_file);  // same object
+  const TextStructureView& text_structure(
+      *verilog_source_file->GetTextStructure());
+  EXPECT_EQ(text_structure.Contents(), new_text);
+  EXPECT_EQ(project.LookupFileOrigin(text_structure.Contents().substr(6, 2)),
+            verilog_source_file);
+
+  // Re-opened file can be parsed again.
+  EXPECT_TRUE(verilog_source_file->Parse().ok());
+  EXPECT_NE(text_structure.SyntaxTree(), nullptr);
+}
+
 TEST(VerilogProjectTest, LookupFileOriginTestMoreFiles) {
   const auto tempdir = ::testing::TempDir();
   const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
@@ -499,6 +530,350 @@ TEST(VerilogProjectTest, IncludeFileNotFound) {
   EXPECT_EQ(project.GetErrorStatuses().size(), 1);
 }
 
+TEST(VerilogProjectTest, IncludeFileSearchesPathsInOrder) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  const std::string includes_dir1 = JoinPath(sources_dir, "includes1");
+  const std::string includes_dir2 = JoinPath(sources_dir, "includes2");
+  const std::string subdir = JoinPath(includes_dir2, "sub");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  EXPECT_TRUE(CreateDir(includes_dir1).ok());
+  EXPECT_TRUE(CreateDir(includes_dir2).ok());
+  EXPECT_TRUE(CreateDir(subdir).ok());
+  VerilogProject project(sources_dir,
+                         {JoinPath(sources_dir, "missing"), includes_dir1,
+                          includes_dir2});
+
+  const ScopedTestFile both1(includes_dir1, "`define A 1\n", "both.svh");
+  const ScopedTestFile both2(includes_dir2, "`define A 2\n", "both.svh");
+  const ScopedTestFile only2(includes_dir2, "`define B 2\n", "only2.svh");
+  const ScopedTestFile nested(subdir, "`define C 3\n", "nested.svh");
+
+  {  // First match wins.
+    const auto status_or_file = project.OpenIncludedFile("both.svh");
+    ASSERT_TRUE(status_or_file.ok());
+    EXPECT_EQ((*status_or_file)->ResolvedPath(), both1.filename());
+  }
+  {
+    const auto status_or_file = project.OpenIncludedFile("only2.svh");
+    ASSERT_TRUE(status_or_file.ok());
+    EXPECT_EQ((*status_or_file)->ResolvedPath(), only2.filename());
+  }
+  {  // A directory is not an included file.
+    const auto status_or_file = project.OpenIncludedFile("sub");
+    EXPECT_FALSE(status_or_file.ok());
+  }
+  {
+    const auto status_or_file = project.OpenIncludedFile("sub/nested.svh");
+    ASSERT_TRUE(status_or_file.ok());
+    EXPECT_EQ((*status_or_file)->ResolvedPath(), nested.filename());
+  }
+  EXPECT_EQ(project.GetErrorStatuses().size(), 1);
+}
+
+TEST(VerilogProjectTest, IncludeFileUnderDifferentNamesIsShared) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  const std::string includes_dir = JoinPath(sources_dir, "includes");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  EXPECT_TRUE(CreateDir(includes_dir).ok());
+  EXPECT_TRUE(CreateDir(JoinPath(includes_dir, "sub")).ok());
+  VerilogProject project(sources_dir, {includes_dir});
+
+  const ScopedTestFile tf(includes_dir, "`define FOO 1\n", "foo.svh");
+  const auto status_or_file = project.OpenIncludedFile("foo.svh");
+  ASSERT_TRUE(status_or_file.ok());
+  for (absl::string_view alias : {"./foo.svh", "sub/../foo.svh"}) {
+    const auto status_or_alias = project.OpenIncludedFile(alias);
+    ASSERT_TRUE(status_or_alias.ok()) << alias;
+    EXPECT_EQ(*status_or_alias, *status_or_file) << alias;
+    // again
+    const auto status_or_alias2 = project.OpenIncludedFile(alias);
+    ASSERT_TRUE(status_or_alias2.ok()) << alias;
+    EXPECT_EQ(*status_or_alias2, *status_or_file) << alias;
+  }
+  EXPECT_TRUE(project.GetErrorStatuses().empty());
+}
+
+TEST(VerilogProjectTest, MacroDefinitionsOfUnopenedFile) {
+  const auto tempdir = ::testing::TempDir();
+  VerilogProject project(tempdir, {});
+  const auto status_or_macros = project.MacroDefinitions("never-opened.sv");
+  EXPECT_FALSE(status_or_macros.ok());
+}
+
+TEST(VerilogProjectTest, MacroDefinitionsIncludeHeaders) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  const std::string includes_dir = JoinPath(sources_dir, "includes");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  EXPECT_TRUE(CreateDir(includes_dir).ok());
+  VerilogProject project(sources_dir, {includes_dir});
+
+  const ScopedTestFile base(includes_dir,
+                            "`define WIDTH 8\n"
+                            "`define DEPTH 4\n",
+                            "base.svh");
+  const ScopedTestFile derived(includes_dir,
+                               "`include \"base.svh\"\n"
+                               "`define DEPTH 16\n",
+                               "derived.svh");
+  const ScopedTestFile unit1(sources_dir,
+                             "`include \"derived.svh\"\n"
+                             "`define UNIT1\n"
+                             "module unit1;\nendmodule\n",
+                             "unit1.sv");
+  const ScopedTestFile unit2(sources_dir,
+                             "`include \"base.svh\"\n"
+                             "`include \"derived.svh\"\n"
+                             "module unit2;\nendmodule\n",
+                             "unit2.sv");
+  for (absl::string_view unit : {"unit1.sv", "unit2.sv"}) {
+    ASSERT_TRUE(project.OpenTranslationUnit(unit).ok()) << unit;
+  }
+
+  const auto status_or_macros1 = project.MacroDefinitions("unit1.sv");
+  ASSERT_TRUE(status_or_macros1.ok()) << status_or_macros1.status();
+  const LayeredMacroRegistry& macros1(*status_or_macros1);
+  EXPECT_EQ(macros1.Layers().size(), 3);  // base, derived, unit1
+  ASSERT_NE(macros1.Find("WIDTH"), nullptr);
+  EXPECT_EQ(macros1.Find("WIDTH")->DefinitionText().text(), "8");
+  ASSERT_NE(macros1.Find("DEPTH"), nullptr);
+  EXPECT_EQ(macros1.Find("DEPTH")->DefinitionText().text(), "16");
+  EXPECT_NE(macros1.Find("UNIT1"), nullptr);
+
+  const auto status_or_macros2 = project.MacroDefinitions("unit2.sv");
+  ASSERT_TRUE(status_or_macros2.ok()) << status_or_macros2.status();
+  const LayeredMacroRegistry& macros2(*status_or_macros2);
+  EXPECT_EQ(macros2.Layers().size(), 3);  // base, derived, unit2
+  EXPECT_EQ(macros2.Find("UNIT1"), nullptr);
+
+  // The headers' definitions are shared, not copied.
+  EXPECT_EQ(macros1.Find("WIDTH"), macros2.Find("WIDTH"));
+  EXPECT_EQ(macros1.Find("DEPTH"), macros2.Find("DEPTH"));
+  EXPECT_EQ(macros1.Layers()[0], macros2.Layers()[0]);
+  EXPECT_EQ(macros1.Layers()[1], macros2.Layers()[1]);
+
+  // Repeated queries return the same definitions.
+  const auto status_or_again = project.MacroDefinitions("unit1.sv");
+  ASSERT_TRUE(status_or_again.ok());
+  EXPECT_EQ(status_or_again->Layers(), macros1.Layers());
+  EXPECT_TRUE(project.GetErrorStatuses().empty());
+}
+
+TEST(VerilogProjectTest, MacroDefinitionsWithIncludeCycle) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, __FUNCTION__);
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {sources_dir});
+
+  const ScopedTestFile ping(sources_dir,
+                            "`include \"pong.svh\"\n"
+                            "`define PING\n",
+                            "ping.svh");
+  const ScopedTestFile pong(sources_dir,
+                            "`include \"ping.svh\"\n"
+                            "`define PONG\n",
+                            "pong.svh");
+  ASSERT_TRUE(project.OpenIncludedFile("ping.svh").ok());
+  const auto status_or_macros = project.MacroDefinitions("ping.svh");
+  ASSERT_TRUE(status_or_macros.ok());
+  EXPECT_NE(status_or_macros->Find("PING"), nullptr);
+  EXPECT_NE(status_or_macros->Find("PONG"), nullptr);
+
+  // Entering the cycle from the other file yields the same definitions, and
+  // does not depend on which file was entered first.
+  const auto status_or_pong_macros = project.MacroDefinitions("pong.svh");
+  ASSERT_TRUE(status_or_pong_macros.ok());
+  EXPECT_NE(status_or_pong_macros->Find("PING"), nullptr);
+  EXPECT_NE(status_or_pong_macros->Find("PONG"), nullptr);
+  ASSERT_EQ(status_or_pong_macros->Layers().size(), 2);
+  // Each file's own definitions are shared among registries.
+  EXPECT_EQ(status_or_pong_macros->Layers().front(),
+            status_or_macros->Layers().back());
+  EXPECT_EQ(status_or_pong_macros->Layers().back(),
+            status_or_macros->Layers().front());
+}
+
+TEST(VerilogProjectTest, ParsedMemoryBudgetEvictsLeastRecentlyParsed) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, "parsed_memory_budget");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {});
+
+  // Files of the same size, with the same number of tokens.
+  const ScopedTestFile tf1(sources_dir, "module m1;\nendmodule\n");
+  const ScopedTestFile tf2(sources_dir, "module m2;\nendmodule\n");
+  const ScopedTestFile tf3(sources_dir, "module m3;\nendmodule\n");
+  VerilogSourceFile* file1 =
+      *project.OpenTranslationUnit(Basename(tf1.filename()));
+  VerilogSourceFile* file2 =
+      *project.OpenTranslationUnit(Basename(tf2.filename()));
+  VerilogSourceFile* file3 =
+      *project.OpenTranslationUnit(Basename(tf3.filename()));
+  const absl::string_view contents1(file1->GetTextStructure()->Contents());
+
+  ASSERT_TRUE(file1->Parse().ok());
+  const size_t one_file = project.ParsedMemoryUsage();
+  EXPECT_GT(one_file, 0);
+  project.SetParsedMemoryBudget(2 * one_file);
+  ASSERT_TRUE(file2->Parse().ok());
+  ASSERT_TRUE(file3->Parse().ok());
+  EXPECT_EQ(project.ParsedMemoryUsage(), 2 * one_file);
+
+  // Only the least recently parsed file was evicted, but not its contents.
+  const auto parsed = [](const VerilogSourceFile* file) {
+    return !file->GetTextStructure()->TokenStream().empty();
+  };
+  EXPECT_FALSE(parsed(file1));
+  EXPECT_TRUE(parsed(file2));
+  EXPECT_TRUE(parsed(file3));
+  EXPECT_EQ(file1->GetTextStructure()->Contents(), contents1);
+  EXPECT_EQ(file1->GetTextStructure()->Contents().data(), contents1.data());
+  EXPECT_EQ(project.LookupFileOrigin(contents1.substr(7, 2)), file1);
+
+  // Evicted files are parsed again on demand.
+  EXPECT_TRUE(file1->Parse().ok());
+  EXPECT_TRUE(parsed(file1));
+  EXPECT_FALSE(parsed(file2));
+  EXPECT_TRUE(parsed(file3));
+
+  // Re-parsing a parsed file makes it the most recently parsed one.
+  EXPECT_TRUE(file3->Parse().ok());
+  EXPECT_TRUE(file2->Parse().ok());
+  EXPECT_FALSE(parsed(file1));
+  EXPECT_TRUE(parsed(file2));
+  EXPECT_TRUE(parsed(file3));
+
+  // Lowering the budget evicts immediately.
+  project.SetParsedMemoryBudget(one_file);
+  EXPECT_FALSE(parsed(file3));
+  EXPECT_TRUE(parsed(file2));
+  EXPECT_EQ(project.ParsedMemoryUsage(), one_file);
+}
+
+TEST(VerilogProjectTest, ParsedFilePinPreventsEviction) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, "parsed_file_pin");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {});
+
+  const ScopedTestFile tf1(sources_dir, "module m1;\nendmodule\n");
+  const ScopedTestFile tf2(sources_dir, "module m2;\nendmodule\n");
+  VerilogSourceFile* file1 =
+      *project.OpenTranslationUnit(Basename(tf1.filename()));
+  VerilogSourceFile* file2 =
+      *project.OpenTranslationUnit(Basename(tf2.filename()));
+  project.SetParsedMemoryBudget(1);  // Any parsed file exceeds this.
+
+  {
+    const ParsedFilePin pin(file1);
+    ASSERT_TRUE(file1->Parse().ok());
+    const verible::TextStructureView* text_structure =
+        file1->GetTextStructure();
+    ASSERT_TRUE(file2->Parse().ok());
+    // Pinned, and not re-parsed.
+    EXPECT_EQ(file1->GetTextStructure(), text_structure);
+    EXPECT_FALSE(text_structure->TokenStream().empty());
+  }
+  // Evicted when unpinned.
+  EXPECT_TRUE(file1->GetTextStructure()->TokenStream().empty());
+  EXPECT_FALSE(file2->GetTextStructure()->TokenStream().empty());
+}
+
+// Records the files whose parsed structures are evicted, and checks that they
+// are still there when notified.
+class RecordingEvictionObserver final : public ParsedFileEvictionObserver {
+ public:
+  void OnParsedStructuresEvicted(const VerilogSourceFile& file) final {
+    EXPECT_FALSE(file.GetTextStructure()->TokenStream().empty());
+    evicted.push_back(&file);
+  }
+
+  std::vector<const VerilogSourceFile*> evicted;
+};
+
+TEST(VerilogProjectTest, EvictionIsObservable) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, "eviction_observable");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {});
+
+  const ScopedTestFile tf1(sources_dir, "module m1;\nendmodule\n");
+  const ScopedTestFile tf2(sources_dir, "module m2;\nendmodule\n");
+  VerilogSourceFile* file1 =
+      *project.OpenTranslationUnit(Basename(tf1.filename()));
+  VerilogSourceFile* file2 =
+      *project.OpenTranslationUnit(Basename(tf2.filename()));
+  RecordingEvictionObserver observer;
+  project.AddEvictionObserver(&observer);
+  project.SetParsedMemoryBudget(1);  // Any parsed file exceeds this.
+
+  ASSERT_TRUE(file1->Parse().ok());
+  EXPECT_EQ(file1->EvictionCount(), 0);
+  ASSERT_TRUE(file2->Parse().ok());
+  EXPECT_EQ(file1->EvictionCount(), 1);
+  EXPECT_EQ(file2->EvictionCount(), 0);
+  EXPECT_EQ(observer.evicted,
+            std::vector<const VerilogSourceFile*>({file1}));
+
+  ASSERT_TRUE(file1->Parse().ok());
+  EXPECT_EQ(file1->EvictionCount(), 1);
+  EXPECT_EQ(file2->EvictionCount(), 1);
+  EXPECT_EQ(observer.evicted,
+            std::vector<const VerilogSourceFile*>({file1, file2}));
+
+  // Removed observers are no longer notified.
+  project.RemoveEvictionObserver(&observer);
+  ASSERT_TRUE(file2->Parse().ok());
+  EXPECT_EQ(file1->EvictionCount(), 2);
+  EXPECT_EQ(observer.evicted.size(), 2);
+}
+
+TEST(VerilogProjectTest, ReopenFileIsObservableAndRefusedWhilePinned) {
+  const auto tempdir = ::testing::TempDir();
+  const std::string sources_dir = JoinPath(tempdir, "reopen_pinned");
+  EXPECT_TRUE(CreateDir(sources_dir).ok());
+  VerilogProject project(sources_dir, {});
+
+  const ScopedTestFile tf(sources_dir, "module m;\nendmodule\n");
+  const std::string file_name(Basename(tf.filename()));
+  VerilogSourceFile* file = *project.OpenTranslationUnit(file_name);
+  RecordingEvictionObserver observer;
+  project.AddEvictionObserver(&observer);
+  ASSERT_TRUE(file->Parse().ok());
+
+  constexpr absl::string_view new_text("class c;\nendclass\n");
+  ASSERT_TRUE(SetContents(tf.filename(), new_text).ok());
+  {
+    const ParsedFilePin pin(file);
+    EXPECT_TRUE(file->IsPinned());
+    const verible::TextStructureView* text_structure = file->GetTextStructure();
+    const auto status_or_reopened = project.ReopenFile(file_name);
+    EXPECT_EQ(status_or_reopened.status().code(),
+              absl::StatusCode::kFailedPrecondition);
+    // Left unchanged.
+    EXPECT_EQ(file->GetTextStructure(), text_structure);
+    EXPECT_EQ(text_structure->Contents(), "module m;\nendmodule\n");
+    EXPECT_FALSE(text_structure->TokenStream().empty());
+    EXPECT_EQ(file->EvictionCount(), 0);
+    EXPECT_TRUE(observer.evicted.empty());
+  }
+  EXPECT_FALSE(file->IsPinned());
+
+  // Observers are notified before the parsed structures are discarded.
+  ASSERT_TRUE(project.ReopenFile(file_name).ok());
+  EXPECT_EQ(file->EvictionCount(), 1);
+  EXPECT_EQ(observer.evicted, std::vector<const VerilogSourceFile*>({file}));
+  EXPECT_EQ(file->GetTextStructure()->Contents(), new_text);
+
+  // A file that was not parsed since it was reopened has nothing to discard.
+  ASSERT_TRUE(project.ReopenFile(file_name).ok());
+  EXPECT_EQ(file->EvictionCount(), 1);
+  EXPECT_EQ(observer.evicted.size(), 1);
+  project.RemoveEvictionObserver(&observer);
+}
+
 TEST(VerilogProjecTest, AddVirtualFile) {
   const auto tempdir = ::testing::TempDir();
   const std::string sources_dir = JoinPath(tempdir, "srcs");
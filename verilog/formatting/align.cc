@@ -44,6 +44,7 @@ namespace formatter {
 
 using verible::AlignablePartitionGroup;
 using verible::AlignedPartitionClassification;
+using verible::AlignPartitionGroups;
 using verible::AlignmentCellScannerGenerator;
 using verible::AlignmentColumnProperties;
 using verible::AlignmentGroupAction;
@@ -1397,29 +1398,8 @@ void TabularAlignTokenPartitions(TokenPartitionTree* partition_ptr,
   VLOG(1) << "extracting alignment partition groups...";
   const std::vector<AlignablePartitionGroup> alignment_groups(
       alignment_partitioner(subpartitions_range, style));
-  for (const auto& alignment_group : alignment_groups) {
-    const TokenPartitionRange partition_range(alignment_group.Range());
-    if (partition_range.empty()) continue;
-    if (AnyPartitionSubRangeIsDisabled(partition_range, full_text,
-                                       disabled_byte_ranges)) {
-      // Within an aligned group, if the group is partially disabled
-      // due to incremental formatting, then leave the new lines
-      // unformatted rather than falling back to compact-left formatting.
-      // However, allow the first token to be correctly indented.
-      IndentButPreserveOtherSpacing(partition_range, full_text, ftokens);
-      continue;
-
-      // TODO(fangism): instead of disabling the whole range, sub-partition
-      // it one more level, and operate on those ranges, essentially treating
-      // no-format ranges like alignment group boundaries.
-      // Requires IntervalSet::Intersect operation.
-
-      // TODO(b/159824483): attempt to detect and re-use pre-existing alignment
-    }
-
-    // Calculate alignment and possibly apply it depending on alignment policy.
-    alignment_group.Align(full_text, style.column_limit, ftokens);
-  }
+  AlignPartitionGroups(alignment_groups, ftokens, full_text,
+                       disabled_byte_ranges, style.column_limit);
   VLOG(1) << "end of " << __FUNCTION__;
 }
 
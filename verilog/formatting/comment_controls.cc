@@ -15,6 +15,7 @@
 #include "verilog/formatting/comment_controls.h"
 
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "absl/strings/match.h"
@@ -25,7 +26,6 @@
 #include "common/strings/line_column_map.h"
 #include "common/util/logging.h"
 #include "common/util/range.h"
-#include "common/util/spacer.h"
 #include "verilog/parser/verilog_parser.h"
 #include "verilog/parser/verilog_token_classifications.h"
 #include "verilog/parser/verilog_token_enum.h"
@@ -113,6 +113,15 @@ static size_t NewlineCount(absl::string_view s) {
 void FormatWhitespaceWithDisabledByteRanges(
     absl::string_view text_base, absl::string_view space_text,
     const ByteOffsetSet& disabled_ranges, std::ostream& stream) {
+  std::string output;
+  FormatWhitespaceWithDisabledByteRanges(text_base, space_text,
+                                         disabled_ranges, &output);
+  stream << output;
+}
+
+void FormatWhitespaceWithDisabledByteRanges(
+    absl::string_view text_base, absl::string_view space_text,
+    const ByteOffsetSet& disabled_ranges, std::string* output) {
   VLOG(3) << __FUNCTION__;
   CHECK(verible::IsSubRange(space_text, text_base));
   const int start = std::distance(text_base.begin(), space_text.begin());
@@ -126,7 +135,7 @@ void FormatWhitespaceWithDisabledByteRanges(
   // Special case if space_text is empty.
   if (space_text.empty() && start != 0) {
     if (!disabled_ranges.Contains(start)) {
-      stream << '\n';
+      output->push_back('\n');
       return;
     }
   }
@@ -140,7 +149,7 @@ void FormatWhitespaceWithDisabledByteRanges(
       const absl::string_view disabled(
           text_base.substr(next_start, range.first - next_start));
       VLOG(3) << "preserved: \"" << VisualizeWhitespace{disabled} << '"';
-      stream << disabled;
+      output->append(disabled.data(), disabled.size());
       total_enabled_newlines += NewlineCount(disabled);
     }
     {  // for enabled intervals, preserve only newlines
@@ -148,7 +157,7 @@ void FormatWhitespaceWithDisabledByteRanges(
           text_base.substr(range.first, range.second - range.first));
       const size_t newline_count = NewlineCount(enabled);
       VLOG(3) << "formatted: " << newline_count << "*\\n";
-      stream << verible::Spacer(newline_count, '\n');
+      output->append(newline_count, '\n');
       partially_enabled = true;
       total_enabled_newlines += newline_count;
     }
@@ -157,12 +166,12 @@ void FormatWhitespaceWithDisabledByteRanges(
   // If there is a disabled interval left over, print that.
   const absl::string_view final_disabled(
       text_base.substr(next_start, end - next_start));
-  stream << final_disabled;
+  output->append(final_disabled.data(), final_disabled.size());
   total_enabled_newlines += NewlineCount(final_disabled);
 
   // Print at least one newline if some subrange was format-enabled.
   if (partially_enabled && total_enabled_newlines == 0 && start != 0) {
-    stream << '\n';
+    output->push_back('\n');
   }
 }
 
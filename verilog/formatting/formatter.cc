@@ -18,9 +18,14 @@
 #include <cstddef>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <sstream>
 #include <vector>
 
+#include "absl/random/random.h"
 #include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/line_wrap_searcher.h"
 #include "common/formatting/token_partition_tree.h"
@@ -28,6 +33,7 @@
 #include "common/formatting/verification.h"
 #include "common/strings/diff.h"
 #include "common/strings/line_column_map.h"
+#include "common/strings/mem_block.h"
 #include "common/strings/position.h"
 #include "common/strings/range.h"
 #include "common/text/text_structure.h"
@@ -35,7 +41,9 @@
 #include "common/text/tree_utils.h"
 #include "common/util/expandable_tree_view.h"
 #include "common/util/interval.h"
+#include "common/util/interval_set.h"
 #include "common/util/iterator_range.h"
+#include "common/util/enum_flags.h"
 #include "common/util/logging.h"
 #include "common/util/range.h"
 #include "common/util/spacer.h"
@@ -47,6 +55,7 @@
 #include "verilog/formatting/align.h"
 #include "verilog/formatting/comment_controls.h"
 #include "verilog/formatting/format_style.h"
+#include "verilog/formatting/formatter_profile.h"
 #include "verilog/formatting/token_annotator.h"
 #include "verilog/formatting/tree_unwrapper.h"
 #include "verilog/parser/verilog_token_enum.h"
@@ -82,8 +91,20 @@ class Formatter {
 
   void SelectLines(const LineNumberSet& lines);
 
-  // Outputs all of the FormattedExcerpt lines to stream.
-  void Emit(std::ostream& stream) const;
+  // Enables collection of per-phase statistics into 'profile'.
+  void SetProfile(FormatterProfile* profile) { profile_ = profile; }
+
+  // Line-wrap searching that would exceed this time is abandoned, and the
+  // affected partitions preserve their original spacing.
+  void SetDeadline(absl::Time deadline) { deadline_ = deadline; }
+
+  // Byte ranges of partitions that were left unformatted due to the deadline.
+  const ByteOffsetSet& UnformattedRanges() const {
+    return unformatted_ranges_;
+  }
+
+  // Appends all of the FormattedExcerpt lines to 'output'.
+  void Emit(std::string* output) const;
 
  private:
   // Contains structural information about the code to format, such as
@@ -96,6 +117,30 @@ class Formatter {
   // Ranges of text where formatter is disabled (by comment directives).
   ByteOffsetSet disabled_ranges_;
 
+  // If true, only selected lines are enabled for formatting (incremental
+  // mode), and work can be restricted to the partitions that enclose them.
+  bool selected_lines_only_ = false;
+
+  // If set, collects timing and search statistics.  Not owned.
+  FormatterProfile* profile_ = nullptr;
+
+  // Time after which remaining partitions are no longer formatted.
+  absl::Time deadline_ = absl::InfiniteFuture();
+
+  // Ranges of text left unformatted because the deadline was reached.
+  ByteOffsetSet unformatted_ranges_;
+
+  // Returns true if the deadline has been reached.
+  bool DeadlineExceeded() const {
+    return deadline_ != absl::InfiniteFuture() && absl::Now() >= deadline_;
+  }
+
+  // Reverts a partition to its original spacing, including the whitespace
+  // that precedes it, and records it as unformatted.
+  void PreserveOriginalSpacing(
+      const UnwrappedLine& uwline,
+      std::vector<verible::PreFormatToken>* preformatted_tokens);
+
   // Set of formatted lines, populated by calling Format().
   std::vector<verible::FormattedExcerpt> formatted_lines_;
 };
@@ -149,11 +194,52 @@ Status VerifyFormatting(const verible::TextStructureView& text_structure,
   return absl::OkStatus();
 }
 
+// Cheaper alternative to VerifyFormatting(): only lexes the formatted output,
+// and compares it to the tokens of the original text without building a
+// syntax tree.
+static Status VerifyFormattingLexically(
+    const verible::TextStructureView& text_structure,
+    absl::string_view formatted_output) {
+  std::ostringstream errstream;
+  if (verilog::FormatEquivalentToTokens(text_structure.TokenStream(),
+                                        formatted_output, &errstream) !=
+      DiffStatus::kEquivalent) {
+    return absl::DataLossError(absl::StrCat(
+        "Formatted output is lexically different from the input.    "
+        "Please file a bug.  Details:\n",
+        errstream.str()));
+  }
+  return absl::OkStatus();
+}
+
+// Returns true if a file should be verified fully, as per 'control'.
+static bool ShouldVerifyFully(const ExecutionControl& control) {
+  switch (control.verification) {
+    case VerificationMode::kFull:
+      return true;
+    case VerificationMode::kLexical: {
+      thread_local absl::BitGen bitgen;
+      return absl::Bernoulli(bitgen, control.full_verification_rate);
+    }
+    default:
+      return false;
+  }
+}
+
+// Prints the collected profile as JSON to the diagnostic stream.
+static void PrintProfile(const ExecutionControl& control,
+                         absl::string_view filename,
+                         const FormatterProfile& profile) {
+  Json::Value json(profile.ToJson(control.show_formatting_profile));
+  json["filename"] = std::string(filename);
+  control.Stream() << json << std::endl;
+}
+
 static Status ReformatVerilogIncrementally(absl::string_view original_text,
                                            absl::string_view formatted_text,
                                            absl::string_view filename,
                                            const FormatStyle& style,
-                                           std::ostream& reformat_stream,
+                                           std::string* reformatted_text,
                                            const ExecutionControl& control) {
   // Differences from the first formatting.
   const verible::LineDiffs formatting_diffs(original_text, formatted_text);
@@ -166,29 +252,35 @@ static Status ReformatVerilogIncrementally(absl::string_view original_text,
   // re-formatting on the whole file unless line ranges are specified.
   formatted_lines.Add(formatting_diffs.after_lines.size() + 1);
   VLOG(1) << "formatted changed lines: " << formatted_lines;
-  return FormatVerilog(formatted_text, filename, style, reformat_stream,
+  return FormatVerilog(formatted_text, filename, style, reformatted_text,
                        formatted_lines, control);
 }
 
+// Reformatting shares the time budget of the first run, which ends at
+// 'deadline'.
 static Status ReformatVerilog(absl::string_view original_text,
                               absl::string_view formatted_text,
                               absl::string_view filename,
                               const FormatStyle& style,
-                              std::ostream& reformat_stream,
+                              std::string* reformatted_text,
                               const LineNumberSet& lines,
-                              const ExecutionControl& control) {
+                              const ExecutionControl& control,
+                              absl::Time deadline) {
   // Disable reformat check to terminate recursion.
   ExecutionControl convergence_control(control);
   convergence_control.verify_convergence = false;
+  convergence_control.show_formatting_profile = 0;
+  convergence_control.time_budget =
+      std::max(deadline - absl::Now(), absl::ZeroDuration());
 
   if (lines.empty()) {
     // format whole file
-    return FormatVerilog(formatted_text, filename, style, reformat_stream,
+    return FormatVerilog(formatted_text, filename, style, reformatted_text,
                          lines, convergence_control);
   } else {
     // reformat incrementally
     return ReformatVerilogIncrementally(original_text, formatted_text, filename,
-                                        style, reformat_stream,
+                                        style, reformatted_text,
                                         convergence_control);
   }
 }
@@ -196,8 +288,45 @@ static Status ReformatVerilog(absl::string_view original_text,
 Status FormatVerilog(absl::string_view text, absl::string_view filename,
                      const FormatStyle& style, std::ostream& formatted_stream,
                      const LineNumberSet& lines,
-                     const ExecutionControl& control) {
-  const auto analyzer = VerilogAnalyzer::AnalyzeAutomaticMode(text, filename);
+                     const ExecutionControl& control,
+                     LineNumberSet* unformatted_lines) {
+  std::string formatted_text;
+  const Status status = FormatVerilog(text, filename, style, &formatted_text,
+                                      lines, control, unformatted_lines);
+  formatted_stream << formatted_text;
+  return status;
+}
+
+Status FormatVerilog(absl::string_view text, absl::string_view filename,
+                     const FormatStyle& style, std::string* formatted_text,
+                     const LineNumberSet& lines,
+                     const ExecutionControl& control,
+                     LineNumberSet* unformatted_lines) {
+  return FormatVerilog(
+      std::make_shared<verible::StringMemBlock>(std::string(text)), filename,
+      style, formatted_text, lines, control, unformatted_lines);
+}
+
+Status FormatVerilog(std::shared_ptr<verible::MemBlock> content,
+                     absl::string_view filename, const FormatStyle& style,
+                     std::string* formatted_text, const LineNumberSet& lines,
+                     const ExecutionControl& control,
+                     LineNumberSet* unformatted_lines) {
+  // 'content' keeps the text alive, even if the analyzer ends up using a
+  // different (re-parsed) copy of it.
+  const absl::string_view text = ABSL_DIE_IF_NULL(content)->AsStringView();
+  formatted_text->clear();
+  const absl::Time deadline = absl::Now() + control.time_budget;
+  std::unique_ptr<FormatterProfile> profile;
+  if (control.show_formatting_profile > 0) {
+    profile = std::make_unique<FormatterProfile>();
+  }
+  std::unique_ptr<VerilogAnalyzer> analyzer;
+  {
+    FormatterProfile::ScopedPhase phase(profile.get(), "analyze");
+    analyzer = VerilogAnalyzer::AnalyzeAutomaticMode(content, filename);
+    phase.SetItems(ABSL_DIE_IF_NULL(analyzer)->Data().TokenStream().size());
+  }
   {
     // Lex and parse code.  Exit on failure.
     const auto lex_status = ABSL_DIE_IF_NULL(analyzer)->LexStatus();
@@ -218,12 +347,15 @@ Status FormatVerilog(absl::string_view text, absl::string_view filename,
   const verible::TextStructureView& text_structure = analyzer->Data();
   Formatter fmt(text_structure, style);
   fmt.SelectLines(lines);
+  fmt.SetProfile(profile.get());
+  fmt.SetDeadline(deadline);
 
   // Format code.
   const Status format_status = fmt.Format(control);
   if (!format_status.ok()) {
     if (format_status.code() != StatusCode::kResourceExhausted) {
       // Some more fatal error, halt immediately.
+      if (profile) PrintProfile(control, filename, *profile);
       return format_status;
     }
     // Else allow remainder of this function to execute, and print partially
@@ -235,38 +367,63 @@ Status FormatVerilog(absl::string_view text, absl::string_view filename,
     return absl::CancelledError("Halting for diagnostic operation.");
   }
 
-  // Render formatted text to a temporary buffer, so that it can be verified.
-  std::ostringstream output_buffer;
-  fmt.Emit(output_buffer);
-  const std::string& formatted_text(output_buffer.str());
-
-  // Commit verified formatted text to the output stream.
-  formatted_stream << formatted_text;
-
-  return format_status;
-
-  // For now, unconditionally verify.
-  const Status verify_status =
-      VerifyFormatting(text_structure, formatted_text, filename);
-  if (!verify_status.ok()) {
-    return verify_status;
+  // Render formatted text directly into the output buffer, which is also
+  // what gets verified.
+  {
+    FormatterProfile::ScopedPhase phase(profile.get(), "emit");
+    fmt.Emit(formatted_text);
+    phase.SetItems(formatted_text->size());
   }
 
-  // When formatting whole-file (no --lines are specified), ensure that
-  // the formatting transformation is convergent after one iteration.
-  //   format(format(text)) == format(text)
-  if (control.verify_convergence) {
-    std::ostringstream reformat_stream;
-    const auto reformat_status = ReformatVerilog(
-        text, formatted_text, filename, style, reformat_stream, lines, control);
-    if (!reformat_status.ok()) {
-      return reformat_status;
+  if (unformatted_lines != nullptr) {
+    const auto& line_column_map = text_structure.GetLineColumnMap();
+    for (const auto& range : fmt.UnformattedRanges()) {
+      // Convert to 1-based, inclusive-exclusive line numbers.
+      unformatted_lines->Add({line_column_map(range.first).line + 1,
+                              line_column_map(range.second - 1).line + 2});
     }
-    const std::string& reformatted_text(reformat_stream.str());
-    return verible::ReformatMustMatch(text, lines, formatted_text,
-                                      reformatted_text);
   }
-  return format_status;
+
+  // Verification and the convergence check are phases of the profile, too.
+  const Status status = [&]() -> Status {
+    if (control.verification == VerificationMode::kNone) return format_status;
+
+    {
+      const bool verify_fully = ShouldVerifyFully(control);
+      FormatterProfile::ScopedPhase phase(
+          profile.get(), verify_fully ? "verify" : "verify_lexically");
+      phase.SetItems(formatted_text->size());
+      const Status verify_status =
+          verify_fully
+              ? VerifyFormatting(text_structure, *formatted_text, filename)
+              : VerifyFormattingLexically(text_structure, *formatted_text);
+      if (!verify_status.ok()) {
+        return verify_status;
+      }
+    }
+
+    // When formatting whole-file (no --lines are specified), ensure that
+    // the formatting transformation is convergent after one iteration.
+    //   format(format(text)) == format(text)
+    // Partially formatted output (time budget exceeded) need not converge.
+    if (control.verify_convergence && format_status.ok() &&
+        fmt.UnformattedRanges().empty()) {
+      FormatterProfile::ScopedPhase phase(profile.get(), "convergence");
+      std::string reformatted_text;
+      const auto reformat_status =
+          ReformatVerilog(text, *formatted_text, filename, style,
+                          &reformatted_text, lines, control, deadline);
+      phase.SetItems(reformatted_text.size());
+      if (!reformat_status.ok()) {
+        return reformat_status;
+      }
+      return verible::ReformatMustMatch(text, lines, *formatted_text,
+                                        reformatted_text);
+    }
+    return format_status;
+  }();
+  if (profile) PrintProfile(control, filename, *profile);
+  return status;
 }
 
 static verible::Interval<int> DisableByteOffsetRange(
@@ -496,6 +653,30 @@ static void PrintLargestPartitions(
   stream << hline << std::endl;
 }
 
+// This mapping defines how this enum is displayed and parsed.
+static const verible::EnumNameMap<VerificationMode> kVerificationModeStringMap =
+    {
+        {"none", VerificationMode::kNone},
+        {"lexical", VerificationMode::kLexical},
+        {"full", VerificationMode::kFull},
+};
+
+std::ostream& operator<<(std::ostream& stream, VerificationMode mode) {
+  return kVerificationModeStringMap.Unparse(mode, stream);
+}
+
+bool AbslParseFlag(absl::string_view text, VerificationMode* mode,
+                   std::string* error) {
+  return kVerificationModeStringMap.Parse(text, mode, error,
+                                          "VerificationMode");
+}
+
+std::string AbslUnparseFlag(const VerificationMode& mode) {
+  std::ostringstream stream;
+  stream << mode;
+  return stream.str();
+}
+
 std::ostream& ExecutionControl::Stream() const {
   return (stream != nullptr) ? *stream : std::cout;
 }
@@ -503,6 +684,65 @@ std::ostream& ExecutionControl::Stream() const {
 void Formatter::SelectLines(const LineNumberSet& lines) {
   disabled_ranges_ = EnabledLinesToDisabledByteRanges(
       lines, text_structure_.GetLineColumnMap());
+  selected_lines_only_ = !lines.empty();
+}
+
+// Returns true if the text spanned by the partition is entirely
+// format-disabled, in which case all of its tokens preserve original spacing.
+static bool PartitionIsFormatDisabled(const UnwrappedLine& uwline,
+                                      absl::string_view full_text,
+                                      const ByteOffsetSet& disabled_ranges) {
+  if (uwline.IsEmpty()) return false;
+  const verible::FormatTokenRange range(uwline.TokensRange());
+  return disabled_ranges.Contains(verible::Interval<int>{
+      range.front().token->left(full_text),
+      range.back().token->right(full_text)});
+}
+
+// Collects the ranges of format tokens (as indices relative to 'base') that
+// span the smallest partitions that enclose format-enabled text.
+// Formatting decisions inside such a partition (annotation, alignment,
+// expansion, wrapping) depend only on its own tokens, so everything outside
+// of these ranges can be passed through with its original spacing.
+// Only kAlwaysExpand groupings are descended into, because they never need to
+// evaluate whether their full token range fits on a line.
+static void CollectFormattingScope(
+    const TokenPartitionTree& node,
+    std::vector<verible::PreFormatToken>::const_iterator base,
+    absl::string_view full_text, const ByteOffsetSet& disabled_ranges,
+    verible::IntervalSet<int>* scope) {
+  const UnwrappedLine& uwline = node.Value();
+  if (uwline.IsEmpty() ||
+      PartitionIsFormatDisabled(uwline, full_text, disabled_ranges)) {
+    return;
+  }
+  const auto range = uwline.TokensRange();
+  const verible::Interval<int> token_indices{
+      static_cast<int>(std::distance(base, range.begin())),
+      static_cast<int>(std::distance(base, range.end()))};
+  if (node.is_leaf() ||
+      uwline.PartitionPolicy() != PartitionPolicyEnum::kAlwaysExpand) {
+    scope->Add(token_indices);
+    return;
+  }
+  const auto& children = node.Children();
+  if (std::any_of(children.begin(), children.end(),
+                  [](const TokenPartitionTree& child) {
+                    // Expansion of argument lists depends on whether the
+                    // parent partition fits (see DeterminePartitionExpansion).
+                    const auto& child_line = child.Value();
+                    return child_line.PartitionPolicy() ==
+                               PartitionPolicyEnum::kTabularAlignment &&
+                           child_line.Origin() != nullptr &&
+                           child_line.Origin()->Tag().tag ==
+                               (int)NodeEnum::kArgumentList;
+                  })) {
+    scope->Add(token_indices);
+    return;
+  }
+  for (const auto& child : children) {
+    CollectFormattingScope(child, base, full_text, disabled_ranges, scope);
+  }
 }
 
 // Given control flags and syntax tree, selectively disable some ranges
@@ -539,15 +779,12 @@ Status Formatter::Format(const ExecutionControl& control) {
                                unwrapper_data.preformatted_tokens);
 
   const TokenPartitionTree* format_tokens_partitions = nullptr;
-  // TODO(fangism): The following block could be parallelized because
-  // full-partitioning does not depend on format annotations.
+  // When formatting only selected lines, restrict the remaining work to
+  // the partitions that enclose them.
+  const bool restrict_to_scope = selected_lines_only_ &&
+                                 control.restrict_to_selected_lines &&
+                                 !control.AnyStop();
   {
-    // Annotate inter-token information between all adjacent PreFormatTokens.
-    // This must be done before any decisions about ExpandableTreeView
-    // can be made because they depend on minimum-spacing, and must-break.
-    AnnotateFormattingInformation(style_, text_structure_,
-                                  &unwrapper_data.preformatted_tokens);
-
     // Determine ranges of disabling the formatter, based on comment controls.
     disabled_ranges_.Union(DisableFormattingRanges(full_text, token_stream));
 
@@ -558,12 +795,40 @@ Status Formatter::Format(const ExecutionControl& control) {
       DisableSyntaxBasedRanges(&disabled_ranges_, *root, style_, full_text);
     }
 
+    // Partition PreFormatTokens into candidate unwrapped lines.
+    // Partitioning does not depend on format annotations.
+    {
+      FormatterProfile::ScopedPhase phase(profile_, "unwrap");
+      format_tokens_partitions = tree_unwrapper.Unwrap();
+      phase.SetItems(unwrapper_data.preformatted_tokens.size());
+    }
+
+    // Annotate inter-token information between all adjacent PreFormatTokens.
+    // This must be done before any decisions about ExpandableTreeView
+    // can be made because they depend on minimum-spacing, and must-break.
+    FormatterProfile::ScopedPhase phase(profile_, "annotate");
+    if (restrict_to_scope) {
+      verible::IntervalSet<int> scope;
+      CollectFormattingScope(*format_tokens_partitions,
+                             unwrapper_data.preformatted_tokens.begin(),
+                             full_text, disabled_ranges_, &scope);
+      VLOG(1) << "format token ranges in scope: " << scope;
+      AnnotateFormattingInformation(style_, text_structure_, scope,
+                                    &unwrapper_data.preformatted_tokens);
+      int annotated_tokens = 0;
+      for (const auto& range : scope) {
+        annotated_tokens += range.second - range.first;
+      }
+      phase.SetItems(annotated_tokens);
+    } else {
+      AnnotateFormattingInformation(style_, text_structure_,
+                                    &unwrapper_data.preformatted_tokens);
+      phase.SetItems(unwrapper_data.preformatted_tokens.size());
+    }
+
     // Disable formatting ranges.
     verible::PreserveSpacesOnDisabledTokenRanges(
         &unwrapper_data.preformatted_tokens, disabled_ranges_, full_text);
-
-    // Partition PreFormatTokens into candidate unwrapped lines.
-    format_tokens_partitions = tree_unwrapper.Unwrap();
   }
 
   {
@@ -587,14 +852,22 @@ Status Formatter::Format(const ExecutionControl& control) {
 
   {  // In this pass, perform additional modifications to the partitions and
      // spacings.
+    FormatterProfile::ScopedPhase phase(profile_, "align");
+    int aligned_partitions = 0;
     tree_unwrapper.ApplyPreOrder([&](TokenPartitionTree& node) {
       const auto& uwline = node.Value();
+      // Format-disabled partitions keep their original spacing.
+      if (restrict_to_scope &&
+          PartitionIsFormatDisabled(uwline, full_text, disabled_ranges_)) {
+        return;
+      }
       const auto partition_policy = uwline.PartitionPolicy();
 
       switch (partition_policy) {
         case PartitionPolicyEnum::kAppendFittingSubPartitions:
           // Reshape partition tree with kAppendFittingSubPartitions policy
           verible::ReshapeFittingSubpartitions(&node, style_);
+          ++aligned_partitions;
           break;
         case PartitionPolicyEnum::kTabularAlignment:
           // TODO(b/145170750): Adjust inter-token spacing to achieve alignment,
@@ -603,23 +876,32 @@ Status Formatter::Format(const ExecutionControl& control) {
           TabularAlignTokenPartitions(&node,
                                       &unwrapper_data.preformatted_tokens,
                                       full_text, disabled_ranges_, style_);
+          ++aligned_partitions;
           break;
         default:
           break;
       }
     });
+    phase.SetItems(aligned_partitions);
   }
 
   // Produce sequence of independently operable UnwrappedLines.
-  const auto unwrapped_lines = MakeUnwrappedLinesWorklist(
-      *format_tokens_partitions, &unwrapper_data.preformatted_tokens, full_text,
-      disabled_ranges_, style_);
+  std::vector<UnwrappedLine> unwrapped_lines;
+  {
+    FormatterProfile::ScopedPhase phase(profile_, "expand");
+    unwrapped_lines = MakeUnwrappedLinesWorklist(
+        *format_tokens_partitions, &unwrapper_data.preformatted_tokens,
+        full_text, disabled_ranges_, style_);
+    phase.SetItems(unwrapped_lines.size());
+  }
 
   // For each UnwrappedLine: minimize total penalty of wrap/break decisions.
   // TODO(fangism): This could be parallelized if results are written
   // to their own 'slots'.
   std::vector<const UnwrappedLine*> partially_formatted_lines;
   formatted_lines_.reserve(unwrapped_lines.size());
+  FormatterProfile::ScopedPhase search_phase(profile_, "search");
+  int64_t total_search_states = 0;
   for (const auto& uwline : unwrapped_lines) {
     // TODO(fangism): Use different formatting strategies depending on
     // uwline.PartitionPolicy().
@@ -627,10 +909,38 @@ Status Formatter::Format(const ExecutionControl& control) {
       // For partitions that were successfully aligned, do not search
       // line-wrapping, but instead accept the adjusted padded spacing.
       formatted_lines_.emplace_back(uwline);
+    } else if (restrict_to_scope &&
+               PartitionIsFormatDisabled(uwline, full_text, disabled_ranges_)) {
+      // All tokens preserve their original spacing, nothing to search.
+      formatted_lines_.emplace_back(uwline);
+    } else if (DeadlineExceeded()) {
+      // Out of time: leave the remaining partitions unformatted.
+      PreserveOriginalSpacing(uwline, &unwrapper_data.preformatted_tokens);
+      formatted_lines_.emplace_back(uwline);
     } else {
       // In other case, default to searching for optimal line wrapping.
+      // Flat lists (e.g. port connections, arguments) are solved with
+      // dynamic programming, which avoids the exponential blow-up of
+      // best-first search on long lists.  It finds only the first of the
+      // equally optimal solutions, so it can't show the others.
+      int search_states = 0;
       const auto optimal_solutions =
-          verible::SearchLineWraps(uwline, style_, control.max_search_states);
+          !control.show_equally_optimal_wrappings && verible::IsFlatList(uwline)
+              ? verible::SearchFlatListLineWraps(uwline, style_,
+                                                 control.max_search_states,
+                                                 &search_states, deadline_)
+              : verible::SearchLineWraps(uwline, style_,
+                                         control.max_search_states,
+                                         &search_states, deadline_);
+      if (profile_ != nullptr) {
+        total_search_states += search_states;
+        std::ostringstream location;
+        if (!uwline.IsEmpty()) {
+          location << text_structure_.GetLineColumnMap()(
+              uwline.TokensRange().front().token->left(full_text));
+        }
+        profile_->AddSearch(search_states, uwline.Size(), location.str());
+      }
       if (control.show_equally_optimal_wrappings &&
           optimal_solutions.size() > 1) {
         verible::DisplayEquallyOptimalWrappings(control.Stream(), uwline,
@@ -639,12 +949,20 @@ Status Formatter::Format(const ExecutionControl& control) {
       // Arbitrarily choose the first solution, if there are multiple.
       formatted_lines_.push_back(optimal_solutions.front());
       if (!formatted_lines_.back().CompletedFormatting()) {
-        // Copy over any lines that did not finish wrap searching.
-        partially_formatted_lines.push_back(&uwline);
+        if (DeadlineExceeded()) {
+          // Search was cut short by the deadline, not the state limit.
+          PreserveOriginalSpacing(uwline, &unwrapper_data.preformatted_tokens);
+          formatted_lines_.back() = verible::FormattedExcerpt(uwline);
+        } else {
+          // Copy over any lines that did not finish wrap searching.
+          partially_formatted_lines.push_back(&uwline);
+        }
       }
     }
   }
 
+  search_phase.SetItems(total_search_states);
+
   // Report any unwrapped lines that failed to complete wrap searching.
   if (!partially_formatted_lines.empty()) {
     std::ostringstream err_stream;
@@ -662,8 +980,32 @@ Status Formatter::Format(const ExecutionControl& control) {
   return absl::OkStatus();
 }
 
-void Formatter::Emit(std::ostream& stream) const {
+void Formatter::PreserveOriginalSpacing(
+    const UnwrappedLine& uwline,
+    std::vector<verible::PreFormatToken>* preformatted_tokens) {
+  if (uwline.IsEmpty()) return;
+  const absl::string_view full_text(text_structure_.Contents());
+  const auto range = uwline.TokensRange();
+  const int front_offset = range.front().token->left(full_text);
+  const int back_offset = range.back().token->right(full_text);
+  // Cover the whitespace before the partition too, so that Emit() prints its
+  // original line breaks and indentation.
+  const int leading_offset =
+      range.begin() == preformatted_tokens->begin()
+          ? 0
+          : std::prev(range.begin())->token->right(full_text);
+  const ByteOffsetSet preserved{{leading_offset, back_offset}};
+  verible::PreserveSpacesOnDisabledTokenRanges(preformatted_tokens, preserved,
+                                               full_text);
+  disabled_ranges_.Add({leading_offset, back_offset});
+  unformatted_ranges_.Add({front_offset, back_offset});
+}
+
+void Formatter::Emit(std::string* output) const {
   const absl::string_view full_text(text_structure_.Contents());
+  // Formatting mostly changes spacing, so the output is expected to be about
+  // as large as the input.  Leave some room for added indentation.
+  output->reserve(output->size() + full_text.size() + full_text.size() / 8);
   int position = 0;  // tracks with the position in the original full_text
   for (const auto& line : formatted_lines_) {
     // TODO(fangism): The handling of preserved spaces before tokens is messy:
@@ -672,18 +1014,19 @@ void Formatter::Emit(std::ostream& stream) const {
     const absl::string_view leading_whitespace(
         full_text.substr(position, front_offset - position));
     FormatWhitespaceWithDisabledByteRanges(full_text, leading_whitespace,
-                                           disabled_ranges_, stream);
+                                           disabled_ranges_, output);
     // When front of first token is format-disabled, the previous call will
     // already cover the space up to the front token, in which case,
     // the left-indentation for this line should be suppressed to avoid
     // being printed twice.
-    line.FormattedText(stream, !disabled_ranges_.Contains(front_offset));
+    line.AppendFormattedText(output,
+                             !disabled_ranges_.Contains(front_offset));
     position = line.Tokens().back().token->right(full_text);
   }
   // Handle trailing spaces after last token.
   const absl::string_view trailing_whitespace(full_text.substr(position));
   FormatWhitespaceWithDisabledByteRanges(full_text, trailing_whitespace,
-                                         disabled_ranges_, stream);
+                                         disabled_ranges_, output);
 }
 
 }  // namespace formatter
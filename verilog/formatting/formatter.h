@@ -16,15 +16,38 @@
 #define VERIBLE_VERILOG_FORMATTING_FORMATTER_H_
 
 #include <iosfwd>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "common/strings/mem_block.h"
 #include "common/strings/position.h"
 #include "verilog/formatting/format_style.h"
 
 namespace verilog {
 namespace formatter {
 
+// How formatted output is checked against the original text.
+enum class VerificationMode {
+  // No checking.
+  kNone,
+  // Lex the output only, and compare its non-whitespace tokens to those of the
+  // original, in a single pass.  A random fraction of files
+  // (ExecutionControl::full_verification_rate) is verified fully instead.
+  kLexical,
+  // Re-analyze (lex and parse) the output, and compare tokens.
+  kFull,
+};
+
+std::ostream& operator<<(std::ostream&, VerificationMode);
+
+bool AbslParseFlag(absl::string_view, VerificationMode*, std::string*);
+
+std::string AbslUnparseFlag(const VerificationMode&);
+
 // Control over formatter's internal execution phases, mostly for debugging
 // and development.
 struct ExecutionControl {
@@ -52,6 +75,29 @@ struct ExecutionControl {
   // convergence: format(format(text)) == format(text).
   bool verify_convergence = true;
 
+  // If true, formatting only selected lines annotates, aligns and searches
+  // line-wrapping only in the partitions that enclose them.  If false, the
+  // whole file is processed as when all lines are selected, and the result
+  // is discarded outside of the selected lines.  The output is the same.
+  bool restrict_to_selected_lines = true;
+
+  // Checking of formatted output.  When kNone, verify_convergence is ignored.
+  VerificationMode verification = VerificationMode::kNone;
+
+  // With VerificationMode::kLexical, the probability [0, 1] that a file is
+  // verified fully, i.e. as with VerificationMode::kFull.
+  double full_verification_rate = 0.0;
+
+  // Wall-time limit on formatting, measured from the start of FormatVerilog.
+  // Partitions whose line-wrap search could not be completed within the budget
+  // keep their original spacing, and are reported as unformatted.
+  absl::Duration time_budget = absl::InfiniteDuration();
+
+  // When non-zero, print (to Stream()) a JSON profile of the formatter's
+  // phases: wall time and item counts per phase, a histogram of line-wrap
+  // search states per partition, and this many most expensive partitions.
+  int show_formatting_profile = 0;
+
   // Output stream for diagnostic feedback (not formatting output).
   // This is useful for seeing diagnostics without waiting for a Status
   // to be returned.
@@ -68,11 +114,33 @@ struct ExecutionControl {
 // Formats Verilog/SystemVerilog source code.
 // 'lines' controls which lines have formattting explicitly enabled.
 // If this is empty, interpret as all lines enabled for formatting.
+// If 'unformatted_lines' is provided, it receives the (1-based) lines that
+// were left with their original spacing because the time budget ran out.
 absl::Status FormatVerilog(absl::string_view text, absl::string_view filename,
                            const FormatStyle& style,
                            std::ostream& formatted_stream,
                            const verible::LineNumberSet& lines = {},
-                           const ExecutionControl& control = {});
+                           const ExecutionControl& control = {},
+                           verible::LineNumberSet* unformatted_lines = nullptr);
+
+// Same as above, but writes the formatted text into 'formatted_text'
+// (replacing its contents), which avoids copying it through a stream.
+absl::Status FormatVerilog(absl::string_view text, absl::string_view filename,
+                           const FormatStyle& style,
+                           std::string* formatted_text,
+                           const verible::LineNumberSet& lines = {},
+                           const ExecutionControl& control = {},
+                           verible::LineNumberSet* unformatted_lines = nullptr);
+
+// Same as above, but shares ownership of 'text' (non-null) with the
+// analyzer instead of copying it.
+absl::Status FormatVerilog(std::shared_ptr<verible::MemBlock> text,
+                           absl::string_view filename,
+                           const FormatStyle& style,
+                           std::string* formatted_text,
+                           const verible::LineNumberSet& lines = {},
+                           const ExecutionControl& control = {},
+                           verible::LineNumberSet* unformatted_lines = nullptr);
 
 }  // namespace formatter
 }  // namespace verilog
@@ -0,0 +1,109 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/formatting/formatter_profile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "common/util/top_n.h"
+#include "json/json.h"
+
+namespace verilog {
+namespace formatter {
+
+void FormatterProfile::AddPhase(absl::string_view phase, absl::Duration time,
+                                int64_t items) {
+  const auto found =
+      std::find_if(phases_.begin(), phases_.end(),
+                   [phase](const Phase& p) { return p.name == phase; });
+  if (found == phases_.end()) {
+    phases_.push_back({std::string(phase), time, items});
+  } else {
+    found->time += time;
+    found->items += items;
+  }
+}
+
+void FormatterProfile::AddSearch(int states, int tokens,
+                                 absl::string_view location) {
+  searches_.push_back({states, tokens, std::string(location)});
+}
+
+// Returns the index of the power-of-two bucket [2^k, 2^(k+1)) containing n.
+// 0 is placed in the first bucket.
+static size_t HistogramBucket(int n) {
+  size_t bucket = 0;
+  while (n > 1) {
+    n >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Ranks searches by explored states, then by size.
+struct FormatterProfile::CostlierSearch {
+  bool operator()(const Search* left, const Search* right) const {
+    if (left->states != right->states) return left->states > right->states;
+    return left->tokens > right->tokens;
+  }
+};
+
+Json::Value FormatterProfile::ToJson(size_t top_n) const {
+  Json::Value json(Json::objectValue);
+
+  Json::Value& phases = json["phases"] = Json::Value(Json::arrayValue);
+  for (const auto& phase : phases_) {
+    Json::Value& entry = phases.append(Json::Value(Json::objectValue));
+    entry["name"] = phase.name;
+    entry["wall_time_us"] =
+        static_cast<Json::Int64>(absl::ToInt64Microseconds(phase.time));
+    entry["items"] = static_cast<Json::Int64>(phase.items);
+  }
+
+  std::vector<int> histogram;
+  for (const auto& search : searches_) {
+    const size_t bucket = HistogramBucket(search.states);
+    if (bucket >= histogram.size()) histogram.resize(bucket + 1, 0);
+    ++histogram[bucket];
+  }
+  Json::Value& buckets = json["search_states_histogram"] =
+      Json::Value(Json::arrayValue);
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    if (histogram[i] == 0) continue;
+    Json::Value& entry = buckets.append(Json::Value(Json::objectValue));
+    entry["min"] = i == 0 ? 0 : 1 << i;
+    entry["max"] = (2 << i) - 1;
+    entry["partitions"] = histogram[i];
+  }
+
+  verible::TopN<const Search*, CostlierSearch> most_expensive(top_n);
+  for (const auto& search : searches_) most_expensive.push(&search);
+  Json::Value& partitions = json["most_expensive_partitions"] =
+      Json::Value(Json::arrayValue);
+  for (const auto* search : most_expensive.Take()) {
+    Json::Value& entry = partitions.append(Json::Value(Json::objectValue));
+    entry["location"] = search->location;
+    entry["tokens"] = search->tokens;
+    entry["states"] = search->states;
+  }
+  return json;
+}
+
+}  // namespace formatter
+}  // namespace verilog
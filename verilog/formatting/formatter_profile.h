@@ -0,0 +1,101 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_VERILOG_FORMATTING_FORMATTER_PROFILE_H_
+#define VERIBLE_VERILOG_FORMATTING_FORMATTER_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "json/json.h"
+
+namespace verilog {
+namespace formatter {
+
+// Collects per-phase timing and line-wrap search statistics of a single
+// formatter run, for diagnosing slow inputs.
+class FormatterProfile {
+ public:
+  // Measures the wall time of its own lifetime, and adds it to a phase.
+  // No-op if 'profile' is nullptr, so it can be used unconditionally.
+  class ScopedPhase {
+   public:
+    ScopedPhase(FormatterProfile* profile, absl::string_view phase)
+        : profile_(profile),
+          phase_(phase),
+          start_(profile != nullptr ? absl::Now() : absl::InfinitePast()) {}
+
+    ~ScopedPhase() {
+      if (profile_ != nullptr) {
+        profile_->AddPhase(phase_, absl::Now() - start_, items_);
+      }
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    // Sets the number of objects (tokens, partitions, states, bytes)
+    // processed during this phase.
+    void SetItems(int64_t items) { items_ = items; }
+
+   private:
+    FormatterProfile* const profile_;
+    const absl::string_view phase_;
+    const absl::Time start_;
+    int64_t items_ = 0;
+  };
+
+  // Accumulates time and item count into 'phase'.  Phases are reported in
+  // the order in which they were first added.
+  void AddPhase(absl::string_view phase, absl::Duration time, int64_t items);
+
+  // Records the outcome of line-wrap searching on one partition.
+  // 'location' is a human-readable position, such as "line:col".
+  void AddSearch(int states, int tokens, absl::string_view location);
+
+  // Returns a JSON object with keys:
+  //   "phases": [{"name", "wall_time_us", "items"}...]
+  //   "search_states_histogram": [{"min", "max", "partitions"}...]
+  //     with power-of-two sized buckets of search states per partition.
+  //   "most_expensive_partitions": [{"location", "tokens", "states"}...]
+  //     at most 'top_n' partitions, ordered by decreasing search states.
+  Json::Value ToJson(size_t top_n) const;
+
+ private:
+  struct Phase {
+    std::string name;
+    absl::Duration time;
+    int64_t items;
+  };
+
+  struct Search {
+    int states;
+    int tokens;
+    std::string location;
+  };
+
+  struct CostlierSearch;
+
+  std::vector<Phase> phases_;
+  std::vector<Search> searches_;
+};
+
+}  // namespace formatter
+}  // namespace verilog
+
+#endif  // VERIBLE_VERILOG_FORMATTING_FORMATTER_PROFILE_H_
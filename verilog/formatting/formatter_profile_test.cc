@@ -0,0 +1,95 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/formatting/formatter_profile.h"
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "json/json.h"
+
+namespace verilog {
+namespace formatter {
+namespace {
+
+TEST(FormatterProfileTest, Empty) {
+  const FormatterProfile profile;
+  const Json::Value json = profile.ToJson(3);
+  EXPECT_EQ(json["phases"].size(), 0);
+  EXPECT_EQ(json["search_states_histogram"].size(), 0);
+  EXPECT_EQ(json["most_expensive_partitions"].size(), 0);
+}
+
+TEST(FormatterProfileTest, PhasesAccumulateInFirstSeenOrder) {
+  FormatterProfile profile;
+  profile.AddPhase("unwrap", absl::Microseconds(5), 10);
+  profile.AddPhase("search", absl::Microseconds(7), 100);
+  profile.AddPhase("unwrap", absl::Microseconds(3), 2);
+  const Json::Value phases = profile.ToJson(0)["phases"];
+  ASSERT_EQ(phases.size(), 2);
+  EXPECT_EQ(phases[0]["name"].asString(), "unwrap");
+  EXPECT_EQ(phases[0]["wall_time_us"].asInt64(), 8);
+  EXPECT_EQ(phases[0]["items"].asInt64(), 12);
+  EXPECT_EQ(phases[1]["name"].asString(), "search");
+  EXPECT_EQ(phases[1]["wall_time_us"].asInt64(), 7);
+  EXPECT_EQ(phases[1]["items"].asInt64(), 100);
+}
+
+TEST(FormatterProfileTest, ScopedPhase) {
+  FormatterProfile profile;
+  {
+    FormatterProfile::ScopedPhase phase(&profile, "emit");
+    phase.SetItems(42);
+  }
+  {  // no-op without a profile
+    FormatterProfile::ScopedPhase phase(nullptr, "emit");
+    phase.SetItems(1);
+  }
+  const Json::Value phases = profile.ToJson(0)["phases"];
+  ASSERT_EQ(phases.size(), 1);
+  EXPECT_EQ(phases[0]["name"].asString(), "emit");
+  EXPECT_EQ(phases[0]["items"].asInt64(), 42);
+}
+
+TEST(FormatterProfileTest, SearchHistogramAndTopPartitions) {
+  FormatterProfile profile;
+  profile.AddSearch(1, 3, "1:1");
+  profile.AddSearch(3, 4, "2:1");
+  profile.AddSearch(2, 5, "3:1");
+  profile.AddSearch(40, 9, "4:1");
+  profile.AddSearch(40, 12, "5:1");
+  const Json::Value json = profile.ToJson(2);
+
+  const Json::Value histogram = json["search_states_histogram"];
+  ASSERT_EQ(histogram.size(), 3);
+  EXPECT_EQ(histogram[0]["min"].asInt(), 0);
+  EXPECT_EQ(histogram[0]["max"].asInt(), 1);
+  EXPECT_EQ(histogram[0]["partitions"].asInt(), 1);
+  EXPECT_EQ(histogram[1]["min"].asInt(), 2);
+  EXPECT_EQ(histogram[1]["max"].asInt(), 3);
+  EXPECT_EQ(histogram[1]["partitions"].asInt(), 2);
+  EXPECT_EQ(histogram[2]["min"].asInt(), 32);
+  EXPECT_EQ(histogram[2]["max"].asInt(), 63);
+  EXPECT_EQ(histogram[2]["partitions"].asInt(), 2);
+
+  const Json::Value top = json["most_expensive_partitions"];
+  ASSERT_EQ(top.size(), 2);
+  EXPECT_EQ(top[0]["location"].asString(), "5:1");
+  EXPECT_EQ(top[0]["states"].asInt(), 40);
+  EXPECT_EQ(top[0]["tokens"].asInt(), 12);
+  EXPECT_EQ(top[1]["location"].asString(), "4:1");
+}
+
+}  // namespace
+}  // namespace formatter
+}  // namespace verilog
@@ -20,6 +20,7 @@
 
 #include "verilog/formatting/formatter.h"
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -28,6 +29,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/match.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "common/formatting/align.h"
 #include "common/strings/position.h"
 #include "common/text/text_structure.h"
@@ -9367,6 +9369,44 @@ TEST(FormatterEndToEndTest, SelectLines) {
   }
 }
 
+// Tests that formatting selected lines only in the partitions that enclose
+// them gives the same output as formatting the whole file, and discarding the
+// result outside of the selected lines.
+TEST(FormatterEndToEndTest, SelectLinesRestrictedSameAsWholeFile) {
+  // Use a fixed style.
+  FormatStyle style;
+  style.column_limit = 40;
+  style.indentation_spaces = 2;
+  style.wrap_spaces = 4;
+  ExecutionControl whole_file_control;
+  whole_file_control.restrict_to_selected_lines = false;
+  for (const auto& test_case : kFormatterTestCases) {
+    const int num_lines = std::count(test_case.input.begin(),
+                                     test_case.input.end(), '\n') +
+                          1;
+    const int middle = num_lines / 2 + 1;
+    const LineNumberSet kSelections[] = {
+        {{1, 2}},
+        {{middle, middle + 1}},
+        {{num_lines, num_lines + 1}},
+        {{1, 2}, {num_lines, num_lines + 1}},
+        {{2, num_lines + 1}},
+    };
+    for (const auto& lines : kSelections) {
+      std::ostringstream restricted_stream, whole_file_stream;
+      const auto restricted_status = FormatVerilog(
+          test_case.input, "<filename>", style, restricted_stream, lines);
+      const auto whole_file_status =
+          FormatVerilog(test_case.input, "<filename>", style,
+                        whole_file_stream, lines, whole_file_control);
+      EXPECT_EQ(restricted_status, whole_file_status)
+          << "code:\n" << test_case.input << "\nlines: " << lines;
+      EXPECT_EQ(restricted_stream.str(), whole_file_stream.str())
+          << "code:\n" << test_case.input << "\nlines: " << lines;
+    }
+  }
+}
+
 // These tests verify the mode where horizontal spacing is discarded while
 // vertical spacing is preserved.
 TEST(FormatterEndToEndTest, PreserveVSpacesOnly) {
@@ -9986,6 +10026,44 @@ TEST(FormatterEndToEndTest, DiagnosticEquallyOptimalWrappings) {
   }
 }
 
+// Tests which of several equally optimal wrappings is chosen: at the first
+// token where they differ, the one that appends is preferred.
+TEST(FormatterEndToEndTest, EquallyOptimalWrappingsPreferAppend) {
+  static constexpr FormatterTestCase kTestCases[] = {
+      // Wrapping before "DPI-C" and before function costs the same.
+      {"module m;export \"DPI-C\" function mhpmcounter_get;endmodule\n",
+       "module m;\n"
+       "  export \"DPI-C\"\n"
+       "      function\n"
+       "      mhpmcounter_get;\n"
+       "endmodule\n"},
+      {"package p;export \"DPI-C\" function mhpmcounter_get;endpackage\n",
+       "package p;\n"
+       "  export \"DPI-C\"\n"
+       "      function\n"
+       "      mhpmcounter_get;\n"
+       "endpackage\n"},
+      // No tie here, for comparison.
+      {"module m;export \"DPI-C\" function get;endmodule\n",
+       "module m;\n"
+       "  export \"DPI-C\"\n"
+       "      function get;\n"
+       "endmodule\n"},
+  };
+  FormatStyle style;
+  style.column_limit = 22;
+  style.indentation_spaces = 2;
+  style.wrap_spaces = 4;
+  for (const auto& test_case : kTestCases) {
+    VLOG(1) << "code-to-format:\n" << test_case.input << "<EOF>";
+    std::ostringstream stream;
+    const auto status =
+        FormatVerilog(test_case.input, "<filename>", style, stream);
+    EXPECT_OK(status) << status.message();
+    EXPECT_EQ(stream.str(), test_case.expected) << "code:\n" << test_case.input;
+  }
+}
+
 // Test that hitting search space limit results in correct error status.
 TEST(FormatterEndToEndTest, UnfinishedLineWrapSearching) {
   FormatStyle style;
@@ -10005,6 +10083,72 @@ TEST(FormatterEndToEndTest, UnfinishedLineWrapSearching) {
   EXPECT_TRUE(absl::StartsWith(status.message(), "***"));
 }
 
+// Test that running out of time leaves partitions with original spacing.
+TEST(FormatterEndToEndTest, TimeBudgetExceeded) {
+  FormatStyle style;
+  style.column_limit = 40;
+  style.indentation_spaces = 2;
+  style.wrap_spaces = 4;
+
+  const absl::string_view code(
+      "parameter   int x = 1+1;\n"
+      "parameter int    y=2;\n");
+
+  std::ostringstream stream;
+  ExecutionControl control;
+  control.time_budget = absl::ZeroDuration();
+  LineNumberSet unformatted_lines;
+  const auto status = FormatVerilog(code, "<filename>", style, stream,
+                                    kEnableAllLines, control,
+                                    &unformatted_lines);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(stream.str(), code);
+  EXPECT_EQ(unformatted_lines, LineNumberSet({{1, 3}}));
+}
+
+// Test that output left partially formatted by the time budget is not
+// re-formatted for the convergence check.
+TEST(FormatterEndToEndTest, TimeBudgetExceededSkipsConvergence) {
+  const absl::string_view code("parameter   int x = 1+1;\n");
+  std::ostringstream stream, profile_stream;
+  ExecutionControl control;
+  control.time_budget = absl::ZeroDuration();
+  control.verify_convergence = true;
+  control.show_formatting_profile = 1;
+  control.stream = &profile_stream;
+  const auto status = FormatVerilog(code, "<filename>", FormatStyle(), stream,
+                                    kEnableAllLines, control);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(stream.str(), code);
+  EXPECT_FALSE(absl::StrContains(profile_stream.str(), "\"convergence\""))
+      << profile_stream.str();
+}
+
+// Test that the profile covers verification and the convergence check.
+TEST(FormatterEndToEndTest, FormattingProfileIncludesVerification) {
+  const absl::string_view code("parameter   int x = 1+1;\n");
+  for (const auto verification :
+       {VerificationMode::kFull, VerificationMode::kLexical}) {
+    std::ostringstream stream, profile_stream;
+    ExecutionControl control;
+    control.verification = verification;
+    control.show_formatting_profile = 1;
+    control.stream = &profile_stream;
+    const auto status = FormatVerilog(code, "<filename>", FormatStyle(),
+                                      stream, kEnableAllLines, control);
+    EXPECT_TRUE(status.ok()) << status;
+    const std::string profile = profile_stream.str();
+    EXPECT_TRUE(absl::StrContains(
+        profile, verification == VerificationMode::kFull
+                     ? "\"verify\""
+                     : "\"verify_lexically\""))
+        << profile;
+    EXPECT_TRUE(absl::StrContains(profile, "\"convergence\"")) << profile;
+    // Only the outermost run prints a profile.
+    EXPECT_EQ(profile.find("\"phases\""), profile.rfind("\"phases\""));
+  }
+}
+
 static constexpr FormatterTestCase kOnelineFormatBaselineTestCases[] = {
     // Reference - following test cases should not be affected by the switch
     {// Minimal useful case
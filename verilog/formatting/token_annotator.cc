@@ -14,10 +14,14 @@
 
 #include "verilog/formatting/token_annotator.h"
 
+#include <algorithm>
 #include <iterator>
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "common/formatting/format_token.h"
 #include "common/formatting/tree_annotator.h"
 #include "common/strings/range.h"
@@ -47,11 +51,154 @@ using FTT = FormatTokenType;
 // This value must be negative.
 static constexpr int kUnhandledSpacesRequired = -1;
 
+// Syntax tree contexts of a pair of adjacent tokens, as seen by the spacing
+// and line-breaking rules below.
+// Rules that look at the contexts (or at token details other than those in
+// TokenPairKey, like text and original spacing) mark their result as
+// context-dependent.  All other results are the same for every occurrence of
+// the same pair of token types, and are memoized (see TokenPairRuleCache).
+class PairContext {
+ public:
+  // 'common_ancestors' is the number of nodes that 'left' and 'right' have in
+  // common.
+  PairContext(const SyntaxTreeContext& left, const SyntaxTreeContext& right,
+              int common_ancestors)
+      : left_(left), right_(right), common_ancestors_(common_ancestors) {
+    // These are consulted for most pairs, so they are computed up-front in a
+    // single pass, and are part of the memoization key.
+    for (const auto* node : right) {
+      switch (static_cast<NodeEnum>(node->Tag().tag)) {
+        case NodeEnum::kPackedDimensions:
+        case NodeEnum::kUnpackedDimensions:
+          right_in_declared_dimensions_ = true;
+          break;
+        case NodeEnum::kStreamingConcatenation:
+          right_in_streaming_concatenation_ = true;
+          break;
+        case NodeEnum::kUdpCombEntry:
+        case NodeEnum::kUdpSequenceEntry:
+          right_in_udp_entry_ = true;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  bool RightInDeclaredDimensions() const {
+    return right_in_declared_dimensions_;
+  }
+  bool RightInStreamingConcatenation() const {
+    return right_in_streaming_concatenation_;
+  }
+  bool RightInUdpEntry() const { return right_in_udp_entry_; }
+
+  // Returns the number of nodes that Left() and Right() have in common.
+  int CommonAncestors() const {
+    dependent_ = true;
+    return common_ancestors_;
+  }
+
+  const SyntaxTreeContext& Left() const {
+    dependent_ = true;
+    return left_;
+  }
+  const SyntaxTreeContext& Right() const {
+    dependent_ = true;
+    return right_;
+  }
+
+  // Call this before looking at tokens' text, spacing, or annotations.
+  void UseTokenDetails() const { dependent_ = true; }
+
+  // Returns true if Left(), Right(), CommonAncestors() or UseTokenDetails()
+  // were called since the last ResetDependent().
+  bool Dependent() const { return dependent_; }
+  void ResetDependent() const { dependent_ = false; }
+
+ private:
+  const SyntaxTreeContext& left_;
+  const SyntaxTreeContext& right_;
+  const int common_ancestors_;
+  bool right_in_declared_dimensions_ = false;
+  bool right_in_streaming_concatenation_ = false;
+  bool right_in_udp_entry_ = false;
+  mutable bool dependent_ = false;
+};
+
+// Identifies a pair of adjacent tokens for the purposes of memoization:
+// everything that the rules may look at without marking PairContext as used.
+struct TokenPairKey {
+  int left_enum;
+  int left_type;
+  int right_enum;
+  int right_type;
+  // Bit flags: whether each token's text is empty, and the properties of
+  // PairContext that are computed up-front.
+  int flags;
+
+  TokenPairKey(const PreFormatToken& left, const PreFormatToken& right,
+               const PairContext& context)
+      : left_enum(left.TokenEnum()),
+        left_type(left.format_token_enum),
+        right_enum(right.TokenEnum()),
+        right_type(right.format_token_enum),
+        flags(left.token->text().empty() |                   //
+              right.token->text().empty() << 1 |             //
+              context.RightInDeclaredDimensions() << 2 |     //
+              context.RightInStreamingConcatenation() << 3 |  //
+              context.RightInUdpEntry() << 4) {}
+
+  bool operator==(const TokenPairKey& other) const {
+    return left_enum == other.left_enum && left_type == other.left_type &&
+           right_enum == other.right_enum && right_type == other.right_type &&
+           flags == other.flags;
+  }
+
+  template <typename H>
+  friend H AbslHashValue(H h, const TokenPairKey& key) {
+    return H::combine(std::move(h), key.left_enum, key.left_type,
+                      key.right_enum, key.right_type, key.flags);
+  }
+};
+
+// Memoizes the results of rules that did not depend on context, per pair of
+// token types.  Large files contain relatively few distinct pairs, so most
+// lookups hit, and skip the long chains of rules.
+// A cache must only be used with one FormatStyle.
+class TokenPairRuleCache {
+ public:
+  struct Entry {
+    absl::optional<WithReason<int>> spaces;
+    absl::optional<WithReason<int>> token_penalty;
+    absl::optional<WithReason<int>> token_context_penalty;
+    absl::optional<WithReason<SpacingOptions>> break_decision;
+  };
+
+  Entry* Find(const TokenPairKey& key) { return &entries_[key]; }
+
+ private:
+  absl::flat_hash_map<TokenPairKey, Entry> entries_;
+};
+
+// Returns the memoized result in 'memo' if there is one, else evaluates 'rule'
+// and memoizes its result if it did not depend on 'context'.
+// 'memo' may be nullptr, to always evaluate.
+template <typename T, typename Rule>
+static WithReason<T> Memoized(absl::optional<WithReason<T>>* memo,
+                              const PairContext& context, const Rule& rule) {
+  if (memo != nullptr && memo->has_value()) return **memo;
+  context.ResetDependent();
+  const WithReason<T> result = rule();
+  if (memo != nullptr && !context.Dependent()) *memo = result;
+  return result;
+}
+
 static bool IsUnaryPrefixExpressionOperand(const PreFormatToken& left,
-                                           const SyntaxTreeContext& context) {
+                                           const PairContext& context) {
   return (IsUnaryOperator(verilog_tokentype(left.TokenEnum())) &&
-          context.IsInsideFirst({NodeEnum::kUnaryPrefixExpression},
-                                {NodeEnum::kExpression})) ||
+          context.Right().IsInsideFirst({NodeEnum::kUnaryPrefixExpression},
+                                        {NodeEnum::kExpression})) ||
          // Treat '##' like a unary prefix operator.
          left.TokenEnum() == verilog_tokentype::TK_POUNDPOUND;
 }
@@ -129,10 +276,10 @@ static bool IsAnySemicolon(const PreFormatToken& ftoken) {
 // Returns minimum number of spaces required between left and right token.
 // Returning kUnhandledSpacesRequired means the case was not explicitly
 // handled, and it is up to the caller to decide what to do when this happens.
-static WithReason<int> SpacesRequiredBetween(
-    const PreFormatToken& left, const PreFormatToken& right,
-    const SyntaxTreeContext& left_context,
-    const SyntaxTreeContext& right_context, const FormatStyle& style) {
+static WithReason<int> SpacesRequiredBetween(const PreFormatToken& left,
+                                             const PreFormatToken& right,
+                                             const PairContext& context,
+                                             const FormatStyle& style) {
   VLOG(3) << "Spacing between " << verilog_symbol_name(left.TokenEnum())
           << " and " << verilog_symbol_name(right.TokenEnum());
   // Higher precedence rules should be handled earlier in this function.
@@ -162,7 +309,7 @@ static WithReason<int> SpacesRequiredBetween(
   }
 
   // For now, leave everything inside [dimensions] alone.
-  if (InDeclaredDimensions(right_context)) {
+  if (context.RightInDeclaredDimensions()) {
     // ... except for the spacing before '[' and around ':',
     // which are covered elsewhere.
     if (right.TokenEnum() != '[' && left.TokenEnum() != ':' &&
@@ -174,7 +321,7 @@ static WithReason<int> SpacesRequiredBetween(
   }
 
   // Unary operators (context-sensitive)
-  if (IsUnaryPrefixExpressionOperand(left, right_context) &&
+  if (IsUnaryPrefixExpressionOperand(left, context) &&
       (left.format_token_enum != FormatTokenType::binary_operator ||
        !IsUnaryOperator(static_cast<verilog_tokentype>(right.TokenEnum())))) {
     // TODO: There are _some_ unary operators on the right that could
@@ -205,7 +352,7 @@ static WithReason<int> SpacesRequiredBetween(
     return {1, "Space between return keyword and return value"};
   }
 
-  if (right_context.IsInsideFirst({NodeEnum::kStreamingConcatenation}, {})) {
+  if (context.RightInStreamingConcatenation()) {
     if (left.TokenEnum() == TK_LS || left.TokenEnum() == TK_RS) {
       return {0, "No space around streaming operators"};
     } else if (left.format_token_enum == FormatTokenType::numeric_literal ||
@@ -225,11 +372,10 @@ static WithReason<int> SpacesRequiredBetween(
   }
 
   // Do not force space between '^' and '{' operators
-  if (right_context.IsInsideFirst({NodeEnum::kUnaryPrefixExpression}, {})) {
-    if (IsUnaryOperator(static_cast<verilog_tokentype>(left.TokenEnum())) &&
-        right.TokenEnum() == '{') {
-      return {0, "No space between unary and concatenation operators"};
-    }
+  if (IsUnaryOperator(static_cast<verilog_tokentype>(left.TokenEnum())) &&
+      right.TokenEnum() == '{' &&
+      context.Right().IsInsideFirst({NodeEnum::kUnaryPrefixExpression}, {})) {
+    return {0, "No space between unary and concatenation operators"};
   }
 
   // Add missing space around either side of all types of assignment operator.
@@ -240,14 +386,15 @@ static WithReason<int> SpacesRequiredBetween(
     // Inside [], allows 0 or 1 spaces, and symmetrize.
     // TODO(fangism): make this behavior configurable
     if (right.format_token_enum == FormatTokenType::binary_operator &&
-        InRangeLikeContext(right_context)) {
+        InRangeLikeContext(context.Right())) {
       if (style.compact_indexing_and_selections &&
-          !InDeclaredDimensions(right_context)) {
+          !context.RightInDeclaredDimensions()) {
         return {0,
                 "Compact binary expressions inside indexing / bit selection "
                 "operator []"};
       }
 
+      context.UseTokenDetails();
       int spaces = right.OriginalLeadingSpaces().length();
       if (spaces > 1) {
         spaces = 1;
@@ -255,7 +402,8 @@ static WithReason<int> SpacesRequiredBetween(
       return {spaces, "Limit <= 1 space before binary operator inside []."};
     }
     if (left.format_token_enum == FormatTokenType::binary_operator &&
-        InRangeLikeContext(left_context)) {
+        InRangeLikeContext(context.Left())) {
+      context.UseTokenDetails();
       return {left.before.spaces_required,
               "Symmetrize spaces before and after binary operator inside []."};
     }
@@ -265,6 +413,7 @@ static WithReason<int> SpacesRequiredBetween(
   // If the token on either side is an empty string, do not inject any
   // additional spaces.  This can occur with some lexical tokens like
   // verilog_tokentype::PP_define_body.
+  // (Text emptiness is part of TokenPairKey.)
   if (left.token->text().empty() || right.token->text().empty()) {
     return {0, "No additional space around empty-string tokens."};
   }
@@ -275,8 +424,7 @@ static WithReason<int> SpacesRequiredBetween(
     return {0, "No space inside based numeric literals"};
   }
 
-  if (right_context.IsInsideFirst(
-          {NodeEnum::kUdpCombEntry, NodeEnum::kUdpSequenceEntry}, {})) {
+  if (context.RightInUdpEntry()) {
     // Spacing before ';' is handled above
     return {1, "One space around UDP entries"};
   }
@@ -311,15 +459,15 @@ static WithReason<int> SpacesRequiredBetween(
         IsKeywordCallable(verilog_tokentype(left.TokenEnum()))) {
       // TODO(fangism): This logic should use .DirectParentIs() to minimize risk
       // of unintended reach.
-      if (right_context.IsInside(NodeEnum::kActualNamedPort) ||
-          right_context.IsInside(NodeEnum::kPort)) {
+      if (context.Right().IsInside(NodeEnum::kActualNamedPort) ||
+          context.Right().IsInside(NodeEnum::kPort)) {
         return {0, "Named port: no space between ID and '('"};
       }
-      if (right_context.IsInside(NodeEnum::kGateInstance) ||
-          right_context.IsInside(NodeEnum::kPrimitiveGateInstance)) {
+      if (context.Right().IsInside(NodeEnum::kGateInstance) ||
+          context.Right().IsInside(NodeEnum::kPrimitiveGateInstance)) {
         return {1, "Module/primitive instance: want space between ID and '('"};
       }
-      if (left_context.DirectParentIs(NodeEnum::kModuleHeader)) {
+      if (context.Left().DirectParentIs(NodeEnum::kModuleHeader)) {
         return {1,
                 "Module/interface declarations: want space between ID and '('"};
       }
@@ -330,8 +478,9 @@ static WithReason<int> SpacesRequiredBetween(
 
   if (left.TokenEnum() == ':') {
     // Spacing in ranges
-    if (InRangeLikeContext(right_context)) {
+    if (InRangeLikeContext(context.Right())) {
       // Take advantage here that the left token was already annotated (above)
+      context.UseTokenDetails();
       return {left.before.spaces_required,
               "Symmetrize spaces before and after ':' in bit slice"};
     }
@@ -347,22 +496,22 @@ static WithReason<int> SpacesRequiredBetween(
     if (left.format_token_enum == FormatTokenType::keyword) {
       return {1, "Space between keyword and '{'."};
     }
-    if (right_context.DirectParentsAre(
+    if (context.Right().DirectParentsAre(
             {NodeEnum::kBraceGroup, NodeEnum::kConstraintDeclaration})) {
       return {1, "Space before '{' when opening a constraint definition body."};
     }
-    if (right_context.DirectParentsAre(
+    if (context.Right().DirectParentsAre(
             {NodeEnum::kBraceGroup, NodeEnum::kCoverPoint})) {
       return {1, "Space before '{' when opening a coverpoint body."};
     }
-    if (right_context.DirectParentsAre(
+    if (context.Right().DirectParentsAre(
             {NodeEnum::kBraceGroup, NodeEnum::kEnumType})) {
       return {1, "Space before '{' when opening an enum type."};
     }
     if (left.TokenEnum() == ')') {
       return {1, "Space betwen ')' and '{', e.g. conditional constraint."};
     }
-    if (left.TokenEnum() == ']' && InDeclaredDimensions(left_context)) {
+    if (left.TokenEnum() == ']' && InDeclaredDimensions(context.Left())) {
       return {1, "Space between declared array type and '{' (e.g. in typedef)"};
     }
     return {0, "No space before '{' in most other contexts."};
@@ -372,7 +521,7 @@ static WithReason<int> SpacesRequiredBetween(
   if ((left.format_token_enum == FormatTokenType::keyword ||
        left.format_token_enum == FormatTokenType::identifier) &&
       right.TokenEnum() == '[') {
-    if (right_context.IsInsideFirst({NodeEnum::kPackedDimensions},
+    if (context.Right().IsInsideFirst({NodeEnum::kPackedDimensions},
                                     {NodeEnum::kExpression})) {
       // "type [packed...]" (space between type and packed dimensions)
       // avoid touching any expressions inside the packed dimensions
@@ -383,7 +532,7 @@ static WithReason<int> SpacesRequiredBetween(
   }
   if (left.TokenEnum() == ']' &&
       right.format_token_enum == FormatTokenType::identifier) {
-    if (right_context.DirectParentsAre(
+    if (context.Right().DirectParentsAre(
             {NodeEnum::kUnqualifiedId,
              NodeEnum::kDataTypeImplicitBasicIdDimensions})) {
       // "[packed...] id" (space between packed dimensions and id)
@@ -401,7 +550,7 @@ static WithReason<int> SpacesRequiredBetween(
     if (left.TokenEnum() == TK_default) {
       return {0, "No space inside \"default:\""};
     }
-    if (right_context.DirectParentIsOneOf(
+    if (context.Right().DirectParentIsOneOf(
             {NodeEnum::kCaseItem, NodeEnum::kCaseInsideItem,
              NodeEnum::kCasePatternItem, NodeEnum::kGenerateCaseItem,
              NodeEnum::kPropertyCaseItem, NodeEnum::kRandSequenceCaseItem,
@@ -420,26 +569,27 @@ static WithReason<int> SpacesRequiredBetween(
 
     // Everything that resembles a prefix-statement label,
     // and label before 'begin'
-    if (right_context.DirectParentIsOneOf({NodeEnum::kBlockIdentifier,
+    if (context.Right().DirectParentIsOneOf({NodeEnum::kBlockIdentifier,
                                            NodeEnum::kLabeledStatement,
                                            NodeEnum::kGenerateBlock})) {
       return {1, "1 space before ':' in prefix block labels"};
     }
 
     // kConditionExpression should have 1 space
-    if (right_context.DirectParentIs(NodeEnum::kConditionExpression)) {
+    if (context.Right().DirectParentIs(NodeEnum::kConditionExpression)) {
       return {1, "condition ?: expression wants 1 space around ':'"};
     }
 
     // Spacing in ranges
-    if (InRangeLikeContext(right_context)) {
+    if (InRangeLikeContext(context.Right())) {
+      context.UseTokenDetails();
       int spaces = right.OriginalLeadingSpaces().length();
       if (spaces > 1) {
         spaces = 1;
       }
       return {spaces, "Limit spaces before ':' in bit slice to 0 or 1"};
     }
-    if (right_context.DirectParentIs(NodeEnum::kValueRange)) {
+    if (context.Right().DirectParentIs(NodeEnum::kValueRange)) {
       return {1, "Spaces around ':' in value ranges."};
     }
 
@@ -502,8 +652,8 @@ static WithReason<int> SpacesRequiredBetween(
     // This may be controversial or context-dependent, as parameterized
     // classes often appear with method calls like:
     //   type#(params...)::method(...);
-    if (left_context.DirectParentIs(NodeEnum::kUnqualifiedId) &&
-        !left_context.IsInsideFirst(
+    if (context.Left().DirectParentIs(NodeEnum::kUnqualifiedId) &&
+        !context.Left().IsInsideFirst(
             {NodeEnum::kInstantiationType, NodeEnum::kBindTargetInstance,
              NodeEnum::kExtendsList},
             {})) {
@@ -561,14 +711,17 @@ struct SpacePolicy {
   bool force_preserve_spaces;
 };
 
-static SpacePolicy SpacesRequiredBetween(
-    const FormatStyle& style, const PreFormatToken& left,
-    const PreFormatToken& right, const SyntaxTreeContext& left_context,
-    const SyntaxTreeContext& right_context) {
+static SpacePolicy SpacesRequiredBetween(const FormatStyle& style,
+                                         const PreFormatToken& left,
+                                         const PreFormatToken& right,
+                                         const PairContext& context,
+                                         TokenPairRuleCache::Entry* memo) {
   // Default for unhandled cases, 1 space to be conservative.
   constexpr int kUnhandledSpacesDefault = 1;
   const auto spaces =
-      SpacesRequiredBetween(left, right, left_context, right_context, style);
+      Memoized(memo ? &memo->spaces : nullptr, context, [&]() {
+        return SpacesRequiredBetween(left, right, context, style);
+      });
   VLOG(1) << "spaces: " << spaces.value << ", reason: " << spaces.reason;
 
   if (spaces.value == kUnhandledSpacesRequired) {
@@ -628,11 +781,11 @@ static WithReason<int> BreakPenaltyBetweenTokens(
   return {0, "no further adjustment (default)"};
 }
 
+// Annotating through AnnotateFormatTokensUsingSyntaxContext() tracks this
+// during the traversal, so this linear-time check is only needed for
+// individually annotated tokens.
 static int CommonAncestors(const SyntaxTreeContext& left,
                            const SyntaxTreeContext& right) {
-  // TODO(fangism): re-check of common ancestry is slow (linear-time),
-  // and could be avoided by memoizing the point of common ancestry between
-  // leaves *during* the traversal.
   const auto* shorter = &left;
   const auto* longer = &right;
   // For C++11 compatibility, we use the 3-iterator form of std::mismatch().
@@ -649,43 +802,41 @@ static int CommonAncestors(const SyntaxTreeContext& left,
 }
 
 // Token-independent break penalty factor.
-static int ContextBasedPenalty(const SyntaxTreeContext& left_context,
-                               const SyntaxTreeContext& right_context) {
+static int ContextBasedPenalty(const PairContext& context) {
   // This factor takes into account syntax tree depth, favoring keeping
   // elements deeper in the tree closer together.
   // The current simple model gives equal weight to every element in the
   // context stack.
   // TODO(fangism): custom weights by syntax tree node type.
   constexpr int kDepthScaleFactor = 2;
-  const int num_common = CommonAncestors(left_context, right_context);
+  const int num_common = context.CommonAncestors();
   const int penalty = num_common * kDepthScaleFactor;
   return penalty;
 }
 
 static WithReason<int> TokensWithContextBreakPenalty(
     const verible::PreFormatToken& left, const verible::PreFormatToken& right,
-    const SyntaxTreeContext& left_context,
-    const SyntaxTreeContext& right_context) {
+    const PairContext& context) {
   const verilog_tokentype left_type =
       static_cast<verilog_tokentype>(left.TokenEnum());
   const verilog_tokentype right_type =
       static_cast<verilog_tokentype>(right.TokenEnum());
-  if (right_context.DirectParentIs(NodeEnum::kConditionExpression) &&
-      IsTernaryOperator(right_type)) {
+  if (IsTernaryOperator(right_type) &&
+      context.Right().DirectParentIs(NodeEnum::kConditionExpression)) {
     return {3, "Prefer to split after ternary operators (+3 on left)."};
   }
-  if (left_context.DirectParentIs(NodeEnum::kConditionExpression) &&
-      IsTernaryOperator(left_type)) {
+  if (IsTernaryOperator(left_type) &&
+      context.Left().DirectParentIs(NodeEnum::kConditionExpression)) {
     return {-1, "Prefer to split after ternary operators (-1 on right)."};
   }
-  if (right_context.DirectParentIs(NodeEnum::kBinaryExpression) &&
-      right.format_token_enum == FormatTokenType::binary_operator) {
+  if (right.format_token_enum == FormatTokenType::binary_operator &&
+      context.Right().DirectParentIs(NodeEnum::kBinaryExpression)) {
     // This value should be kept small so that binding affinity still honors
     // operator precedence which is currently reflected in syntax tree depth.
     return {8, "Prefer to split after binary operators (+8 on left)."};
   }
-  if (left_context.DirectParentIs(NodeEnum::kBinaryExpression) &&
-      left.format_token_enum == FormatTokenType::binary_operator) {
+  if (left.format_token_enum == FormatTokenType::binary_operator &&
+      context.Left().DirectParentIs(NodeEnum::kBinaryExpression)) {
     return {0, "Prefer to split after binary operators (+0 on right)."};
   }
   return {0, "No adjustment."};
@@ -694,22 +845,25 @@ static WithReason<int> TokensWithContextBreakPenalty(
 // Returns the split penalty for line-breaking before the right token.
 static WithReason<int> BreakPenaltyBetween(
     const verible::PreFormatToken& left, const verible::PreFormatToken& right,
-    const SyntaxTreeContext& left_context,
-    const SyntaxTreeContext& right_context) {
+    const PairContext& context, TokenPairRuleCache::Entry* memo) {
   VLOG(3) << "Inter-token penalty between "
           << verilog_symbol_name(left.TokenEnum()) << " and "
           << verilog_symbol_name(right.TokenEnum());
 
-  const int depth_penalty = ContextBasedPenalty(left_context, right_context);
+  const int depth_penalty = ContextBasedPenalty(context);
   VLOG(3) << "context break penalty: " << depth_penalty;
 
   // This factor only looks at left and right tokens:
-  const auto inter_token_penalty = BreakPenaltyBetweenTokens(left, right);
+  const auto inter_token_penalty =
+      Memoized(memo ? &memo->token_penalty : nullptr, context,
+               [&]() { return BreakPenaltyBetweenTokens(left, right); });
   VLOG(3) << "inter-token break penalty: " << inter_token_penalty.value << ", "
           << inter_token_penalty.reason;
 
   const auto token_with_context_penalty =
-      TokensWithContextBreakPenalty(left, right, left_context, right_context);
+      Memoized(memo ? &memo->token_context_penalty : nullptr, context, [&]() {
+        return TokensWithContextBreakPenalty(left, right, context);
+      });
   VLOG(3) << "token+context break penalty: " << token_with_context_penalty.value
           << ", " << token_with_context_penalty.reason;
 
@@ -727,10 +881,9 @@ static WithReason<int> BreakPenaltyBetween(
 // Returns decision whether to break, not break, or evaluate both choices.
 static WithReason<SpacingOptions> BreakDecisionBetween(
     const FormatStyle& style, const PreFormatToken& left,
-    const PreFormatToken& right, const SyntaxTreeContext& left_context,
-    const SyntaxTreeContext& right_context) {
+    const PreFormatToken& right, const PairContext& context) {
   // For now, leave everything inside [dimensions] alone.
-  if (InDeclaredDimensions(right_context)) {
+  if (context.RightInDeclaredDimensions()) {
     // ... except for the spacing immediately around '[' and ']',
     // which is covered by other rules.
     if (left.TokenEnum() != '[' && left.TokenEnum() != ']' &&
@@ -758,6 +911,7 @@ static WithReason<SpacingOptions> BreakDecisionBetween(
   if (right.TokenEnum() == PP_define_body) {
     // TODO(b/141517267): reflow macro definition text with flexible
     // line-continuations.
+    context.UseTokenDetails();
     const absl::string_view text = right.Text();
     if (std::count(text.begin(), text.end(), '\n') >= 2) {
       return {SpacingOptions::Preserve,
@@ -780,6 +934,7 @@ static WithReason<SpacingOptions> BreakDecisionBetween(
     // Check if there are any newlines between these tokens' texts.
     // Caution: when testing this case, must provide valid text between
     // tokens to avoid reading uninitialized memory.
+    context.UseTokenDetails();
     auto preceding_whitespace = verible::make_string_view_range(
         left.token->text().end(), right.token->text().begin());
 
@@ -798,7 +953,7 @@ static WithReason<SpacingOptions> BreakDecisionBetween(
 
   // Unary operators (context-sensitive)
   // For now, never separate unary prefix operators from their operands.
-  if (IsUnaryPrefixExpressionOperand(left, right_context)) {
+  if (IsUnaryPrefixExpressionOperand(left, context)) {
     return {SpacingOptions::MustAppend,
             "Never separate unary prefix operator from its operand"};
   }
@@ -879,6 +1034,7 @@ static WithReason<SpacingOptions> BreakDecisionBetween(
 
   if (left.TokenEnum() == ',' &&
       right.TokenEnum() == verilog_tokentype::MacroArg) {
+    context.UseTokenDetails();
     const absl::string_view text(right.Text());
     if (std::find(text.begin(), text.end(), '\n') != text.end()) {
       return {SpacingOptions::MustWrap,
@@ -891,16 +1047,22 @@ static WithReason<SpacingOptions> BreakDecisionBetween(
           "Default: leave wrap decision to algorithm"};
 }
 
-// Extern linkage for sake of direct testing, though not exposed in public
-// headers.
-// TODO(fangism): could move this to a -internal.h header.
-void AnnotateFormatToken(const FormatStyle& style,
-                         const PreFormatToken& prev_token,
-                         PreFormatToken* curr_token,
-                         const SyntaxTreeContext& prev_context,
-                         const SyntaxTreeContext& curr_context) {
-  const auto p = SpacesRequiredBetween(style, prev_token, *curr_token,
-                                       prev_context, curr_context);
+// 'common_ancestors' is the number of nodes that 'prev_context' and
+// 'curr_context' have in common.
+// 'cache' may be nullptr, to evaluate all rules.
+static void AnnotateFormatToken(const FormatStyle& style,
+                                const PreFormatToken& prev_token,
+                                PreFormatToken* curr_token,
+                                const SyntaxTreeContext& prev_context,
+                                const SyntaxTreeContext& curr_context,
+                                int common_ancestors,
+                                TokenPairRuleCache* cache) {
+  const PairContext context(prev_context, curr_context, common_ancestors);
+  TokenPairRuleCache::Entry* memo =
+      cache ? cache->Find(TokenPairKey(prev_token, *curr_token, context))
+            : nullptr;
+  const auto p =
+      SpacesRequiredBetween(style, prev_token, *curr_token, context, memo);
   curr_token->before.spaces_required = p.spaces_required;
   if (p.force_preserve_spaces) {
     // forego all inter-token calculations
@@ -908,17 +1070,32 @@ void AnnotateFormatToken(const FormatStyle& style,
   } else {
     // Update the break penalty and if the curr_token is allowed to
     // break before it.
-    const auto break_penalty = BreakPenaltyBetween(prev_token, *curr_token,
-                                                   prev_context, curr_context);
+    const auto break_penalty =
+        BreakPenaltyBetween(prev_token, *curr_token, context, memo);
     curr_token->before.break_penalty = break_penalty.value;
-    const auto breaker = BreakDecisionBetween(style, prev_token, *curr_token,
-                                              prev_context, curr_context);
+    const auto breaker =
+        Memoized(memo ? &memo->break_decision : nullptr, context, [&]() {
+          return BreakDecisionBetween(style, prev_token, *curr_token, context);
+        });
     curr_token->before.break_decision = breaker.value;
     VLOG(3) << "line break constraint: " << breaker.value << ": "
             << breaker.reason;
   }
 }
 
+// Extern linkage for sake of direct testing, though not exposed in public
+// headers.
+// TODO(fangism): could move this to a -internal.h header.
+void AnnotateFormatToken(const FormatStyle& style,
+                         const PreFormatToken& prev_token,
+                         PreFormatToken* curr_token,
+                         const SyntaxTreeContext& prev_context,
+                         const SyntaxTreeContext& curr_context) {
+  AnnotateFormatToken(style, prev_token, curr_token, prev_context,
+                      curr_context, CommonAncestors(prev_context, curr_context),
+                      nullptr);
+}
+
 void AnnotateFormattingInformation(
     const FormatStyle& style, const verible::TextStructureView& text_structure,
     std::vector<verible::PreFormatToken>* format_tokens) {
@@ -928,6 +1105,49 @@ void AnnotateFormattingInformation(
                                 text_structure.EOFToken(), format_tokens);
 }
 
+// Returns true if the annotation of the token that follows 'left' could
+// depend on the annotation of 'left' itself, e.g. symmetric spacing around
+// operators inside ranges (see SpacesRequiredBetween).
+static bool AnnotationDependsOnLeftAnnotation(const PreFormatToken& left) {
+  return left.format_token_enum == FTT::binary_operator ||
+         left.TokenEnum() == ':';
+}
+
+void AnnotateFormattingInformation(
+    const FormatStyle& style, const verible::TextStructureView& text_structure,
+    const verible::IntervalSet<int>& token_ranges,
+    std::vector<verible::PreFormatToken>* format_tokens) {
+  if (format_tokens->empty()) return;
+  ConnectPreFormatTokensPreservedSpaceStarts(text_structure.Contents().begin(),
+                                             format_tokens);
+
+  TokenPairRuleCache cache;
+  const auto annotator =
+      [&style, &cache](const PreFormatToken& prev_token,
+                       PreFormatToken* curr_token,
+                       const SyntaxTreeContext& prev_context,
+                       const SyntaxTreeContext& current_context,
+                       int common_ancestors) {
+        AnnotateFormatToken(style, prev_token, curr_token, prev_context,
+                            current_context, common_ancestors, &cache);
+      };
+  const auto tokens_begin = format_tokens->begin();
+  const int tokens_size = format_tokens->size();
+  for (const auto& range : token_ranges) {
+    int begin = std::max(range.first, 0);
+    const int end = std::min(range.second, tokens_size);
+    // Back up until the first annotation no longer depends on a
+    // preceding (unannotated) token's annotation.
+    while (begin > 1 &&
+           AnnotationDependsOnLeftAnnotation((*format_tokens)[begin - 1])) {
+      --begin;
+    }
+    verible::AnnotateFormatTokensUsingSyntaxContext(
+        text_structure.SyntaxTree().get(), text_structure.EOFToken(),
+        tokens_begin, tokens_begin + begin, tokens_begin + end, annotator);
+  }
+}
+
 void AnnotateFormattingInformation(
     const FormatStyle& style, const char* buffer_start,
     const verible::Symbol* syntax_tree_root,
@@ -944,14 +1164,17 @@ void AnnotateFormattingInformation(
   }
 
   // Annotate inter-token information using the syntax tree for context.
+  TokenPairRuleCache cache;
   AnnotateFormatTokensUsingSyntaxContext(
       syntax_tree_root, eof_token, format_tokens->begin(), format_tokens->end(),
-      // lambda: bind the FormatStyle, forwarding all other arguments
-      [&style](const PreFormatToken& prev_token, PreFormatToken* curr_token,
-               const SyntaxTreeContext& prev_context,
-               const SyntaxTreeContext& current_context) {
+      // lambda: bind the FormatStyle and cache, forwarding all other arguments
+      [&style, &cache](const PreFormatToken& prev_token,
+                       PreFormatToken* curr_token,
+                       const SyntaxTreeContext& prev_context,
+                       const SyntaxTreeContext& current_context,
+                       int common_ancestors) {
         AnnotateFormatToken(style, prev_token, curr_token, prev_context,
-                            current_context);
+                            current_context, common_ancestors, &cache);
       });
 }
 
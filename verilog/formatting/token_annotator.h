@@ -21,6 +21,7 @@
 #include "common/text/symbol.h"
 #include "common/text/text_structure.h"
 #include "common/text/token_info.h"
+#include "common/util/interval_set.h"
 #include "verilog/formatting/format_style.h"
 
 namespace verilog {
@@ -36,6 +37,15 @@ void AnnotateFormattingInformation(
     const FormatStyle& style, const verible::TextStructureView& text_structure,
     std::vector<verible::PreFormatToken>* format_tokens);
 
+// Same as above, but only annotates the format tokens whose indices (into
+// format_tokens) are in 'token_ranges'.  Other tokens keep their default
+// inter-token information, apart from the preserved-space references.
+// This is used to save work when only selected lines are being formatted.
+void AnnotateFormattingInformation(
+    const FormatStyle& style, const verible::TextStructureView& text_structure,
+    const verible::IntervalSet<int>& token_ranges,
+    std::vector<verible::PreFormatToken>* format_tokens);
+
 // This interface is only provided for testing, without requiring a
 // TextStructureView.
 //   buffer_start: start of the text buffer that is being formatted.
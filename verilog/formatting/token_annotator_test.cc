@@ -23,6 +23,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "common/formatting/format_token.h"
+#include "common/formatting/tree_annotator.h"
 #include "common/formatting/unwrapped_line.h"
 #include "common/formatting/unwrapped_line_test_utils.h"
 #include "common/text/syntax_tree_context.h"
@@ -32,7 +33,9 @@
 #include "common/util/iterator_adaptors.h"
 #include "gtest/gtest.h"
 #include "verilog/CST/verilog_nonterminals.h"
+#include "verilog/analysis/verilog_analyzer.h"
 #include "verilog/formatting/format_style.h"
+#include "verilog/formatting/tree_unwrapper.h"
 #include "verilog/formatting/verilog_token.h"
 #include "verilog/parser/verilog_parser.h"
 #include "verilog/parser/verilog_token_enum.h"
@@ -5416,6 +5419,99 @@ TEST(TokenAnnotatorTest, OriginalSpacingSensitiveTests) {
   }
 }
 
+// Source file that repeats pairs of token types in many different contexts.
+constexpr absl::string_view kWholeFileText =
+    "// Copyright notice\n"
+    "`include \"defs.svh\"\n"
+    "`define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+    "package pkg;\n"
+    "  typedef enum logic [1:0] {IDLE, BUSY = 2'b01, DONE} state_t;\n"
+    "  typedef struct packed {\n"
+    "    logic [7:0] data;  // payload\n"
+    "    logic valid;\n"
+    "  } item_t;\n"
+    "  localparam int W = 8, D = W * 2 + 1;\n"
+    "  function automatic int add(input int a, int b = 1);\n"
+    "    return a + b;\n"
+    "  endfunction : add\n"
+    "endpackage\n"
+    "class base #(type T = int, int N = 4) extends pkg::item_base;\n"
+    "  rand T items[N];\n"
+    "  constraint c {items.size() inside {[1:N]}; }\n"
+    "  extern virtual task run(ref T x);\n"
+    "endclass\n"
+    "module top #(parameter int W = 8)(\n"
+    "    input logic clk, rst_n,\n"
+    "    input logic [W-1:0] in[2][4],\n"
+    "    output logic [W-1:0] out\n"
+    ");\n"
+    "  import pkg::*;\n"
+    "  state_t state, next;\n"
+    "  logic [W-1:0] mem[0:3], tmp;\n"
+    "  wire [3:0] bus = {in[0][1][3:0]};\n"
+    "  assign out = rst_n ? mem[state][W-1:0] : '0;\n"
+    "  assign tmp = {<<8{in[1][2]}} ^ {W{1'b1}};\n"
+    "  always_ff @(posedge clk or negedge rst_n) begin : seq\n"
+    "    if (!rst_n) state <= IDLE;\n"
+    "    else begin\n"
+    "      state <= next;\n"
+    "      mem[add(1, 2)] <= #1 `MAX(in[0][0], tmp) - (W'(3) << 1);\n"
+    "    end\n"
+    "  end\n"
+    "  always_comb begin\n"
+    "    case (state)\n"
+    "      IDLE, BUSY: next = state_t'(state + 1);\n"
+    "      default: next = IDLE;\n"
+    "    endcase\n"
+    "    for (int i = 0; i < W; i++) begin\n"
+    "      tmp[i] = ~in[0][i % 4][i];\n"
+    "    end\n"
+    "  end\n"
+    "  sub #(.W(W), .D(W / 2)) u_sub (.clk, .in(in[1][0]), .out());\n"
+    "  initial $display(\"%d %s\", W, \"top\");\n"
+    "endmodule : top\n"
+    "primitive udp (output o, input a, b);\n"
+    "  table\n"
+    "    0 ? : 0;\n"
+    "    1 0 : 1;\n"
+    "  endtable\n"
+    "endprimitive\n";
+
+// Annotating a whole file memoizes the results of rules per pair of token
+// types, and tracks the contexts' common ancestors during the traversal.
+// This must yield the same annotations as evaluating every pair on its own.
+TEST(TokenAnnotatorTest, CachedAnnotationSameAsUncached) {
+  VerilogAnalyzer analyzer(kWholeFileText, "<file>");
+  ASSERT_TRUE(analyzer.Analyze().ok());
+  const verible::TextStructureView& text_structure = analyzer.Data();
+  const UnwrapperData unwrapper_data(text_structure.TokenStream());
+
+  for (const FormatStyle& style : {DefaultStyle, CompactIndexSelectionStyle}) {
+    std::vector<PreFormatToken> cached(unwrapper_data.preformatted_tokens);
+    AnnotateFormattingInformation(style, text_structure, &cached);
+
+    std::vector<PreFormatToken> uncached(unwrapper_data.preformatted_tokens);
+    verible::ConnectPreFormatTokensPreservedSpaceStarts(
+        text_structure.Contents().begin(), &uncached);
+    verible::AnnotateFormatTokensUsingSyntaxContext(
+        text_structure.SyntaxTree().get(), text_structure.EOFToken(),
+        uncached.begin(), uncached.end(),
+        [&style](const PreFormatToken& left, PreFormatToken* right,
+                 const verible::SyntaxTreeContext& left_context,
+                 const verible::SyntaxTreeContext& right_context,
+                 int /* common_ancestors */) {
+          AnnotateFormatToken(style, left, right, left_context,
+                              right_context);
+        });
+
+    ASSERT_EQ(cached.size(), uncached.size());
+    for (size_t i = 0; i < cached.size(); ++i) {
+      EXPECT_EQ(cached[i].before, uncached[i].before)
+          << "at token " << i << ": " << *cached[i].token;
+    }
+  }
+}
+
 }  // namespace
 }  // namespace formatter
 }  // namespace verilog
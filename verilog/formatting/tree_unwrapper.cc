@@ -578,10 +578,15 @@ void TreeUnwrapper::Visit(const SyntaxTreeNode& node) {
   VLOG(3) << __FUNCTION__ << " node: " << tag;
 
   // This phase is only concerned with creating token partitions (during tree
-  // recursive descent) and setting correct indentation values.  It is ok to
+  // descent) and setting correct indentation values.  It is ok to
   // have excessive partitioning during this phase.
+  // Capacity for sub-partitions is reserved section by section, as each one
+  // is entered (see verible::TreeUnwrapper::VisitIndentedSection()), because
+  // every partition owns its own vector of children.
   SetIndentationsAndCreatePartitions(node);
+}
 
+void TreeUnwrapper::PostVisitNodeHook(const SyntaxTreeNode& node) {
   // This phase is only concerned with reshaping operations on token partitions,
   // such as merging, flattening, hoisting.  Reshaping should only occur on the
   // return path of tree traversal (here).
@@ -91,6 +91,7 @@ class TreeUnwrapper : public verible::TreeUnwrapper {
 
   void Visit(const verible::SyntaxTreeLeaf& leaf) override;
   void Visit(const verible::SyntaxTreeNode& node) override;
+  void PostVisitNodeHook(const verible::SyntaxTreeNode& node) override;
 
   void SetIndentationsAndCreatePartitions(const verible::SyntaxTreeNode& node);
 
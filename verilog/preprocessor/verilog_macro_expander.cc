@@ -0,0 +1,261 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/preprocessor/verilog_macro_expander.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "common/text/macro_definition.h"
+#include "common/text/token_info.h"
+#include "common/text/token_stream_view.h"
+#include "common/util/container_util.h"
+#include "common/util/status_macros.h"
+#include "verilog/parser/verilog_lexer.h"
+#include "verilog/parser/verilog_token_enum.h"
+
+namespace verilog {
+
+using verible::MacroDefinition;
+using verible::TokenInfo;
+using verible::TokenStreamView;
+using verible::container::FindOrNull;
+
+// Appends 'text' to 'out', replacing identifiers that name formal parameters
+// with their actual arguments, also inside of (unlexed) macro call arguments,
+// and removing token concatenation operators (``).
+static absl::Status SubstituteText(
+    absl::string_view text,
+    const MacroDefinition::substitution_map_type& substitutions,
+    std::string* out) {
+  VerilogLexer lexer(text);
+  while (true) {
+    const TokenInfo& token(lexer.DoNextToken());
+    if (token.isEOF()) break;
+    if (lexer.TokenIsError(token)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Lexical error at \"", token.text(), "\""));
+    }
+    switch (token.token_enum()) {
+      case SymbolIdentifier: {
+        const auto* actual = FindOrNull(substitutions, token.text());
+        absl::StrAppend(out, actual != nullptr ? actual->text() : token.text());
+        break;
+      }
+      case MacroArg:
+        RETURN_IF_ERROR(SubstituteText(token.text(), substitutions, out));
+        break;
+      case PP_TOKEN_CONCAT:
+        break;  // Joins the adjacent tokens.
+      default:
+        absl::StrAppend(out, token.text());
+        break;
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Lexes 'text' into 'tokens', attributed to 'macro', leaving out whitespace
+// and comments.
+static absl::Status LexExpansion(absl::string_view text,
+                                 const MacroDefinition* macro,
+                                 std::vector<ExpandedToken>* tokens) {
+  VerilogLexer lexer(text);
+  while (true) {
+    const TokenInfo& token(lexer.DoNextToken());
+    if (token.isEOF()) break;
+    if (lexer.TokenIsError(token)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Lexical error at \"", token.text(), "\""));
+    }
+    if (VerilogLexer::KeepSyntaxTreeTokens(token)) {
+      tokens->push_back(ExpandedToken{token, nullptr, macro});
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Reads the arguments of the macro call at tokens[*index], which must be
+// followed by '(', arguments separated by ',', and ')'.  Blank arguments
+// have no MacroArg token, and are read as empty text.
+// Returns false if the call is not complete.  Otherwise, leaves '*index' at
+// the closing parenthesis.
+static bool ReadMacroCallArguments(const std::vector<ExpandedToken>& tokens,
+                                   size_t* index,
+                                   std::vector<TokenInfo>* arguments) {
+  size_t i = *index + 1;
+  if (i >= tokens.size() || tokens[i].token.token_enum() != '(') return false;
+  TokenInfo argument(MacroArg, "");
+  for (++i; i < tokens.size(); ++i) {
+    const TokenInfo& token(tokens[i].token);
+    switch (token.token_enum()) {
+      case MacroArg:
+        argument = token;
+        break;
+      case ',':
+        arguments->push_back(argument);
+        argument = TokenInfo(MacroArg, "");
+        break;
+      case ')':
+      case MacroCallCloseToEndLine:
+        arguments->push_back(argument);
+        *index = i;
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+VerilogMacroExpander::VerilogMacroExpander(
+    const MacroDefinitionRegistry& definitions)
+    : lookup_definition_([&definitions](absl::string_view name) {
+        return FindOrNull(definitions, name);
+      }) {}
+
+VerilogMacroExpander::VerilogMacroExpander(
+    const LayeredMacroRegistry& definitions)
+    : lookup_definition_([&definitions](absl::string_view name) {
+        return definitions.Find(name);
+      }) {}
+
+const MacroDefinition* VerilogMacroExpander::LookupDefinition(
+    const TokenInfo& call) const {
+  absl::string_view name = call.text();
+  if (!absl::ConsumePrefix(&name, "`")) return nullptr;
+  return lookup_definition_(name);
+}
+
+absl::Status VerilogMacroExpander::Expand(
+    const TokenStreamView& tokens, std::vector<ExpandedToken>* expanded,
+    std::vector<VerilogPreprocessError>* errors) {
+  std::vector<ExpandedToken> input;
+  input.reserve(tokens.size());
+  for (const auto& token : tokens) {
+    input.push_back(ExpandedToken{*token, &*token, nullptr});
+  }
+  const auto status = ExpandTokens(input, expanded);
+  if (!status.ok()) {
+    errors->emplace_back(*current_origin_, std::string(status.message()));
+  }
+  current_origin_ = nullptr;
+  return status;
+}
+
+absl::Status VerilogMacroExpander::ExpandTokens(
+    const std::vector<ExpandedToken>& tokens,
+    std::vector<ExpandedToken>* expanded) {
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    const ExpandedToken& current(tokens[i]);
+    if (current.origin != nullptr) current_origin_ = current.origin;
+    const MacroDefinition* definition = nullptr;
+    std::vector<TokenInfo> arguments;
+    switch (current.token.token_enum()) {
+      case MacroIdentifier:
+      case MacroIdItem:
+      case MacroNumericWidth:
+        definition = LookupDefinition(current.token);
+        // Macros with parameters can not be called without arguments.
+        if (definition != nullptr && definition->IsCallable()) {
+          definition = nullptr;
+        }
+        break;
+      case MacroCallId:
+        definition = LookupDefinition(current.token);
+        if (definition == nullptr || !definition->IsCallable()) {
+          definition = nullptr;
+          break;
+        }
+        if (!ReadMacroCallArguments(tokens, &i, &arguments)) {
+          return absl::InvalidArgumentError(absl::StrCat(
+              "Unterminated call of macro ", current.token.text()));
+        }
+        break;
+      default:
+        break;
+    }
+    if (definition == nullptr) {
+      expanded->push_back(current);
+      continue;
+    }
+    const Expansion* expansion;
+    RETURN_IF_ERROR(
+        ExpandCall(current.token, *definition, arguments, &expansion));
+    for (const auto& token : expansion->tokens) {
+      expanded->push_back(
+          ExpandedToken{token.token, current.origin, token.macro});
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VerilogMacroExpander::ExpandCall(
+    const TokenInfo& call, const MacroDefinition& definition,
+    const std::vector<TokenInfo>& arguments, const Expansion** expansion) {
+  if (std::find(active_macros_.begin(), active_macros_.end(), &definition) !=
+      active_macros_.end()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Recursive expansion of macro ", call.text()));
+  }
+
+  std::vector<TokenInfo> actuals(arguments);
+  // `FOO() passes one blank argument to a macro without parameters.
+  if (definition.Parameters().empty() && actuals.size() == 1 &&
+      actuals.front().text().empty()) {
+    actuals.clear();
+  }
+
+  std::string key(definition.Name());
+  for (const auto& actual : actuals) {
+    absl::StrAppend(&key, absl::string_view("\0", 1), actual.text());
+  }
+  const auto found = expansions_.find(key);
+  if (found != expansions_.end()) {
+    *expansion = found->second.get();
+    return absl::OkStatus();
+  }
+
+  MacroDefinition::substitution_map_type substitutions;
+  RETURN_IF_ERROR(definition.PopulateSubstitutionMap(actuals, &substitutions));
+  auto result = absl::make_unique<Expansion>();
+  std::vector<ExpandedToken> lexed;
+  absl::Status status = SubstituteText(definition.DefinitionText().text(),
+                                       substitutions, &result->text);
+  if (status.ok()) status = LexExpansion(result->text, &definition, &lexed);
+  if (!status.ok()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "In expansion of macro ", call.text(), ": ", status.message()));
+  }
+
+  // Expand nested macro calls.
+  active_macros_.push_back(&definition);
+  status = ExpandTokens(lexed, &result->tokens);
+  active_macros_.pop_back();
+  RETURN_IF_ERROR(status);
+
+  *expansion = result.get();
+  expansions_.emplace(std::move(key), std::move(result));
+  return absl::OkStatus();
+}
+
+}  // namespace verilog
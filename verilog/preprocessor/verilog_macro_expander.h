@@ -0,0 +1,145 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// VerilogMacroExpander substitutes macro definitions into token streams.
+
+// TODO(fangism): token string-ification (`"...`")
+// TODO(fangism): expand macro calls that appear in `define bodies at the
+//   point of definition, for macros that are re-defined later.
+
+#ifndef VERIBLE_VERILOG_PREPROCESSOR_VERILOG_MACRO_EXPANDER_H_
+#define VERIBLE_VERILOG_PREPROCESSOR_VERILOG_MACRO_EXPANDER_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "common/text/macro_definition.h"
+#include "common/text/token_info.h"
+#include "common/text/token_stream_view.h"
+#include "verilog/preprocessor/verilog_macro_registry.h"
+#include "verilog/preprocessor/verilog_preprocess.h"
+
+namespace verilog {
+
+// One token of a macro-expanded token stream.
+struct ExpandedToken {
+  verible::TokenInfo token;
+
+  // The token of the input stream that this token was copied from, or, for
+  // tokens produced by macro expansion, the macro call in the input stream
+  // (the outermost one, for nested expansions).
+  const verible::TokenInfo* origin;
+
+  // The innermost macro whose expansion produced this token, or nullptr for
+  // tokens that were copied from the input stream.
+  const verible::MacroDefinition* macro;
+};
+
+// VerilogMacroExpander replaces calls of defined macros, like `FOO and
+// `BAR(a, b), with their definition text, after substituting actual
+// arguments (or default values) for formal parameters.  Macro calls that
+// result from expansion are expanded recursively.  Calls of macros that are
+// not defined are passed through, like everything else.
+//
+// Expansions are memoized by macro name and argument text, so each distinct
+// call, e.g. `uvm_field_int(data, UVM_ALL_ON), is substituted and lexed only
+// once, no matter how often it appears, directly or inside other macros.
+//
+// Expanded tokens point into text that is owned by this object, so it must
+// outlive them.  Tokens copied from the input stream still point into the
+// original text.  The macro definitions must outlive this object, and must
+// not change while it is in use.
+//
+// Usage:
+//   VerilogMacroExpander expander(preprocess_data.macro_definitions);
+//   std::vector<ExpandedToken> expanded;
+//   std::vector<VerilogPreprocessError> errors;
+//   auto status = expander.Expand(preprocess_data.preprocessed_token_stream,
+//                                 &expanded, &errors);
+class VerilogMacroExpander {
+ public:
+  using MacroDefinitionRegistry =
+      VerilogPreprocessData::MacroDefinitionRegistry;
+
+  explicit VerilogMacroExpander(const MacroDefinitionRegistry& definitions);
+
+  // Uses the definitions of several files, e.g. of a translation unit and
+  // the files that it `includes.
+  explicit VerilogMacroExpander(const LayeredMacroRegistry& definitions);
+
+  VerilogMacroExpander(const VerilogMacroExpander&) = delete;
+  VerilogMacroExpander(VerilogMacroExpander&&) = delete;
+  VerilogMacroExpander& operator=(const VerilogMacroExpander&) = delete;
+  VerilogMacroExpander& operator=(VerilogMacroExpander&&) = delete;
+
+  // Appends the expansion of 'tokens' to 'expanded'.
+  // Stops at the first malformed or recursive macro call, or lexical error in
+  // an expansion, which is recorded in 'errors' (at the call in 'tokens').
+  absl::Status Expand(const verible::TokenStreamView& tokens,
+                      std::vector<ExpandedToken>* expanded,
+                      std::vector<VerilogPreprocessError>* errors);
+
+  // Returns the number of distinct macro calls that were expanded so far.
+  size_t NumMemoizedExpansions() const { return expansions_.size(); }
+
+ private:
+  // Memoized expansion of one macro call.
+  struct Expansion {
+    // Definition text after substitution of the arguments.
+    std::string text;
+
+    // Fully expanded tokens, with null origins.  Points into 'text' and into
+    // the texts of nested expansions.
+    std::vector<ExpandedToken> tokens;
+  };
+
+  // Appends the expansion of 'tokens' to 'expanded'.
+  absl::Status ExpandTokens(const std::vector<ExpandedToken>& tokens,
+                            std::vector<ExpandedToken>* expanded);
+
+  // Returns the expansion of a call of 'definition' with 'arguments'
+  // (unexpanded text), computing it if needed.
+  absl::Status ExpandCall(const verible::TokenInfo& call,
+                          const verible::MacroDefinition& definition,
+                          const std::vector<verible::TokenInfo>& arguments,
+                          const Expansion** expansion);
+
+  // Returns the definition of the macro called by 'call', or nullptr.
+  const verible::MacroDefinition* LookupDefinition(
+      const verible::TokenInfo& call) const;
+
+  // Returns the definition of a macro by name, or nullptr.
+  const std::function<const verible::MacroDefinition*(absl::string_view)>
+      lookup_definition_;
+
+  // Memoized expansions, keyed by macro name and arguments.
+  absl::flat_hash_map<std::string, std::unique_ptr<const Expansion>>
+      expansions_;
+
+  // Macros that are being expanded, outermost first, to reject recursion.
+  std::vector<const verible::MacroDefinition*> active_macros_;
+
+  // Input token that is being expanded, to which errors are attributed.
+  const verible::TokenInfo* current_origin_ = nullptr;
+};
+
+}  // namespace verilog
+
+#endif  // VERIBLE_VERILOG_PREPROCESSOR_VERILOG_MACRO_EXPANDER_H_
@@ -0,0 +1,228 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/preprocessor/verilog_macro_expander.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "common/lexer/token_stream_adapter.h"
+#include "common/text/token_info.h"
+#include "common/text/token_stream_view.h"
+#include "gtest/gtest.h"
+#include "verilog/parser/verilog_lexer.h"
+#include "verilog/preprocessor/verilog_macro_registry.h"
+#include "verilog/preprocessor/verilog_preprocess.h"
+
+namespace verilog {
+namespace {
+
+using verible::TokenInfo;
+using verible::TokenSequence;
+using verible::TokenStreamView;
+
+class MacroExpanderTester {
+ public:
+  // Collects the macro definitions of 'definitions'.
+  explicit MacroExpanderTester(absl::string_view definitions) {
+    VerilogPreprocess preprocessor;
+    preprocess_data_ = preprocessor.ScanStream(Lex(definitions));
+    EXPECT_TRUE(preprocess_data_.errors.empty());
+    expander_ = absl::make_unique<VerilogMacroExpander>(
+        preprocess_data_.macro_definitions);
+  }
+
+  // Uses the (externally owned) 'definitions'.
+  explicit MacroExpanderTester(const LayeredMacroRegistry& definitions)
+      : expander_(absl::make_unique<VerilogMacroExpander>(definitions)) {}
+
+  // Returns the expansion of 'text', with tokens separated by spaces.
+  std::string Expand(absl::string_view text) {
+    ExpandTokens(text);
+    EXPECT_TRUE(status_.ok()) << status_;
+    std::vector<absl::string_view> texts;
+    for (const auto& token : expanded_) {
+      if (!token.token.isEOF()) texts.push_back(token.token.text());
+    }
+    return absl::StrJoin(texts, " ");
+  }
+
+  void ExpandTokens(absl::string_view text) {
+    expanded_.clear();
+    errors_.clear();
+    status_ = expander_->Expand(Lex(text), &expanded_, &errors_);
+  }
+
+  const VerilogPreprocessData& PreprocessData() const {
+    return preprocess_data_;
+  }
+
+  const VerilogMacroExpander& Expander() const { return *expander_; }
+
+  const std::vector<ExpandedToken>& Expanded() const { return expanded_; }
+
+  const std::vector<VerilogPreprocessError>& Errors() const { return errors_; }
+
+  const absl::Status& Status() const { return status_; }
+
+ private:
+  // Returns the syntax tree tokens of 'text'.
+  TokenStreamView Lex(absl::string_view text) {
+    token_sequences_.emplace_back();
+    TokenSequence& tokens(token_sequences_.back());
+    VerilogLexer lexer(text);
+    EXPECT_TRUE(verible::MakeTokenSequence(&lexer, text, &tokens,
+                                           [](const TokenInfo&) {})
+                    .ok());
+    TokenStreamView view;
+    for (auto iter = tokens.cbegin(); iter != tokens.cend(); ++iter) {
+      if (VerilogLexer::KeepSyntaxTreeTokens(*iter)) view.push_back(iter);
+    }
+    return view;
+  }
+
+  // Lexed texts, which must outlive the preprocessing results.
+  std::deque<TokenSequence> token_sequences_;
+  VerilogPreprocessData preprocess_data_;
+  std::unique_ptr<VerilogMacroExpander> expander_;
+  std::vector<ExpandedToken> expanded_;
+  std::vector<VerilogPreprocessError> errors_;
+  absl::Status status_;
+};
+
+constexpr absl::string_view kDefinitions =
+    "`define WIDTH 8\n"
+    "`define EMPTY\n"
+    "`define NOARGS() nothing\n"
+    "`define ADD(a, b=1) a + b\n"
+    "`define PAREN(x) (x)\n"
+    "`define MUL_ADD(a, b) `PAREN(a) * `ADD(b, `WIDTH)\n"
+    "`define SIGNAL(name) wire name``_q;\n"
+    "`define LOOP `LOOP_AGAIN\n"
+    "`define LOOP_AGAIN `LOOP\n";
+
+TEST(VerilogMacroExpanderTest, PassesThroughTokensWithoutMacros) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("wire [7:0] w;"), "wire [ 7 : 0 ] w ;");
+  EXPECT_EQ(tester.Expander().NumMemoizedExpansions(), 0);
+}
+
+TEST(VerilogMacroExpanderTest, UndefinedMacrosArePassedThrough) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("x = `UNDEFINED + `NOT_DEFINED(1);"),
+            "x = `UNDEFINED + `NOT_DEFINED ( 1 ) ;");
+}
+
+TEST(VerilogMacroExpanderTest, MacrosWithoutParameters) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("wire [`WIDTH-1:0] w;"), "wire [ 8 - 1 : 0 ] w ;");
+  EXPECT_EQ(tester.Expand("x = y `EMPTY;"), "x = y ;");
+  EXPECT_EQ(tester.Expand("x = `NOARGS();"), "x = nothing ;");
+}
+
+TEST(VerilogMacroExpanderTest, MacrosWithParameters) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("x = `ADD(y, z);"), "x = y + z ;");
+  EXPECT_EQ(tester.Expand("x = `ADD(y, );"), "x = y + 1 ;");  // default
+  EXPECT_EQ(tester.Expand("x = `ADD(f(y, z), 2);"), "x = f ( y , z ) + 2 ;");
+  // Macros with parameters are not expanded without arguments.
+  EXPECT_EQ(tester.Expand("x = `ADD;"), "x = `ADD ;");
+}
+
+TEST(VerilogMacroExpanderTest, NestedMacroCalls) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("x = `MUL_ADD(y, z);"),
+            "x = ( y ) * z + 8 ;");
+  EXPECT_EQ(tester.Expand("x = `ADD(`WIDTH, `PAREN(y));"),
+            "x = 8 + ( y ) ;");
+}
+
+TEST(VerilogMacroExpanderTest, TokenConcatenation) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("`SIGNAL(valid)"), "wire valid_q ;");
+}
+
+TEST(VerilogMacroExpanderTest, ExpansionsAreMemoized) {
+  MacroExpanderTester tester(kDefinitions);
+  EXPECT_EQ(tester.Expand("x = `MUL_ADD(y, z);"),
+            "x = ( y ) * z + 8 ;");
+  // `MUL_ADD(y, z), `PAREN(y), `ADD(z, `WIDTH) and `WIDTH
+  EXPECT_EQ(tester.Expander().NumMemoizedExpansions(), 4);
+  EXPECT_EQ(tester.Expand("a = `MUL_ADD(y, z); b = `PAREN(y) + `WIDTH;"),
+            "a = ( y ) * z + 8 ; b = ( y ) + 8 ;");
+  EXPECT_EQ(tester.Expander().NumMemoizedExpansions(), 4);
+  EXPECT_EQ(tester.Expand("c = `PAREN(w);"), "c = ( w ) ;");
+  EXPECT_EQ(tester.Expander().NumMemoizedExpansions(), 5);
+}
+
+TEST(VerilogMacroExpanderTest, Origins) {
+  MacroExpanderTester tester(kDefinitions);
+  tester.ExpandTokens("x = `MUL_ADD(y, z);");
+  ASSERT_TRUE(tester.Status().ok());
+  const auto& definitions = tester.PreprocessData().macro_definitions;
+  const auto& expanded = tester.Expanded();
+  ASSERT_EQ(expanded.size(), 11);  // including EOF
+
+  // Tokens of the input stream.
+  EXPECT_EQ(expanded[0].origin->text(), "x");
+  EXPECT_EQ(expanded[0].macro, nullptr);
+  EXPECT_EQ(expanded[1].origin->text(), "=");
+  EXPECT_EQ(expanded[9].origin->text(), ";");
+
+  // Tokens from the expansion: ( y ) * z + 8
+  const char* const kMacros[] = {"PAREN", "PAREN", "PAREN", "MUL_ADD",
+                                 "ADD",   "ADD",   "WIDTH"};
+  for (int i = 0; i < 7; ++i) {
+    const ExpandedToken& token(expanded[2 + i]);
+    EXPECT_EQ(token.origin->text(), "`MUL_ADD") << i;
+    EXPECT_EQ(token.macro, &definitions.find(kMacros[i])->second) << i;
+  }
+}
+
+TEST(VerilogMacroExpanderTest, LayeredDefinitions) {
+  const MacroExpanderTester header("`define WIDTH 8\n`define DEPTH 4\n");
+  const MacroExpanderTester unit("`define DEPTH 16\n");
+  LayeredMacroRegistry registry;
+  for (const auto* layer : {&header, &unit}) {
+    registry.AddLayer(std::make_shared<const LayeredMacroRegistry::Layer>(
+        layer->PreprocessData().macro_definitions));
+  }
+  MacroExpanderTester tester(registry);
+  EXPECT_EQ(tester.Expand("x = `WIDTH * `DEPTH;"), "x = 8 * 16 ;");
+}
+
+TEST(VerilogMacroExpanderTest, RecursiveMacro) {
+  MacroExpanderTester tester(kDefinitions);
+  tester.ExpandTokens("x = `LOOP;");
+  EXPECT_FALSE(tester.Status().ok());
+  ASSERT_EQ(tester.Errors().size(), 1);
+  EXPECT_EQ(tester.Errors().front().token_info.text(), "`LOOP");
+}
+
+TEST(VerilogMacroExpanderTest, WrongNumberOfArguments) {
+  MacroExpanderTester tester(kDefinitions);
+  tester.ExpandTokens("x = y;\nx = `MUL_ADD(1, 2, 3);");
+  EXPECT_FALSE(tester.Status().ok());
+  ASSERT_EQ(tester.Errors().size(), 1);
+  EXPECT_EQ(tester.Errors().front().token_info.text(), "`MUL_ADD");
+}
+
+}  // namespace
+}  // namespace verilog
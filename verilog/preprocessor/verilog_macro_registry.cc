@@ -0,0 +1,46 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/preprocessor/verilog_macro_registry.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "common/text/macro_definition.h"
+#include "common/util/container_util.h"
+
+namespace verilog {
+
+using verible::container::FindOrNull;
+
+void LayeredMacroRegistry::AddLayer(std::shared_ptr<const Layer> layer) {
+  if (layer == nullptr || !layer_set_.insert(layer.get()).second) return;
+  layers_.push_back(std::move(layer));
+}
+
+void LayeredMacroRegistry::AddLayers(const LayeredMacroRegistry& other) {
+  for (const auto& layer : other.layers_) AddLayer(layer);
+}
+
+const verible::MacroDefinition* LayeredMacroRegistry::Find(
+    absl::string_view name) const {
+  for (auto layer = layers_.rbegin(); layer != layers_.rend(); ++layer) {
+    const auto* definition = FindOrNull(**layer, name);
+    if (definition != nullptr) return definition;
+  }
+  return nullptr;
+}
+
+}  // namespace verilog
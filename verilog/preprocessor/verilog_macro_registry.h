@@ -0,0 +1,66 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_VERILOG_PREPROCESSOR_VERILOG_MACRO_REGISTRY_H_
+#define VERIBLE_VERILOG_PREPROCESSOR_VERILOG_MACRO_REGISTRY_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "common/text/macro_definition.h"
+#include "verilog/preprocessor/verilog_preprocess.h"
+
+namespace verilog {
+
+// LayeredMacroRegistry is a set of macro definitions that is composed of
+// immutable layers, e.g. the definitions of each `included file, followed by
+// those of the including file.  Definitions in upper layers take precedence.
+//
+// Layers are shared, never copied: registries of different translation units
+// that include the same header all point to that header's single layer.
+// Copying or extending a registry only copies the list of its layers.
+class LayeredMacroRegistry {
+ public:
+  using Layer = VerilogPreprocessData::MacroDefinitionRegistry;
+
+  // Adds 'layer' on top of the existing layers.
+  // Layers that are already present are not added again, so a header that is
+  // included (directly or indirectly) more than once keeps its first place.
+  void AddLayer(std::shared_ptr<const Layer> layer);
+
+  // Adds all layers of 'other' on top of the existing layers, in order.
+  void AddLayers(const LayeredMacroRegistry& other);
+
+  // Returns the definition of macro 'name' from the uppermost layer that
+  // defines it, or nullptr if there is none.
+  const verible::MacroDefinition* Find(absl::string_view name) const;
+
+  // Returns the layers, lowest first.
+  const std::vector<std::shared_ptr<const Layer>>& Layers() const {
+    return layers_;
+  }
+
+ private:
+  // Lowest layer first.
+  std::vector<std::shared_ptr<const Layer>> layers_;
+
+  // Same as layers_, for de-duplication.
+  absl::flat_hash_set<const Layer*> layer_set_;
+};
+
+}  // namespace verilog
+
+#endif  // VERIBLE_VERILOG_PREPROCESSOR_VERILOG_MACRO_REGISTRY_H_
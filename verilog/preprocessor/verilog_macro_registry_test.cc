@@ -0,0 +1,99 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/preprocessor/verilog_macro_registry.h"
+
+#include <memory>
+
+#include "absl/strings/string_view.h"
+#include "common/text/macro_definition.h"
+#include "common/text/token_info.h"
+#include "gtest/gtest.h"
+
+namespace verilog {
+namespace {
+
+using verible::MacroDefinition;
+using verible::TokenInfo;
+using Layer = LayeredMacroRegistry::Layer;
+
+// Returns a layer that defines each of 'names' with 'text'.
+std::shared_ptr<const Layer> MakeLayer(
+    std::initializer_list<absl::string_view> names, absl::string_view text) {
+  auto layer = std::make_shared<Layer>();
+  for (absl::string_view name : names) {
+    MacroDefinition definition(TokenInfo(1, "`define"), TokenInfo(2, name));
+    definition.SetDefinitionText(TokenInfo(3, text));
+    layer->emplace(name, definition);
+  }
+  return layer;
+}
+
+TEST(LayeredMacroRegistryTest, Empty) {
+  LayeredMacroRegistry registry;
+  EXPECT_TRUE(registry.Layers().empty());
+  EXPECT_EQ(registry.Find("FOO"), nullptr);
+}
+
+TEST(LayeredMacroRegistryTest, UpperLayersTakePrecedence) {
+  LayeredMacroRegistry registry;
+  registry.AddLayer(MakeLayer({"FOO", "BAR"}, "lower"));
+  registry.AddLayer(MakeLayer({"BAR"}, "upper"));
+  ASSERT_NE(registry.Find("FOO"), nullptr);
+  EXPECT_EQ(registry.Find("FOO")->DefinitionText().text(), "lower");
+  ASSERT_NE(registry.Find("BAR"), nullptr);
+  EXPECT_EQ(registry.Find("BAR")->DefinitionText().text(), "upper");
+  EXPECT_EQ(registry.Find("BAZ"), nullptr);
+}
+
+TEST(LayeredMacroRegistryTest, LayersAreSharedNotCopied) {
+  const auto header = MakeLayer({"FOO"}, "header");
+  LayeredMacroRegistry unit1, unit2;
+  unit1.AddLayer(header);
+  unit1.AddLayer(MakeLayer({"BAR"}, "unit1"));
+  unit2.AddLayer(header);
+  EXPECT_EQ(unit1.Find("FOO"), unit2.Find("FOO"));
+  EXPECT_EQ(unit1.Find("FOO"), &header->find("FOO")->second);
+  EXPECT_EQ(unit2.Find("BAR"), nullptr);
+}
+
+TEST(LayeredMacroRegistryTest, LayersAreAddedOnce) {
+  const auto header = MakeLayer({"FOO"}, "header");
+  LayeredMacroRegistry included;
+  included.AddLayer(header);
+  included.AddLayer(MakeLayer({"FOO"}, "included"));
+
+  LayeredMacroRegistry registry;
+  registry.AddLayer(header);
+  registry.AddLayers(included);  // 'header' is already there
+  EXPECT_EQ(registry.Layers().size(), 2);
+  EXPECT_EQ(registry.Find("FOO")->DefinitionText().text(), "included");
+
+  registry.AddLayer(header);  // does not move 'header' up
+  EXPECT_EQ(registry.Layers().size(), 2);
+  EXPECT_EQ(registry.Find("FOO")->DefinitionText().text(), "included");
+}
+
+TEST(LayeredMacroRegistryTest, CopiesAreIndependent) {
+  LayeredMacroRegistry registry;
+  registry.AddLayer(MakeLayer({"FOO"}, "first"));
+  LayeredMacroRegistry copy(registry);
+  copy.AddLayer(MakeLayer({"FOO"}, "second"));
+  EXPECT_EQ(registry.Find("FOO")->DefinitionText().text(), "first");
+  EXPECT_EQ(copy.Find("FOO")->DefinitionText().text(), "second");
+  EXPECT_EQ(registry.Layers().front(), copy.Layers().front());
+}
+
+}  // namespace
+}  // namespace verilog
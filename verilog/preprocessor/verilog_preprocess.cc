@@ -17,6 +17,7 @@
 #include <functional>
 #include <iterator>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -26,11 +27,13 @@
 #include "absl/strings/string_view.h"
 #include "common/lexer/token_generator.h"
 #include "common/lexer/token_stream_adapter.h"
+#include "common/strings/range.h"
 #include "common/text/macro_definition.h"
 #include "common/text/token_info.h"
 #include "common/text/token_stream_view.h"
 #include "common/util/container_util.h"
 #include "common/util/logging.h"
+#include "common/util/status_macros.h"
 #include "verilog/parser/verilog_parser.h"  // for verilog_symbol_name()
 #include "verilog/parser/verilog_token_enum.h"
 
@@ -144,6 +147,7 @@ std::unique_ptr<VerilogPreprocessError> VerilogPreprocess::ParseMacroDefinition(
   auto token_scan = define_tokens.begin() + 2;  // skip `define and the name
   auto token_iter = *token_scan;
   if (token_iter->token_enum() == '(') {
+    macro_definition->SetCallable();  // even without parameters
     token_iter = *++token_scan;
     // Scan for macro parameters.
     while (token_iter->token_enum() != ')') {
@@ -180,11 +184,35 @@ std::unique_ptr<VerilogPreprocessError> VerilogPreprocess::ParseMacroDefinition(
 absl::Status VerilogPreprocess::HandleTokenIterator(
     const TokenStreamView::const_iterator iter,
     const StreamIteratorGenerator& generator) {
+  if (config_.filter_branches) {
+    switch ((*iter)->token_enum()) {
+      case PP_ifdef:
+      case PP_ifndef:
+      case PP_elsif:
+      case PP_else:
+      case PP_endif:
+        return HandleConditional(iter, generator);
+      default:
+        break;
+    }
+    // EOF always reaches the parser.
+    if (!InActiveBranch() && !(*iter)->isEOF()) {
+      PruneToken(**iter);
+      return absl::OkStatus();
+    }
+  }
+  pruning_ = false;
+
   // For now, pass through all macro definition tokens to next consumer
   // (parser).
   switch ((*iter)->token_enum()) {
     case PP_define:
       return HandleDefine(iter, generator);
+    case PP_undef:
+      // Only conditional evaluation depends on what is defined.
+      if (config_.filter_branches) return HandleUndef(iter, generator);
+      preprocess_data_.preprocessed_token_stream.push_back(*iter);
+      return absl::OkStatus();
     default:
       // All other tokens are passed through unmodified.
       preprocess_data_.preprocessed_token_stream.push_back(*iter);
@@ -237,6 +265,120 @@ absl::Status VerilogPreprocess::HandleDefine(
   return absl::OkStatus();
 }
 
+// Reads the macro name that follows a conditional directive or `undef.
+absl::Status VerilogPreprocess::ConsumeMacroName(
+    const TokenStreamView::const_iterator directive,
+    const StreamIteratorGenerator& generator,
+    TokenStreamView::const_iterator* name) {
+  *name = generator();
+  const TokenInfo& token(***name);
+  if (token.isEOF()) {
+    preprocess_data_.errors.emplace_back(
+        token, absl::StrCat("unexpected EOF where expecting macro name after ",
+                            (*directive)->text()));
+    return absl::InvalidArgumentError("Missing macro name.");
+  }
+  if (token.token_enum() != PP_Identifier) {
+    preprocess_data_.errors.emplace_back(
+        token, absl::StrCat("Expected identifier for macro name, but got \"",
+                            token.text(), "\""));
+    return absl::InvalidArgumentError("Missing macro name.");
+  }
+  return absl::OkStatus();
+}
+
+bool VerilogPreprocess::IsDefined(absl::string_view name) const {
+  return preprocess_data_.macro_definitions.find(name) !=
+             preprocess_data_.macro_definitions.end() ||
+         external_defines_.find(std::string(name)) != external_defines_.end();
+}
+
+void VerilogPreprocess::PruneToken(const TokenInfo& token) {
+  const absl::string_view text = token.text();
+  std::vector<absl::string_view>& ranges(preprocess_data_.pruned_ranges);
+  if (pruning_ && !ranges.empty()) {
+    // Extend over the whitespace and comments between pruned tokens.
+    ranges.back() = verible::make_string_view_range(
+        ranges.back().data(), text.data() + text.length());
+  } else {
+    ranges.push_back(text);
+  }
+  pruning_ = true;
+}
+
+// Responds to `undef directives (only when evaluating conditionals).
+// Like `define, these are passed through.
+absl::Status VerilogPreprocess::HandleUndef(
+    const TokenStreamView::const_iterator iter,  // points to `undef token
+    const StreamIteratorGenerator& generator) {
+  preprocess_data_.preprocessed_token_stream.push_back(*iter);
+  TokenStreamView::const_iterator name;
+  RETURN_IF_ERROR(ConsumeMacroName(iter, generator, &name));
+  preprocess_data_.preprocessed_token_stream.push_back(*name);
+  preprocess_data_.macro_definitions.erase((*name)->text());
+  external_defines_.erase(std::string((*name)->text()));
+  return absl::OkStatus();
+}
+
+// Evaluates conditional directives, which are removed from the token stream
+// along with the inactive branches.
+absl::Status VerilogPreprocess::HandleConditional(
+    const TokenStreamView::const_iterator iter,  // points to the directive
+    const StreamIteratorGenerator& generator) {
+  const TokenInfo& directive(**iter);
+  const int directive_enum = directive.token_enum();
+  PruneToken(directive);
+
+  if (directive_enum != PP_ifdef && directive_enum != PP_ifndef) {
+    if (conditionals_.empty()) {
+      preprocess_data_.errors.emplace_back(
+          directive, absl::StrCat(directive.text(),
+                                  " without matching `ifdef or `ifndef"));
+      return absl::InvalidArgumentError("Unbalanced conditional directive.");
+    }
+    if (directive_enum != PP_endif && conditionals_.back().in_else) {
+      preprocess_data_.errors.emplace_back(
+          directive, absl::StrCat(directive.text(), " after `else"));
+      return absl::InvalidArgumentError("Unbalanced conditional directive.");
+    }
+  }
+
+  switch (directive_enum) {
+    case PP_ifdef:
+    case PP_ifndef: {
+      TokenStreamView::const_iterator name;
+      RETURN_IF_ERROR(ConsumeMacroName(iter, generator, &name));
+      PruneToken(**name);
+      const bool parent_active = InActiveBranch();
+      const bool condition =
+          IsDefined((*name)->text()) == (directive_enum == PP_ifdef);
+      conditionals_.emplace_back(directive, parent_active, condition);
+      break;
+    }
+    case PP_elsif: {
+      TokenStreamView::const_iterator name;
+      RETURN_IF_ERROR(ConsumeMacroName(iter, generator, &name));
+      PruneToken(**name);
+      ConditionalBlock& block(conditionals_.back());
+      const bool condition = !block.taken && IsDefined((*name)->text());
+      block.active = block.parent_active && condition;
+      block.taken = block.taken || condition;
+      break;
+    }
+    case PP_else: {
+      ConditionalBlock& block(conditionals_.back());
+      block.active = block.parent_active && !block.taken;
+      block.taken = true;
+      block.in_else = true;
+      break;
+    }
+    default:  // PP_endif
+      conditionals_.pop_back();
+      break;
+  }
+  return absl::OkStatus();
+}
+
 VerilogPreprocessData VerilogPreprocess::ScanStream(
     const TokenStreamView& token_stream) {
   preprocess_data_.preprocessed_token_stream.reserve(token_stream.size());
@@ -252,6 +394,11 @@ VerilogPreprocessData VerilogPreprocess::ScanStream(
     }
     iter = iter_generator();
   }
+  if (iter == end && !conditionals_.empty()) {
+    preprocess_data_.errors.emplace_back(
+        conditionals_.back().opening,
+        absl::StrCat("unterminated ", conditionals_.back().opening.text()));
+  }
   return std::move(preprocess_data_);
 }
 
@@ -20,17 +20,12 @@
 // For example, it may expand a macro call if its definition happens to be
 // available, but it is not required to do so.
 // The pseudo-preprocessor is free to evaluate any/all/no conditional
-// branches.
+// branches.  By default, it passes all branches through, but it can be
+// configured to evaluate conditionals, given a set of predefined macros.
 // Each analysis tool may configure the pseudo-preprocessor differently.
 
-// TODO(fangism): expand macros if locally defined, and feed un-lexed
-//   body text to lexer.  This approach works if the definition text
-//   does not depend on the start-condition state at the macro call site.
-// TODO(fangism): implement conditional evaluation policy (`ifdef, `else, ...)
-// TODO(fangism): token concatenation, e.g. a``b
-//   This will produce tokens that are not in the original source text.
-// TODO(fangism): token string-ification (turning symbol names into strings)
-// TODO(fangism): evaluate `defines inside `defines at expansion time.
+// Macro calls are not expanded here; VerilogMacroExpander
+// (verilog_macro_expander.h) expands them using the collected definitions.
 
 #ifndef VERIBLE_VERILOG_PREPROCESSOR_VERILOG_PREPROCESS_H_
 #define VERIBLE_VERILOG_PREPROCESSOR_VERILOG_PREPROCESS_H_
@@ -74,6 +69,13 @@ struct VerilogPreprocessData {
 
   // Sequence of tokens rejected by preprocessing.
   std::vector<VerilogPreprocessError> errors;
+
+  // Spans of the original text whose tokens were removed from
+  // preprocessed_token_stream by conditional evaluation (inactive branches
+  // and the conditional directives themselves), in textual order.
+  // Remaining tokens still point into the original text, so this is only
+  // needed to account for the removed text, e.g. to leave it unformatted.
+  std::vector<absl::string_view> pruned_ranges;
 };
 
 // VerilogPreprocess transforms a TokenStreamView.
@@ -84,14 +86,28 @@ class VerilogPreprocess {
   using MacroParameterInfo = verible::MacroParameterInfo;
 
  public:
+  struct Config {
+    // If true, evaluate `ifdef, `ifndef, `elsif, `else and `endif, and remove
+    // the inactive branches (and the directives themselves) from the
+    // preprocessed token stream.  Otherwise, all branches are kept.
+    bool filter_branches = false;
+
+    // Macros that are considered defined before the start of the text, like
+    // with +define+NAME=VALUE, keyed by name.  Only their presence matters
+    // (for conditional evaluation), not their values.
+    std::map<std::string, std::string> defines;
+  };
+
   VerilogPreprocess() : preprocess_data_() {}
 
+  explicit VerilogPreprocess(const Config& config)
+      : config_(config), preprocess_data_() {}
+
   // ScanStream reads in a stream of tokens returns the result as a move
   // of preprocessor_data_.  preprocessor_data_ should not be accessed
   // after this returns.
   VerilogPreprocessData ScanStream(const TokenStreamView& token_stream);
 
-  // TODO(fangism): ExpandMacro, ExpandMacroCall
   // TODO(b/111544845): ExpandEvalStringLiteral
 
  private:
@@ -104,6 +120,32 @@ class VerilogPreprocess {
   absl::Status HandleDefine(const TokenStreamView::const_iterator,
                             const StreamIteratorGenerator&);
 
+  absl::Status HandleUndef(const TokenStreamView::const_iterator,
+                           const StreamIteratorGenerator&);
+
+  // Evaluates `ifdef, `ifndef, `elsif, `else and `endif directives.
+  absl::Status HandleConditional(const TokenStreamView::const_iterator,
+                                 const StreamIteratorGenerator&);
+
+  // Reads the macro name that follows a conditional directive or `undef
+  // into 'name'.
+  absl::Status ConsumeMacroName(const TokenStreamView::const_iterator directive,
+                                const StreamIteratorGenerator&,
+                                TokenStreamView::const_iterator* name);
+
+  // Returns true if 'name' is a defined macro.
+  bool IsDefined(absl::string_view name) const;
+
+  // Returns true if tokens are currently kept, i.e. not inside any inactive
+  // conditional branch.
+  bool InActiveBranch() const {
+    return conditionals_.empty() || conditionals_.back().active;
+  }
+
+  // Removes 'token' from the preprocessed stream, and accounts for its text
+  // in pruned_ranges.
+  void PruneToken(const verible::TokenInfo& token);
+
   // The following functions return nullptr when there is no error:
   static std::unique_ptr<VerilogPreprocessError> ConsumeMacroDefinition(
       const StreamIteratorGenerator&, TokenStreamView*);
@@ -116,6 +158,39 @@ class VerilogPreprocess {
 
   void RegisterMacroDefinition(const MacroDefinition&);
 
+  // State of one level of `ifdef/`ifndef nesting.
+  struct ConditionalBlock {
+    ConditionalBlock(const verible::TokenInfo& opening, bool parent_active,
+                     bool condition)
+        : opening(opening),
+          parent_active(parent_active),
+          taken(condition),
+          active(parent_active && condition) {}
+
+    // The directive that opened this block, for diagnostics.
+    verible::TokenInfo opening;
+    // True if the block is inside an active branch.
+    bool parent_active;
+    // True if any previous branch's condition held.
+    bool taken;
+    // True if the current branch is active.
+    bool active;
+    // True after `else.
+    bool in_else = false;
+  };
+
+  const Config config_;
+
+  // Predefined macros, less the ones that were `undef-ined.
+  std::map<std::string, std::string> external_defines_ = config_.defines;
+
+  // Stack of open conditional blocks, innermost last.
+  std::vector<ConditionalBlock> conditionals_;
+
+  // True if the last token was pruned, so the next pruned token extends the
+  // last of pruned_ranges.
+  bool pruning_ = false;
+
   // Results of preprocessing
   VerilogPreprocessData preprocess_data_;
 };
@@ -15,9 +15,13 @@
 #include "verilog/preprocessor/verilog_preprocess.h"
 
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
 #include "common/text/macro_definition.h"
 #include "common/text/token_info.h"
 #include "common/util/container_util.h"
@@ -39,6 +43,12 @@ class PreprocessorTester {
     status_ = analyzer_.Analyze();
   }
 
+  PreprocessorTester(const char* text, const VerilogPreprocess::Config& config)
+      : analyzer_(text, "<<inline-file>>"), status_() {
+    analyzer_.SetPreprocessConfig(config);
+    status_ = analyzer_.Analyze();
+  }
+
   const VerilogPreprocessData& PreprocessorData() const {
     return analyzer_.PreprocessorData();
   }
@@ -157,6 +167,21 @@ TEST(VerilogPreprocessTest, OneMacroDefinitionNoParamsSimpleValue) {
   EXPECT_TRUE(macro->Parameters().empty());
 }
 
+TEST(VerilogPreprocessTest, OneMacroDefinitionNoParamsEmptyParens) {
+  PreprocessorTester tester(
+      "module foo;\nendmodule\n"
+      "`define FOOOO() 99\n");
+  const auto& definitions = tester.PreprocessorData().macro_definitions;
+  EXPECT_TRUE(tester.Status().ok()) << "Unexpected analyzer failure.";
+  EXPECT_TRUE(tester.PreprocessorData().errors.empty());
+  EXPECT_THAT(definitions, ElementsAre(Pair("FOOOO", testing::_)));
+  auto macro = FindOrNull(definitions, "FOOOO");
+  ASSERT_NE(macro, nullptr);
+  EXPECT_EQ(macro->DefinitionText().text(), "99");
+  EXPECT_TRUE(macro->IsCallable());
+  EXPECT_TRUE(macro->Parameters().empty());
+}
+
 TEST(VerilogPreprocessTest, OneMacroDefinitionOneParamWithValue) {
   PreprocessorTester tester(
       "module foo;\nendmodule\n"
@@ -224,5 +249,148 @@ TEST(VerilogPreprocessTest, TwoMacroDefinitions) {
   }
 }
 
+// Returns the text of the preprocessed tokens, separated by spaces.
+std::string PreprocessedText(const PreprocessorTester& tester) {
+  std::vector<absl::string_view> texts;
+  const auto& tokens = tester.PreprocessorData().preprocessed_token_stream;
+  for (const auto& token : tokens) {
+    if (!token->isEOF()) texts.push_back(token->text());
+  }
+  return absl::StrJoin(texts, " ");
+}
+
+VerilogPreprocess::Config FilterBranches(
+    std::map<std::string, std::string> defines = {}) {
+  VerilogPreprocess::Config config;
+  config.filter_branches = true;
+  config.defines = std::move(defines);
+  return config;
+}
+
+TEST(VerilogPreprocessTest, KeepsAllBranchesByDefault) {
+  PreprocessorTester tester(
+      "`ifdef FOO\n"
+      "module foo;\nendmodule\n"
+      "`else\n"
+      "module bar;\nendmodule\n"
+      "`endif\n");
+  EXPECT_TRUE(tester.Status().ok());
+  EXPECT_EQ(PreprocessedText(tester),
+            "`ifdef FOO module foo ; endmodule `else module bar ; endmodule "
+            "`endif");
+  EXPECT_TRUE(tester.PreprocessorData().pruned_ranges.empty());
+}
+
+struct ConditionalTest {
+  const char* input;
+  std::map<std::string, std::string> defines;
+  const char* expected;  // preprocessed tokens
+};
+
+TEST(VerilogPreprocessTest, FilterBranches) {
+  const ConditionalTest test_cases[] = {
+      {"`ifdef A\nwire a;\n`endif\n", {}, ""},
+      {"`ifdef A\nwire a;\n`endif\n", {{"A", ""}}, "wire a ;"},
+      {"`ifndef A\nwire a;\n`endif\n", {}, "wire a ;"},
+      {"`ifndef A\nwire a;\n`endif\n", {{"A", "1"}}, ""},
+      {"`ifdef A\nwire a;\n`else\nwire b;\n`endif\n", {}, "wire b ;"},
+      {"`ifdef A\nwire a;\n`else\nwire b;\n`endif\n",
+       {{"A", ""}},
+       "wire a ;"},
+      {"`ifdef A\nwire a;\n`elsif B\nwire b;\n`else\nwire c;\n`endif\n",
+       {{"B", ""}},
+       "wire b ;"},
+      {"`ifdef A\nwire a;\n`elsif B\nwire b;\n`else\nwire c;\n`endif\n",
+       {{"A", ""}, {"B", ""}},
+       "wire a ;"},
+      {"`ifdef A\nwire a;\n`elsif B\nwire b;\n`else\nwire c;\n`endif\n",
+       {},
+       "wire c ;"},
+      // nested
+      {"`ifdef A\n`ifdef B\nwire ab;\n`else\nwire a;\n`endif\n`endif\n",
+       {{"A", ""}},
+       "wire a ;"},
+      {"`ifdef A\n`ifndef B\nwire a;\n`endif\n`else\nwire c;\n`endif\n",
+       {{"B", ""}},
+       "wire c ;"},
+      // local definitions
+      {"`define A\n`ifdef A\nwire a;\n`endif\n", {}, "`define A wire a ;"},
+      {"`undef A\n`ifdef A\nwire a;\n`endif\n", {{"A", ""}}, "`undef A"},
+      {"`ifdef A\n`define B\n`endif\n`ifdef B\nwire b;\n`endif\n", {}, ""},
+  };
+  for (const auto& test_case : test_cases) {
+    PreprocessorTester tester(test_case.input,
+                              FilterBranches(test_case.defines));
+    EXPECT_TRUE(tester.Status().ok()) << test_case.input;
+    EXPECT_TRUE(tester.PreprocessorData().errors.empty()) << test_case.input;
+    EXPECT_EQ(PreprocessedText(tester), test_case.expected) << test_case.input;
+  }
+}
+
+TEST(VerilogPreprocessTest, FilterBranchesRecordsPrunedRanges) {
+  constexpr absl::string_view text(
+      "module m;\n"
+      "`ifdef FPGA\n"
+      "  wire fpga;  // comment\n"
+      "`else\n"
+      "  wire sim;\n"
+      "`endif\n"
+      "endmodule\n");
+  PreprocessorTester tester(text.data(), FilterBranches());
+  EXPECT_TRUE(tester.Status().ok());
+  EXPECT_EQ(PreprocessedText(tester), "module m ; wire sim ; endmodule");
+  EXPECT_THAT(tester.PreprocessorData().pruned_ranges,
+              ElementsAre("`ifdef FPGA\n"
+                          "  wire fpga;  // comment\n"
+                          "`else",
+                          "`endif"));
+  // Ranges point into the original text.
+  const absl::string_view contents = tester.Analyzer().Data().Contents();
+  for (const auto range : tester.PreprocessorData().pruned_ranges) {
+    EXPECT_GE(range.data(), contents.data());
+    EXPECT_LE(range.data() + range.length(),
+              contents.data() + contents.length());
+  }
+}
+
+TEST(VerilogPreprocessTest, FilterBranchesSkipsUnparseableBranches) {
+  PreprocessorTester tester(
+      "module m;\n"
+      "`ifdef NEVER\n"
+      "  this is not ( verilog\n"
+      "`endif\n"
+      "endmodule\n",
+      FilterBranches());
+  EXPECT_TRUE(tester.Status().ok());
+  EXPECT_TRUE(tester.Analyzer().GetRejectedTokens().empty());
+}
+
+TEST(VerilogPreprocessTest, InvalidConditionals) {
+  const FailTest test_cases[] = {
+      {"`ifdef A\n", 0},                  // unterminated
+      {"`ifdef A\n`else\n", 0},          // unterminated
+      {"`ifdef A\n`ifdef B\n`endif\n", 0},  // unterminated
+      {"`endif\n", 0},                    // unbalanced
+      {"`else\n", 0},                     // unbalanced
+      {"`elsif A\n", 0},                  // unbalanced
+      {"`ifdef A\n`else\n`else\n`endif\n", 15},   // `else after `else
+      {"`ifdef A\n`else\n`elsif B\n`endif\n", 15},  // `elsif after `else
+      {"`ifdef\n", 7},                    // missing macro name
+  };
+  for (const auto& test_case : test_cases) {
+    PreprocessorTester tester(test_case.input, FilterBranches());
+    EXPECT_FALSE(tester.Status().ok())
+        << "Expected preprocess to fail on invalid input: \"" << test_case.input
+        << "\"";
+    const auto& rejected_tokens = tester.Analyzer().GetRejectedTokens();
+    ASSERT_FALSE(rejected_tokens.empty())
+        << "on invalid input: \"" << test_case.input << "\"";
+    const int rejected_token_offset =
+        rejected_tokens[0].token_info.left(tester.Analyzer().Data().Contents());
+    EXPECT_EQ(rejected_token_offset, test_case.offset)
+        << "on invalid input: \"" << test_case.input << "\"";
+  }
+}
+
 }  // namespace
 }  // namespace verilog
@@ -0,0 +1,113 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/tools/formatter/format_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/strings/content_hash.h"
+#include "common/util/file_util.h"
+#include "common/util/logging.h"
+
+namespace verilog {
+namespace formatter {
+
+namespace fs = std::filesystem;
+
+using verible::ContentHash;
+
+std::string FormatCache::EntryPath(absl::string_view fingerprint,
+                                   absl::string_view content) const {
+  // Hashing the fingerprint separately avoids concatenating large contents.
+  return verible::file::JoinPath(
+      directory_,
+      ContentHash(absl::StrCat(ContentHash(fingerprint), ContentHash(content),
+                               content.length())));
+}
+
+bool FormatCache::Contains(absl::string_view fingerprint,
+                           absl::string_view content) const {
+  const std::string path(EntryPath(fingerprint, content));
+  std::error_code err;
+  if (!fs::exists(path, err)) return false;
+  // Refresh for least-recently-used eviction.  Failure is harmless, e.g.
+  // if another process just evicted this entry.
+  fs::last_write_time(path, fs::file_time_type::clock::now(), err);
+  return true;
+}
+
+absl::Status FormatCache::Insert(absl::string_view fingerprint,
+                                 absl::string_view content) const {
+  if (auto status = verible::file::CreateDir(directory_); !status.ok()) {
+    return status;
+  }
+  const std::string path(EntryPath(fingerprint, content));
+  if (auto status = verible::file::SetContentsAtomically(path, "");
+      !status.ok()) {
+    return status;
+  }
+  const std::lock_guard<std::mutex> lock(mutex_);
+  if (entry_count_ == kUnknownCount || ++entry_count_ > max_entries_) {
+    entry_count_ = EvictOldEntries();
+  }
+  return absl::OkStatus();
+}
+
+// Returns true if 'name' is that of a cache entry, not e.g. that of a
+// temporary file of an insertion in progress (see SetContentsAtomically()).
+static bool IsEntryName(absl::string_view name) {
+  // Entries are named by ContentHash(), i.e. 32 hex digits.
+  return name.length() == 32 &&
+         std::all_of(name.begin(), name.end(),
+                     [](char c) { return absl::ascii_isxdigit(c); });
+}
+
+size_t FormatCache::EvictOldEntries() const {
+  std::error_code err;
+  std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+  for (auto it = fs::directory_iterator(directory_, err);
+       !err && it != fs::directory_iterator(); it.increment(err)) {
+    const fs::directory_entry& entry = *it;
+    if (!IsEntryName(entry.path().filename().string())) continue;
+    std::error_code entry_err;
+    if (!entry.is_regular_file(entry_err)) continue;
+    const auto time = entry.last_write_time(entry_err);
+    if (entry_err) continue;  // concurrently removed
+    entries.emplace_back(time, entry.path());
+  }
+  if (entries.size() <= max_entries_) return entries.size();
+  // Remove down to 3/4 of the bound, so that the directory is only listed
+  // again after max_entries_/4 more insertions.
+  const size_t remove_count = entries.size() - max_entries_ * 3 / 4;
+  std::nth_element(entries.begin(), entries.begin() + remove_count,
+                   entries.end());
+  VLOG(1) << "Evicting " << remove_count << " format cache entries.";
+  for (size_t i = 0; i < remove_count; ++i) {
+    fs::remove(entries[i].second, err);  // Concurrent removal is fine.
+  }
+  return entries.size() - remove_count;
+}
+
+}  // namespace formatter
+}  // namespace verilog
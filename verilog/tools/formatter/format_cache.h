@@ -0,0 +1,80 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VERIBLE_VERILOG_TOOLS_FORMATTER_FORMAT_CACHE_H_
+#define VERIBLE_VERILOG_TOOLS_FORMATTER_FORMAT_CACHE_H_
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace verilog {
+namespace formatter {
+
+// Persistent record of file contents that are known to be already formatted
+// (fixed points of the formatter), so that repeated runs can skip them.
+//
+// Each entry is an empty marker file in 'directory', named after the hash of
+// the contents together with a 'fingerprint' of everything else that affects
+// formatting (tool version, style).  Entries are created atomically and
+// never modified, so one directory can be shared by concurrent processes.
+// Lookups refresh an entry's timestamp, and whenever an insertion makes the
+// directory hold more than 'max_entries' markers, the least recently used
+// ones are removed.
+// The directory is only listed on the first insertion, and when the number of
+// entries, as counted then and kept up to date by insertions, exceeds
+// 'max_entries'.  Evictions remove entries down to 3/4 of 'max_entries', so
+// the directory is listed at most once every max_entries/4 insertions.
+// This is thread-safe.
+class FormatCache {
+ public:
+  FormatCache(absl::string_view directory, size_t max_entries)
+      : directory_(directory), max_entries_(max_entries) {}
+
+  // Returns true if 'content' was recorded as formatted under 'fingerprint'.
+  bool Contains(absl::string_view fingerprint, absl::string_view content) const;
+
+  // Records that 'content' is formatted under 'fingerprint'.
+  absl::Status Insert(absl::string_view fingerprint,
+                      absl::string_view content) const;
+
+ private:
+  std::string EntryPath(absl::string_view fingerprint,
+                        absl::string_view content) const;
+
+  // Returns the number of entries in directory_, and removes the least
+  // recently used ones if there are more than max_entries_.
+  size_t EvictOldEntries() const;
+
+  const std::string directory_;
+  const size_t max_entries_;
+
+  // Guards entry_count_.
+  mutable std::mutex mutex_;
+
+  // Number of entries in directory_, as last listed plus the insertions of
+  // this object since then.  Entries of other processes sharing directory_
+  // are only seen when it is listed again.  Unknown (kUnknownCount) before
+  // the first insertion.
+  static constexpr size_t kUnknownCount = ~size_t{0};
+  mutable size_t entry_count_ = kUnknownCount;
+};
+
+}  // namespace formatter
+}  // namespace verilog
+
+#endif  // VERIBLE_VERILOG_TOOLS_FORMATTER_FORMAT_CACHE_H_
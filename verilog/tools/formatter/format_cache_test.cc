@@ -0,0 +1,149 @@
+// Copyright 2017-2020 The Verible Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "verilog/tools/formatter/format_cache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "common/util/file_util.h"
+#include "gtest/gtest.h"
+
+namespace verilog {
+namespace formatter {
+namespace {
+
+namespace fs = std::filesystem;
+
+TEST(FormatCacheTest, InsertAndLookup) {
+  const std::string dir =
+      verible::file::JoinPath(::testing::TempDir(), "format_cache_lookup");
+  const FormatCache cache(dir, 100);
+  EXPECT_FALSE(cache.Contains("style1", "module m;\nendmodule\n"));
+  ASSERT_TRUE(cache.Insert("style1", "module m;\nendmodule\n").ok());
+  EXPECT_TRUE(cache.Contains("style1", "module m;\nendmodule\n"));
+  // Different style or content is not a hit.
+  EXPECT_FALSE(cache.Contains("style2", "module m;\nendmodule\n"));
+  EXPECT_FALSE(cache.Contains("style1", "module n;\nendmodule\n"));
+
+  // Another instance sharing the directory sees the same entries.
+  const FormatCache other(dir, 100);
+  EXPECT_TRUE(other.Contains("style1", "module m;\nendmodule\n"));
+}
+
+TEST(FormatCacheTest, BoundedSize) {
+  const std::string dir =
+      verible::file::JoinPath(::testing::TempDir(), "format_cache_bounded");
+  constexpr size_t kMaxEntries = 8;
+  const FormatCache cache(dir, kMaxEntries);
+  const auto entry_count = [&dir]() -> size_t {
+    const auto listing = verible::file::ListDir(dir);
+    EXPECT_TRUE(listing.ok()) << listing.status();
+    return listing.ok() ? listing->files.size() : 0;
+  };
+  for (size_t i = 0; i < kMaxEntries; ++i) {
+    ASSERT_TRUE(cache.Insert("style", absl::StrCat("content", i)).ok());
+  }
+  EXPECT_EQ(entry_count(), kMaxEntries);
+
+  // Make all entries old, then use one of them.  Setting timestamps apart
+  // explicitly avoids depending on the file system's timestamp resolution.
+  const auto old_time =
+      fs::file_time_type::clock::now() - std::chrono::hours(1);
+  for (const auto& entry : fs::directory_iterator(dir)) {
+    fs::last_write_time(entry.path(), old_time);
+  }
+  EXPECT_TRUE(cache.Contains("style", "content3"));
+
+  // Inserting beyond the bound removes the least recently used entries.
+  ASSERT_TRUE(cache.Insert("style", "new content").ok());
+  EXPECT_LE(entry_count(), kMaxEntries);
+  EXPECT_TRUE(cache.Contains("style", "content3"));
+  EXPECT_TRUE(cache.Contains("style", "new content"));
+
+  // The bound holds after every insertion.
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(cache.Insert("style", absl::StrCat("more content", i)).ok());
+    EXPECT_LE(entry_count(), kMaxEntries);
+  }
+}
+
+// Returns the number of cache entries (not temporary files) in 'dir'.
+static size_t CountEntries(const std::string& dir) {
+  size_t count = 0;
+  for (const auto& entry : fs::directory_iterator(dir)) {
+    if (entry.path().filename().string().find('.') == std::string::npos) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+TEST(FormatCacheTest, DirectoryIsListedOnlyWhenFull) {
+  const std::string dir =
+      verible::file::JoinPath(::testing::TempDir(), "format_cache_listing");
+  constexpr size_t kMaxEntries = 8;
+  const FormatCache cache(dir, kMaxEntries);
+  ASSERT_TRUE(cache.Insert("style", "first").ok());
+  EXPECT_EQ(CountEntries(dir), 1);
+
+  // Entries added behind this object's back (e.g. by another process) are not
+  // seen by insertions while its own count is within the bound...
+  const auto old_time =
+      fs::file_time_type::clock::now() - std::chrono::hours(1);
+  for (int i = 0; i < 20; ++i) {
+    // Named like entries, i.e. 32 hex digits.
+    const std::string path = verible::file::JoinPath(
+        dir, absl::StrCat(std::string(30, 'f'), absl::Hex(i, absl::kZeroPad2)));
+    ASSERT_TRUE(verible::file::SetContents(path, "").ok());
+    fs::last_write_time(path, old_time);
+  }
+  for (size_t i = 2; i <= kMaxEntries; ++i) {
+    ASSERT_TRUE(cache.Insert("style", absl::StrCat("content", i)).ok());
+    EXPECT_EQ(CountEntries(dir), 20 + i);
+  }
+
+  // ... but once that exceeds the bound, the directory is listed again, and
+  // the oldest entries are removed.
+  ASSERT_TRUE(cache.Insert("style", "one too many").ok());
+  EXPECT_EQ(CountEntries(dir), kMaxEntries * 3 / 4);
+  EXPECT_TRUE(cache.Contains("style", "one too many"));
+}
+
+TEST(FormatCacheTest, TemporaryFilesAreNotEntries) {
+  const std::string dir =
+      verible::file::JoinPath(::testing::TempDir(), "format_cache_temporary");
+  constexpr size_t kMaxEntries = 4;
+  const FormatCache cache(dir, kMaxEntries);
+  ASSERT_TRUE(cache.Insert("style", "first").ok());
+
+  // An insertion in progress by another process, older than all entries.
+  const std::string temp_path = verible::file::JoinPath(
+      dir, absl::StrCat(std::string(32, 'f'), ".tmp-1-0"));
+  ASSERT_TRUE(verible::file::SetContents(temp_path, "").ok());
+  fs::last_write_time(temp_path,
+                      fs::file_time_type::clock::now() - std::chrono::hours(1));
+
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(cache.Insert("style", absl::StrCat("content", i)).ok());
+    EXPECT_LE(CountEntries(dir), kMaxEntries);
+  }
+  EXPECT_TRUE(fs::exists(temp_path));
+}
+
+}  // namespace
+}  // namespace formatter
+}  // namespace verilog
@@ -0,0 +1,80 @@
+#!/bin/bash
+# Copyright 2017-2020 The Verible Authors.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Tests the --jobs flag of verible-verilog-format with multiple --inplace files.
+
+declare -r MY_EXPECT_FILE="${TEST_TMPDIR}/myexpect.txt"
+declare -r MY_FORMATTED_FILE="${TEST_TMPDIR}/formatted.sv"
+
+# Get tool from argument
+[[ "$#" == 1 ]] || {
+  echo "Expecting 1 positional argument, verible-verilog-format path."
+  exit 1
+}
+formatter="$(rlocation ${TEST_WORKSPACE}/$1)"
+
+cat >${MY_EXPECT_FILE} <<EOF
+module m;
+endmodule
+EOF
+
+# Will overwrite these files in-place.
+declare -a files
+for i in 1 2 3 4 5 6 7 8; do
+  files+=("${TEST_TMPDIR}/in${i}.sv")
+  cat >"${TEST_TMPDIR}/in${i}.sv" <<EOF
+  module    m   ;endmodule
+EOF
+done
+
+# An already formatted file must not be rewritten.
+cp "${MY_EXPECT_FILE}" "${MY_FORMATTED_FILE}"
+touch -d "2000-01-01 00:00:00" "${MY_FORMATTED_FILE}"
+declare -r BEFORE_MTIME="$(stat -c %Y "${MY_FORMATTED_FILE}")"
+
+# Run formatter.
+${formatter} --inplace --jobs=3 "${files[@]}" "${MY_FORMATTED_FILE}" || exit 1
+
+for f in "${files[@]}" "${MY_FORMATTED_FILE}"; do
+  diff --strip-trailing-cr "$f" "${MY_EXPECT_FILE}" || exit 2
+done
+
+[[ "$(stat -c %Y "${MY_FORMATTED_FILE}")" == "${BEFORE_MTIME}" ]] || {
+  echo "Already formatted file was rewritten."
+  exit 3
+}
+
+# No temporary files are left behind.
+if ls "${TEST_TMPDIR}" | grep -q '\.tmp-'; then
+  echo "Temporary files were left behind."
+  exit 4
+fi
+
+# Standard input among the files is formatted to stdout, whole.
+declare -r MY_OUTPUT_FILE="${TEST_TMPDIR}/myoutput.txt"
+for i in 1 2 3 4 5 6 7 8; do
+  cat >"${TEST_TMPDIR}/in${i}.sv" <<EOF
+  module    m   ;endmodule
+EOF
+done
+echo "  module    m   ;endmodule" |
+  ${formatter} --inplace --jobs=3 "${files[@]:0:4}" - "${files[@]:4}" \
+    >"${MY_OUTPUT_FILE}" || exit 5
+diff --strip-trailing-cr "${MY_OUTPUT_FILE}" "${MY_EXPECT_FILE}" || exit 6
+for f in "${files[@]}"; do
+  diff --strip-trailing-cr "$f" "${MY_EXPECT_FILE}" || exit 7
+done
+
+echo "PASS"
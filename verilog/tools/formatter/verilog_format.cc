@@ -22,11 +22,16 @@
 //   0: stdout output can be used to replace original file
 //   nonzero: stdout output (if any) should be discarded
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>  // IWYU pragma: keep  // for ostringstream
 #include <string>   // for string, allocator, etc
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
@@ -36,7 +41,9 @@
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "common/formatting/align.h"
+#include "common/strings/mem_block.h"
 #include "common/strings/position.h"
 #include "common/util/file_util.h"
 #include "common/util/init_command_line.h"
@@ -44,14 +51,17 @@
 #include "common/util/logging.h"  // for operator<<, LOG, LogMessage, etc
 #include "verilog/formatting/format_style.h"
 #include "verilog/formatting/formatter.h"
+#include "verilog/tools/formatter/format_cache.h"
 
 using absl::StatusCode;
 using verible::AlignmentPolicy;
 using verible::IndentationStyle;
 using verible::LineNumberSet;
 using verilog::formatter::ExecutionControl;
+using verilog::formatter::FormatCache;
 using verilog::formatter::FormatStyle;
 using verilog::formatter::FormatVerilog;
+using verilog::formatter::VerificationMode;
 
 // Pseudo-singleton, so that repeated flag occurrences accumulate values.
 //   --flag x --flag y yields [x, y]
@@ -102,9 +112,20 @@ ABSL_FLAG(bool, failsafe_success, true,
 ABSL_FLAG(bool, verify_convergence, true,
           "If true, and not incrementally formatting with --lines, "
           "verify that re-formatting the formatted output yields "
-          "no further changes, i.e. formatting is convergent.");
+          "no further changes, i.e. formatting is convergent.  "
+          "Requires --verify other than none.");
+ABSL_FLAG(VerificationMode, verify, VerificationMode::kNone,
+          "Checking of formatted output against the input: "
+          "none, lexical (lex the output only, and compare tokens), or "
+          "full (also re-parse the output).");
+ABSL_FLAG(double, full_verification_rate, 0.0,
+          "With --verify=lexical, the fraction [0, 1] of files, chosen at "
+          "random, that are verified fully, as with --verify=full.");
 
 ABSL_FLAG(bool, verbose, false, "Be more verbose.");
+ABSL_FLAG(int, jobs, 1,
+          "Number of files to format concurrently with --inplace.  "
+          "0 means use all available hardware threads.");
 
 ABSL_FLAG(int, show_largest_token_partitions, 0,
           "If > 0, print token partitioning and then "
@@ -118,6 +139,23 @@ ABSL_FLAG(bool, show_inter_token_info, false,
 ABSL_FLAG(bool, show_equally_optimal_wrappings, false,
           "If true, print when multiple optimal solutions are found (stderr), "
           "but continue to operate normally.");
+ABSL_FLAG(absl::Duration, time_budget, absl::InfiniteDuration(),
+          "Wall-time limit per file, e.g. 100ms.  Code that could not be "
+          "formatted in time keeps its original spacing, and its lines are "
+          "reported (stderr).");
+ABSL_FLAG(int, show_formatting_profile, 0,
+          "If > 0, print (stderr) a JSON report of wall time per formatter "
+          "phase, a histogram of line-wrap search states per partition, and "
+          "this many most expensive partitions.");
+ABSL_FLAG(std::string, format_cache_dir, "",
+          "If non-empty, remember in this directory which file contents are "
+          "already formatted (with the same tool version, style and search "
+          "limits), and skip them on subsequent runs.  The directory may be "
+          "shared by concurrent invocations.  Only used when formatting whole "
+          "files.");
+ABSL_FLAG(int, format_cache_max_entries, 100000,
+          "Maximum number of entries kept in --format_cache_dir; the least "
+          "recently used ones are removed first.");
 ABSL_FLAG(int, max_search_states, 100000,
           "Limits the number of search states explored during "
           "line wrap optimization.");
@@ -177,32 +215,96 @@ ABSL_FLAG(bool, try_wrap_long_lines, false,
           "decisions where wrapping is needed, else leave them unformatted.  "
           "This is a short-term measure to reduce risk-of-harm.");
 
-static std::ostream& FileMsg(absl::string_view filename) {
-  std::cerr << filename << ": ";
-  return std::cerr;
+static std::ostream& FileMsg(std::ostream& messages,
+                             absl::string_view filename) {
+  messages << filename << ": ";
+  return messages;
 }
 
+// Returns a string that identifies everything besides the file content that
+// can affect formatted output.  This includes the search limits: a file can
+// be a fixed point under a small budget, but not under a larger one.
+static std::string FormatFingerprint(const FormatStyle& style,
+                                     const ExecutionControl& control) {
+  return absl::StrCat(
+      verible::GetBuildVersion(), "|", control.max_search_states, ",",
+      absl::FormatDuration(control.time_budget), "|", style.indentation_spaces,
+      ",", style.wrap_spaces, ",", style.column_limit, ",",
+      style.over_column_limit_penalty, "|",
+      absl::StrJoin(
+          {
+              style.port_declarations_indentation,
+              style.named_parameter_indentation,
+              style.named_port_indentation,
+              style.formal_parameters_indentation,
+          },
+          ",", absl::StreamFormatter()),
+      "|",
+      absl::StrJoin(
+          {
+              style.port_declarations_alignment,
+              style.struct_union_members_alignment,
+              style.named_parameter_alignment,
+              style.named_port_alignment,
+              style.module_net_variable_alignment,
+              style.assignment_statement_alignment,
+              style.enum_assignment_statement_alignment,
+              style.formal_parameters_alignment,
+              style.class_member_variable_alignment,
+              style.case_items_alignment,
+              style.distribution_items_alignment,
+          },
+          ",", absl::StreamFormatter()),
+      "|", style.try_wrap_long_lines, style.expand_coverpoints,
+      style.compact_indexing_and_selections);
+}
+
+// Returns the cache of already formatted contents, or nullptr if disabled.
+static const FormatCache* GetFormatCache() {
+  static const FormatCache* const cache = []() -> const FormatCache* {
+    const std::string dir = absl::GetFlag(FLAGS_format_cache_dir);
+    if (dir.empty()) return nullptr;
+    if (verible::GetBuildVersion().empty()) {
+      // Without a version stamp, entries from different builds could not
+      // be told apart.
+      LOG(WARNING) << "--format_cache_dir ignored in unversioned build.";
+      return nullptr;
+    }
+    return new FormatCache(dir, absl::GetFlag(FLAGS_format_cache_max_entries));
+  }();
+  return cache;
+}
+
+// Formats one file.  Diagnostics are written to 'messages', and formatted
+// text that is not written in-place (and diagnostic dumps) to 'output', which
+// allows concurrent invocations to keep their results separate.
 static bool formatOneFile(absl::string_view filename,
-                          const LineNumberSet& lines_to_format) {
+                          const LineNumberSet& lines_to_format,
+                          std::ostream& messages = std::cerr,
+                          std::ostream& output = std::cout) {
   const bool inplace = absl::GetFlag(FLAGS_inplace);
   const bool is_stdin = filename == "-";
   const auto& stdin_name = absl::GetFlag(FLAGS_stdin_name);
 
   if (inplace && is_stdin) {
-    FileMsg(filename)
+    FileMsg(messages, filename)
         << "--inplace is incompatible with stdin.  Ignoring --inplace "
         << "and writing to stdout." << std::endl;
   }
 
   const auto diagnostic_filename = is_stdin ? stdin_name : filename;
 
-  // Read contents into memory first.
-  std::string content;
-  absl::Status status = verible::file::GetContents(filename, &content);
+  // Read contents into memory first.  The formatter shares this block
+  // instead of copying it.
+  auto content_block = verible::file::GetContentAsMemBlock(filename);
+  absl::Status status = content_block.status();
   if (!status.ok()) {
-    FileMsg(filename) << status << std::endl;
+    FileMsg(messages, filename) << status << std::endl;
     return false;
   }
+  const std::shared_ptr<verible::MemBlock> content_owner =
+      std::move(*content_block);
+  const absl::string_view content = content_owner->AsStringView();
 
   // TODO(fangism): When requesting --inplace, verify that file
   // is write-able, and fail-early if it is not.
@@ -214,7 +316,7 @@ static bool formatOneFile(absl::string_view filename,
   ExecutionControl formatter_control;
   {
     // execution control flags
-    formatter_control.stream = &std::cout;  // for diagnostics only
+    formatter_control.stream = &output;  // for diagnostics only
     formatter_control.show_largest_token_partitions =
         absl::GetFlag(FLAGS_show_largest_token_partitions);
     formatter_control.show_token_partition_tree =
@@ -227,6 +329,16 @@ static bool formatOneFile(absl::string_view filename,
         absl::GetFlag(FLAGS_max_search_states);
     formatter_control.verify_convergence =
         absl::GetFlag(FLAGS_verify_convergence);
+    formatter_control.verification = absl::GetFlag(FLAGS_verify);
+    formatter_control.full_verification_rate =
+        absl::GetFlag(FLAGS_full_verification_rate);
+    formatter_control.time_budget = absl::GetFlag(FLAGS_time_budget);
+    formatter_control.show_formatting_profile =
+        absl::GetFlag(FLAGS_show_formatting_profile);
+    if (formatter_control.show_formatting_profile > 0) {
+      // Keep stdout clean for formatted output.
+      formatter_control.stream = &messages;
+    }
 
     // formatting style flags
     format_style.try_wrap_long_lines = absl::GetFlag(FLAGS_try_wrap_long_lines);
@@ -263,51 +375,98 @@ static bool formatOneFile(absl::string_view filename,
         absl::GetFlag(FLAGS_assignment_statement_alignment);
   }
 
-  std::ostringstream stream;
-  const auto format_status =
-      FormatVerilog(content, diagnostic_filename, format_style, stream,
-                    lines_to_format, formatter_control);
+  // The cache only applies to whole files, and to plain formatting runs.
+  const FormatCache* cache =
+      (lines_to_format.empty() &&
+       formatter_control.show_largest_token_partitions == 0 &&
+       !formatter_control.show_token_partition_tree &&
+       !formatter_control.show_equally_optimal_wrappings &&
+       formatter_control.show_formatting_profile == 0)
+          ? GetFormatCache()
+          : nullptr;
+  std::string fingerprint;
+  if (cache != nullptr) {
+    fingerprint = FormatFingerprint(format_style, formatter_control);
+    if (cache->Contains(fingerprint, content)) {
+      if (absl::GetFlag(FLAGS_verbose)) {
+        FileMsg(messages, filename)
+            << "Already formatted (cached), no change." << std::endl;
+      }
+      if (!inplace || is_stdin) output << content;
+      return true;
+    }
+  }
+
+  std::string formatted_output;
+  LineNumberSet unformatted_lines;
+  const auto format_status = FormatVerilog(
+      content_owner, diagnostic_filename, format_style, &formatted_output,
+      lines_to_format, formatter_control, &unformatted_lines);
+  if (!unformatted_lines.empty()) {
+    // Same 1-based N-M notation as --lines.
+    std::vector<std::string> ranges;
+    for (const auto& range : unformatted_lines) {
+      ranges.push_back(range.second - range.first == 1
+                           ? absl::StrCat(range.first)
+                           : absl::StrCat(range.first, "-", range.second - 1));
+    }
+    FileMsg(messages, filename)
+        << "Time budget exceeded, left unformatted lines: "
+        << absl::StrJoin(ranges, ",") << std::endl;
+  }
 
-  const std::string& formatted_output(stream.str());
   if (!format_status.ok()) {
     if (!inplace) {
       // Fall back to printing original content regardless of error condition.
-      std::cout << content;
+      output << content;
     }
     switch (format_status.code()) {
       case StatusCode::kCancelled:
       case StatusCode::kInvalidArgument:
-        FileMsg(filename) << format_status.message() << std::endl;
+        FileMsg(messages, filename) << format_status.message() << std::endl;
         break;
       case StatusCode::kDataLoss:
-        FileMsg(filename) << format_status.message()
-                          << "; problematic formatter output is\n"
-                          << formatted_output << "<<EOF>>" << std::endl;
+        FileMsg(messages, filename)
+            << format_status.message() << "; problematic formatter output is\n"
+            << formatted_output << "<<EOF>>" << std::endl;
         break;
       default:
-        FileMsg(filename) << format_status.message() << "[other error status]"
-                          << std::endl;
+        FileMsg(messages, filename)
+            << format_status.message() << "[other error status]" << std::endl;
         break;
     }
 
     return absl::GetFlag(FLAGS_failsafe_success);
   }
 
+  if (cache != nullptr && unformatted_lines.empty() &&
+      content == formatted_output) {
+    // Failing to record is not an error, only a missed optimization.
+    status = cache->Insert(fingerprint, content);
+    if (!status.ok()) {
+      VLOG(1) << "format cache: " << status;
+    }
+  }
+
   // Safe to write out result, having passed above verification.
   if (inplace && !is_stdin) {
     // Don't write if the output is exactly as the input, so that we don't mess
     // with tools that look for timestamp changes (such as make).
     if (content != formatted_output) {
-      status = verible::file::SetContents(filename, formatted_output);
+      // Write to a temporary file and rename, so that an interrupted run
+      // never leaves a truncated source file behind.
+      status = verible::file::SetContentsAtomically(filename, formatted_output);
       if (!status.ok()) {
-        FileMsg(filename) << "error writing result " << status << std::endl;
+        FileMsg(messages, filename)
+            << "error writing result " << status << std::endl;
         return false;
       }
     } else if (absl::GetFlag(FLAGS_verbose)) {
-      FileMsg(filename) << "Already formatted, no change." << std::endl;
+      FileMsg(messages, filename)
+          << "Already formatted, no change." << std::endl;
     }
   } else {
-    std::cout << formatted_output;
+    output << formatted_output;
   }
 
   return true;
@@ -349,12 +508,52 @@ int main(int argc, char** argv) {
     }
   }
 
-  bool all_success = true;
   // All positional arguments are file names.  Exclude program name.
-  for (const absl::string_view filename :
-       verible::make_range(file_args.begin() + 1, file_args.end())) {
-    all_success &= formatOneFile(filename, lines_to_format);
+  const std::vector<absl::string_view> filenames(file_args.begin() + 1,
+                                                 file_args.end());
+
+  int jobs = absl::GetFlag(FLAGS_jobs);
+  if (jobs <= 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+  // Concurrency only applies to in-place formatting, where outputs go to
+  // separate files.
+  if (!absl::GetFlag(FLAGS_inplace)) jobs = 1;
+  jobs = std::min<int>(jobs, filenames.size());
+
+  if (jobs <= 1) {
+    bool all_success = true;
+    for (const absl::string_view filename : filenames) {
+      all_success &= formatOneFile(filename, lines_to_format);
+    }
+    return all_success ? 0 : 1;
   }
 
+  // Workers pull the next file from a shared index.  Each file's diagnostics
+  // are buffered and printed as a whole to avoid interleaving.
+  // Standard output (e.g. formatting '-' from stdin) is collected per file,
+  // and printed in the order of the files once all are done.
+  std::atomic<size_t> next_file(0);
+  std::atomic<bool> all_success(true);
+  std::mutex messages_mutex;
+  std::vector<std::string> outputs(filenames.size());
+  const auto worker = [&]() {
+    for (size_t i = next_file++; i < filenames.size(); i = next_file++) {
+      std::ostringstream messages, output;
+      if (!formatOneFile(filenames[i], lines_to_format, messages, output)) {
+        all_success = false;
+      }
+      outputs[i] = output.str();
+      const std::string& text(messages.str());
+      if (!text.empty()) {
+        const std::lock_guard<std::mutex> lock(messages_mutex);
+        std::cerr << text << std::flush;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(jobs);
+  for (int j = 0; j < jobs; ++j) workers.emplace_back(worker);
+  for (auto& w : workers) w.join();
+  for (const std::string& output : outputs) std::cout << output;
+
   return all_success ? 0 : 1;
 }
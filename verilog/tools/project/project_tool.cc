@@ -15,11 +15,13 @@
 #include <functional>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/usage.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "common/util/file_util.h"
 #include "common/util/init_command_line.h"
@@ -27,6 +29,7 @@
 #include "common/util/subcommand.h"
 #include "verilog/analysis/dependencies.h"
 #include "verilog/analysis/symbol_table.h"
+#include "verilog/analysis/symbol_table_snapshot.h"
 #include "verilog/analysis/verilog_project.h"
 
 // Note: These flags were copied over from
@@ -51,6 +54,20 @@ e.g --include_dir_paths directory1,directory2
 if "A.sv" exists in both "directory1" and "directory2" the one in "directory1" is the one we will use.
 )");
 
+ABSL_FLAG(int, jobs, 1,
+          "Number of threads used to build and resolve the symbol table.  "
+          "0 means use all available hardware threads.");
+
+ABSL_FLAG(int, max_parsed_memory_mb, 0,
+          "If positive, limits the (estimated) memory used by the token "
+          "streams and syntax trees of parsed files to this many megabytes, "
+          "by re-parsing files as needed.  0 means unlimited.");
+
+ABSL_FLAG(std::string, symbol_table_snapshot, "",
+          "If non-empty, symbol-table-refs saves the resolved symbol table in "
+          "this file, and reuses it instead of rebuilding it for as long as "
+          "the project's configuration and files remain unchanged.");
+
 using verible::SubcommandArgsRange;
 using verible::SubcommandEntry;
 
@@ -87,6 +104,26 @@ struct VerilogProjectConfig {
 
     return absl::OkStatus();
   }
+
+  // Identifies everything besides file contents that affects the symbol
+  // table, for validating symbol table snapshots.  Fields are prefixed with
+  // their lengths, and lists with their sizes, so that no two configurations
+  // have the same fingerprint, whatever characters the paths contain.
+  std::string Fingerprint() const {
+    std::string fingerprint;
+    const auto add_field = [&fingerprint](absl::string_view field) {
+      absl::StrAppend(&fingerprint, field.length(), ":", field, ";");
+    };
+    const auto add_list = [&](const std::vector<std::string>& fields) {
+      absl::StrAppend(&fingerprint, fields.size(), ";");
+      for (const auto& field : fields) add_field(field);
+    };
+    add_field(verible::GetBuildVersion());
+    add_field(file_list_root);
+    add_list(include_dir_paths);
+    add_list(files_names);
+    return fingerprint;
+  }
 };
 
 // Holds VerilogProject and SymbolTable together with proper object lifetime.
@@ -117,6 +154,11 @@ struct ProjectSymbols {
     // Error-out early if any files failed to open.
     project = absl::make_unique<verilog::VerilogProject>(
         config.file_list_root, config.include_dir_paths);
+    const int max_parsed_memory_mb = absl::GetFlag(FLAGS_max_parsed_memory_mb);
+    if (max_parsed_memory_mb > 0) {
+      project->SetParsedMemoryBudget(static_cast<size_t>(max_parsed_memory_mb)
+                                     << 20);
+    }
     for (const auto& file : config.files_names) {
       const auto open_status = project->OpenTranslationUnit(file);
       if (!open_status.ok()) return open_status.status();
@@ -132,14 +174,14 @@ struct ProjectSymbols {
     VLOG(1) << __FUNCTION__;
     // For now, ingest files in the order they were listed.
     // Without conflicting definitions in files, this order should not matter.
-    for (const auto& file : config.files_names) {
-      symbol_table->BuildSingleTranslationUnit(file, build_statuses);
-    }
+    symbol_table->BuildTranslationUnitsConcurrently(
+        config.files_names, build_statuses, absl::GetFlag(FLAGS_jobs));
   }
 
   // Resolves symbols.
   void Resolve(std::vector<absl::Status>* resolve_statuses) {
-    symbol_table->Resolve(resolve_statuses);
+    symbol_table->ResolveConcurrently(resolve_statuses,
+                                      absl::GetFlag(FLAGS_jobs));
   }
 };
 
@@ -188,6 +230,21 @@ static absl::Status BuildAndShowSymbolTable(const SubcommandArgsRange& args,
   return absl::OkStatus();
 }
 
+static absl::Status ShowSymbolReferences(
+    const verilog::SymbolTable& symbol_table,
+    const std::vector<absl::Status>& statuses, std::ostream& outs) {
+  // Print.
+  outs << "Symbol References:" << std::endl;
+  symbol_table.PrintSymbolReferences(outs) << std::endl;
+
+  // Accumulate diagnostics.
+  if (!statuses.empty()) {
+    return absl::InvalidArgumentError(JoinStatusMessages(statuses));
+  }
+
+  return absl::OkStatus();
+}
+
 static absl::Status ResolveAndShowSymbolReferences(
     const SubcommandArgsRange& args, std::istream& ins, std::ostream& outs,
     std::ostream& errs) {
@@ -199,6 +256,26 @@ static absl::Status ResolveAndShowSymbolReferences(
     if (!status.ok()) return status;
   }
 
+  // Reuse the previous results if none of the files changed.
+  const std::string snapshot_path = absl::GetFlag(FLAGS_symbol_table_snapshot);
+  const std::string fingerprint = config.Fingerprint();
+  if (!snapshot_path.empty()) {
+    const auto snapshot = verilog::SymbolTableSnapshot::Open(snapshot_path);
+    if (!snapshot.ok()) {
+      VLOG(1) << "Not using symbol table snapshot: " << snapshot.status();
+    } else if ((*snapshot)->Fingerprint() != fingerprint) {
+      VLOG(1) << "Not using symbol table snapshot of another configuration.";
+    } else {
+      const std::vector<std::string> stale_files = (*snapshot)->StaleFiles();
+      if (stale_files.empty()) {
+        return ShowSymbolReferences((*snapshot)->Table(),
+                                    (*snapshot)->Diagnostics(), outs);
+      }
+      VLOG(1) << "Not using symbol table snapshot, changed files: "
+              << absl::StrJoin(stale_files, ", ");
+    }
+  }
+
   // Load project and files.
   ProjectSymbols project_symbols(config);
   {
@@ -213,16 +290,17 @@ static absl::Status ResolveAndShowSymbolReferences(
   // Resolve symbols.
   project_symbols.Resolve(&statuses);
 
-  // Print.
-  outs << "Symbol References:" << std::endl;
-  project_symbols.symbol_table->PrintSymbolReferences(outs) << std::endl;
-
-  // Accumulate diagnostics.
-  if (!statuses.empty()) {
-    return absl::InvalidArgumentError(JoinStatusMessages(statuses));
+  if (!snapshot_path.empty()) {
+    // Failing to save is not an error, only a missed optimization.
+    const auto status = verilog::SymbolTableSnapshot::Write(
+        *project_symbols.symbol_table, statuses, fingerprint, snapshot_path);
+    if (!status.ok()) {
+      errs << "Failed to save symbol table snapshot: " << status.message()
+           << std::endl;
+    }
   }
 
-  return absl::OkStatus();
+  return ShowSymbolReferences(*project_symbols.symbol_table, statuses, outs);
 }
 
 static absl::Status ShowFileDependencies(const SubcommandArgsRange& args,
@@ -266,6 +344,56 @@ static absl::Status ShowFileDependencies(const SubcommandArgsRange& args,
   return absl::OkStatus();
 }
 
+static absl::Status ShowFileCompileOrder(const SubcommandArgsRange& args,
+                                         std::istream& ins, std::ostream& outs,
+                                         std::ostream& errs) {
+  VLOG(1) << __FUNCTION__;
+  // Load configuration.
+  VerilogProjectConfig config;
+  {
+    const auto status = config.LoadFromGlobalFlags();
+    if (!status.ok()) return status;
+  }
+
+  // Load project and files.
+  ProjectSymbols project_symbols(config);
+  {
+    const auto status = project_symbols.Load();
+    if (!status.ok()) return status;
+  }
+
+  // Build symbol table.
+  std::vector<absl::Status> statuses;
+  project_symbols.Build(&statuses);
+
+  // Accumulate diagnostics.
+  if (!statuses.empty()) {
+    return absl::InvalidArgumentError(JoinStatusMessages(statuses));
+  }
+
+  // Partially resolve symbols.
+  project_symbols.symbol_table->ResolveLocallyOnly();
+
+  // Compute dependencies, and order all listed files, including those that
+  // neither define nor reference any symbols.
+  const verilog::FileDependencies deps(*project_symbols.symbol_table);
+  std::vector<const verilog::VerilogSourceFile*> files;
+  for (const auto& file_name : config.files_names) {
+    const auto* file =
+        project_symbols.project->LookupRegisteredFile(file_name);
+    if (file != nullptr) files.push_back(file);
+  }
+  const verilog::FileCompileOrder order(deps.CompileOrder(files));
+
+  // Print.
+  order.PrintLevels(outs);
+  if (order.HasCycles()) {
+    errs << "Warning: files in braces depend on each other cyclically."
+         << std::endl;
+  }
+  return absl::OkStatus();
+}
+
 static const std::pair<absl::string_view, SubcommandEntry> kCommands[] = {
     {"symbol-table-defs",        //
      {&BuildAndShowSymbolTable,  //
@@ -283,6 +411,7 @@ Project options, including source file list.
 
 Prints human-readable representation of symbol table references, after
 attempting to resolve symbols.
+With --symbol_table_snapshot, the results are reused while no file changes.
 
 Input:
 Project options, including source file list.
@@ -295,6 +424,22 @@ Prints human-readable representation of inter-file dependencies, e.g.
 
   "file1.sv" depends on "file2.sv" for symbols { X, Y, Z... }
 
+Input:
+Project options, including source file list.
+)"}},
+    {"file-order",            //
+     {&ShowFileCompileOrder,  //
+      R"(file-order [project args]
+
+Prints the files grouped by dependency level, in compile order, e.g.
+
+  level 0: "base.sv" { "cycle1.sv" "cycle2.sv" }
+  level 1: "top.sv"
+
+Every file only depends on files of lower levels (or on files in the same
+braces, which depend on each other cyclically), so the files of each level
+can be compiled concurrently.
+
 Input:
 Project options, including source file list.
 )"}},
@@ -232,6 +232,62 @@ grep -q "[combined statuses]:" "$MY_OUTPUT_FILE" || {
   exit 1
 }
 
+################################################################################
+echo "=== Reuse symbol table snapshot while files are unchanged."
+
+MY_SNAPSHOT_FILE="${TEST_TMPDIR}/symbols.snapshot"
+rm -f "$MY_SNAPSHOT_FILE"
+
+cat > "$MY_INPUT_FILE" <<EOF
+localparam int fooo = 1;
+localparam int barr = fooo;
+EOF
+
+echo "myinput.txt" > "$FILE_LIST_INPUT"
+for run in build reuse; do
+  "$project_tool" \
+    symbol-table-refs \
+    --file_list_path "$FILE_LIST_INPUT" \
+    --file_list_root "$(dirname "$MY_INPUT_FILE")" \
+    --symbol_table_snapshot "$MY_SNAPSHOT_FILE" \
+    > "$MY_OUTPUT_FILE.$run" 2>&1
+
+  status="$?"
+  [[ $status == 0 ]] || {
+    echo "Expected exit code 0 ($run), but got $status"
+    exit 1
+  }
+done
+
+[[ -f "$MY_SNAPSHOT_FILE" ]] || {
+  echo "Expected snapshot file $MY_SNAPSHOT_FILE to be written."
+  exit 1
+}
+
+diff "$MY_OUTPUT_FILE.build" "$MY_OUTPUT_FILE.reuse" || {
+  echo "Expected the same symbol references from the snapshot."
+  exit 1
+}
+
+# Changing a file invalidates the snapshot.
+cat > "$MY_INPUT_FILE" <<EOF
+localparam int quux = 1;
+localparam int barr = quux;
+EOF
+
+"$project_tool" \
+  symbol-table-refs \
+  --file_list_path "$FILE_LIST_INPUT" \
+  --file_list_root "$(dirname "$MY_INPUT_FILE")" \
+  --symbol_table_snapshot "$MY_SNAPSHOT_FILE" \
+  > "$MY_OUTPUT_FILE" 2>&1
+
+grep -q "(@quux -> \$root::quux)" "$MY_OUTPUT_FILE" || {
+  echo "Expected \"(@quux -> \$root::quux)\" in $MY_OUTPUT_FILE but didn't find it.  Got:"
+  cat "$MY_OUTPUT_FILE"
+  exit 1
+}
+
 ################################################################################
 echo "=== Show dependencies between two files (parameters)"
 
@@ -305,5 +361,51 @@ EOF
 
 diff --strip-trailing-cr -u "$MY_EXPECT_FILE" "$MY_OUTPUT_FILE" || { exit 1; }
 
+################################################################################
+echo "=== Show compile order of files"
+
+cat > "$MY_INPUT_FILE".A <<EOF
+module mm;
+endmodule
+EOF
+
+cat > "$MY_INPUT_FILE".B <<EOF
+module qq;
+  mm mm_inst();
+  rr rr_inst();
+endmodule
+EOF
+
+cat > "$MY_INPUT_FILE".C <<EOF
+module rr;
+  mm mm_inst();
+endmodule
+EOF
+
+# Construct a file-list on-the-fly as a file-descriptor
+FILE_LIST_INPUT="${TEST_TMPDIR}/myinputlist.txt"
+echo "myinput.txt.B" > "$FILE_LIST_INPUT"
+echo "myinput.txt.C" >> "$FILE_LIST_INPUT"
+echo "myinput.txt.A" >> "$FILE_LIST_INPUT"
+"$project_tool" \
+  file-order \
+  --file_list_path "$FILE_LIST_INPUT" \
+  --file_list_root "$(dirname "$MY_INPUT_FILE".A)" \
+  > "$MY_OUTPUT_FILE" 2>&1
+
+status="$?"
+[[ $status == 0 ]] || {
+  "Expected exit code 0, but got $status"
+  exit 1
+}
+
+cat > "$MY_EXPECT_FILE" <<EOF
+level 0: "myinput.txt.A"
+level 1: "myinput.txt.C"
+level 2: "myinput.txt.B"
+EOF
+
+diff --strip-trailing-cr -u "$MY_EXPECT_FILE" "$MY_OUTPUT_FILE" || { exit 1; }
+
 ################################################################################
 echo "PASS"